@@ -99,6 +99,35 @@ typedef struct mdns_result_s {
 
 typedef void (*mdns_query_notify_t)(mdns_search_once_t *search);
 
+/**
+ * @brief   Usage of one of the fixed capacity pools of the mDNS server
+ */
+typedef struct {
+    uint16_t size;                          /*!< number of entries of the pool */
+    uint16_t used;                          /*!< entries in use */
+    uint16_t peak;                          /*!< most entries in use at once */
+    uint32_t exhausted;                     /*!< allocations failed because the pool was empty */
+} mdns_pool_stats_t;
+
+/**
+ * @brief   mDNS server statistics
+ */
+typedef struct {
+    mdns_pool_stats_t rx_packets;           /*!< received packets pending to the mDNS task (CONFIG_MDNS_RX_POOL_SIZE) */
+    mdns_pool_stats_t questions;            /*!< questions of the packet being parsed (CONFIG_MDNS_QUESTION_POOL_SIZE) */
+    mdns_pool_stats_t actions;              /*!< actions pending to the mDNS task (CONFIG_MDNS_ACTION_POOL_SIZE) */
+    mdns_pool_stats_t results;              /*!< records received from other hosts, kept to answer queries (CONFIG_MDNS_RESULT_CACHE_SIZE),
+                                                 exhausted also counts records too large for an entry */
+    mdns_pool_stats_t responses;            /*!< serialized responses kept to answer repeated queries (CONFIG_MDNS_RESPONSE_CACHE_SIZE),
+                                                 exhausted also counts responses with too many answers for an entry */
+    uint32_t response_cache_hits;           /*!< responses sent from the response cache */
+    uint32_t response_cache_misses;         /*!< cacheable responses that had to be built */
+    uint32_t answers_suppressed;            /*!< answers left out because the querier listed them as known answers */
+    uint32_t answers_split;                 /*!< answers sent in continuation packets, after the first one was full */
+    uint32_t result_cache_hits;             /*!< queries answered from received records (CONFIG_MDNS_RESULT_CACHE_SIZE) */
+    uint32_t result_cache_misses;           /*!< queries sent to the network */
+} mdns_stats_t;
+
 /**
  * @brief  Initialize mDNS on given interface
  *
@@ -587,6 +616,8 @@ mdns_search_once_t *mdns_query_async_new(const char *name, const char *service_t
 /**
  * @brief  Generic mDNS query
  *         All following query methods are derived from this one
+ *         Queries answered by records received earlier, whose TTL has not run out, return without waiting
+ *         (see CONFIG_MDNS_RESULT_CACHE_SIZE)
  *
  * @param  name         service instance or host name (NULL for PTR queries)
  * @param  service_type service type (_http, _arduino, _ftp etc.) (NULL for host queries)
@@ -768,6 +799,17 @@ esp_err_t mdns_unregister_netif(esp_netif_t *esp_netif);
  */
 esp_err_t mdns_netif_action(esp_netif_t *esp_netif, mdns_event_actions_t event_action);
 
+/**
+ * @brief   Get statistics of the mDNS server
+ *
+ * @param   stats Filled with the current statistics
+ * @return
+ *     - ESP_OK success
+ *     - ESP_ERR_INVALID_STATE  mDNS is not running
+ *     - ESP_ERR_INVALID_ARG    stats is NULL
+ */
+esp_err_t mdns_get_stats(mdns_stats_t *stats);
+
 #ifdef __cplusplus
 }
 #endif
@@ -5,6 +5,7 @@
  */
 
 #include <string.h>
+#include <ctype.h>
 #include <sys/param.h>
 #include "freertos/FreeRTOS.h"
 #include "freertos/task.h"
@@ -43,6 +44,9 @@ static const char *MDNS_SUB_STR = "_sub";
 
 mdns_server_t *_mdns_server = NULL;
 static mdns_host_item_t *_mdns_host_list = NULL;
+static mdns_host_item_t **_mdns_host_index = NULL;
+static size_t _mdns_host_index_size = 0;
+static size_t _mdns_host_index_len = 0;
 static mdns_host_item_t _mdns_self_host;
 
 static const char *TAG = "mdns";
@@ -50,7 +54,17 @@ static const char *TAG = "mdns";
 static volatile TaskHandle_t _mdns_service_task_handle = NULL;
 static SemaphoreHandle_t _mdns_service_semaphore = NULL;
 
+static mdns_pool_t _mdns_action_pool;
+static mdns_action_t _mdns_action_blocks[MDNS_ACTION_POOL_SIZE];
+static mdns_pool_t _mdns_question_pool;
+static mdns_parsed_question_t _mdns_question_blocks[MDNS_QUESTION_POOL_SIZE];
+static mdns_pool_t _mdns_result_pool;
+static mdns_cached_record_t _mdns_result_blocks[MDNS_RESULT_CACHE_SIZE];
+static mdns_pool_t _mdns_response_pool;
+static mdns_response_t _mdns_response_blocks[MDNS_RESPONSE_CACHE_SIZE];
+
 static void _mdns_search_finish_done(void);
+static const char *_mdns_get_default_instance_name(void);
 static mdns_search_once_t *_mdns_search_find_from(mdns_search_once_t *search, mdns_name_t *name, uint16_t type, mdns_if_t tcpip_if, mdns_ip_protocol_t ip_protocol);
 static void _mdns_search_result_add_ip(mdns_search_once_t *search, const char *hostname, esp_ip_addr_t *ip,
                                        mdns_if_t tcpip_if, mdns_ip_protocol_t ip_protocol, uint32_t ttl);
@@ -235,6 +249,132 @@ static char *_mdns_mangle_name(char *in)
     return ret;
 }
 
+/**
+ * @brief  folds a name into a case-insensitive FNV-1a hash, NULL hashes as an empty name
+ */
+static uint32_t _mdns_hash_add(uint32_t hash, const char *name)
+{
+    if (name) {
+        while (*name) {
+            hash = (hash ^ (uint8_t)tolower((unsigned char) * name++)) * MDNS_HASH_PRIME;
+        }
+    }
+    // terminate the name, so that ("ab", "c") and ("a", "bc") hash differently
+    return (hash ^ '.') * MDNS_HASH_PRIME;
+}
+
+static inline uint32_t _mdns_service_type_hash(const char *service, const char *proto)
+{
+    return _mdns_hash_add(_mdns_hash_add(MDNS_HASH_INIT, service), proto) % MDNS_MAX_SERVICES;
+}
+
+static inline uint32_t _mdns_service_instance_hash(const char *instance, const char *service, const char *proto)
+{
+    return _mdns_hash_add(_mdns_hash_add(_mdns_hash_add(MDNS_HASH_INIT, instance), service), proto) % MDNS_MAX_SERVICES;
+}
+
+/**
+ * @brief  rebuilds the indexes of services by type and by instance name
+ *
+ * Called whenever a service is added, removed or renamed, and when the default instance name changes.
+ * Buckets keep the order of the service list, so lookups return the same service as a list scan would.
+ */
+static void _mdns_index_services(void)
+{
+    memset(_mdns_server->index.types, 0, sizeof(_mdns_server->index.types));
+    memset(_mdns_server->index.instances, 0, sizeof(_mdns_server->index.instances));
+    const char *default_instance = _mdns_get_default_instance_name();
+    mdns_srv_item_t *s = _mdns_server->services;
+    while (s) {
+        mdns_service_t *srv = s->service;
+        mdns_srv_item_t **tail = &_mdns_server->index.types[_mdns_service_type_hash(srv->service, srv->proto)];
+        while (*tail) {
+            tail = &(*tail)->type_next;
+        }
+        *tail = s;
+        s->type_next = NULL;
+        tail = &_mdns_server->index.instances[_mdns_service_instance_hash(srv->instance ? srv->instance : default_instance,
+                                                                          srv->service, srv->proto)];
+        while (*tail) {
+            tail = &(*tail)->instance_next;
+        }
+        *tail = s;
+        s->instance_next = NULL;
+        s = s->next;
+    }
+}
+
+/**
+ * @brief  get the bucket of the delegated host index where given hostname belongs
+ */
+static inline mdns_host_item_t **_mdns_host_index_bucket(const char *hostname)
+{
+    return &_mdns_host_index[_mdns_hash_add(MDNS_HASH_INIT, hostname) & (_mdns_host_index_size - 1)];
+}
+
+/**
+ * @brief  adds a delegated host to the host index, growing the index if it gets crowded
+ *
+ * @return false if the index could not be allocated
+ */
+static bool _mdns_host_index_add(mdns_host_item_t *host)
+{
+    if (_mdns_host_index_len >= _mdns_host_index_size) {
+        size_t size = _mdns_host_index_size ? _mdns_host_index_size * 2 : MDNS_HOST_INDEX_MIN_SIZE;
+        mdns_host_item_t **index = (mdns_host_item_t **)calloc(size, sizeof(mdns_host_item_t *));
+        if (index) {
+            free(_mdns_host_index);
+            _mdns_host_index = index;
+            _mdns_host_index_size = size;
+            // the new host is not in the list yet
+            for (mdns_host_item_t *h = _mdns_host_list; h; h = h->next) {
+                mdns_host_item_t **bucket = _mdns_host_index_bucket(h->hostname);
+                h->index_next = *bucket;
+                *bucket = h;
+            }
+        } else if (!_mdns_host_index) {
+            HOOK_MALLOC_FAILED;
+            return false;
+        }
+    }
+    mdns_host_item_t **bucket = _mdns_host_index_bucket(host->hostname);
+    host->index_next = *bucket;
+    *bucket = host;
+    _mdns_host_index_len++;
+    return true;
+}
+
+static void _mdns_host_index_remove(mdns_host_item_t *host)
+{
+    mdns_host_item_t **bucket = _mdns_host_index_bucket(host->hostname);
+    while (*bucket) {
+        if (*bucket == host) {
+            *bucket = host->index_next;
+            _mdns_host_index_len--;
+            return;
+        }
+        bucket = &(*bucket)->index_next;
+    }
+}
+
+/**
+ * @brief  finds a delegated host by its name
+ */
+static mdns_host_item_t *_mdns_host_index_find(const char *hostname)
+{
+    if (!_mdns_host_index) {
+        return NULL;
+    }
+    mdns_host_item_t *host = *_mdns_host_index_bucket(hostname);
+    while (host) {
+        if (strcasecmp(host->hostname, hostname) == 0) {
+            return host;
+        }
+        host = host->index_next;
+    }
+    return NULL;
+}
+
 static bool _mdns_service_match(const mdns_service_t *srv, const char *service, const char *proto,
                                 const char *hostname)
 {
@@ -256,19 +396,25 @@ static bool _mdns_service_match(const mdns_service_t *srv, const char *service,
  */
 static mdns_srv_item_t *_mdns_get_service_item(const char *service, const char *proto, const char *hostname)
 {
-    mdns_srv_item_t *s = _mdns_server->services;
+    if (!service || !proto) {
+        return NULL;
+    }
+    mdns_srv_item_t *s = _mdns_server->index.types[_mdns_service_type_hash(service, proto)];
     while (s) {
         if (_mdns_service_match(s->service, service, proto, hostname)) {
             return s;
         }
-        s = s->next;
+        s = s->type_next;
     }
     return NULL;
 }
 
 static mdns_srv_item_t *_mdns_get_service_item_subtype(const char *subtype, const char *service, const char *proto)
 {
-    mdns_srv_item_t *s = _mdns_server->services;
+    if (!service || !proto) {
+        return NULL;
+    }
+    mdns_srv_item_t *s = _mdns_server->index.types[_mdns_service_type_hash(service, proto)];
     while (s) {
         if (_mdns_service_match(s->service, service, proto, NULL)) {
             mdns_subtype_t *subtype_item = s->service->subtype;
@@ -279,7 +425,7 @@ static mdns_srv_item_t *_mdns_get_service_item_subtype(const char *subtype, cons
                 subtype_item = subtype_item->next;
             }
         }
-        s = s->next;
+        s = s->type_next;
     }
     return NULL;
 }
@@ -289,14 +435,7 @@ static mdns_host_item_t *mdns_get_host_item(const char *hostname)
     if (hostname == NULL || strcasecmp(hostname, _mdns_server->hostname) == 0) {
         return &_mdns_self_host;
     }
-    mdns_host_item_t *host = _mdns_host_list;
-    while (host != NULL) {
-        if (strcasecmp(host->hostname, hostname) == 0) {
-            return host;
-        }
-        host = host->next;
-    }
-    return NULL;
+    return _mdns_host_index_find(hostname);
 }
 
 static bool _mdns_can_add_more_services(void)
@@ -314,20 +453,106 @@ static bool _mdns_can_add_more_services(void)
     return true;
 }
 
+esp_err_t _mdns_pool_init(mdns_pool_t *pool, void *blocks, size_t block_size, size_t count)
+{
+    memset(pool, 0, sizeof(mdns_pool_t));
+    pool->lock = xSemaphoreCreateMutex();
+    if (!pool->lock) {
+        return ESP_ERR_NO_MEM;
+    }
+    for (size_t i = count; i > 0; i--) {
+        mdns_pool_block_t *block = (mdns_pool_block_t *)((uint8_t *)blocks + (i - 1) * block_size);
+        block->next = pool->free_blocks;
+        pool->free_blocks = block;
+    }
+    pool->stats.size = count;
+    return ESP_OK;
+}
+
+void _mdns_pool_deinit(mdns_pool_t *pool)
+{
+    if (pool->lock) {
+        vSemaphoreDelete(pool->lock);
+    }
+    memset(pool, 0, sizeof(mdns_pool_t));
+}
+
+void *_mdns_pool_alloc(mdns_pool_t *pool)
+{
+    if (!pool->lock) {
+        return NULL;
+    }
+    xSemaphoreTake(pool->lock, portMAX_DELAY);
+    mdns_pool_block_t *block = pool->free_blocks;
+    if (block) {
+        pool->free_blocks = block->next;
+        pool->stats.used++;
+        if (pool->stats.used > pool->stats.peak) {
+            pool->stats.peak = pool->stats.used;
+        }
+    } else {
+        pool->stats.exhausted++;
+    }
+    xSemaphoreGive(pool->lock);
+    return block;
+}
+
+void _mdns_pool_free(mdns_pool_t *pool, void *block)
+{
+    if (!block) {
+        return;
+    }
+    xSemaphoreTake(pool->lock, portMAX_DELAY);
+    ((mdns_pool_block_t *)block)->next = pool->free_blocks;
+    pool->free_blocks = block;
+    pool->stats.used--;
+    xSemaphoreGive(pool->lock);
+}
+
+void _mdns_pool_get_stats(mdns_pool_t *pool, mdns_pool_stats_t *stats)
+{
+    if (!pool->lock) {
+        memset(stats, 0, sizeof(mdns_pool_stats_t));
+        return;
+    }
+    xSemaphoreTake(pool->lock, portMAX_DELAY);
+    *stats = pool->stats;
+    xSemaphoreGive(pool->lock);
+}
+
+/**
+ * @brief  Take an action from the pool, its fields are left for the caller to set
+ */
+static mdns_action_t *_mdns_alloc_action(void)
+{
+    mdns_action_t *action = (mdns_action_t *)_mdns_pool_alloc(&_mdns_action_pool);
+    if (!action) {
+        ESP_LOGW(TAG, "No free action, all %d are pending", MDNS_ACTION_POOL_SIZE);
+    }
+    return action;
+}
+
+/**
+ * @brief  Return an action to the pool
+ */
+static void _mdns_release_action(mdns_action_t *action)
+{
+    _mdns_pool_free(&_mdns_action_pool, action);
+}
+
 esp_err_t _mdns_send_rx_action(mdns_rx_packet_t *packet)
 {
     mdns_action_t *action = NULL;
 
-    action = (mdns_action_t *)malloc(sizeof(mdns_action_t));
+    action = _mdns_alloc_action();
     if (!action) {
-        HOOK_MALLOC_FAILED;
         return ESP_ERR_NO_MEM;
     }
 
     action->type = ACTION_RX_HANDLE;
     action->data.rx_handle.packet = packet;
     if (xQueueSend(_mdns_server->action_queue, &action, (TickType_t)0) != pdPASS) {
-        free(action);
+        _mdns_release_action(action);
         return ESP_ERR_NO_MEM;
     }
     return ESP_OK;
@@ -385,18 +610,18 @@ static bool _mdns_service_match_instance(const mdns_service_t *srv, const char *
 static mdns_srv_item_t *_mdns_get_service_item_instance(const char *instance, const char *service, const char *proto,
         const char *hostname)
 {
-    mdns_srv_item_t *s = _mdns_server->services;
+    if (!instance) {
+        return _mdns_get_service_item(service, proto, hostname);
+    }
+    if (!service || !proto) {
+        return NULL;
+    }
+    mdns_srv_item_t *s = _mdns_server->index.instances[_mdns_service_instance_hash(instance, service, proto)];
     while (s) {
-        if (instance) {
-            if (_mdns_service_match_instance(s->service, instance, service, proto, hostname)) {
-                return s;
-            }
-        } else {
-            if (_mdns_service_match(s->service, service, proto, hostname)) {
-                return s;
-            }
+        if (_mdns_service_match_instance(s->service, instance, service, proto, hostname)) {
+            return s;
         }
-        s = s->next;
+        s = s->instance_next;
     }
     return NULL;
 }
@@ -465,6 +690,11 @@ static const uint8_t *_mdns_read_fqdn(const uint8_t *packet, const uint8_t *star
     return start + index + 1;
 }
 
+/**
+ * @brief  set when a record does not fit in the packet being built, so that it goes to the next packet
+ */
+static bool _mdns_packet_full;
+
 /**
  * @brief  sets uint16_t value in a packet
  *
@@ -493,6 +723,7 @@ static inline void _mdns_set_u16(uint8_t *packet, uint16_t index, uint16_t value
 static inline uint8_t _mdns_append_u8(uint8_t *packet, uint16_t *index, uint8_t value)
 {
     if (*index >= MDNS_MAX_PACKET_SIZE) {
+        _mdns_packet_full = true;
         return 0;
     }
     packet[*index] = value;
@@ -512,6 +743,7 @@ static inline uint8_t _mdns_append_u8(uint8_t *packet, uint16_t *index, uint8_t
 static inline uint8_t _mdns_append_u16(uint8_t *packet, uint16_t *index, uint16_t value)
 {
     if ((*index + 1) >= MDNS_MAX_PACKET_SIZE) {
+        _mdns_packet_full = true;
         return 0;
     }
     _mdns_append_u8(packet, index, (value >> 8) & 0xFF);
@@ -531,6 +763,7 @@ static inline uint8_t _mdns_append_u16(uint8_t *packet, uint16_t *index, uint16_
 static inline uint8_t _mdns_append_u32(uint8_t *packet, uint16_t *index, uint32_t value)
 {
     if ((*index + 3) >= MDNS_MAX_PACKET_SIZE) {
+        _mdns_packet_full = true;
         return 0;
     }
     _mdns_append_u8(packet, index, (value >> 24) & 0xFF);
@@ -553,6 +786,7 @@ static inline uint8_t _mdns_append_u32(uint8_t *packet, uint16_t *index, uint32_
 static inline uint8_t _mdns_append_type(uint8_t *packet, uint16_t *index, uint8_t type, bool flush, uint32_t ttl)
 {
     if ((*index + 10) >= MDNS_MAX_PACKET_SIZE) {
+        _mdns_packet_full = true;
         return 0;
     }
     uint16_t mdns_class = MDNS_CLASS_IN;
@@ -585,6 +819,7 @@ static inline uint8_t _mdns_append_type(uint8_t *packet, uint16_t *index, uint8_
 static inline uint8_t _mdns_append_string_with_len(uint8_t *packet, uint16_t *index, const char *string, uint8_t len)
 {
     if ((*index + len + 1) >= MDNS_MAX_PACKET_SIZE) {
+        _mdns_packet_full = true;
         return 0;
     }
     _mdns_append_u8(packet, index, len);
@@ -606,6 +841,7 @@ static inline uint8_t _mdns_append_string(uint8_t *packet, uint16_t *index, cons
 {
     uint8_t len = strlen(string);
     if ((*index + len + 1) >= MDNS_MAX_PACKET_SIZE) {
+        _mdns_packet_full = true;
         return 0;
     }
     _mdns_append_u8(packet, index, len);
@@ -633,6 +869,7 @@ static inline int append_one_txt_record_entry(uint8_t *packet, uint16_t *index,
     size_t key_len = strlen(txt->key);
     size_t len = key_len + txt->value_len + (txt->value ? 1 : 0);
     if ((*index + len + 1) >= MDNS_MAX_PACKET_SIZE) {
+        _mdns_packet_full = true;
         return 0;
     }
     _mdns_append_u8(packet, index, len);
@@ -649,6 +886,7 @@ static inline int append_one_txt_record_entry(uint8_t *packet, uint16_t *index,
 static inline int append_single_str(uint8_t *packet, uint16_t *index, const char *str, int len)
 {
     if ((*index + len + 1) >= MDNS_MAX_PACKET_SIZE) {
+        _mdns_packet_full = true;
         return 0;
     }
     if (!_mdns_append_u8(packet, index, len)) {
@@ -678,7 +916,7 @@ static uint16_t append_fqdn_dots(uint8_t *packet, uint16_t *index, const char *n
     char *end = host;
     char *start = host;
     do  {
-        end = memchr(start, '.', len);
+        end = memchr(start, '.', host + len - start);
         end = end ? end : host + len;
         int part_len = end - start;
         if (!append_single_str(packet, index, start, part_len)) {
@@ -699,10 +937,89 @@ static uint16_t append_fqdn_dots(uint8_t *packet, uint16_t *index, const char *n
 }
 #endif /* CONFIG_MDNS_RESPOND_REVERSE_QUERIES */
 
+/**
+ * @brief  name suffixes written to the packet being built, so that later names can point to them
+ */
+static struct {
+    mdns_name_suffix_t suffixes[MDNS_NAME_DICT_SIZE];
+    uint8_t buckets[MDNS_NAME_DICT_BUCKETS];
+    uint8_t len;
+} _mdns_name_dict;
+
+/**
+ * @brief  forgets the name suffixes of the previous packet
+ */
+static void _mdns_name_dict_reset(void)
+{
+    memset(_mdns_name_dict.buckets, MDNS_NAME_DICT_END, sizeof(_mdns_name_dict.buckets));
+    _mdns_name_dict.len = 0;
+}
+
+static inline uint8_t *_mdns_name_dict_bucket(const char *label, uint8_t next)
+{
+    return &_mdns_name_dict.buckets[_mdns_hash_add(MDNS_HASH_INIT ^ next, label) & (MDNS_NAME_DICT_BUCKETS - 1)];
+}
+
+/**
+ * @brief  finds the suffix made of a label followed by a known suffix
+ *
+ * @return the suffix or MDNS_NAME_DICT_END if it is not in the packet yet
+ */
+static uint8_t _mdns_name_dict_find(const uint8_t *packet, const char *label, uint8_t len, uint8_t next)
+{
+    uint8_t i = *_mdns_name_dict_bucket(label, next);
+    while (i != MDNS_NAME_DICT_END) {
+        const mdns_name_suffix_t *suffix = &_mdns_name_dict.suffixes[i];
+        const uint8_t *data = packet + suffix->offset;
+        if (suffix->next == next && data[0] == len && strncasecmp((const char *)data + 1, label, len) == 0) {
+            return i;
+        }
+        i = suffix->chain;
+    }
+    return MDNS_NAME_DICT_END;
+}
+
+/**
+ * @brief  remembers the suffix starting with the label written at offset, unless there are too many
+ */
+static uint8_t _mdns_name_dict_add(const char *label, uint16_t offset, uint8_t next)
+{
+    if (_mdns_name_dict.len == MDNS_NAME_DICT_SIZE) {
+        return MDNS_NAME_DICT_END;
+    }
+    uint8_t i = _mdns_name_dict.len++;
+    uint8_t *bucket = _mdns_name_dict_bucket(label, next);
+    _mdns_name_dict.suffixes[i].offset = offset;
+    _mdns_name_dict.suffixes[i].next = next;
+    _mdns_name_dict.suffixes[i].chain = *bucket;
+    *bucket = i;
+    return i;
+}
+
+/**
+ * @brief  forgets the suffixes added after the first len ones, when the record they are in is taken out of the packet
+ */
+static void _mdns_name_dict_truncate(uint8_t len)
+{
+    while (_mdns_name_dict.len > len) {
+        uint8_t i = --_mdns_name_dict.len;
+        // the suffix added last is the head of its bucket
+        for (uint8_t b = 0; b < MDNS_NAME_DICT_BUCKETS; b++) {
+            if (_mdns_name_dict.buckets[b] == i) {
+                _mdns_name_dict.buckets[b] = _mdns_name_dict.suffixes[i].chain;
+                break;
+            }
+        }
+    }
+}
+
 /**
  * @brief  appends FQDN to a packet, incrementing the index and
  *         compressing the output if previous occurrence of the string (or part of it) has been found
  *
+ * The longest suffix of the name already written to the packet is looked up label by label
+ * from the end of the name, only the labels before it are written.
+ *
  * @param  packet       MDNS packet
  * @param  index        offset in the packet
  * @param  strings      string array containing the parts of the FQDN
@@ -710,66 +1027,44 @@ static uint16_t append_fqdn_dots(uint8_t *packet, uint16_t *index, const char *n
  *
  * @return length of added data: 0 on error or length on success
  */
-static uint16_t _mdns_append_fqdn(uint8_t *packet, uint16_t *index, const char *strings[], uint8_t count, size_t packet_len)
+static uint16_t _mdns_append_fqdn(uint8_t *packet, uint16_t *index, const char *strings[], uint8_t count)
 {
-    if (!count) {
-        //empty string so terminate
-        return _mdns_append_u8(packet, index, 0);
-    }
-    mdns_name_t name;
-    static char buf[MDNS_NAME_BUF_LEN];
-    uint8_t len = strlen(strings[0]);
-    //try to find first the string length in the packet (if it exists)
-    uint8_t *len_location = (uint8_t *)memchr(packet, (char)len, *index);
-    while (len_location) {
-        //check if the string after len_location is the string that we are looking for
-        if (memcmp(len_location + 1, strings[0], len)) { //not continuing with our string
-search_next:
-            //try and find the length byte further in the packet
-            len_location = (uint8_t *)memchr(len_location + 1, (char)len, *index - (len_location + 1 - packet));
-            continue;
-        }
-        //seems that we might have found the string that we are looking for
-        //read the destination into name and compare
-        name.parts = 0;
-        name.sub = 0;
-        name.host[0] = 0;
-        name.service[0] = 0;
-        name.proto[0] = 0;
-        name.domain[0] = 0;
-        const uint8_t *content = _mdns_read_fqdn(packet, len_location, &name, buf, packet_len);
-        if (!content) {
-            //not a readable fqdn?
-            goto search_next; // could be our unfinished fqdn, continue searching
-        }
-        if (name.parts == count) {
-            uint8_t i;
-            for (i = 0; i < count; i++) {
-                if (strcasecmp(strings[i], (const char *)&name + (i * (MDNS_NAME_BUF_LEN)))) {
-                    //not our string! let's search more
-                    goto search_next;
-                }
-            }
-            //we actually have found the string
+    uint8_t suffix = MDNS_NAME_DICT_END;
+    uint8_t literal = count;
+    while (literal) {
+        uint8_t found = _mdns_name_dict_find(packet, strings[literal - 1], strlen(strings[literal - 1]), suffix);
+        if (found == MDNS_NAME_DICT_END) {
             break;
-        } else {
-            goto search_next;
         }
+        suffix = found;
+        literal--;
     }
-    //string is not yet in the packet, so let's add it
-    if (!len_location) {
-        uint8_t written = _mdns_append_string(packet, index, strings[0]);
-        if (!written) {
+
+    uint16_t start = *index;
+    for (uint8_t i = 0; i < literal; i++) {
+        if (!_mdns_append_string(packet, index, strings[i])) {
             return 0;
         }
-        //run the same for the other strings in the name
-        return written + _mdns_append_fqdn(packet, index, &strings[1], count - 1, packet_len);
     }
-
-    //we have found the string so let's insert a pointer to it instead
-    uint16_t offset = len_location - packet;
-    offset |= MDNS_NAME_REF;
-    return _mdns_append_u16(packet, index, offset);
+    uint16_t offset = *index;
+    if (suffix == MDNS_NAME_DICT_END) {
+        //no part of the name is in the packet yet, so terminate
+        if (!_mdns_append_u8(packet, index, 0)) {
+            return 0;
+        }
+    } else if (!_mdns_append_u16(packet, index, MDNS_NAME_REF | _mdns_name_dict.suffixes[suffix].offset)) {
+        return 0;
+    }
+    //the name is complete, its suffixes can be pointed to
+    while (literal) {
+        literal--;
+        offset -= (uint8_t)strlen(strings[literal]) + 1;
+        suffix = _mdns_name_dict_add(strings[literal], offset, suffix);
+        if (suffix == MDNS_NAME_DICT_END) {
+            break;
+        }
+    }
+    return *index - start;
 }
 
 /**
@@ -797,7 +1092,7 @@ static uint16_t _mdns_append_ptr_record(uint8_t *packet, uint16_t *index, const
     str[2] = proto;
     str[3] = MDNS_DEFAULT_DOMAIN;
 
-    part_length = _mdns_append_fqdn(packet, index, str + 1, 3, MDNS_MAX_PACKET_SIZE);
+    part_length = _mdns_append_fqdn(packet, index, str + 1, 3);
     if (!part_length) {
         return 0;
     }
@@ -810,7 +1105,7 @@ static uint16_t _mdns_append_ptr_record(uint8_t *packet, uint16_t *index, const
     record_length += part_length;
 
     uint16_t data_len_location = *index - 2;
-    part_length = _mdns_append_fqdn(packet, index, str, 4, MDNS_MAX_PACKET_SIZE);
+    part_length = _mdns_append_fqdn(packet, index, str, 4);
     if (!part_length) {
         return 0;
     }
@@ -845,7 +1140,7 @@ static uint16_t _mdns_append_subtype_ptr_record(uint8_t *packet, uint16_t *index
         return 0;
     }
 
-    part_length = _mdns_append_fqdn(packet, index, subtype_str, ARRAY_SIZE(subtype_str), MDNS_MAX_PACKET_SIZE);
+    part_length = _mdns_append_fqdn(packet, index, subtype_str, ARRAY_SIZE(subtype_str));
     if (!part_length) {
         return 0;
     }
@@ -858,7 +1153,7 @@ static uint16_t _mdns_append_subtype_ptr_record(uint8_t *packet, uint16_t *index
     record_length += part_length;
 
     uint16_t data_len_location = *index - 2;
-    part_length = _mdns_append_fqdn(packet, index, instance_str, ARRAY_SIZE(instance_str), MDNS_MAX_PACKET_SIZE);
+    part_length = _mdns_append_fqdn(packet, index, instance_str, ARRAY_SIZE(instance_str));
     if (!part_length) {
         return 0;
     }
@@ -897,7 +1192,7 @@ static uint16_t _mdns_append_sdptr_record(uint8_t *packet, uint16_t *index, mdns
     str[1] = service->proto;
     str[2] = MDNS_DEFAULT_DOMAIN;
 
-    part_length = _mdns_append_fqdn(packet, index, sd_str, 4, MDNS_MAX_PACKET_SIZE);
+    part_length = _mdns_append_fqdn(packet, index, sd_str, 4);
 
     record_length += part_length;
 
@@ -908,7 +1203,7 @@ static uint16_t _mdns_append_sdptr_record(uint8_t *packet, uint16_t *index, mdns
     record_length += part_length;
 
     uint16_t data_len_location = *index - 2;
-    part_length = _mdns_append_fqdn(packet, index, str, 3, MDNS_MAX_PACKET_SIZE);
+    part_length = _mdns_append_fqdn(packet, index, str, 3);
     if (!part_length) {
         return 0;
     }
@@ -946,7 +1241,7 @@ static uint16_t _mdns_append_txt_record(uint8_t *packet, uint16_t *index, mdns_s
         return 0;
     }
 
-    part_length = _mdns_append_fqdn(packet, index, str, 4, MDNS_MAX_PACKET_SIZE);
+    part_length = _mdns_append_fqdn(packet, index, str, 4);
     if (!part_length) {
         return 0;
     }
@@ -1010,7 +1305,7 @@ static uint16_t _mdns_append_srv_record(uint8_t *packet, uint16_t *index, mdns_s
         return 0;
     }
 
-    part_length = _mdns_append_fqdn(packet, index, str, 4, MDNS_MAX_PACKET_SIZE);
+    part_length = _mdns_append_fqdn(packet, index, str, 4);
     if (!part_length) {
         return 0;
     }
@@ -1043,7 +1338,7 @@ static uint16_t _mdns_append_srv_record(uint8_t *packet, uint16_t *index, mdns_s
         return 0;
     }
 
-    part_length = _mdns_append_fqdn(packet, index, str, 2, MDNS_MAX_PACKET_SIZE);
+    part_length = _mdns_append_fqdn(packet, index, str, 2);
     if (!part_length) {
         return 0;
     }
@@ -1076,7 +1371,7 @@ static uint16_t _mdns_append_a_record(uint8_t *packet, uint16_t *index, const ch
         return 0;
     }
 
-    part_length = _mdns_append_fqdn(packet, index, str, 2, MDNS_MAX_PACKET_SIZE);
+    part_length = _mdns_append_fqdn(packet, index, str, 2);
     if (!part_length) {
         return 0;
     }
@@ -1091,6 +1386,7 @@ static uint16_t _mdns_append_a_record(uint8_t *packet, uint16_t *index, const ch
     uint16_t data_len_location = *index - 2;
 
     if ((*index + 3) >= MDNS_MAX_PACKET_SIZE) {
+        _mdns_packet_full = true;
         return 0;
     }
     _mdns_append_u8(packet, index, ip & 0xFF);
@@ -1128,7 +1424,7 @@ static uint16_t _mdns_append_aaaa_record(uint8_t *packet, uint16_t *index, const
     }
 
 
-    part_length = _mdns_append_fqdn(packet, index, str, 2, MDNS_MAX_PACKET_SIZE);
+    part_length = _mdns_append_fqdn(packet, index, str, 2);
     if (!part_length) {
         return 0;
     }
@@ -1143,6 +1439,7 @@ static uint16_t _mdns_append_aaaa_record(uint8_t *packet, uint16_t *index, const
     uint16_t data_len_location = *index - 2;
 
     if ((*index + MDNS_ANSWER_AAAA_SIZE) > MDNS_MAX_PACKET_SIZE) {
+        _mdns_packet_full = true;
         return 0;
     }
 
@@ -1184,7 +1481,7 @@ static uint16_t _mdns_append_question(uint8_t *packet, uint16_t *index, mdns_out
         if (q->domain) {
             str[str_index++] = q->domain;
         }
-        part_length = _mdns_append_fqdn(packet, index, str, str_index, MDNS_MAX_PACKET_SIZE);
+        part_length = _mdns_append_fqdn(packet, index, str, str_index);
         if (!part_length) {
             return 0;
         }
@@ -1290,7 +1587,7 @@ static uint8_t _mdns_append_reverse_ptr_record(uint8_t *packet, uint16_t *index,
     uint16_t data_len_location = *index - 2; /* store the position of size (2=16bis) of this record */
     const char *str[2] = { _mdns_self_host.hostname, MDNS_DEFAULT_DOMAIN };
 
-    int part_length = _mdns_append_fqdn(packet, index, str, 2, MDNS_MAX_PACKET_SIZE);
+    int part_length = _mdns_append_fqdn(packet, index, str, 2);
     if (!part_length) {
         return 0;
     }
@@ -1417,67 +1714,390 @@ static uint8_t _mdns_append_answer(uint8_t *packet, uint16_t *index, mdns_out_an
 }
 
 /**
- * @brief  sends a packet
+ * @brief  serialized responses, the most recently used first
+ */
+static struct {
+    mdns_response_t *entries[MDNS_RESPONSE_CACHE_SIZE];
+    uint8_t len;
+    uint32_t hits;
+    uint32_t misses;
+    uint32_t too_large;             // responses with more answers than an entry holds
+} _mdns_response_cache;
+
+/**
+ * @brief  forgets the cached responses, called whenever our records or interfaces change
+ */
+static void _mdns_response_cache_clear(void)
+{
+    for (uint8_t i = 0; i < _mdns_response_cache.len; i++) {
+        _mdns_pool_free(&_mdns_response_pool, _mdns_response_cache.entries[i]);
+        _mdns_response_cache.entries[i] = NULL;
+    }
+    _mdns_response_cache.len = 0;
+}
+
+static inline mdns_out_answer_t *_mdns_tx_packet_section(const mdns_tx_packet_t *p, uint8_t section)
+{
+    return section == 0 ? p->answers : section == 1 ? p->servers : p->additional;
+}
+
+static inline uint32_t _mdns_hash_word(uint32_t hash, uintptr_t word)
+{
+    return (hash ^ word) * MDNS_HASH_PRIME;
+}
+
+/**
+ * @brief  hashes the answers of a packet to send
+ *
+ * Only the answers to queries and announcements are cached, packets with questions
+ * (probes, queries and legacy unicast answers), goodbyes, answers to our searches
+ * and packets with more than MDNS_RESPONSE_MAX_ANSWERS answers are not.
+ *
+ * @param  p            the packet
+ * @param  hash         set to the hash of the interface and of the answers
+ * @param  answers_len  set to the number of answers
+ *
+ * @return true if the packet can be cached
+ */
+static bool _mdns_response_hash(const mdns_tx_packet_t *p, uint32_t *hash, uint16_t *answers_len)
+{
+    if (p->questions || p->flags != MDNS_FLAGS_QR_AUTHORITATIVE) {
+        return false;
+    }
+    uint32_t h = _mdns_hash_word(_mdns_hash_word(MDNS_HASH_INIT, p->tcpip_if), p->ip_protocol);
+    uint16_t len = 0;
+    for (uint8_t section = 0; section < MDNS_TX_SECTIONS; section++) {
+        for (const mdns_out_answer_t *a = _mdns_tx_packet_section(p, section); a; a = a->next) {
+            if (a->bye || a->custom_service) {
+                return false;
+            }
+            h = _mdns_hash_word(h, (uintptr_t)a->service);
+            h = _mdns_hash_word(h, (uintptr_t)a->host);
+            h = _mdns_hash_word(h, a->type | section << 16 | a->flush << 24);
+            len++;
+        }
+    }
+    if (len > MDNS_RESPONSE_MAX_ANSWERS) {
+        _mdns_response_cache.too_large++;
+        return false;
+    }
+    *hash = h;
+    *answers_len = len;
+    return true;
+}
+
+static bool _mdns_response_match(const mdns_response_t *r, const mdns_tx_packet_t *p, uint32_t hash, uint16_t answers_len)
+{
+    if (r->hash != hash || r->answers_len != answers_len || r->tcpip_if != p->tcpip_if || r->ip_protocol != p->ip_protocol) {
+        return false;
+    }
+    const mdns_response_answer_t *k = r->answers;
+    for (uint8_t section = 0; section < MDNS_TX_SECTIONS; section++) {
+        for (const mdns_out_answer_t *a = _mdns_tx_packet_section(p, section); a; a = a->next, k++) {
+            if (k->section != section || k->type != a->type || k->service != a->service
+                    || k->host != a->host || k->flush != a->flush) {
+                return false;
+            }
+        }
+    }
+    return true;
+}
+
+/**
+ * @brief  copies the cached response with the answers of the packet to send
+ *
+ * @return length of the response or 0 if it is not cached
+ */
+static uint16_t _mdns_response_cache_get(const mdns_tx_packet_t *p, uint32_t hash, uint16_t answers_len, uint8_t *packet)
+{
+    for (uint8_t i = 0; i < _mdns_response_cache.len; i++) {
+        mdns_response_t *r = _mdns_response_cache.entries[i];
+        if (_mdns_response_match(r, p, hash, answers_len)) {
+            memmove(&_mdns_response_cache.entries[1], &_mdns_response_cache.entries[0], i * sizeof(mdns_response_t *));
+            _mdns_response_cache.entries[0] = r;
+            memcpy(packet, r->packet, r->len);
+            _mdns_set_u16(packet, MDNS_HEAD_ID_OFFSET, p->id);
+            _mdns_response_cache.hits++;
+            return r->len;
+        }
+    }
+    _mdns_response_cache.misses++;
+    return 0;
+}
+
+/**
+ * @brief  keeps the response built for the packet to send, in place of the least recently used one
+ */
+static void _mdns_response_cache_put(const mdns_tx_packet_t *p, uint32_t hash, uint16_t answers_len, const uint8_t *packet, uint16_t len)
+{
+    mdns_response_t *r = (mdns_response_t *)_mdns_pool_alloc(&_mdns_response_pool);
+    if (!r && _mdns_response_cache.len) {
+        // the pool counted the exhaustion, make room by dropping the least recently used response
+        _mdns_pool_free(&_mdns_response_pool, _mdns_response_cache.entries[--_mdns_response_cache.len]);
+        r = (mdns_response_t *)_mdns_pool_alloc(&_mdns_response_pool);
+    }
+    if (!r) {
+        return;
+    }
+    r->hash = hash;
+    r->tcpip_if = p->tcpip_if;
+    r->ip_protocol = p->ip_protocol;
+    r->answers_len = answers_len;
+    r->len = len;
+    mdns_response_answer_t *k = r->answers;
+    for (uint8_t section = 0; section < MDNS_TX_SECTIONS; section++) {
+        for (const mdns_out_answer_t *a = _mdns_tx_packet_section(p, section); a; a = a->next, k++) {
+            k->service = a->service;
+            k->host = a->host;
+            k->type = a->type;
+            k->section = section;
+            k->flush = a->flush;
+        }
+    }
+    memcpy(r->packet, packet, len);
+
+    memmove(&_mdns_response_cache.entries[1], &_mdns_response_cache.entries[0], _mdns_response_cache.len * sizeof(mdns_response_t *));
+    _mdns_response_cache.entries[0] = r;
+    _mdns_response_cache.len++;
+}
+
+/**
+ * @brief  answers left out of the responses or sent in continuation packets
+ */
+static struct {
+    uint32_t suppressed;
+    uint32_t split;
+} _mdns_answer_stats;
+
+/**
+ * @brief  serializes a packet, continuing from the cursor
+ *
+ * Answers are appended in order until one does not fit, the cursor is then left on it for the next packet.
+ * The questions go to the first packet only, queries continued in another packet are marked truncated
+ * (RFC 6762, 7.2).
  *
  * @param  p       the packet
+ * @param  packet  buffer of MDNS_MAX_PACKET_SIZE bytes
+ * @param  cursor  the first answer to append, set to the first one that did not fit
+ *
+ * @return length of the packet
  */
-static void _mdns_dispatch_tx_packet(mdns_tx_packet_t *p)
+static uint16_t _mdns_build_tx_packet(const mdns_tx_packet_t *p, uint8_t *packet, mdns_tx_cursor_t *cursor)
 {
-    static uint8_t packet[MDNS_MAX_PACKET_SIZE];
+    static const uint16_t count_offsets[MDNS_TX_SECTIONS] = {
+        MDNS_HEAD_ANSWERS_OFFSET, MDNS_HEAD_SERVERS_OFFSET, MDNS_HEAD_ADDITIONAL_OFFSET
+    };
     uint16_t index = MDNS_HEAD_LEN;
     memset(packet, 0, MDNS_HEAD_LEN);
+    _mdns_name_dict_reset();
     mdns_out_question_t *q;
-    mdns_out_answer_t *a;
-    uint8_t count;
+    uint16_t count;
 
-    _mdns_set_u16(packet, MDNS_HEAD_FLAGS_OFFSET, p->flags);
     _mdns_set_u16(packet, MDNS_HEAD_ID_OFFSET, p->id);
 
-    count = 0;
-    q = p->questions;
-    while (q) {
-        if (_mdns_append_question(packet, &index, q)) {
-            count++;
+    if (!cursor->packets) {
+        count = 0;
+        q = p->questions;
+        while (q) {
+            if (_mdns_append_question(packet, &index, q)) {
+                count++;
+            }
+            q = q->next;
         }
-        q = q->next;
+        _mdns_set_u16(packet, MDNS_HEAD_QUESTIONS_OFFSET, count);
     }
-    _mdns_set_u16(packet, MDNS_HEAD_QUESTIONS_OFFSET, count);
 
     count = 0;
-    a = p->answers;
-    while (a) {
-        count += _mdns_append_answer(packet, &index, a, p->tcpip_if);
-        a = a->next;
+    cursor->records = 0;
+    while (cursor->section < MDNS_TX_SECTIONS) {
+        mdns_out_answer_t *a = cursor->answer;
+        if (!a) {
+            _mdns_set_u16(packet, count_offsets[cursor->section], count);
+            count = 0;
+            if (++cursor->section < MDNS_TX_SECTIONS) {
+                cursor->answer = _mdns_tx_packet_section(p, cursor->section);
+            }
+            continue;
+        }
+        uint16_t start = index;
+        uint8_t suffixes = _mdns_name_dict.len;
+        _mdns_packet_full = false;
+        uint8_t records = _mdns_append_answer(packet, &index, a, p->tcpip_if);
+        if (_mdns_packet_full) {
+            index = start;
+            _mdns_name_dict_truncate(suffixes);
+            if (cursor->records) {
+                // the next packet continues with this answer
+                _mdns_set_u16(packet, count_offsets[cursor->section], count);
+                break;
+            }
+            records = 0; // does not fit even alone, it is left out
+        }
+        count += records;
+        cursor->records += records;
+        cursor->answer = a->next;
     }
-    _mdns_set_u16(packet, MDNS_HEAD_ANSWERS_OFFSET, count);
+    cursor->packets++;
 
-    count = 0;
-    a = p->servers;
-    while (a) {
-        count += _mdns_append_answer(packet, &index, a, p->tcpip_if);
-        a = a->next;
+    uint16_t flags = p->flags;
+    if (cursor->section < MDNS_TX_SECTIONS && !(flags & MDNS_FLAGS_QUERY_REPSONSE)) {
+        flags |= MDNS_FLAGS_DISTRIBUTED;
     }
-    _mdns_set_u16(packet, MDNS_HEAD_SERVERS_OFFSET, count);
+    _mdns_set_u16(packet, MDNS_HEAD_FLAGS_OFFSET, flags);
+    return index;
+}
 
-    count = 0;
-    a = p->additional;
-    while (a) {
-        count += _mdns_append_answer(packet, &index, a, p->tcpip_if);
-        a = a->next;
+/**
+ * @brief  sends a packet, in several packets if its answers do not fit in one
+ *
+ * Answers to repeated queries are sent from the response cache, as long as our records do not change.
+ *
+ * @param  p       the packet
+ */
+static void _mdns_dispatch_tx_packet(mdns_tx_packet_t *p)
+{
+    static uint8_t packet[MDNS_MAX_PACKET_SIZE];
+    mdns_tx_cursor_t cursor = { 0, p->answers, 0, 0 };
+    uint32_t hash;
+    uint16_t answers_len;
+    bool cacheable = _mdns_response_hash(p, &hash, &answers_len);
+    uint16_t index = cacheable ? _mdns_response_cache_get(p, hash, answers_len, packet) : 0;
+    if (index) {
+        cursor.section = MDNS_TX_SECTIONS;
+    } else {
+        index = _mdns_build_tx_packet(p, packet, &cursor);
+        if (cacheable && cursor.section == MDNS_TX_SECTIONS) {
+            _mdns_response_cache_put(p, hash, answers_len, packet, index);
+        }
     }
-    _mdns_set_u16(packet, MDNS_HEAD_ADDITIONAL_OFFSET, count);
 
+    for (;;) {
 #ifdef MDNS_ENABLE_DEBUG
-    _mdns_dbg_printf("\nTX[%u][%u]: ", p->tcpip_if, p->ip_protocol);
-    if (p->dst.type == ESP_IPADDR_TYPE_V4) {
-        _mdns_dbg_printf("To: " IPSTR ":%u, ", IP2STR(&p->dst.u_addr.ip4), p->port);
-    } else {
-        _mdns_dbg_printf("To: " IPV6STR ":%u, ", IPV62STR(p->dst.u_addr.ip6), p->port);
+        _mdns_dbg_printf("\nTX[%u][%u]: ", p->tcpip_if, p->ip_protocol);
+        if (p->dst.type == ESP_IPADDR_TYPE_V4) {
+            _mdns_dbg_printf("To: " IPSTR ":%u, ", IP2STR(&p->dst.u_addr.ip4), p->port);
+        } else {
+            _mdns_dbg_printf("To: " IPV6STR ":%u, ", IPV62STR(p->dst.u_addr.ip6), p->port);
+        }
+        mdns_debug_packet(packet, index);
+#endif
+
+        _mdns_udp_pcb_write(p->tcpip_if, p->ip_protocol, &p->dst, p->port, packet, index);
+
+        if (cursor.section == MDNS_TX_SECTIONS) {
+            break;
+        }
+        index = _mdns_build_tx_packet(p, packet, &cursor);
+        if (!cursor.records) {
+            break; // what was left had nothing to send
+        }
+        _mdns_answer_stats.split += cursor.records;
+    }
+}
+
+/**
+ * @brief  compares two deadlines, ties are broken by the order they were armed in
+ */
+static inline bool _mdns_deadline_before(const mdns_deadline_t *a, const mdns_deadline_t *b)
+{
+    int32_t diff = (int32_t)(a->at - b->at);
+    return diff < 0 || (diff == 0 && (int32_t)(a->seq - b->seq) < 0);
+}
+
+static inline void _mdns_deadline_place(mdns_deadline_t *d, uint16_t index)
+{
+    _mdns_server->deadlines.heap[index] = d;
+    d->index = index;
+}
+
+static void _mdns_deadline_sift_up(mdns_deadline_t *d)
+{
+    uint16_t index = d->index;
+    while (index) {
+        mdns_deadline_t *parent = _mdns_server->deadlines.heap[(index - 1) / 2];
+        if (!_mdns_deadline_before(d, parent)) {
+            break;
+        }
+        _mdns_deadline_place(parent, index);
+        index = (index - 1) / 2;
+    }
+    _mdns_deadline_place(d, index);
+}
+
+static void _mdns_deadline_sift_down(mdns_deadline_t *d)
+{
+    uint16_t index = d->index;
+    uint16_t len = _mdns_server->deadlines.len;
+    for (;;) {
+        uint32_t child = 2 * (uint32_t)index + 1;
+        if (child >= len) {
+            break;
+        }
+        if (child + 1 < len && _mdns_deadline_before(_mdns_server->deadlines.heap[child + 1], _mdns_server->deadlines.heap[child])) {
+            child++;
+        }
+        if (!_mdns_deadline_before(_mdns_server->deadlines.heap[child], d)) {
+            break;
+        }
+        _mdns_deadline_place(_mdns_server->deadlines.heap[child], index);
+        index = child;
+    }
+    _mdns_deadline_place(d, index);
+}
+
+/**
+ * @brief  removes a deadline from the heap, no-op if it is not armed
+ */
+static void _mdns_deadline_disarm(mdns_deadline_t *d)
+{
+    if (!d->armed) {
+        return;
+    }
+    d->armed = false;
+    mdns_deadline_t *last = _mdns_server->deadlines.heap[--_mdns_server->deadlines.len];
+    if (last == d) {
+        return;
+    }
+    _mdns_deadline_place(last, d->index);
+    _mdns_deadline_sift_up(last);
+    _mdns_deadline_sift_down(last);
+}
+
+/**
+ * @brief  (re)arms a deadline to expire at given tick time in ms
+ *
+ * @return false if the heap could not grow
+ */
+static bool _mdns_deadline_arm(mdns_deadline_t *d, uint32_t at)
+{
+    _mdns_deadline_disarm(d);
+    if (_mdns_server->deadlines.len == _mdns_server->deadlines.size) {
+        uint32_t size = _mdns_server->deadlines.size ? _mdns_server->deadlines.size * 2 : MDNS_DEADLINES_MIN_LEN;
+        if (size > UINT16_MAX) {
+            return false;
+        }
+        mdns_deadline_t **heap = (mdns_deadline_t **)realloc(_mdns_server->deadlines.heap, size * sizeof(mdns_deadline_t *));
+        if (!heap) {
+            HOOK_MALLOC_FAILED;
+            return false;
+        }
+        _mdns_server->deadlines.heap = heap;
+        _mdns_server->deadlines.size = size;
     }
-    mdns_debug_packet(packet, index);
-#endif
+    d->at = at;
+    d->seq = _mdns_server->deadlines.seq++;
+    d->index = _mdns_server->deadlines.len++;
+    d->armed = true;
+    _mdns_deadline_sift_up(d);
+    return true;
+}
 
-    _mdns_udp_pcb_write(p->tcpip_if, p->ip_protocol, &p->dst, p->port, packet, index);
+/**
+ * @brief  get the earliest armed deadline
+ */
+static inline mdns_deadline_t *_mdns_deadline_first(void)
+{
+    return _mdns_server->deadlines.len ? _mdns_server->deadlines.heap[0] : NULL;
 }
 
 /**
@@ -1505,6 +2125,7 @@ static void _mdns_free_tx_packet(mdns_tx_packet_t *packet)
     queueFree(mdns_out_answer_t, packet->answers);
     queueFree(mdns_out_answer_t, packet->servers);
     queueFree(mdns_out_answer_t, packet->additional);
+    _mdns_deadline_disarm(&packet->deadline);
     free(packet);
 }
 
@@ -1519,19 +2140,14 @@ static void _mdns_schedule_tx_packet(mdns_tx_packet_t *packet, uint32_t ms_after
     if (!packet) {
         return;
     }
-    packet->send_at = (xTaskGetTickCount() * portTICK_PERIOD_MS) + ms_after;
-    packet->next = NULL;
-    if (!_mdns_server->tx_queue_head || _mdns_server->tx_queue_head->send_at > packet->send_at) {
-        packet->next = _mdns_server->tx_queue_head;
-        _mdns_server->tx_queue_head = packet;
+    packet->deadline.type = MDNS_DEADLINE_TX;
+    packet->deadline.owner = packet;
+    if (!_mdns_deadline_arm(&packet->deadline, (xTaskGetTickCount() * portTICK_PERIOD_MS) + ms_after)) {
+        _mdns_free_tx_packet(packet);
         return;
     }
-    mdns_tx_packet_t *q = _mdns_server->tx_queue_head;
-    while (q->next && q->next->send_at <= packet->send_at) {
-        q = q->next;
-    }
-    packet->next = q->next;
-    q->next = packet;
+    packet->next = _mdns_server->tx_queue_head;
+    _mdns_server->tx_queue_head = packet;
 }
 
 /**
@@ -1584,13 +2200,15 @@ static void _mdns_clear_pcb_tx_queue_head(mdns_if_t tcpip_if, mdns_ip_protocol_t
 static mdns_tx_packet_t *_mdns_get_next_pcb_packet(mdns_if_t tcpip_if, mdns_ip_protocol_t ip_protocol)
 {
     mdns_tx_packet_t *q = _mdns_server->tx_queue_head;
+    mdns_tx_packet_t *next = NULL;
     while (q) {
-        if (q->tcpip_if == tcpip_if && q->ip_protocol == ip_protocol) {
-            return q;
+        if (q->tcpip_if == tcpip_if && q->ip_protocol == ip_protocol
+                && (!next || _mdns_deadline_before(&q->deadline, &next->deadline))) {
+            next = q;
         }
         q = q->next;
     }
-    return NULL;
+    return next;
 }
 
 /**
@@ -1779,6 +2397,140 @@ static bool _mdns_service_match_ptr_question(const mdns_service_t *service, cons
     return true;
 }
 
+/**
+ * @brief  Duplicate string or return error
+ */
+static esp_err_t _mdns_strdup_check(char **out, const char *in)
+{
+    if (in && in[0]) {
+        *out = strdup(in);
+        if (!*out) {
+            return ESP_FAIL;
+        }
+        return ESP_OK;
+    }
+    *out = NULL;
+    return ESP_OK;
+}
+
+/**
+ * @brief  remembers a record of ours listed in the known answers of a query
+ */
+static void _mdns_add_known_answer(mdns_parsed_packet_t *parsed_packet, uint16_t type, mdns_srv_item_t *service,
+                                   mdns_host_item_t *host, const esp_ip_addr_t *addr)
+{
+    if (parsed_packet->known_answers_len == MDNS_KNOWN_ANSWERS_MAX) {
+        return; // the records not remembered are sent again
+    }
+    mdns_known_answer_t *known = &parsed_packet->known_answers[parsed_packet->known_answers_len++];
+    known->type = type;
+    known->service = service;
+    known->host = host;
+    if (addr) {
+        memcpy(&known->addr, addr, sizeof(esp_ip_addr_t));
+    }
+}
+
+static bool _mdns_is_known_address(const mdns_parsed_packet_t *parsed_packet, uint16_t type, const mdns_host_item_t *host,
+                                   const esp_ip_addr_t *addr)
+{
+    for (uint8_t i = 0; i < parsed_packet->known_answers_len; i++) {
+        const mdns_known_answer_t *known = &parsed_packet->known_answers[i];
+        if (known->type != type || known->host != host) {
+            continue;
+        }
+        if (type == MDNS_TYPE_A ? known->addr.u_addr.ip4.addr == addr->u_addr.ip4.addr
+                : !memcmp(known->addr.u_addr.ip6.addr, addr->u_addr.ip6.addr, MDNS_ANSWER_AAAA_SIZE)) {
+            return true;
+        }
+    }
+    return false;
+}
+
+/**
+ * @brief  checks that the querier knows every address of the host we would answer with
+ */
+static bool _mdns_host_addresses_known(const mdns_parsed_packet_t *parsed_packet, mdns_host_item_t *host, uint16_t type)
+{
+    esp_ip_addr_t addr = { 0 };
+    bool known = false;
+    if (host != &_mdns_self_host) {
+        uint8_t addr_type = type == MDNS_TYPE_A ? ESP_IPADDR_TYPE_V4 : ESP_IPADDR_TYPE_V6;
+        for (mdns_ip_addr_t *a = host->address_list; a; a = a->next) {
+            if (a->addr.type != addr_type) {
+                continue;
+            }
+            if (!_mdns_is_known_address(parsed_packet, type, host, &a->addr)) {
+                return false;
+            }
+            known = true;
+        }
+        return known;
+    }
+    // our own addresses are those of the interface, and of its duplicate
+    mdns_if_t tcpip_if = parsed_packet->tcpip_if;
+    for (uint8_t i = 0; i < (_mdns_if_is_dup(parsed_packet->tcpip_if) ? 2 : 1); i++) {
+        if (type == MDNS_TYPE_A) {
+            esp_netif_ip_info_t if_ip_info;
+            if (esp_netif_get_ip_info(_mdns_get_esp_netif(tcpip_if), &if_ip_info)) {
+                return false;
+            }
+            addr.u_addr.ip4.addr = if_ip_info.ip.addr;
+        }
+#if CONFIG_LWIP_IPV6
+        else if (esp_netif_get_ip6_linklocal(_mdns_get_esp_netif(tcpip_if), &addr.u_addr.ip6)) {
+            return false;
+        }
+#endif
+        if (!_mdns_is_known_address(parsed_packet, type, host, &addr)) {
+            return false;
+        }
+        known = true;
+        tcpip_if = _mdns_get_other_if(tcpip_if);
+    }
+    return known;
+}
+
+static bool _mdns_answer_is_known(const mdns_parsed_packet_t *parsed_packet, const mdns_out_answer_t *answer)
+{
+    if (answer->type == MDNS_TYPE_A || answer->type == MDNS_TYPE_AAAA) {
+        return answer->host && _mdns_host_addresses_known(parsed_packet, answer->host, answer->type);
+    }
+    for (uint8_t i = 0; i < parsed_packet->known_answers_len; i++) {
+        const mdns_known_answer_t *known = &parsed_packet->known_answers[i];
+        if (known->type == answer->type && known->service && known->service->service == answer->service) {
+            return true;
+        }
+    }
+    return false;
+}
+
+/**
+ * @brief  leaves out the answers the querier already knows (RFC 6762, 7.1)
+ *
+ * @return number of answers left out
+ */
+static uint16_t _mdns_suppress_known_answers(mdns_tx_packet_t *packet, const mdns_parsed_packet_t *parsed_packet)
+{
+    mdns_out_answer_t **sections[] = { &packet->answers, &packet->additional };
+    uint16_t suppressed = 0;
+    for (size_t i = 0; i < ARRAY_SIZE(sections); i++) {
+        mdns_out_answer_t **a = sections[i];
+        while (*a) {
+            if (_mdns_answer_is_known(parsed_packet, *a)) {
+                mdns_out_answer_t *known = *a;
+                *a = known->next;
+                free(known);
+                suppressed++;
+            } else {
+                a = &(*a)->next;
+            }
+        }
+    }
+    _mdns_answer_stats.suppressed += suppressed;
+    return suppressed;
+}
+
 /**
  * @brief  Create answer packet to questions from parsed packet
  */
@@ -1808,7 +2560,7 @@ static void _mdns_create_answer_from_parsed_packet(mdns_parsed_packet_t *parsed_
                 return;
             }
         } else if (q->service && q->proto) {
-            mdns_srv_item_t *service = _mdns_server->services;
+            mdns_srv_item_t *service = _mdns_server->index.types[_mdns_service_type_hash(q->service, q->proto)];
             while (service) {
                 if (_mdns_service_match_ptr_question(service->service, q)) {
                     if (!_mdns_create_answer_from_service(packet, service->service, q, shared, send_flush)) {
@@ -1816,7 +2568,7 @@ static void _mdns_create_answer_from_parsed_packet(mdns_parsed_packet_t *parsed_
                         return;
                     }
                 }
-                service = service->next;
+                service = service->type_next;
             }
         } else if (q->type == MDNS_TYPE_A || q->type == MDNS_TYPE_AAAA) {
             if (!_mdns_create_answer_from_hostname(packet, q->host, send_flush)) {
@@ -1854,16 +2606,24 @@ static void _mdns_create_answer_from_parsed_packet(mdns_parsed_packet_t *parsed_
             }
             out_question->type = q->type;
             out_question->unicast = q->unicast;
-            out_question->host = q->host;
-            q->host = NULL;
-            out_question->service = q->service;
-            q->service = NULL;
-            out_question->proto = q->proto;
-            q->proto = NULL;
-            out_question->domain = q->domain;
-            q->domain = NULL;
             out_question->next = NULL;
             out_question->own_dynamic_memory = true;
+            // the parsed question goes back to its pool, keep copies of its names
+            char *host = NULL, *service = NULL, *proto = NULL, *domain = NULL;
+            if (_mdns_strdup_check(&host, q->host) || _mdns_strdup_check(&service, q->service)
+                    || _mdns_strdup_check(&proto, q->proto) || _mdns_strdup_check(&domain, q->domain)) {
+                HOOK_MALLOC_FAILED;
+                free(host);
+                free(service);
+                free(proto);
+                free(out_question);
+                _mdns_free_tx_packet(packet);
+                return;
+            }
+            out_question->host = host;
+            out_question->service = service;
+            out_question->proto = proto;
+            out_question->domain = domain;
             queueToEnd(mdns_out_question_t, packet->questions, out_question);
         }
         if (q->unicast) {
@@ -1871,6 +2631,10 @@ static void _mdns_create_answer_from_parsed_packet(mdns_parsed_packet_t *parsed_
         }
         q = q->next;
     }
+    if (parsed_packet->known_answers_len && _mdns_suppress_known_answers(packet, parsed_packet) && !packet->answers) {
+        _mdns_free_tx_packet(packet);
+        return;
+    }
     if (unicast || !send_flush) {
         memcpy(&packet->dst, &parsed_packet->src, sizeof(esp_ip_addr_t));
         packet->port = parsed_packet->src_port;
@@ -2838,6 +3602,7 @@ static void _mdns_dup_interface(mdns_if_t tcpip_if)
                 _mdns_pcb_deinit(tcpip_if, i);
             }
             _mdns_server->interfaces[tcpip_if].pcbs[i].state = PCB_DUP;
+            _mdns_response_cache_clear();
             _mdns_announce_pcb(other_if, i, NULL, 0, true);
         }
     }
@@ -2920,14 +3685,7 @@ static bool _hostname_is_ours(const char *hostname)
             strcasecmp(hostname, _mdns_server->hostname) == 0) {
         return true;
     }
-    mdns_host_item_t *host = _mdns_host_list;
-    while (host != NULL) {
-        if (strcasecmp(hostname, host->hostname) == 0) {
-            return true;
-        }
-        host = host->next;
-    }
-    return false;
+    return _mdns_host_index_find(hostname) != NULL;
 }
 
 /**
@@ -2950,6 +3708,10 @@ static bool _mdns_delegate_hostname_add(const char *hostname, mdns_ip_addr_t *ad
     }
     host->address_list = address_list;
     host->hostname = hostname;
+    if (!_mdns_host_index_add(host)) {
+        free(host);
+        return false;
+    }
     host->next = _mdns_host_list;
     _mdns_host_list = host;
     return true;
@@ -2998,6 +3760,11 @@ static void free_delegated_hostnames(void)
         host = host->next;
         free(item);
     }
+    _mdns_host_list = NULL;
+    free(_mdns_host_index);
+    _mdns_host_index = NULL;
+    _mdns_host_index_size = 0;
+    _mdns_host_index_len = 0;
 }
 
 static bool _mdns_delegate_hostname_remove(const char *hostname)
@@ -3016,6 +3783,7 @@ static bool _mdns_delegate_hostname_remove(const char *hostname)
                 prev_srv->next = srv->next;
                 srv = srv->next;
             }
+            _mdns_index_services();
             _mdns_free_service(to_free->service);
             free(to_free);
         } else {
@@ -3023,24 +3791,19 @@ static bool _mdns_delegate_hostname_remove(const char *hostname)
             srv = srv->next;
         }
     }
-    mdns_host_item_t *host = _mdns_host_list;
-    mdns_host_item_t *prev_host = NULL;
-    while (host != NULL) {
-        if (strcasecmp(hostname, host->hostname) == 0) {
-            if (prev_host == NULL) {
-                _mdns_host_list = host->next;
-            } else {
-                prev_host->next = host->next;
-            }
-            free_address_list(host->address_list);
-            free((char *)host->hostname);
-            free(host);
-            break;
-        } else {
-            prev_host = host;
-            host = host->next;
-        }
+    mdns_host_item_t *host = _mdns_host_index_find(hostname);
+    if (host == NULL) {
+        return true;
     }
+    _mdns_host_index_remove(host);
+    mdns_host_item_t **item = &_mdns_host_list;
+    while (*item != host) {
+        item = &(*item)->next;
+    }
+    *item = host->next;
+    free_address_list(host->address_list);
+    free((char *)host->hostname);
+    free(host);
     return true;
 }
 
@@ -3187,6 +3950,20 @@ static const uint8_t *_mdns_parse_fqdn(const uint8_t *packet, const uint8_t *sta
     return next_data;
 }
 
+/**
+ * @brief  Called from parser to check if a known SRV record is the one we would answer with
+ *
+ * @param  target       the parsed target of the record
+ */
+static bool _mdns_srv_is_ours(const mdns_service_t *service, uint16_t priority, uint16_t weight, uint16_t port,
+                              const mdns_name_t *target)
+{
+    const char *hostname = service->hostname ? service->hostname : _mdns_server->hostname;
+    return priority == service->priority && weight == service->weight && port == service->port
+           && !_str_null_or_empty(hostname) && !strcasecmp(target->host, hostname)
+           && !target->service[0] && !target->proto[0] && !strcasecmp(target->domain, MDNS_DEFAULT_DOMAIN);
+}
+
 /**
  * @brief  Called from parser to check if question matches particular service
  */
@@ -3195,24 +3972,13 @@ static bool _mdns_question_matches(mdns_parsed_question_t *question, uint16_t ty
     if (question->type != type) {
         return false;
     }
-    if (type == MDNS_TYPE_A || type == MDNS_TYPE_AAAA) {
-        return true;
-    } else if (type == MDNS_TYPE_PTR || type == MDNS_TYPE_SDPTR) {
+    if (type == MDNS_TYPE_PTR || type == MDNS_TYPE_SDPTR) {
         if (question->service && question->proto && question->domain
                 && !strcasecmp(service->service->service, question->service)
                 && !strcasecmp(service->service->proto, question->proto)
                 && !strcasecmp(MDNS_DEFAULT_DOMAIN, question->domain)) {
             return true;
         }
-    } else if (service && (type == MDNS_TYPE_SRV || type == MDNS_TYPE_TXT)) {
-        const char *name = _mdns_get_service_instance_name(service->service);
-        if (name && question->host && question->service && question->proto && question->domain
-                && !strcasecmp(name, question->host)
-                && !strcasecmp(service->service->service, question->service)
-                && !strcasecmp(service->service->proto, question->proto)
-                && !strcasecmp(MDNS_DEFAULT_DOMAIN, question->domain)) {
-            return true;
-        }
     }
 
     return false;
@@ -3227,11 +3993,7 @@ static void _mdns_remove_parsed_question(mdns_parsed_packet_t *parsed_packet, ui
 
     if (_mdns_question_matches(q, type, service)) {
         parsed_packet->questions = q->next;
-        free(q->host);
-        free(q->service);
-        free(q->proto);
-        free(q->domain);
-        free(q);
+        _mdns_pool_free(&_mdns_question_pool, q);
         return;
     }
 
@@ -3239,11 +4001,7 @@ static void _mdns_remove_parsed_question(mdns_parsed_packet_t *parsed_packet, ui
         mdns_parsed_question_t *p = q->next;
         if (_mdns_question_matches(p, type, service)) {
             q->next = p->next;
-            free(p->host);
-            free(p->service);
-            free(p->proto);
-            free(p->domain);
-            free(p);
+            _mdns_pool_free(&_mdns_question_pool, p);
             return;
         }
         q = q->next;
@@ -3317,90 +4075,354 @@ static void _mdns_result_txt_create(const uint8_t *data, size_t len, mdns_txt_it
         HOOK_MALLOC_FAILED;
         return;
     }
-    uint8_t *txt_value_len = (uint8_t *)malloc(num_items);
-    if (!txt_value_len) {
-        free(txt);
-        HOOK_MALLOC_FAILED;
+    uint8_t *txt_value_len = (uint8_t *)malloc(num_items);
+    if (!txt_value_len) {
+        free(txt);
+        HOOK_MALLOC_FAILED;
+        return;
+    }
+    memset(txt, 0, sizeof(mdns_txt_item_t) * num_items);
+    memset(txt_value_len, 0, num_items);
+    size_t txt_num = 0;
+
+    while (i < len) {
+        partLen = data[i++];
+        if (!partLen) {
+            break;
+        }
+
+        if ((i + partLen) > len) {
+            goto handle_error;//error
+        }
+
+        int name_len = _mdns_txt_item_name_get_len(data + i, partLen);
+        if (name_len < 0) {//invalid item (no name)
+            i += partLen;
+            continue;
+        }
+        char *key = (char *)malloc(name_len + 1);
+        if (!key) {
+            HOOK_MALLOC_FAILED;
+            goto handle_error;//error
+        }
+
+        mdns_txt_item_t *t = &txt[txt_num];
+        uint8_t *value_len = &txt_value_len[txt_num];
+        txt_num++;
+
+        memcpy(key, data + i, name_len);
+        key[name_len] = 0;
+        i += name_len + 1;
+        t->key = key;
+
+        int new_value_len = partLen - name_len - 1;
+        if (new_value_len > 0) {
+            char *value = (char *)malloc(new_value_len + 1);
+            if (!value) {
+                HOOK_MALLOC_FAILED;
+                goto handle_error;//error
+            }
+            memcpy(value, data + i, new_value_len);
+            value[new_value_len] = 0;
+            *value_len = new_value_len;
+            i += new_value_len;
+            t->value = value;
+        }
+    }
+
+    *out_txt = txt;
+    *out_count = txt_num;
+    *out_value_len = txt_value_len;
+    return;
+
+handle_error :
+    for (y = 0; y < txt_num; y++) {
+        mdns_txt_item_t *t = &txt[y];
+        free((char *)t->key);
+        free((char *)t->value);
+    }
+    free(txt_value_len);
+    free(txt);
+}
+
+/**
+ * @brief  Take a question from the pool and push it to the parsed packet
+ */
+static mdns_parsed_question_t *_mdns_alloc_parsed_question(mdns_parsed_packet_t *parsed_packet)
+{
+    mdns_parsed_question_t *question = (mdns_parsed_question_t *)_mdns_pool_alloc(&_mdns_question_pool);
+    if (!question) {
+        ESP_LOGW(TAG, "Too many questions, the packet is not answered");
+        return NULL;
+    }
+    question->next = parsed_packet->questions;
+    parsed_packet->questions = question;
+    return question;
+}
+
+/**
+ * @brief  records received from other hosts, kept to answer our queries
+ */
+static struct {
+    mdns_cached_record_t *records[MDNS_RESULT_CACHE_SIZE];
+    uint8_t len;
+    uint32_t hits;
+    uint32_t misses;
+    uint32_t too_large;             // records with names or TXT data larger than an entry
+} _mdns_result_cache;
+
+static void _mdns_result_cache_remove(uint8_t i)
+{
+    _mdns_pool_free(&_mdns_result_pool, _mdns_result_cache.records[i]);
+    _mdns_result_cache.records[i] = _mdns_result_cache.records[--_mdns_result_cache.len];
+    _mdns_result_cache.records[_mdns_result_cache.len] = NULL;
+}
+
+/**
+ * @brief  forgets all the received records
+ */
+static void _mdns_result_cache_clear(void)
+{
+    while (_mdns_result_cache.len) {
+        _mdns_result_cache_remove(_mdns_result_cache.len - 1);
+    }
+}
+
+/**
+ * @brief  forgets the records received on an interface, called when it goes down
+ */
+static void _mdns_result_cache_clear_if(mdns_if_t tcpip_if, mdns_ip_protocol_t ip_protocol)
+{
+    uint8_t i = 0;
+    while (i < _mdns_result_cache.len) {
+        mdns_cached_record_t *r = _mdns_result_cache.records[i];
+        if (r->tcpip_if == tcpip_if && r->ip_protocol == ip_protocol) {
+            _mdns_result_cache_remove(i);
+        } else {
+            i++;
+        }
+    }
+}
+
+static bool _mdns_cached_record_same_data(const mdns_cached_record_t *a, const mdns_cached_record_t *b)
+{
+    switch (a->type) {
+    case MDNS_TYPE_PTR:
+        return !strcasecmp(a->target, b->target);
+    case MDNS_TYPE_SRV:
+        return a->port == b->port && !strcasecmp(a->target, b->target);
+    case MDNS_TYPE_TXT:
+        return a->txt_len == b->txt_len && !memcmp(a->txt, b->txt, a->txt_len);
+    case MDNS_TYPE_A:
+        return a->addr.u_addr.ip4.addr == b->addr.u_addr.ip4.addr;
+    default:
+        return !memcmp(a->addr.u_addr.ip6.addr, b->addr.u_addr.ip6.addr, MDNS_ANSWER_AAAA_SIZE);
+    }
+}
+
+/**
+ * @brief  Called from parser to cache a PTR, SRV, TXT, A or AAAA record of another host
+ *
+ * A record received again refreshes its TTL. Goodbyes (TTL 0) and records with the cache-flush bit
+ * make the cached records they replace expire in a second (RFC 6762, 10.1 and 10.2).
+ */
+static void _mdns_result_cache_add(const mdns_name_t *name, uint16_t type, uint32_t ttl, bool flush,
+                                   const uint8_t *data, size_t len, const uint8_t *data_ptr, uint16_t data_len,
+                                   mdns_if_t tcpip_if, mdns_ip_protocol_t ip_protocol)
+{
+    static mdns_name_t target;
+    static mdns_cached_record_t record;
+
+    if (name->sub) {
+        return;
+    }
+    memset(&record, 0, sizeof(record));
+    switch (type) {
+    case MDNS_TYPE_PTR:
+        if (!_mdns_parse_fqdn(data, data_ptr, &target, len) || !target.host[0]
+                || strcasecmp(target.service, name->service) || strcasecmp(target.proto, name->proto)) {
+            return;
+        }
+        memcpy(record.target, target.host, sizeof(record.target));
+        break;
+    case MDNS_TYPE_SRV:
+        if (data_len <= MDNS_SRV_FQDN_OFFSET || !_mdns_parse_fqdn(data, data_ptr + MDNS_SRV_FQDN_OFFSET, &target, len)) {
+            return;
+        }
+        record.port = _mdns_read_u16(data_ptr, MDNS_SRV_PORT_OFFSET);
+        memcpy(record.target, target.host, sizeof(record.target));
+        break;
+    case MDNS_TYPE_TXT:
+        if (data_len > sizeof(record.txt)) {
+            _mdns_result_cache.too_large++;
+            return;
+        }
+        memcpy(record.txt, data_ptr, data_len);
+        record.txt_len = data_len;
+        break;
+    case MDNS_TYPE_A:
+        if (data_len != sizeof(uint32_t)) {
+            return;
+        }
+        record.addr.type = ESP_IPADDR_TYPE_V4;
+        memcpy(&record.addr.u_addr.ip4.addr, data_ptr, sizeof(uint32_t));
+        break;
+#if CONFIG_LWIP_IPV6
+    case MDNS_TYPE_AAAA:
+        if (data_len != MDNS_ANSWER_AAAA_SIZE) {
+            return;
+        }
+        record.addr.type = ESP_IPADDR_TYPE_V6;
+        memcpy(record.addr.u_addr.ip6.addr, data_ptr, MDNS_ANSWER_AAAA_SIZE);
+        break;
+#endif
+    default:
+        return;
+    }
+
+    size_t service_len = strlen(name->service) + 1;
+    size_t proto_len = strlen(name->proto) + 1;
+    if (service_len > sizeof(record.service) || proto_len > sizeof(record.proto)) {
+        _mdns_result_cache.too_large++;
         return;
     }
-    memset(txt, 0, sizeof(mdns_txt_item_t) * num_items);
-    memset(txt_value_len, 0, num_items);
-    size_t txt_num = 0;
-
-    while (i < len) {
-        partLen = data[i++];
-        if (!partLen) {
-            break;
-        }
-
-        if ((i + partLen) > len) {
-            goto handle_error;//error
+    uint32_t now = xTaskGetTickCount() * portTICK_PERIOD_MS;
+    bool found = false;
+    uint8_t i = 0;
+    record.type = type;
+    record.tcpip_if = tcpip_if;
+    record.ip_protocol = ip_protocol;
+    memcpy(record.host, name->host, sizeof(record.host));
+    memcpy(record.service, name->service, service_len);
+    memcpy(record.proto, name->proto, proto_len);
+    record.received = now;
+    record.expires = now + (ttl < MDNS_RESULT_CACHE_TTL_MAX ? ttl : MDNS_RESULT_CACHE_TTL_MAX) * 1000;
+
+    while (i < _mdns_result_cache.len) {
+        mdns_cached_record_t *r = _mdns_result_cache.records[i];
+        if ((int32_t)(r->expires - now) <= 0) {
+            _mdns_result_cache_remove(i);
+            continue;
         }
-
-        int name_len = _mdns_txt_item_name_get_len(data + i, partLen);
-        if (name_len < 0) {//invalid item (no name)
-            i += partLen;
+        i++;
+        if (r->type != type || r->tcpip_if != tcpip_if || r->ip_protocol != ip_protocol
+                || strcasecmp(r->host, name->host) || strcasecmp(r->service, name->service) || strcasecmp(r->proto, name->proto)) {
             continue;
         }
-        char *key = (char *)malloc(name_len + 1);
-        if (!key) {
-            HOOK_MALLOC_FAILED;
-            goto handle_error;//error
+        bool same = _mdns_cached_record_same_data(r, &record);
+        if (same && ttl) {
+            r->received = now;
+            r->expires = record.expires;
+        } else if ((same || (flush && (int32_t)(now - r->received) > MDNS_RESULT_CACHE_FLUSH_MS))
+                   && (int32_t)(r->expires - now) > MDNS_RESULT_CACHE_FLUSH_MS) {
+            r->expires = now + MDNS_RESULT_CACHE_FLUSH_MS;
         }
+        found |= same;
+    }
+    if (found || !ttl) {
+        return;
+    }
 
-        mdns_txt_item_t *t = &txt[txt_num];
-        uint8_t *value_len = &txt_value_len[txt_num];
-        txt_num++;
-
-        memcpy(key, data + i, name_len);
-        key[name_len] = 0;
-        i += name_len + 1;
-        t->key = key;
-
-        int new_value_len = partLen - name_len - 1;
-        if (new_value_len > 0) {
-            char *value = (char *)malloc(new_value_len + 1);
-            if (!value) {
-                HOOK_MALLOC_FAILED;
-                goto handle_error;//error
+    mdns_cached_record_t *r = (mdns_cached_record_t *)_mdns_pool_alloc(&_mdns_result_pool);
+    if (!r && _mdns_result_cache.len) {
+        // the pool counted the exhaustion, make room by dropping the record closest to expiry
+        uint8_t oldest = 0;
+        for (i = 1; i < _mdns_result_cache.len; i++) {
+            if ((int32_t)(_mdns_result_cache.records[i]->expires - _mdns_result_cache.records[oldest]->expires) < 0) {
+                oldest = i;
             }
-            memcpy(value, data + i, new_value_len);
-            value[new_value_len] = 0;
-            *value_len = new_value_len;
-            i += new_value_len;
-            t->value = value;
         }
+        _mdns_result_cache_remove(oldest);
+        r = (mdns_cached_record_t *)_mdns_pool_alloc(&_mdns_result_pool);
+    }
+    if (r) {
+        memcpy(r, &record, sizeof(mdns_cached_record_t));
+        _mdns_result_cache.records[_mdns_result_cache.len++] = r;
     }
+}
 
-    *out_txt = txt;
-    *out_count = txt_num;
-    *out_value_len = txt_value_len;
-    return;
+/**
+ * @brief  adds a cached record to the results of a search, the way the parser adds a received one
+ */
+static void _mdns_result_cache_replay(mdns_search_once_t *search, const mdns_cached_record_t *r, uint32_t ttl)
+{
+    mdns_result_t *result = NULL;
+    mdns_txt_item_t *txt = NULL;
+    uint8_t *txt_value_len = NULL;
+    size_t txt_count = 0;
 
-handle_error :
-    for (y = 0; y < txt_num; y++) {
-        mdns_txt_item_t *t = &txt[y];
-        free((char *)t->key);
-        free((char *)t->value);
+    switch (r->type) {
+    case MDNS_TYPE_PTR:
+        _mdns_search_result_add_ptr(search, r->target, r->service, r->proto, r->tcpip_if, r->ip_protocol, ttl);
+        break;
+    case MDNS_TYPE_SRV:
+        if (search->type != MDNS_TYPE_PTR) {
+            _mdns_search_result_add_srv(search, r->target, r->port, r->tcpip_if, r->ip_protocol, ttl);
+        } else if ((result = _mdns_search_result_add_ptr(search, r->host, r->service, r->proto, r->tcpip_if,
+                             r->ip_protocol, ttl)) && !result->hostname) {
+            result->port = r->port;
+            result->hostname = strdup(r->target);
+        }
+        break;
+    case MDNS_TYPE_TXT:
+        if (search->type != MDNS_TYPE_PTR) {
+            _mdns_result_txt_create(r->txt, r->txt_len, &txt, &txt_value_len, &txt_count);
+            if (txt_count) {
+                _mdns_search_result_add_txt(search, txt, txt_value_len, txt_count, r->tcpip_if, r->ip_protocol, ttl);
+            }
+        } else if ((result = _mdns_search_result_add_ptr(search, r->host, r->service, r->proto, r->tcpip_if,
+                             r->ip_protocol, ttl)) && !result->txt) {
+            _mdns_result_txt_create(r->txt, r->txt_len, &txt, &txt_value_len, &txt_count);
+            if (txt_count) {
+                result->txt = txt;
+                result->txt_count = txt_count;
+                result->txt_value_len = txt_value_len;
+            }
+        }
+        break;
+    default:
+        _mdns_search_result_add_ip(search, r->host, (esp_ip_addr_t *)&r->addr, r->tcpip_if, r->ip_protocol, ttl);
+        break;
     }
-    free(txt_value_len);
-    free(txt);
 }
 
 /**
- * @brief  Duplicate string or return error
+ * @brief  Called when a search starts, to collect the results from the cached records
+ *
+ * @param  search       the search, not yet in the search chain
+ *
+ * @return true if the search is answered and does not need to go to the network
  */
-static esp_err_t _mdns_strdup_check(char **out, char *in)
+static bool _mdns_result_cache_answer(mdns_search_once_t *search)
 {
-    if (in && in[0]) {
-        *out = strdup(in);
-        if (!*out) {
-            return ESP_FAIL;
+    // instances first, so that their hosts are known when the addresses are added
+    static const uint16_t types[] = { MDNS_TYPE_PTR, MDNS_TYPE_SRV, MDNS_TYPE_TXT, MDNS_TYPE_A, MDNS_TYPE_AAAA };
+    static mdns_name_t name;
+    uint32_t now = xTaskGetTickCount() * portTICK_PERIOD_MS;
+
+    for (size_t t = 0; t < ARRAY_SIZE(types); t++) {
+        for (uint8_t i = 0; i < _mdns_result_cache.len; i++) {
+            mdns_cached_record_t *r = _mdns_result_cache.records[i];
+            int32_t left = (int32_t)(r->expires - now);
+            if (r->type != types[t] || left <= 0) {
+                continue;
+            }
+            memcpy(name.host, r->host, strlen(r->host) + 1);
+            memcpy(name.service, r->service, strlen(r->service) + 1);
+            memcpy(name.proto, r->proto, strlen(r->proto) + 1);
+            if (_mdns_search_find_from(search, &name, r->type, r->tcpip_if, r->ip_protocol)) {
+                _mdns_result_cache_replay(search, r, (left + 999) / 1000);
+            }
         }
-        return ESP_OK;
     }
-    *out = NULL;
-    return ESP_OK;
+    if (!search->num_results) {
+        return false;
+    }
+    if (search->max_results && search->num_results >= search->max_results) {
+        return true;
+    }
+    // other hosts may have instances of a service type, or records of a name, we have not heard of
+    return search->type != MDNS_TYPE_PTR && search->type != MDNS_TYPE_ANY;
 }
 
 /**
@@ -3452,11 +4474,9 @@ void mdns_parse_packet(mdns_rx_packet_t *packet)
         return;
     }
 
-    mdns_parsed_packet_t *parsed_packet = (mdns_parsed_packet_t *)malloc(sizeof(mdns_parsed_packet_t));
-    if (!parsed_packet) {
-        HOOK_MALLOC_FAILED;
-        return;
-    }
+    // packets are parsed one at a time by the service task
+    static mdns_parsed_packet_t parsed;
+    mdns_parsed_packet_t *parsed_packet = &parsed;
     memset(parsed_packet, 0, sizeof(mdns_parsed_packet_t));
 
     mdns_name_t *name = &n;
@@ -3470,13 +4490,11 @@ void mdns_parse_packet(mdns_rx_packet_t *packet)
     header.additional = _mdns_read_u16(data, MDNS_HEAD_ADDITIONAL_OFFSET);
 
     if (header.flags == MDNS_FLAGS_QR_AUTHORITATIVE && packet->src_port != MDNS_SERVICE_PORT) {
-        free(parsed_packet);
         return;
     }
 
     //if we have not set the hostname, we can not answer questions
     if (header.questions && !header.answers && _str_null_or_empty(_mdns_server->hostname)) {
-        free(parsed_packet);
         return;
     }
 
@@ -3519,23 +4537,29 @@ void mdns_parse_packet(mdns_rx_packet_t *packet)
                 parsed_packet->discovery = true;
                 mdns_srv_item_t *a = _mdns_server->services;
                 while (a) {
-                    mdns_parsed_question_t *question = (mdns_parsed_question_t *)calloc(1, sizeof(mdns_parsed_question_t));
+                    // one question per service type, it is answered for all its services
+                    mdns_parsed_question_t *question = parsed_packet->questions;
+                    while (question && (question->type != MDNS_TYPE_SDPTR
+                                        || strcasecmp(question->service, a->service->service)
+                                        || strcasecmp(question->proto, a->service->proto))) {
+                        question = question->next;
+                    }
+                    if (question) {
+                        a = a->next;
+                        continue;
+                    }
+                    question = _mdns_alloc_parsed_question(parsed_packet);
                     if (!question) {
-                        HOOK_MALLOC_FAILED;
                         goto clear_rx_packet;
                     }
-                    question->next = parsed_packet->questions;
-                    parsed_packet->questions = question;
-
+                    // the service cannot go away before the packet is answered
                     question->unicast = unicast;
                     question->type = MDNS_TYPE_SDPTR;
+                    question->sub = false;
                     question->host = NULL;
-                    question->service = strdup(a->service->service);
-                    question->proto = strdup(a->service->proto);
-                    question->domain = strdup(MDNS_DEFAULT_DOMAIN);
-                    if (!question->service || !question->proto || !question->domain) {
-                        goto clear_rx_packet;
-                    }
+                    question->service = (char *)a->service->service;
+                    question->proto = (char *)a->service->proto;
+                    question->domain = (char *)MDNS_DEFAULT_DOMAIN;
                     a = a->next;
                 }
                 continue;
@@ -3548,23 +4572,18 @@ void mdns_parse_packet(mdns_rx_packet_t *packet)
                 parsed_packet->probe = true;
             }
 
-            mdns_parsed_question_t *question = (mdns_parsed_question_t *)calloc(1, sizeof(mdns_parsed_question_t));
+            mdns_parsed_question_t *question = _mdns_alloc_parsed_question(parsed_packet);
             if (!question) {
-                HOOK_MALLOC_FAILED;
                 goto clear_rx_packet;
             }
-            question->next = parsed_packet->questions;
-            parsed_packet->questions = question;
-
             question->unicast = unicast;
             question->type = type;
             question->sub = name->sub;
-            if (_mdns_strdup_check(&(question->host), name->host)
-                    || _mdns_strdup_check(&(question->service), name->service)
-                    || _mdns_strdup_check(&(question->proto), name->proto)
-                    || _mdns_strdup_check(&(question->domain), name->domain)) {
-                goto clear_rx_packet;
-            }
+            memcpy(&question->name, name, sizeof(mdns_name_t));
+            question->host = question->name.host[0] ? question->name.host : NULL;
+            question->service = question->name.service[0] ? question->name.service : NULL;
+            question->proto = question->name.proto[0] ? question->name.proto : NULL;
+            question->domain = question->name.domain[0] ? question->name.domain : NULL;
         }
     }
 
@@ -3588,6 +4607,7 @@ void mdns_parse_packet(mdns_rx_packet_t *packet)
             uint32_t ttl = _mdns_read_u32(content, MDNS_TTL_OFFSET);
             uint16_t data_len = _mdns_read_u16(content, MDNS_LEN_OFFSET);
             const uint8_t *data_ptr = content + MDNS_DATA_OFFSET;
+            bool flush = mdns_class & 0x8000;
             mdns_class &= 0x7FFF;
 
             content = data_ptr + data_len;
@@ -3624,6 +4644,9 @@ void mdns_parse_packet(mdns_rx_packet_t *packet)
                     //skip this record
                     continue;
                 }
+                if (mdns_class == MDNS_CLASS_IN) {
+                    _mdns_result_cache_add(name, type, ttl, flush, data, len, data_ptr, data_len, packet->tcpip_if, packet->ip_protocol);
+                }
                 search_result = _mdns_search_find_from(_mdns_server->search_once, name, type, packet->tcpip_if, packet->ip_protocol);
             }
 
@@ -3638,7 +4661,10 @@ void mdns_parse_packet(mdns_rx_packet_t *packet)
                     if (discovery && (service = _mdns_get_service_item(name->service, name->proto, NULL))) {
                         _mdns_remove_parsed_question(parsed_packet, MDNS_TYPE_SDPTR, service);
                     } else if (service && parsed_packet->questions && !parsed_packet->probe) {
-                        _mdns_remove_parsed_question(parsed_packet, type, service);
+                        service = _mdns_get_service_item_instance(name->host, name->service, name->proto, NULL);
+                        if (service && ttl >= MDNS_ANSWER_PTR_TTL / 2) {
+                            _mdns_add_known_answer(parsed_packet, type, service, NULL, NULL);
+                        }
                     } else if (service) {
                         //check if TTL is more than half of the full TTL value (4500)
                         if (ttl > (MDNS_ANSWER_PTR_TTL / 2)) {
@@ -3648,6 +4674,10 @@ void mdns_parse_packet(mdns_rx_packet_t *packet)
                 }
             } else if (type == MDNS_TYPE_SRV) {
                 mdns_result_t *result = NULL;
+                mdns_srv_item_t *known = NULL;
+                if (ours && parsed_packet->questions && !parsed_packet->probe && ttl >= MDNS_ANSWER_SRV_TTL / 2) {
+                    known = _mdns_get_service_item_instance(name->host, name->service, name->proto, NULL);
+                }
                 if (search_result && search_result->type == MDNS_TYPE_PTR) {
                     result = search_result->result;
                     while (result) {
@@ -3688,7 +4718,9 @@ void mdns_parse_packet(mdns_rx_packet_t *packet)
                     }
                 } else if (ours) {
                     if (parsed_packet->questions && !parsed_packet->probe) {
-                        _mdns_remove_parsed_question(parsed_packet, type, service);
+                        if (known && _mdns_srv_is_ours(known->service, priority, weight, port, name)) {
+                            _mdns_add_known_answer(parsed_packet, type, known, NULL, NULL);
+                        }
                         continue;
                     } else if (parsed_packet->distributed) {
                         _mdns_remove_scheduled_answer(packet->tcpip_if, packet->ip_protocol, type, service);
@@ -3713,6 +4745,8 @@ void mdns_parse_packet(mdns_rx_packet_t *packet)
                                     if (new_instance) {
                                         free((char *)service->service->instance);
                                         service->service->instance = new_instance;
+                                        _mdns_index_services();
+                                        _mdns_response_cache_clear();
                                     }
                                     _mdns_probe_all_pcbs(&service, 1, false, false);
                                 } else if (!_str_null_or_empty(_mdns_server->instance)) {
@@ -3720,6 +4754,8 @@ void mdns_parse_packet(mdns_rx_packet_t *packet)
                                     if (new_instance) {
                                         free((char *)_mdns_server->instance);
                                         _mdns_server->instance = new_instance;
+                                        _mdns_index_services();
+                                        _mdns_response_cache_clear();
                                     }
                                     _mdns_restart_all_pcbs_no_instance();
                                 } else {
@@ -3729,6 +4765,8 @@ void mdns_parse_packet(mdns_rx_packet_t *packet)
                                         free((char *)_mdns_server->hostname);
                                         _mdns_server->hostname = new_host;
                                         _mdns_self_host.hostname = new_host;
+                                        _mdns_index_services();
+                                        _mdns_response_cache_clear();
                                     }
                                     _mdns_restart_all_pcbs();
                                 }
@@ -3780,8 +4818,11 @@ void mdns_parse_packet(mdns_rx_packet_t *packet)
                         }
                     }
                 } else if (ours) {
-                    if (parsed_packet->questions && !parsed_packet->probe && service) {
-                        _mdns_remove_parsed_question(parsed_packet, type, service);
+                    if (parsed_packet->questions && !parsed_packet->probe) {
+                        mdns_srv_item_t *known = _mdns_get_service_item_instance(name->host, name->service, name->proto, NULL);
+                        if (known && ttl >= MDNS_ANSWER_TXT_TTL / 2 && !_mdns_check_txt_collision(known->service, data_ptr, data_len)) {
+                            _mdns_add_known_answer(parsed_packet, type, known, NULL, NULL);
+                        }
                         continue;
                     }
                     //detect collision (-1=won, 0=none, 1=lost)
@@ -3815,7 +4856,10 @@ void mdns_parse_packet(mdns_rx_packet_t *packet)
                     }
                 } else if (ours) {
                     if (parsed_packet->questions && !parsed_packet->probe) {
-                        _mdns_remove_parsed_question(parsed_packet, type, NULL);
+                        mdns_host_item_t *host = mdns_get_host_item(name->host);
+                        if (host && ttl >= MDNS_ANSWER_AAAA_TTL / 2) {
+                            _mdns_add_known_answer(parsed_packet, type, NULL, host, &ip6);
+                        }
                         continue;
                     }
                     //detect collision (-1=won, 0=none, 1=lost)
@@ -3840,6 +4884,8 @@ void mdns_parse_packet(mdns_rx_packet_t *packet)
                                     free((char *)_mdns_server->hostname);
                                     _mdns_server->hostname = new_host;
                                     _mdns_self_host.hostname = new_host;
+                                    _mdns_index_services();
+                                    _mdns_response_cache_clear();
                                 }
                                 _mdns_restart_all_pcbs();
                             }
@@ -3865,7 +4911,10 @@ void mdns_parse_packet(mdns_rx_packet_t *packet)
                     }
                 } else if (ours) {
                     if (parsed_packet->questions && !parsed_packet->probe) {
-                        _mdns_remove_parsed_question(parsed_packet, type, NULL);
+                        mdns_host_item_t *host = mdns_get_host_item(name->host);
+                        if (host && ttl >= MDNS_ANSWER_A_TTL / 2) {
+                            _mdns_add_known_answer(parsed_packet, type, NULL, host, &ip);
+                        }
                         continue;
                     }
                     //detect collision (-1=won, 0=none, 1=lost)
@@ -3890,6 +4939,8 @@ void mdns_parse_packet(mdns_rx_packet_t *packet)
                                     free((char *)_mdns_server->hostname);
                                     _mdns_server->hostname = new_host;
                                     _mdns_self_host.hostname = new_host;
+                                    _mdns_index_services();
+                                    _mdns_response_cache_clear();
                                 }
                                 _mdns_restart_all_pcbs();
                             }
@@ -3918,21 +4969,8 @@ clear_rx_packet:
     while (parsed_packet->questions) {
         mdns_parsed_question_t *question = parsed_packet->questions;
         parsed_packet->questions = parsed_packet->questions->next;
-        if (question->host) {
-            free(question->host);
-        }
-        if (question->service) {
-            free(question->service);
-        }
-        if (question->proto) {
-            free(question->proto);
-        }
-        if (question->domain) {
-            free(question->domain);
-        }
-        free(question);
+        _mdns_pool_free(&_mdns_question_pool, question);
     }
-    free(parsed_packet);
 }
 
 /**
@@ -3954,6 +4992,7 @@ void _mdns_enable_pcb(mdns_if_t tcpip_if, mdns_ip_protocol_t ip_protocol)
 void _mdns_disable_pcb(mdns_if_t tcpip_if, mdns_ip_protocol_t ip_protocol)
 {
     _mdns_clean_netif_ptr(tcpip_if);
+    _mdns_result_cache_clear_if(tcpip_if, ip_protocol);
 
     if (_mdns_server->interfaces[tcpip_if].pcbs[ip_protocol].pcb) {
         _mdns_clear_pcb_tx_queue_head(tcpip_if, ip_protocol);
@@ -4222,6 +5261,7 @@ static mdns_search_once_t *_mdns_search_init(const char *name, const char *servi
 static void _mdns_search_finish(mdns_search_once_t *search)
 {
     search->state = SEARCH_OFF;
+    _mdns_deadline_disarm(&search->deadline);
     queueDetach(mdns_search_once_t, _mdns_server->search_once, search);
     if (search->notifier) {
         search->notifier(search);
@@ -4234,8 +5274,20 @@ static void _mdns_search_finish(mdns_search_once_t *search)
  */
 static void _mdns_search_add(mdns_search_once_t *search)
 {
+    bool answered = _mdns_result_cache_answer(search);
     search->next = _mdns_server->search_once;
     _mdns_server->search_once = search;
+    if (answered) {
+        _mdns_result_cache.hits++;
+        _mdns_search_finish(search);
+        return;
+    }
+    _mdns_result_cache.misses++;
+    search->deadline.type = MDNS_DEADLINE_SEARCH;
+    search->deadline.owner = search;
+    if (!_mdns_deadline_arm(&search->deadline, xTaskGetTickCount() * portTICK_PERIOD_MS)) {
+        _mdns_search_finish(search);
+    }
 }
 
 /**
@@ -4735,6 +5787,69 @@ static void _mdns_remap_self_service_hostname(const char *old_hostname, const ch
     }
 }
 
+/**
+ * @brief  Send the questions of an active search, or finish it once timed out
+ */
+static void _mdns_search_run(mdns_search_once_t *search, uint32_t now)
+{
+    uint32_t end = search->started_at + search->timeout;
+    if ((int32_t)(now - end) >= 0) {
+        _mdns_search_finish(search);
+        return;
+    }
+    search->state = SEARCH_RUNNING;
+    search->sent_at = now;
+    _mdns_search_send(search);
+    if ((int32_t)(end - now) > MDNS_SEARCH_RESEND_MS) {
+        end = now + MDNS_SEARCH_RESEND_MS;
+    }
+    if (!_mdns_deadline_arm(&search->deadline, end)) {
+        _mdns_search_finish(search);
+    }
+}
+
+/**
+ * @brief  Transmit the packets and run the searches whose deadline has expired
+ */
+static void _mdns_run_deadlines(void)
+{
+    uint32_t now = xTaskGetTickCount() * portTICK_PERIOD_MS;
+    mdns_deadline_t *d;
+    while ((d = _mdns_deadline_first()) && (int32_t)(d->at - now) <= 0) {
+        _mdns_deadline_disarm(d);
+        if (d->type == MDNS_DEADLINE_TX) {
+            mdns_tx_packet_t *p = (mdns_tx_packet_t *)d->owner;
+            queueDetach(mdns_tx_packet_t, _mdns_server->tx_queue_head, p);
+            _mdns_tx_handle_packet(p);
+        } else {
+            _mdns_search_run((mdns_search_once_t *)d->owner, now);
+        }
+    }
+}
+
+/**
+ * @brief  Arm the timer one-shot for the earliest deadline, if it is not armed for it already
+ */
+static void _mdns_timer_rearm(void)
+{
+    mdns_deadline_t *d = _mdns_deadline_first();
+    if (_mdns_server->deadlines.timer_armed && d && d->at == _mdns_server->deadlines.timer_at) {
+        return;
+    }
+    if (_mdns_server->deadlines.timer_armed) {
+        esp_timer_stop(_mdns_server->timer_handle);
+        _mdns_server->deadlines.timer_armed = false;
+    }
+    if (!d) {
+        return;
+    }
+    int32_t delay = (int32_t)(d->at - xTaskGetTickCount() * portTICK_PERIOD_MS);
+    if (esp_timer_start_once(_mdns_server->timer_handle, delay > 0 ? (uint64_t)delay * 1000 : 0) == ESP_OK) {
+        _mdns_server->deadlines.timer_armed = true;
+        _mdns_server->deadlines.timer_at = d->at;
+    }
+}
+
 /**
  * @brief  Free action data
  */
@@ -4768,15 +5883,8 @@ static void _mdns_free_action(mdns_action_t *action)
         free(action->data.srv_subtype_add.subtype);
         break;
     case ACTION_SEARCH_ADD:
-    //fallthrough
-    case ACTION_SEARCH_SEND:
-    //fallthrough
-    case ACTION_SEARCH_END:
         _mdns_search_free(action->data.search_add.search);
         break;
-    case ACTION_TX_HANDLE:
-        _mdns_free_tx_packet(action->data.tx_handle.packet);
-        break;
     case ACTION_RX_HANDLE:
         _mdns_packet_free(action->data.rx_handle.packet);
         break;
@@ -4790,7 +5898,7 @@ static void _mdns_free_action(mdns_action_t *action)
     default:
         break;
     }
-    free(action);
+    _mdns_release_action(action);
 }
 
 /**
@@ -4816,6 +5924,7 @@ static void _mdns_execute_action(mdns_action_t *action)
         free((char *)_mdns_server->hostname);
         _mdns_server->hostname = action->data.hostname_set.hostname;
         _mdns_self_host.hostname = action->data.hostname_set.hostname;
+        _mdns_index_services();
         _mdns_restart_all_pcbs();
         xSemaphoreGive(_mdns_server->action_sema);
         break;
@@ -4823,12 +5932,14 @@ static void _mdns_execute_action(mdns_action_t *action)
         _mdns_send_bye_all_pcbs_no_instance(false);
         free((char *)_mdns_server->instance);
         _mdns_server->instance = action->data.instance;
+        _mdns_index_services();
         _mdns_restart_all_pcbs_no_instance();
 
         break;
     case ACTION_SERVICE_ADD:
         action->data.srv_add.service->next = _mdns_server->services;
         _mdns_server->services = action->data.srv_add.service;
+        _mdns_index_services();
         _mdns_probe_all_pcbs(&action->data.srv_add.service, 1, false, false);
         break;
     case ACTION_SERVICE_INSTANCE_SET:
@@ -4837,6 +5948,7 @@ static void _mdns_execute_action(mdns_action_t *action)
             free((char *)action->data.srv_instance.service->service->instance);
         }
         action->data.srv_instance.service->service->instance = action->data.srv_instance.instance;
+        _mdns_index_services();
         _mdns_probe_all_pcbs(&action->data.srv_instance.service, 1, false, false);
 
         break;
@@ -4935,6 +6047,7 @@ static void _mdns_execute_action(mdns_action_t *action)
         if (action->data.srv_del.service) {
             if (_mdns_server->services == action->data.srv_del.service) {
                 _mdns_server->services = a->next;
+                _mdns_index_services();
                 _mdns_send_bye(&a, 1, false);
                 _mdns_remove_scheduled_service_packets(a->service);
                 _mdns_free_service(a->service);
@@ -4946,6 +6059,7 @@ static void _mdns_execute_action(mdns_action_t *action)
                 if (a->next == action->data.srv_del.service) {
                     mdns_srv_item_t *b = a->next;
                     a->next = a->next->next;
+                    _mdns_index_services();
                     _mdns_send_bye(&b, 1, false);
                     _mdns_remove_scheduled_service_packets(b->service);
                     _mdns_free_service(b->service);
@@ -4959,6 +6073,7 @@ static void _mdns_execute_action(mdns_action_t *action)
         _mdns_send_final_bye(false);
         a = _mdns_server->services;
         _mdns_server->services = NULL;
+        _mdns_index_services();
         while (a) {
             mdns_srv_item_t *s = a;
             a = a->next;
@@ -4971,24 +6086,10 @@ static void _mdns_execute_action(mdns_action_t *action)
     case ACTION_SEARCH_ADD:
         _mdns_search_add(action->data.search_add.search);
         break;
-    case ACTION_SEARCH_SEND:
-        _mdns_search_send(action->data.search_add.search);
-        break;
-    case ACTION_SEARCH_END:
-        _mdns_search_finish(action->data.search_add.search);
+    case ACTION_TIMER:
+        _mdns_server->deadlines.timer_armed = false;
+        _mdns_run_deadlines();
         break;
-    case ACTION_TX_HANDLE: {
-        mdns_tx_packet_t *p = _mdns_server->tx_queue_head;
-        // packet to be handled should be at tx head, but must be consistent with the one pushed to action queue
-        if (p && p == action->data.tx_handle.packet && p->queued) {
-            p->queued = false; // clearing, as the packet might be reused (pushed and transmitted again)
-            _mdns_server->tx_queue_head = p->next;
-            _mdns_tx_handle_packet(p);
-        } else {
-            ESP_LOGD(TAG, "Skipping transmit of an unexpected packet!");
-        }
-    }
-    break;
     case ACTION_RX_HANDLE:
         mdns_parse_packet(action->data.rx_handle.packet);
         _mdns_packet_free(action->data.rx_handle.packet);
@@ -5007,7 +6108,11 @@ static void _mdns_execute_action(mdns_action_t *action)
     default:
         break;
     }
-    free(action);
+    if (action->type != ACTION_TIMER && action->type != ACTION_RX_HANDLE && action->type != ACTION_SEARCH_ADD) {
+        // services, hosts or interfaces changed
+        _mdns_response_cache_clear();
+    }
+    _mdns_release_action(action);
 }
 
 /**
@@ -5017,92 +6122,20 @@ static esp_err_t _mdns_send_search_action(mdns_action_type_t type, mdns_search_o
 {
     mdns_action_t *action = NULL;
 
-    action = (mdns_action_t *)malloc(sizeof(mdns_action_t));
+    action = _mdns_alloc_action();
     if (!action) {
-        HOOK_MALLOC_FAILED;
         return ESP_ERR_NO_MEM;
     }
 
     action->type = type;
     action->data.search_add.search = search;
     if (xQueueSend(_mdns_server->action_queue, &action, (TickType_t)0) != pdPASS) {
-        free(action);
+        _mdns_release_action(action);
         return ESP_ERR_NO_MEM;
     }
     return ESP_OK;
 }
 
-/**
- * @brief  Called from timer task to run mDNS responder
- *
- * periodically checks first unqueued packet (from tx head).
- * if it is scheduled to be transmitted, then pushes the packet to action queue to be handled.
- *
- */
-static void _mdns_scheduler_run(void)
-{
-    MDNS_SERVICE_LOCK();
-    mdns_tx_packet_t *p = _mdns_server->tx_queue_head;
-    mdns_action_t *action = NULL;
-
-    // find first unqueued packet
-    while (p && p->queued) {
-        p = p->next;
-    }
-    if (!p) {
-        MDNS_SERVICE_UNLOCK();
-        return;
-    }
-    if ((int32_t)(p->send_at - (xTaskGetTickCount() * portTICK_PERIOD_MS)) < 0) {
-        action = (mdns_action_t *)malloc(sizeof(mdns_action_t));
-        if (action) {
-            action->type = ACTION_TX_HANDLE;
-            action->data.tx_handle.packet = p;
-            p->queued = true;
-            if (xQueueSend(_mdns_server->action_queue, &action, (TickType_t)0) != pdPASS) {
-                free(action);
-                p->queued = false;
-            }
-        } else {
-            HOOK_MALLOC_FAILED;
-            // continue
-        }
-    }
-    MDNS_SERVICE_UNLOCK();
-}
-
-/**
- * @brief  Called from timer task to run active searches
- */
-static void _mdns_search_run(void)
-{
-    MDNS_SERVICE_LOCK();
-    mdns_search_once_t *s = _mdns_server->search_once;
-    uint32_t now = xTaskGetTickCount() * portTICK_PERIOD_MS;
-    if (!s) {
-        MDNS_SERVICE_UNLOCK();
-        return;
-    }
-    while (s) {
-        if (s->state != SEARCH_OFF) {
-            if (now > (s->started_at + s->timeout)) {
-                s->state = SEARCH_OFF;
-                if (_mdns_send_search_action(ACTION_SEARCH_END, s) != ESP_OK) {
-                    s->state = SEARCH_RUNNING;
-                }
-            } else if (s->state == SEARCH_INIT || (now - s->sent_at) > 1000) {
-                s->state = SEARCH_RUNNING;
-                s->sent_at = now;
-                if (_mdns_send_search_action(ACTION_SEARCH_SEND, s) != ESP_OK) {
-                    s->sent_at -= 1000;
-                }
-            }
-        }
-        s = s->next;
-    }
-    MDNS_SERVICE_UNLOCK();
-}
-
 /**
  * @brief  the main MDNS service task. Packets are received and parsed here
  */
@@ -5117,6 +6150,7 @@ static void _mdns_service_task(void *pvParameters)
                 }
                 MDNS_SERVICE_LOCK();
                 _mdns_execute_action(a);
+                _mdns_timer_rearm();
                 MDNS_SERVICE_UNLOCK();
             }
         } else {
@@ -5127,10 +6161,23 @@ static void _mdns_service_task(void *pvParameters)
     vTaskDelete(NULL);
 }
 
+/**
+ * @brief  Called from timer task once the earliest deadline expired
+ *
+ * Only wakes up the service task, which handles the deadlines and arms the timer for the next one.
+ */
 static void _mdns_timer_cb(void *arg)
 {
-    _mdns_scheduler_run();
-    _mdns_search_run();
+    mdns_action_t *action = _mdns_alloc_action();
+    if (action) {
+        action->type = ACTION_TIMER;
+        if (xQueueSend(_mdns_server->action_queue, &action, (TickType_t)0) == pdPASS) {
+            return;
+        }
+        _mdns_release_action(action);
+    }
+    // action queue is full, try again later
+    esp_timer_start_once(_mdns_server->timer_handle, MDNS_TIMER_PERIOD_US);
 }
 
 static esp_err_t _mdns_start_timer(void)
@@ -5141,21 +6188,16 @@ static esp_err_t _mdns_start_timer(void)
         .dispatch_method = ESP_TIMER_TASK,
         .name = "mdns_timer"
     };
-    esp_err_t err = esp_timer_create(&timer_conf, &(_mdns_server->timer_handle));
-    if (err) {
-        return err;
-    }
-    return esp_timer_start_periodic(_mdns_server->timer_handle, MDNS_TIMER_PERIOD_US);
+    _mdns_server->deadlines.timer_armed = false;
+    return esp_timer_create(&timer_conf, &(_mdns_server->timer_handle));
 }
 
 static esp_err_t _mdns_stop_timer(void)
 {
     esp_err_t err = ESP_OK;
     if (_mdns_server->timer_handle) {
-        err = esp_timer_stop(_mdns_server->timer_handle);
-        if (err) {
-            return err;
-        }
+        // not running unless a deadline is pending
+        esp_timer_stop(_mdns_server->timer_handle);
         err = esp_timer_delete(_mdns_server->timer_handle);
     }
     return err;
@@ -5204,7 +6246,6 @@ static esp_err_t _mdns_service_task_start(void)
  */
 static esp_err_t _mdns_service_task_stop(void)
 {
-    _mdns_stop_timer();
     if (_mdns_service_task_handle) {
         mdns_action_t action;
         mdns_action_t *a = &action;
@@ -5217,6 +6258,8 @@ static esp_err_t _mdns_service_task_stop(void)
             vTaskDelay(10 / portTICK_PERIOD_MS);
         }
     }
+    // the service task arms the timer, so stop the timer once the task is gone
+    _mdns_stop_timer();
     vSemaphoreDelete(_mdns_service_semaphore);
     _mdns_service_semaphore = NULL;
     return ESP_OK;
@@ -5228,9 +6271,8 @@ static esp_err_t mdns_post_custom_action_tcpip_if(mdns_if_t mdns_if, mdns_event_
         return ESP_ERR_INVALID_STATE;
     }
 
-    mdns_action_t *action = (mdns_action_t *)calloc(1, sizeof(mdns_action_t));
+    mdns_action_t *action = _mdns_alloc_action();
     if (!action) {
-        HOOK_MALLOC_FAILED;
         return ESP_ERR_NO_MEM;
     }
     action->type = ACTION_SYSTEM_EVENT;
@@ -5238,7 +6280,7 @@ static esp_err_t mdns_post_custom_action_tcpip_if(mdns_if_t mdns_if, mdns_event_
     action->data.sys_event.interface = mdns_if;
 
     if (xQueueSend(_mdns_server->action_queue, &action, (TickType_t)0) != pdPASS) {
-        free(action);
+        _mdns_release_action(action);
     }
     return ESP_OK;
 }
@@ -5366,6 +6408,15 @@ esp_err_t mdns_init(void)
         goto free_queue;
     }
 
+    if (_mdns_pool_init(&_mdns_action_pool, _mdns_action_blocks, sizeof(mdns_action_t), MDNS_ACTION_POOL_SIZE)
+            || _mdns_pool_init(&_mdns_question_pool, _mdns_question_blocks, sizeof(mdns_parsed_question_t), MDNS_QUESTION_POOL_SIZE)
+            || _mdns_pool_init(&_mdns_result_pool, _mdns_result_blocks, sizeof(mdns_cached_record_t), MDNS_RESULT_CACHE_SIZE)
+            || _mdns_pool_init(&_mdns_response_pool, _mdns_response_blocks, sizeof(mdns_response_t), MDNS_RESPONSE_CACHE_SIZE)
+            || _mdns_rx_pool_init()) {
+        err = ESP_ERR_NO_MEM;
+        goto free_pools;
+    }
+
 #if CONFIG_MDNS_PREDEF_NETIF_STA || CONFIG_MDNS_PREDEF_NETIF_AP
     if ((err = esp_event_handler_register(WIFI_EVENT, ESP_EVENT_ANY_ID, mdns_preset_if_handle_system_event, NULL)) != ESP_OK) {
         goto free_event_handlers;
@@ -5421,6 +6472,12 @@ free_all_and_disable_pcbs:
 free_event_handlers:
     unregister_predefined_handlers();
 #endif
+free_pools:
+    _mdns_rx_pool_deinit();
+    _mdns_pool_deinit(&_mdns_response_pool);
+    _mdns_pool_deinit(&_mdns_result_pool);
+    _mdns_pool_deinit(&_mdns_question_pool);
+    _mdns_pool_deinit(&_mdns_action_pool);
     vSemaphoreDelete(_mdns_server->action_sema);
 free_queue:
     vQueueDelete(_mdns_server->action_queue);
@@ -5472,12 +6529,47 @@ void mdns_free(void)
         }
         free(h);
     }
+    free(_mdns_server->deadlines.heap);
+    _mdns_response_cache_clear();
+    memset(&_mdns_response_cache, 0, sizeof(_mdns_response_cache));
+    memset(&_mdns_answer_stats, 0, sizeof(_mdns_answer_stats));
+    _mdns_result_cache_clear();
+    memset(&_mdns_result_cache, 0, sizeof(_mdns_result_cache));
+    _mdns_rx_pool_deinit();
+    _mdns_pool_deinit(&_mdns_response_pool);
+    _mdns_pool_deinit(&_mdns_result_pool);
+    _mdns_pool_deinit(&_mdns_question_pool);
+    _mdns_pool_deinit(&_mdns_action_pool);
     vSemaphoreDelete(_mdns_server->action_sema);
     vSemaphoreDelete(_mdns_server->lock);
     free(_mdns_server);
     _mdns_server = NULL;
 }
 
+esp_err_t mdns_get_stats(mdns_stats_t *stats)
+{
+    if (!_mdns_server) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    if (!stats) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    _mdns_rx_pool_get_stats(&stats->rx_packets);
+    _mdns_pool_get_stats(&_mdns_question_pool, &stats->questions);
+    _mdns_pool_get_stats(&_mdns_action_pool, &stats->actions);
+    _mdns_pool_get_stats(&_mdns_result_pool, &stats->results);
+    stats->results.exhausted += _mdns_result_cache.too_large;
+    _mdns_pool_get_stats(&_mdns_response_pool, &stats->responses);
+    stats->responses.exhausted += _mdns_response_cache.too_large;
+    stats->response_cache_hits = _mdns_response_cache.hits;
+    stats->response_cache_misses = _mdns_response_cache.misses;
+    stats->answers_suppressed = _mdns_answer_stats.suppressed;
+    stats->answers_split = _mdns_answer_stats.split;
+    stats->result_cache_hits = _mdns_result_cache.hits;
+    stats->result_cache_misses = _mdns_result_cache.misses;
+    return ESP_OK;
+}
+
 esp_err_t mdns_hostname_set(const char *hostname)
 {
     if (!_mdns_server) {
@@ -5491,9 +6583,8 @@ esp_err_t mdns_hostname_set(const char *hostname)
         return ESP_ERR_NO_MEM;
     }
 
-    mdns_action_t *action = (mdns_action_t *)malloc(sizeof(mdns_action_t));
+    mdns_action_t *action = _mdns_alloc_action();
     if (!action) {
-        HOOK_MALLOC_FAILED;
         free(new_hostname);
         return ESP_ERR_NO_MEM;
     }
@@ -5501,7 +6592,7 @@ esp_err_t mdns_hostname_set(const char *hostname)
     action->data.hostname_set.hostname = new_hostname;
     if (xQueueSend(_mdns_server->action_queue, &action, (TickType_t)0) != pdPASS) {
         free(new_hostname);
-        free(action);
+        _mdns_release_action(action);
         return ESP_ERR_NO_MEM;
     }
     xSemaphoreTake(_mdns_server->action_sema, portMAX_DELAY);
@@ -5521,9 +6612,8 @@ esp_err_t mdns_delegate_hostname_add(const char *hostname, const mdns_ip_addr_t
         return ESP_ERR_NO_MEM;
     }
 
-    mdns_action_t *action = (mdns_action_t *)malloc(sizeof(mdns_action_t));
+    mdns_action_t *action = _mdns_alloc_action();
     if (!action) {
-        HOOK_MALLOC_FAILED;
         free(new_hostname);
         return ESP_ERR_NO_MEM;
     }
@@ -5532,7 +6622,7 @@ esp_err_t mdns_delegate_hostname_add(const char *hostname, const mdns_ip_addr_t
     action->data.delegate_hostname.address_list = copy_address_list(address_list);
     if (xQueueSend(_mdns_server->action_queue, &action, (TickType_t)0) != pdPASS) {
         free(new_hostname);
-        free(action);
+        _mdns_release_action(action);
         return ESP_ERR_NO_MEM;
     }
     return ESP_OK;
@@ -5551,9 +6641,8 @@ esp_err_t mdns_delegate_hostname_remove(const char *hostname)
         return ESP_ERR_NO_MEM;
     }
 
-    mdns_action_t *action = (mdns_action_t *)malloc(sizeof(mdns_action_t));
+    mdns_action_t *action = _mdns_alloc_action();
     if (!action) {
-        HOOK_MALLOC_FAILED;
         free(new_hostname);
         return ESP_ERR_NO_MEM;
     }
@@ -5561,7 +6650,7 @@ esp_err_t mdns_delegate_hostname_remove(const char *hostname)
     action->data.delegate_hostname.hostname = new_hostname;
     if (xQueueSend(_mdns_server->action_queue, &action, (TickType_t)0) != pdPASS) {
         free(new_hostname);
-        free(action);
+        _mdns_release_action(action);
         return ESP_ERR_NO_MEM;
     }
     return ESP_OK;
@@ -5569,7 +6658,11 @@ esp_err_t mdns_delegate_hostname_remove(const char *hostname)
 
 bool mdns_hostname_exists(const char *hostname)
 {
-    return _hostname_is_ours(hostname);
+    bool ret = false;
+    MDNS_SERVICE_LOCK();
+    ret = _hostname_is_ours(hostname);
+    MDNS_SERVICE_UNLOCK();
+    return ret;
 }
 
 esp_err_t mdns_instance_name_set(const char *instance)
@@ -5585,9 +6678,8 @@ esp_err_t mdns_instance_name_set(const char *instance)
         return ESP_ERR_NO_MEM;
     }
 
-    mdns_action_t *action = (mdns_action_t *)malloc(sizeof(mdns_action_t));
+    mdns_action_t *action = _mdns_alloc_action();
     if (!action) {
-        HOOK_MALLOC_FAILED;
         free(new_instance);
         return ESP_ERR_NO_MEM;
     }
@@ -5595,7 +6687,7 @@ esp_err_t mdns_instance_name_set(const char *instance)
     action->data.instance = new_instance;
     if (xQueueSend(_mdns_server->action_queue, &action, (TickType_t)0) != pdPASS) {
         free(new_instance);
-        free(action);
+        _mdns_release_action(action);
         return ESP_ERR_NO_MEM;
     }
     return ESP_OK;
@@ -5636,9 +6728,8 @@ esp_err_t mdns_service_add_for_host(const char *instance, const char *service, c
     item->service = s;
     item->next = NULL;
 
-    mdns_action_t *action = (mdns_action_t *)malloc(sizeof(mdns_action_t));
+    mdns_action_t *action = _mdns_alloc_action();
     if (!action) {
-        HOOK_MALLOC_FAILED;
         _mdns_free_service(s);
         free(item);
         return ESP_ERR_NO_MEM;
@@ -5648,13 +6739,20 @@ esp_err_t mdns_service_add_for_host(const char *instance, const char *service, c
     if (xQueueSend(_mdns_server->action_queue, &action, (TickType_t)0) != pdPASS) {
         _mdns_free_service(s);
         free(item);
-        free(action);
+        _mdns_release_action(action);
         return ESP_ERR_NO_MEM;
     }
 
     size_t start = xTaskGetTickCount();
     size_t timeout_ticks = pdMS_TO_TICKS(MDNS_SERVICE_ADD_TIMEOUT_MS);
-    while (_mdns_get_service_item_instance(instance, service, proto, hostname) == NULL) {
+    // the service index is rebuilt by the mDNS task, so it is only looked up under the lock
+    for (;;) {
+        MDNS_SERVICE_LOCK();
+        bool added = _mdns_get_service_item_instance(instance, service, proto, hostname) != NULL;
+        MDNS_SERVICE_UNLOCK();
+        if (added) {
+            break;
+        }
         uint32_t expired = xTaskGetTickCount() - start;
         if (expired >= timeout_ticks) {
             return ESP_FAIL; // Timeout
@@ -5676,13 +6774,21 @@ esp_err_t mdns_service_add(const char *instance, const char *service, const char
 
 bool mdns_service_exists(const char *service_type, const char *proto, const char *hostname)
 {
-    return _mdns_get_service_item(service_type, proto, hostname) != NULL;
+    bool ret = false;
+    MDNS_SERVICE_LOCK();
+    ret = _mdns_get_service_item(service_type, proto, hostname) != NULL;
+    MDNS_SERVICE_UNLOCK();
+    return ret;
 }
 
 bool mdns_service_exists_with_instance(const char *instance, const char *service_type, const char *proto,
                                        const char *hostname)
 {
-    return _mdns_get_service_item_instance(instance, service_type, proto, hostname) != NULL;
+    bool ret = false;
+    MDNS_SERVICE_LOCK();
+    ret = _mdns_get_service_item_instance(instance, service_type, proto, hostname) != NULL;
+    MDNS_SERVICE_UNLOCK();
+    return ret;
 }
 
 esp_err_t mdns_service_port_set_for_host(const char *instance, const char *service, const char *proto, const char *hostname, uint16_t port)
@@ -5695,16 +6801,15 @@ esp_err_t mdns_service_port_set_for_host(const char *instance, const char *servi
         return ESP_ERR_NOT_FOUND;
     }
 
-    mdns_action_t *action = (mdns_action_t *)malloc(sizeof(mdns_action_t));
+    mdns_action_t *action = _mdns_alloc_action();
     if (!action) {
-        HOOK_MALLOC_FAILED;
         return ESP_ERR_NO_MEM;
     }
     action->type = ACTION_SERVICE_PORT_SET;
     action->data.srv_port.service = s;
     action->data.srv_port.port = port;
     if (xQueueSend(_mdns_server->action_queue, &action, (TickType_t)0) != pdPASS) {
-        free(action);
+        _mdns_release_action(action);
         return ESP_ERR_NO_MEM;
     }
     return ESP_OK;
@@ -5737,9 +6842,8 @@ esp_err_t mdns_service_txt_set_for_host(const char *instance, const char *servic
         }
     }
 
-    mdns_action_t *action = (mdns_action_t *)malloc(sizeof(mdns_action_t));
+    mdns_action_t *action = _mdns_alloc_action();
     if (!action) {
-        HOOK_MALLOC_FAILED;
         _mdns_free_linked_txt(new_txt);
         return ESP_ERR_NO_MEM;
     }
@@ -5749,7 +6853,7 @@ esp_err_t mdns_service_txt_set_for_host(const char *instance, const char *servic
 
     if (xQueueSend(_mdns_server->action_queue, &action, (TickType_t)0) != pdPASS) {
         _mdns_free_linked_txt(new_txt);
-        free(action);
+        _mdns_release_action(action);
         return ESP_ERR_NO_MEM;
     }
     return ESP_OK;
@@ -5775,9 +6879,8 @@ esp_err_t mdns_service_txt_item_set_for_host_with_explicit_value_len(const char
     if (!s) {
         return ESP_ERR_NOT_FOUND;
     }
-    mdns_action_t *action = (mdns_action_t *)malloc(sizeof(mdns_action_t));
+    mdns_action_t *action = _mdns_alloc_action();
     if (!action) {
-        HOOK_MALLOC_FAILED;
         return ESP_ERR_NO_MEM;
     }
 
@@ -5785,14 +6888,14 @@ esp_err_t mdns_service_txt_item_set_for_host_with_explicit_value_len(const char
     action->data.srv_txt_set.service = s;
     action->data.srv_txt_set.key = strdup(key);
     if (!action->data.srv_txt_set.key) {
-        free(action);
+        _mdns_release_action(action);
         return ESP_ERR_NO_MEM;
     }
     if (value_len > 0) {
         action->data.srv_txt_set.value = (char *)malloc(value_len);
         if (!action->data.srv_txt_set.value) {
             free(action->data.srv_txt_set.key);
-            free(action);
+            _mdns_release_action(action);
             return ESP_ERR_NO_MEM;
         }
         memcpy(action->data.srv_txt_set.value, value, value_len);
@@ -5804,7 +6907,7 @@ esp_err_t mdns_service_txt_item_set_for_host_with_explicit_value_len(const char
     if (xQueueSend(_mdns_server->action_queue, &action, (TickType_t)0) != pdPASS) {
         free(action->data.srv_txt_set.key);
         free(action->data.srv_txt_set.value);
-        free(action);
+        _mdns_release_action(action);
         return ESP_ERR_NO_MEM;
     }
     return ESP_OK;
@@ -5847,9 +6950,8 @@ esp_err_t mdns_service_txt_item_remove_for_host(const char *instance, const char
     if (!s) {
         return ESP_ERR_NOT_FOUND;
     }
-    mdns_action_t *action = (mdns_action_t *)malloc(sizeof(mdns_action_t));
+    mdns_action_t *action = _mdns_alloc_action();
     if (!action) {
-        HOOK_MALLOC_FAILED;
         return ESP_ERR_NO_MEM;
     }
 
@@ -5857,12 +6959,12 @@ esp_err_t mdns_service_txt_item_remove_for_host(const char *instance, const char
     action->data.srv_txt_del.service = s;
     action->data.srv_txt_del.key = strdup(key);
     if (!action->data.srv_txt_del.key) {
-        free(action);
+        _mdns_release_action(action);
         return ESP_ERR_NO_MEM;
     }
     if (xQueueSend(_mdns_server->action_queue, &action, (TickType_t)0) != pdPASS) {
         free(action->data.srv_txt_del.key);
-        free(action);
+        _mdns_release_action(action);
         return ESP_ERR_NO_MEM;
     }
     return ESP_OK;
@@ -5887,9 +6989,8 @@ esp_err_t mdns_service_subtype_add_for_host(const char *instance_name, const cha
     if (!s) {
         return ESP_ERR_NOT_FOUND;
     }
-    mdns_action_t *action = (mdns_action_t *)malloc(sizeof(mdns_action_t));
+    mdns_action_t *action = _mdns_alloc_action();
     if (!action) {
-        HOOK_MALLOC_FAILED;
         return ESP_ERR_NO_MEM;
     }
 
@@ -5898,12 +6999,12 @@ esp_err_t mdns_service_subtype_add_for_host(const char *instance_name, const cha
     action->data.srv_subtype_add.subtype = strdup(subtype);
 
     if (!action->data.srv_subtype_add.subtype) {
-        free(action);
+        _mdns_release_action(action);
         return ESP_ERR_NO_MEM;
     }
     if (xQueueSend(_mdns_server->action_queue, &action, (TickType_t)0) != pdPASS) {
         free(action->data.srv_subtype_add.subtype);
-        free(action);
+        _mdns_release_action(action);
         return ESP_ERR_NO_MEM;
     }
     return ESP_OK;
@@ -5927,9 +7028,8 @@ esp_err_t mdns_service_instance_name_set_for_host(const char *instance_old, cons
         return ESP_ERR_NO_MEM;
     }
 
-    mdns_action_t *action = (mdns_action_t *)malloc(sizeof(mdns_action_t));
+    mdns_action_t *action = _mdns_alloc_action();
     if (!action) {
-        HOOK_MALLOC_FAILED;
         free(new_instance);
         return ESP_ERR_NO_MEM;
     }
@@ -5938,7 +7038,7 @@ esp_err_t mdns_service_instance_name_set_for_host(const char *instance_old, cons
     action->data.srv_instance.instance = new_instance;
     if (xQueueSend(_mdns_server->action_queue, &action, (TickType_t)0) != pdPASS) {
         free(new_instance);
-        free(action);
+        _mdns_release_action(action);
         return ESP_ERR_NO_MEM;
     }
     return ESP_OK;
@@ -5962,15 +7062,14 @@ esp_err_t mdns_service_remove_for_host(const char *instance, const char *service
         return ESP_ERR_NOT_FOUND;
     }
 
-    mdns_action_t *action = (mdns_action_t *)malloc(sizeof(mdns_action_t));
+    mdns_action_t *action = _mdns_alloc_action();
     if (!action) {
-        HOOK_MALLOC_FAILED;
         return ESP_ERR_NO_MEM;
     }
     action->type = ACTION_SERVICE_DEL;
     action->data.srv_del.service = s;
     if (xQueueSend(_mdns_server->action_queue, &action, (TickType_t)0) != pdPASS) {
-        free(action);
+        _mdns_release_action(action);
         return ESP_ERR_NO_MEM;
     }
     return ESP_OK;
@@ -5993,14 +7092,13 @@ esp_err_t mdns_service_remove_all(void)
         return ESP_OK;
     }
 
-    mdns_action_t *action = (mdns_action_t *)malloc(sizeof(mdns_action_t));
+    mdns_action_t *action = _mdns_alloc_action();
     if (!action) {
-        HOOK_MALLOC_FAILED;
         return ESP_ERR_NO_MEM;
     }
     action->type = ACTION_SERVICES_CLEAR;
     if (xQueueSend(_mdns_server->action_queue, &action, (TickType_t)0) != pdPASS) {
-        free(action);
+        _mdns_release_action(action);
         return ESP_ERR_NO_MEM;
     }
     return ESP_OK;
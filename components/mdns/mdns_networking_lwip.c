@@ -31,6 +31,9 @@ static const char *TAG = "mdns_networking";
 
 static struct udp_pcb *_pcb_main = NULL;
 
+static mdns_pool_t s_rx_pool;
+static mdns_rx_packet_t s_rx_blocks[MDNS_RX_POOL_SIZE];
+
 static void _udp_recv(void *arg, struct udp_pcb *upcb, struct pbuf *pb, const ip_addr_t *raddr, uint16_t rport);
 
 /**
@@ -131,10 +134,9 @@ static void _udp_recv(void *arg, struct udp_pcb *upcb, struct pbuf *pb, const ip
         pb = pb->next;
         this_pb->next = NULL;
 
-        mdns_rx_packet_t *packet = (mdns_rx_packet_t *)malloc(sizeof(mdns_rx_packet_t));
+        mdns_rx_packet_t *packet = (mdns_rx_packet_t *)_mdns_pool_alloc(&s_rx_pool);
         if (!packet) {
-            HOOK_MALLOC_FAILED;
-            //missed packet - no memory
+            //missed packet - all pending
             pbuf_free(this_pb);
             continue;
         }
@@ -192,7 +194,7 @@ static void _udp_recv(void *arg, struct udp_pcb *upcb, struct pbuf *pb, const ip
         if (!pcb || !_mdns_server || !_mdns_server->action_queue
                 || _mdns_send_rx_action(packet) != ESP_OK) {
             pbuf_free(this_pb);
-            free(packet);
+            _mdns_pool_free(&s_rx_pool, packet);
         }
     }
 
@@ -380,5 +382,20 @@ size_t _mdns_get_packet_len(mdns_rx_packet_t *packet)
 void _mdns_packet_free(mdns_rx_packet_t *packet)
 {
     pbuf_free(packet->pb);
-    free(packet);
+    _mdns_pool_free(&s_rx_pool, packet);
+}
+
+esp_err_t _mdns_rx_pool_init(void)
+{
+    return _mdns_pool_init(&s_rx_pool, s_rx_blocks, sizeof(mdns_rx_packet_t), MDNS_RX_POOL_SIZE);
+}
+
+void _mdns_rx_pool_deinit(void)
+{
+    _mdns_pool_deinit(&s_rx_pool);
+}
+
+void _mdns_rx_pool_get_stats(mdns_pool_stats_t *stats)
+{
+    _mdns_pool_get_stats(&s_rx_pool, stats);
 }
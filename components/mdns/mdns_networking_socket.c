@@ -47,6 +47,16 @@ struct pbuf  {
 #define s6_addr32 un.u32_addr
 #endif // CONFIG_IDF_TARGET_LINUX
 
+// Received packet with its buffer, taken from the pool before reading the socket
+typedef struct {
+    mdns_rx_packet_t packet;
+    struct pbuf pb;
+    uint8_t payload[MDNS_MAX_PACKET_SIZE];
+} mdns_rx_block_t;
+
+static mdns_pool_t s_rx_pool;
+static mdns_rx_block_t s_rx_blocks[MDNS_RX_POOL_SIZE];
+
 static void delete_socket(int sock)
 {
     close(sock);
@@ -83,9 +93,22 @@ size_t _mdns_get_packet_len(mdns_rx_packet_t *packet)
 
 void _mdns_packet_free(mdns_rx_packet_t *packet)
 {
-    free(packet->pb->payload);
-    free(packet->pb);
-    free(packet);
+    _mdns_pool_free(&s_rx_pool, packet);
+}
+
+esp_err_t _mdns_rx_pool_init(void)
+{
+    return _mdns_pool_init(&s_rx_pool, s_rx_blocks, sizeof(mdns_rx_block_t), MDNS_RX_POOL_SIZE);
+}
+
+void _mdns_rx_pool_deinit(void)
+{
+    _mdns_pool_deinit(&s_rx_pool);
+}
+
+void _mdns_rx_pool_get_stats(mdns_pool_stats_t *stats)
+{
+    _mdns_pool_get_stats(&s_rx_pool, stats);
 }
 
 esp_err_t _mdns_pcb_deinit(mdns_if_t tcpip_if, mdns_ip_protocol_t ip_protocol)
@@ -279,41 +302,40 @@ void sock_recv_task(void *arg)
                     continue;
                 }
                 if (FD_ISSET(sock, &rfds)) {
-                    static char recvbuf[MDNS_MAX_PACKET_SIZE];
+                    // read into a free pool entry, or drop the packet if all are pending
+                    static uint8_t dropbuf[MDNS_MAX_PACKET_SIZE];
+                    mdns_rx_block_t *block = (mdns_rx_block_t *)_mdns_pool_alloc(&s_rx_pool);
+                    uint8_t *buf = block ? block->payload : dropbuf;
                     uint16_t port = 0;
 
                     struct sockaddr_storage raddr; // Large enough for both IPv4 or IPv6
                     socklen_t socklen = sizeof(struct sockaddr_storage);
                     esp_ip_addr_t addr = {0};
-                    int len = recvfrom(sock, recvbuf, sizeof(recvbuf), 0,
+                    int len = recvfrom(sock, buf, MDNS_MAX_PACKET_SIZE, 0,
                                        (struct sockaddr *) &raddr, &socklen);
                     if (len < 0) {
                         ESP_LOGE(TAG, "multicast recvfrom failed. errno=%d: %s", errno, strerror(errno));
+                        _mdns_pool_free(&s_rx_pool, block);
                         break;
                     }
                     ESP_LOGD(TAG, "[sock=%d]: Received from IP:%s", sock, get_string_address(&raddr));
-                    ESP_LOG_BUFFER_HEXDUMP(TAG, recvbuf, len, ESP_LOG_VERBOSE);
-                    inet_to_espaddr(&raddr, &addr, &port);
-
-                    // Allocate the packet structure and pass it to the mdns main engine
-                    mdns_rx_packet_t *packet = (mdns_rx_packet_t *) calloc(1, sizeof(mdns_rx_packet_t));
-                    struct pbuf *packet_pbuf = calloc(1, sizeof(struct pbuf));
-                    uint8_t *buf = malloc(len);
-                    if (packet == NULL || packet_pbuf == NULL || buf == NULL ) {
-                        free(buf);
-                        free(packet_pbuf);
-                        free(packet);
-                        HOOK_MALLOC_FAILED;
-                        ESP_LOGE(TAG, "Failed to allocate the mdns packet");
+                    if (!block) {
+                        ESP_LOGD(TAG, "No free packet, dropped");
                         continue;
                     }
-                    memcpy(buf, recvbuf, len);
-                    packet_pbuf->next = NULL;
-                    packet_pbuf->payload = buf;
-                    packet_pbuf->tot_len = len;
-                    packet_pbuf->len = len;
+                    ESP_LOG_BUFFER_HEXDUMP(TAG, buf, len, ESP_LOG_VERBOSE);
+                    inet_to_espaddr(&raddr, &addr, &port);
+
+                    // Pass the packet to the mdns main engine
+                    mdns_rx_packet_t *packet = &block->packet;
+                    memset(packet, 0, sizeof(mdns_rx_packet_t));
+                    memset(&block->pb, 0, sizeof(struct pbuf));
+                    block->pb.next = NULL;
+                    block->pb.payload = buf;
+                    block->pb.tot_len = len;
+                    block->pb.len = len;
                     packet->tcpip_if = tcpip_if;
-                    packet->pb = packet_pbuf;
+                    packet->pb = &block->pb;
                     packet->src_port = ntohs(port);
                     memcpy(&packet->src, &addr, sizeof(esp_ip_addr_t));
                     // TODO(IDF-3651): Add the correct dest addr -- for mdns to decide multicast/unicast
@@ -325,9 +347,7 @@ void sock_recv_task(void *arg)
                         packet->src.type == ESP_IPADDR_TYPE_V4 ? MDNS_IP_PROTOCOL_V4 : MDNS_IP_PROTOCOL_V6;
                     if (!_mdns_server || !_mdns_server->action_queue || _mdns_send_rx_action(packet) != ESP_OK) {
                         ESP_LOGE(TAG, "_mdns_send_rx_action failed!");
-                        free(packet->pb->payload);
-                        free(packet->pb);
-                        free(packet);
+                        _mdns_packet_free(packet);
                     }
                 }
             }
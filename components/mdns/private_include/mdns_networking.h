@@ -19,6 +19,21 @@
  */
 esp_err_t _mdns_send_rx_action(mdns_rx_packet_t *packet);
 
+/**
+ * @brief  Set up the pool of received packets
+ */
+esp_err_t _mdns_rx_pool_init(void);
+
+/**
+ * @brief  Release the pool of received packets, once no packet is pending
+ */
+void _mdns_rx_pool_deinit(void);
+
+/**
+ * @brief  Copy usage of the pool of received packets
+ */
+void _mdns_rx_pool_get_stats(mdns_pool_stats_t *stats);
+
 /**
  * @brief  Start PCB
  */
@@ -96,6 +96,13 @@
 #endif
 #define MDNS_NAME_BUF_LEN           (MDNS_NAME_MAX_LEN+1)   // Maximum char buffer size to hold hostname, instance, service or proto
 #define MDNS_MAX_PACKET_SIZE        1460                    // Maximum size of mDNS  outgoing packet
+#define MDNS_RX_POOL_SIZE           CONFIG_MDNS_RX_POOL_SIZE        // Maximum received packets pending to the server
+#define MDNS_QUESTION_POOL_SIZE     CONFIG_MDNS_QUESTION_POOL_SIZE  // Maximum questions parsed from one packet
+#define MDNS_ACTION_POOL_SIZE       CONFIG_MDNS_ACTION_POOL_SIZE    // Maximum actions allocated at once
+#define MDNS_RESPONSE_CACHE_SIZE    CONFIG_MDNS_RESPONSE_CACHE_SIZE // Maximum serialized responses kept
+#define MDNS_RESPONSE_MAX_ANSWERS   64                      // Answers of a cached response, responses with more are built every time
+#define MDNS_RESULT_CACHE_SIZE      CONFIG_MDNS_RESULT_CACHE_SIZE   // Maximum received records kept for queries
+#define MDNS_RESULT_CACHE_TXT_SIZE  CONFIG_MDNS_RESULT_CACHE_TXT_SIZE   // TXT data kept of a received record
 
 #define MDNS_HEAD_LEN               12
 #define MDNS_HEAD_ID_OFFSET         0
@@ -104,6 +111,7 @@
 #define MDNS_HEAD_ANSWERS_OFFSET    6
 #define MDNS_HEAD_SERVERS_OFFSET    8
 #define MDNS_HEAD_ADDITIONAL_OFFSET 10
+#define MDNS_TX_SECTIONS            3                       // Answers, servers and additional records
 
 #define MDNS_TYPE_OFFSET            0
 #define MDNS_CLASS_OFFSET           2
@@ -117,6 +125,19 @@
 #define MDNS_SRV_FQDN_OFFSET        6
 
 #define MDNS_TIMER_PERIOD_US        (CONFIG_MDNS_TIMER_PERIOD_MS*1000)
+#define MDNS_SEARCH_RESEND_MS       1000                    // Period of sending the questions of an active search
+#define MDNS_DEADLINES_MIN_LEN      16                      // Initial size of the deadline heap
+#define MDNS_HOST_INDEX_MIN_SIZE    16                      // Initial number of buckets of the delegated host index
+#define MDNS_HASH_INIT              2166136261u             // FNV-1a offset basis of the name hashes
+#define MDNS_HASH_PRIME             16777619u               // FNV-1a prime of the name hashes
+#define MDNS_NAME_DICT_SIZE         128                     // Max number of name suffixes remembered for compression of a packet
+#define MDNS_NAME_DICT_BUCKETS      64                      // Number of hash buckets of the name suffixes (power of two)
+#define MDNS_NAME_DICT_END          0xFF                    // No suffix: the end of a name or of a bucket
+#define MDNS_KNOWN_ANSWERS_MAX      32                      // Max number of known answers of a query remembered for suppression
+#define MDNS_RESULT_CACHE_FLUSH_MS  1000                    // Records older than this are flushed by a cache-flush record (RFC 6762, 10.2)
+#define MDNS_RESULT_CACHE_TTL_MAX   86400                   // Longest TTL honoured for received records, in seconds
+#define MDNS_RESULT_SERVICE_LEN     17                      // "_" and a service name of up to 15 characters (RFC 6763, 7.2)
+#define MDNS_RESULT_PROTO_LEN       5                       // "_tcp" or "_udp"
 
 #define MDNS_SERVICE_LOCK()     xSemaphoreTake(_mdns_service_semaphore, portMAX_DELAY)
 #define MDNS_SERVICE_UNLOCK()   xSemaphoreGive(_mdns_service_semaphore)
@@ -158,6 +179,19 @@
 
 typedef size_t mdns_if_t;
 
+typedef struct mdns_pool_block_s {
+    struct mdns_pool_block_s *next;
+} mdns_pool_block_t;
+
+/**
+ * @brief  Fixed capacity pool of equally sized blocks, usable from any task
+ */
+typedef struct {
+    SemaphoreHandle_t lock;
+    mdns_pool_block_t *free_blocks;
+    mdns_pool_stats_t stats;
+} mdns_pool_t;
+
 typedef enum {
     PCB_OFF, PCB_DUP, PCB_INIT,
     PCB_PROBE_1, PCB_PROBE_2, PCB_PROBE_3,
@@ -183,9 +217,7 @@ typedef enum {
     ACTION_SERVICE_SUBTYPE_ADD,
     ACTION_SERVICES_CLEAR,
     ACTION_SEARCH_ADD,
-    ACTION_SEARCH_SEND,
-    ACTION_SEARCH_END,
-    ACTION_TX_HANDLE,
+    ACTION_TIMER,
     ACTION_RX_HANDLE,
     ACTION_TASK_STOP,
     ACTION_DELEGATE_HOSTNAME_ADD,
@@ -218,10 +250,11 @@ typedef struct mdns_parsed_question_s {
     uint16_t type;
     bool sub;
     bool unicast;
-    char *host;
+    char *host;                             // these point into name, to the service or are NULL
     char *service;
     char *proto;
     char *domain;
+    mdns_name_t name;
 } mdns_parsed_question_t;
 
 typedef struct mdns_parsed_record_s {
@@ -239,6 +272,16 @@ typedef struct mdns_parsed_record_s {
     uint8_t *data;
 } mdns_parsed_record_t;
 
+/**
+ * @brief  Record of ours listed in the known answers of a query, with at least half of its TTL left
+ */
+typedef struct {
+    uint16_t type;
+    struct mdns_srv_item_s *service;        // PTR, SRV and TXT
+    struct mdns_host_item_t *host;          // A and AAAA
+    esp_ip_addr_t addr;                     // A and AAAA
+} mdns_known_answer_t;
+
 typedef struct {
     mdns_if_t tcpip_if;
     mdns_ip_protocol_t ip_protocol;
@@ -252,6 +295,8 @@ typedef struct {
     mdns_parsed_question_t *questions;
     mdns_parsed_record_t *records;
     uint16_t id;
+    uint8_t known_answers_len;
+    mdns_known_answer_t known_answers[MDNS_KNOWN_ANSWERS_MAX];
 } mdns_parsed_packet_t;
 
 typedef struct {
@@ -291,6 +336,8 @@ typedef struct {
 typedef struct mdns_srv_item_s {
     struct mdns_srv_item_s *next;
     mdns_service_t *service;
+    struct mdns_srv_item_s *type_next;      // next service in the same bucket of the type index
+    struct mdns_srv_item_s *instance_next;  // next service in the same bucket of the instance index
 } mdns_srv_item_t;
 
 typedef struct mdns_out_question_s {
@@ -308,6 +355,7 @@ typedef struct mdns_host_item_t {
     const char *hostname;
     mdns_ip_addr_t *address_list;
     struct mdns_host_item_t *next;
+    struct mdns_host_item_t *index_next;    // next host in the same bucket of the host index
 } mdns_host_item_t;
 
 typedef struct mdns_out_answer_s {
@@ -322,9 +370,89 @@ typedef struct mdns_out_answer_s {
     const char *custom_proto;
 } mdns_out_answer_t;
 
+typedef enum {
+    MDNS_DEADLINE_TX,
+    MDNS_DEADLINE_SEARCH
+} mdns_deadline_type_t;
+
+/**
+ * @brief  Time at which a scheduled packet is sent or an active search is run,
+ *         kept in the deadline heap of the server
+ */
+typedef struct {
+    uint32_t at;                    // tick time in ms
+    uint32_t seq;                   // arming order, equal deadlines expire first in first out
+    uint16_t index;                 // position in the heap while armed
+    bool armed;
+    mdns_deadline_type_t type;
+    void *owner;                    // mdns_tx_packet_t or mdns_search_once_t
+} mdns_deadline_t;
+
+/**
+ * @brief  Name suffix already written to the packet being built, a label followed by another suffix
+ */
+typedef struct {
+    uint16_t offset;                // offset of the label in the packet
+    uint8_t next;                   // suffix following the label, MDNS_NAME_DICT_END if the name ends there
+    uint8_t chain;                  // next suffix in the same hash bucket
+} mdns_name_suffix_t;
+
+/**
+ * @brief  Answer of a cached response, the answers of a packet to send are compared to find the response
+ */
+typedef struct {
+    mdns_service_t *service;
+    mdns_host_item_t *host;
+    uint16_t type;
+    uint8_t section;                // answers, servers or additional
+    uint8_t flush;
+} mdns_response_answer_t;
+
+/**
+ * @brief  Serialized response, kept as long as our records do not change
+ */
+typedef struct {
+    uint32_t hash;                  // hash of the interface and of the answers
+    mdns_if_t tcpip_if;
+    mdns_ip_protocol_t ip_protocol;
+    uint16_t answers_len;           // number of answers
+    uint16_t len;                   // length of the packet
+    mdns_response_answer_t answers[MDNS_RESPONSE_MAX_ANSWERS];
+    uint8_t packet[MDNS_MAX_PACKET_SIZE];
+} mdns_response_t;
+
+/**
+ * @brief  Record received from another host, kept to answer our queries until its TTL runs out
+ */
+typedef struct {
+    uint16_t type;
+    mdns_if_t tcpip_if;
+    mdns_ip_protocol_t ip_protocol;
+    uint32_t received;              // tick time in ms
+    uint32_t expires;               // tick time in ms
+    uint16_t port;                  // SRV
+    esp_ip_addr_t addr;             // A/AAAA
+    char host[MDNS_NAME_BUF_LEN];   // hostname (A/AAAA) or instance (SRV/TXT)
+    char service[MDNS_RESULT_SERVICE_LEN];
+    char proto[MDNS_RESULT_PROTO_LEN];
+    char target[MDNS_NAME_BUF_LEN]; // instance (PTR) or hostname (SRV)
+    uint16_t txt_len;
+    uint8_t txt[MDNS_RESULT_CACHE_TXT_SIZE];
+} mdns_cached_record_t;
+
+/**
+ * @brief  Position in the answers of a packet to send, where the next packet continues when they do not fit in one
+ */
+typedef struct {
+    uint8_t section;                // answers, servers or additional
+    mdns_out_answer_t *answer;      // next answer of the section
+    uint8_t packets;                // number of packets built
+    uint16_t records;               // number of records in the last packet built
+} mdns_tx_cursor_t;
+
 typedef struct mdns_tx_packet_s {
     struct mdns_tx_packet_s *next;
-    uint32_t send_at;
+    mdns_deadline_t deadline;
     mdns_if_t tcpip_if;
     mdns_ip_protocol_t ip_protocol;
     esp_ip_addr_t dst;
@@ -335,7 +463,6 @@ typedef struct mdns_tx_packet_s {
     mdns_out_answer_t *answers;
     mdns_out_answer_t *servers;
     mdns_out_answer_t *additional;
-    bool queued;
     uint16_t id;
 } mdns_tx_packet_t;
 
@@ -363,6 +490,7 @@ typedef struct mdns_search_once_s {
     uint32_t started_at;
     uint32_t sent_at;
     uint32_t timeout;
+    mdns_deadline_t deadline;
     mdns_query_notify_t notifier;
     SemaphoreHandle_t done_semaphore;
     uint16_t type;
@@ -382,12 +510,24 @@ typedef struct mdns_server_s {
     const char *hostname;
     const char *instance;
     mdns_srv_item_t *services;
+    struct {
+        mdns_srv_item_t *types[MDNS_MAX_SERVICES];      // services by service type and proto
+        mdns_srv_item_t *instances[MDNS_MAX_SERVICES];  // services by instance name, service type and proto
+    } index;
     SemaphoreHandle_t lock;
     QueueHandle_t action_queue;
     SemaphoreHandle_t action_sema;
     mdns_tx_packet_t *tx_queue_head;
     mdns_search_once_t *search_once;
     esp_timer_handle_t timer_handle;
+    struct {
+        mdns_deadline_t **heap;     // binary min-heap, earliest deadline first
+        uint16_t len;
+        uint16_t size;
+        uint32_t seq;
+        uint32_t timer_at;          // deadline the timer is armed for
+        bool timer_armed;
+    } deadlines;
 } mdns_server_t;
 
 typedef struct {
@@ -436,9 +576,6 @@ typedef struct {
         struct {
             mdns_search_once_t *search;
         } search_add;
-        struct {
-            mdns_tx_packet_t *packet;
-        } tx_handle;
         struct {
             mdns_rx_packet_t *packet;
         } rx_handle;
@@ -460,5 +597,32 @@ typedef struct {
  */
 esp_netif_t *_mdns_get_esp_netif(mdns_if_t tcpip_if);
 
+/**
+ * @brief  Set up a pool over an array of count blocks of block_size bytes
+ */
+esp_err_t _mdns_pool_init(mdns_pool_t *pool, void *blocks, size_t block_size, size_t count);
+
+/**
+ * @brief  Delete the lock of a pool, all its blocks have to be free
+ */
+void _mdns_pool_deinit(mdns_pool_t *pool);
+
+/**
+ * @brief  Take a block from a pool
+ *
+ * @return the block or NULL if the pool is empty
+ */
+void *_mdns_pool_alloc(mdns_pool_t *pool);
+
+/**
+ * @brief  Return a block to the pool it was taken from
+ */
+void _mdns_pool_free(mdns_pool_t *pool, void *block);
+
+/**
+ * @brief  Copy usage of a pool
+ */
+void _mdns_pool_get_stats(mdns_pool_t *pool, mdns_pool_stats_t *stats);
+
 
 #endif /* MDNS_PRIVATE_H_ */
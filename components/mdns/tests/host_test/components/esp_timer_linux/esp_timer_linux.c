@@ -12,7 +12,9 @@ void *create_tt(esp_timer_cb_t cb);
 
 void destroy_tt(void *tt);
 
-void set_tout(void *tt, uint32_t ms);
+void set_tout(void *tt, uint32_t ms, bool oneshot);
+
+void stop_tt(void *tt);
 
 esp_err_t esp_timer_create(const esp_timer_create_args_t *create_args,
                            esp_timer_handle_t *out_handle)
@@ -23,12 +25,19 @@ esp_err_t esp_timer_create(const esp_timer_create_args_t *create_args,
 
 esp_err_t esp_timer_start_periodic(esp_timer_handle_t timer, uint64_t period)
 {
-    set_tout(timer, period / 1000);
+    set_tout(timer, period / 1000, false);
+    return ESP_OK;
+}
+
+esp_err_t esp_timer_start_once(esp_timer_handle_t timer, uint64_t timeout_us)
+{
+    set_tout(timer, timeout_us / 1000, true);
     return ESP_OK;
 }
 
 esp_err_t esp_timer_stop(esp_timer_handle_t timer)
 {
+    stop_tt(timer);
     return ESP_OK;
 }
 
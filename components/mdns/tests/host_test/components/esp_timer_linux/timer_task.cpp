@@ -23,8 +23,14 @@ extern "C" void destroy_tt(void *tt)
 }
 
 
-extern "C" void set_tout(void *tt, uint32_t ms)
+extern "C" void set_tout(void *tt, uint32_t ms, bool oneshot)
 {
     auto *timer_task = static_cast<TimerTaskMock *>(tt);
-    timer_task->SetTimeout(ms);
+    timer_task->SetTimeout(ms, oneshot);
+}
+
+extern "C" void stop_tt(void *tt)
+{
+    auto *timer_task = static_cast<TimerTaskMock *>(tt);
+    timer_task->Stop();
 }
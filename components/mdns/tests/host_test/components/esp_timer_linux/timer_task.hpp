@@ -0,0 +1,74 @@
+/*
+ * SPDX-FileCopyrightText: 2021-2022 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+#pragma once
+
+#include <queue>
+#include <mutex>
+#include <condition_variable>
+#include <memory>
+#include <thread>
+#include <atomic>
+
+typedef void (*cb_t)(void *arg);
+
+class TimerTaskMock {
+public:
+    TimerTaskMock(cb_t cb): cb(cb), active(false), armed(false), oneshot(false), ms(INT32_MAX) {}
+    ~TimerTaskMock(void)
+    {
+        active = false;
+        if (t.joinable()) {
+            t.join();
+        }
+    }
+
+    void SetTimeout(uint32_t m, bool once = false)
+    {
+        ms = m;
+        oneshot = once;
+        armed = true;
+        if (!active.exchange(true)) {
+            t = std::thread(run_static, this);
+        }
+    }
+
+    void Stop(void)
+    {
+        armed = false;
+    }
+
+private:
+
+    static void run_static(TimerTaskMock *timer)
+    {
+        timer->run();
+    }
+
+    void run(void)
+    {
+        while (active.load()) {
+            if (!armed.load()) {
+                std::this_thread::sleep_for(std::chrono::milliseconds(1));
+                continue;
+            }
+            std::this_thread::sleep_for(std::chrono::milliseconds(ms));
+            if (armed.load()) {
+                if (oneshot.load()) {
+                    armed = false;
+                }
+                cb(nullptr);
+            }
+        }
+    }
+
+    cb_t cb;
+    std::thread t;
+    std::atomic<bool> active;
+    std::atomic<bool> armed;
+    std::atomic<bool> oneshot;
+    std::atomic<uint32_t> ms;
+
+};
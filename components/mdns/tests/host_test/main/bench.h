@@ -0,0 +1,19 @@
+/*
+ * SPDX-FileCopyrightText: 2024 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: Unlicense OR CC0-1.0
+ */
+#pragma once
+
+#include "esp_netif.h"
+
+/**
+ * @brief  Times service and host name lookups while scaling the number of services and delegated hosts
+ */
+void bench_lookup(void);
+
+/**
+ * @brief  Sends mixed query streams to the responder on the netif at increasing rates and reports
+ *         the answered queries per second, the response latency, the heap usage and the dropped queries
+ */
+void bench_load(esp_netif_t *netif);
@@ -0,0 +1,319 @@
+/*
+ * SPDX-FileCopyrightText: 2024 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: Unlicense OR CC0-1.0
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <malloc.h>
+#include <poll.h>
+#include <pthread.h>
+#include <unistd.h>
+#include <sys/param.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include "mdns.h"
+#include "esp_log.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "bench.h"
+
+#define BENCH_MAX_QUERIES   (CONFIG_TEST_BENCH_LOAD_MAX_RATE * CONFIG_TEST_BENCH_LOAD_SECONDS)
+#define BENCH_MIN_RATE      250
+#define BENCH_SETTLE_MS     3000    // probing and announcing of the services
+#define BENCH_DRAIN_MS      500     // longer than the delay of shared answers
+#define BENCH_HTTP          2       // _http._tcp instances, on our host
+#define BENCH_HOSTS         4       // delegated hosts of the _bench._tcp instances
+#define BENCH_PACKET_SIZE   1500
+#define BENCH_HEAD_LEN      12
+#define BENCH_CLASS_IN      1
+
+static const char *TAG = "mdns-bench";
+
+typedef enum {
+    QUERY_BROWSE,       // PTR of _http._tcp, a few instances
+    QUERY_RESOLVE,      // SRV of an instance or A of a host
+    QUERY_REVERSE,      // PTR of our address in in-addr.arpa
+    QUERY_MANY,         // PTR of _bench._tcp, every other service
+    QUERY_KINDS
+} query_kind_t;
+
+static const char *s_kind_names[QUERY_KINDS] = { "browse", "resolve", "reverse", "many" };
+
+// the mix sent in a loop, half of it resolves
+static const query_kind_t s_mix[] = {
+    QUERY_RESOLVE, QUERY_BROWSE, QUERY_RESOLVE, QUERY_REVERSE, QUERY_RESOLVE, QUERY_MANY
+};
+
+typedef struct {
+    uint8_t data[256];
+    size_t len;
+} query_t;
+
+static query_t s_browse;
+static query_t s_resolve[BENCH_HTTP + BENCH_HOSTS + 1];
+static size_t s_resolve_len;
+static query_t s_reverse;
+static query_t s_many;
+
+// queries waiting for their response, by id
+static struct {
+    uint64_t sent_at;
+    query_kind_t kind;
+} s_pending[UINT16_MAX + 1];
+
+static struct {
+    uint32_t latency_us[QUERY_KINDS][BENCH_MAX_QUERIES];
+    size_t answered[QUERY_KINDS];
+} s_step;
+
+static pthread_mutex_t s_lock = PTHREAD_MUTEX_INITIALIZER;
+static volatile bool s_running;
+
+static uint64_t now_ns(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+static void sleep_until(uint64_t ns)
+{
+    struct timespec ts = { .tv_sec = ns / 1000000000ULL, .tv_nsec = ns % 1000000000ULL };
+    clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &ts, NULL);
+}
+
+static size_t heap_used(void)
+{
+    return mallinfo2().uordblks;
+}
+
+static size_t put_name(uint8_t *p, const char *name)
+{
+    size_t n = 0;
+    while (*name) {
+        const char *dot = strchr(name, '.');
+        size_t len = dot ? (size_t)(dot - name) : strlen(name);
+        p[n++] = len;
+        memcpy(p + n, name, len);
+        n += len;
+        name += len + (dot ? 1 : 0);
+    }
+    p[n++] = 0;
+    return n;
+}
+
+/*
+ * One-shot query with one question: sent from an ephemeral port, so it is answered by unicast
+ * with the same id (RFC 6762, 6.7)
+ */
+static void query_init(query_t *q, const char *name, uint16_t type)
+{
+    memset(q->data, 0, BENCH_HEAD_LEN);
+    q->data[5] = 1;
+    q->len = BENCH_HEAD_LEN + put_name(q->data + BENCH_HEAD_LEN, name);
+    q->data[q->len++] = type >> 8;
+    q->data[q->len++] = type & 0xFF;
+    q->data[q->len++] = 0;
+    q->data[q->len++] = BENCH_CLASS_IN;
+}
+
+static bool add_records(void)
+{
+    char instance[32], host[32], name[96];
+    mdns_txt_item_t txt[] = { {"board", "esp32"}, {"path", "/"} };
+    s_resolve_len = 0;
+    for (size_t i = 0; i < BENCH_HTTP; i++) {
+        snprintf(instance, sizeof(instance), "Bench Web %u", (unsigned)i);
+        if (mdns_service_add(instance, "_http", "_tcp", 80 + i, txt, 2) != ESP_OK) {
+            return false;
+        }
+        snprintf(name, sizeof(name), "%s._http._tcp.local", instance);
+        query_init(&s_resolve[s_resolve_len++], name, MDNS_TYPE_SRV);
+    }
+    for (size_t i = 0; i < BENCH_HOSTS; i++) {
+        snprintf(host, sizeof(host), "bench-load-%u", (unsigned)i);
+        mdns_ip_addr_t addr = { 0 };
+        addr.addr.type = ESP_IPADDR_TYPE_V4;
+        addr.addr.u_addr.ip4.addr = esp_netif_htonl(0x0a000a00 | (uint32_t)i);
+        if (mdns_delegate_hostname_add(host, &addr) != ESP_OK) {
+            return false;
+        }
+        snprintf(name, sizeof(name), "%s.local", host);
+        query_init(&s_resolve[s_resolve_len++], name, MDNS_TYPE_A);
+    }
+    snprintf(name, sizeof(name), "%s.local", CONFIG_TEST_HOSTNAME);
+    query_init(&s_resolve[s_resolve_len++], name, MDNS_TYPE_A);
+    for (size_t i = 0; i < CONFIG_MDNS_MAX_SERVICES - BENCH_HTTP; i++) {
+        snprintf(instance, sizeof(instance), "Bench Load %u", (unsigned)i);
+        snprintf(host, sizeof(host), "bench-load-%u", (unsigned)(i % BENCH_HOSTS));
+        if (mdns_service_add_for_host(instance, "_bench", "_tcp", host, 1000 + i, txt, 2) != ESP_OK) {
+            return false;
+        }
+    }
+    query_init(&s_browse, "_http._tcp.local", MDNS_TYPE_PTR);
+    query_init(&s_many, "_bench._tcp.local", MDNS_TYPE_PTR);
+    return true;
+}
+
+static void *receive_task(void *arg)
+{
+    int sock = (intptr_t)arg;
+    uint8_t packet[BENCH_PACKET_SIZE];
+    struct pollfd pfd = { .fd = sock, .events = POLLIN };
+    while (s_running) {
+        if (poll(&pfd, 1, 50) != 1) {
+            continue;
+        }
+        ssize_t len = recv(sock, packet, sizeof(packet), 0);
+        uint64_t now = now_ns();
+        if (len < BENCH_HEAD_LEN || !(packet[2] & 0x80)) {
+            continue;
+        }
+        uint16_t id = packet[0] << 8 | packet[1];
+        pthread_mutex_lock(&s_lock);
+        // the first packet answers the query, large answers continue in more packets
+        if (s_pending[id].sent_at) {
+            query_kind_t kind = s_pending[id].kind;
+            s_step.latency_us[kind][s_step.answered[kind]++] = (now - s_pending[id].sent_at) / 1000;
+            s_pending[id].sent_at = 0;
+        }
+        pthread_mutex_unlock(&s_lock);
+    }
+    return NULL;
+}
+
+static int compare_u32(const void *a, const void *b)
+{
+    uint32_t x = *(const uint32_t *)a, y = *(const uint32_t *)b;
+    return x < y ? -1 : x > y;
+}
+
+static double percentile_ms(const uint32_t *sorted, size_t len, unsigned pct)
+{
+    return len ? sorted[MIN(len - 1, len * pct / 100)] / 1000.0 : 0;
+}
+
+/*
+ * Sends the query mix at a fixed rate, then waits for the late answers and reports the step
+ */
+static void bench_step(int sock, const struct sockaddr_in *dst, uint32_t rate, size_t idle_heap)
+{
+    size_t queries = (size_t)rate * CONFIG_TEST_BENCH_LOAD_SECONDS;
+    uint64_t interval = 1000000000ULL / rate;
+    size_t peak_heap = 0, answered = 0;
+    uint8_t packet[sizeof(s_browse.data)];
+    mdns_stats_t before, after;
+
+    pthread_mutex_lock(&s_lock);
+    memset(s_step.answered, 0, sizeof(s_step.answered));
+    pthread_mutex_unlock(&s_lock);
+    mdns_get_stats(&before);
+
+    uint64_t start = now_ns();
+    for (size_t i = 0; i < queries; i++) {
+        sleep_until(start + i * interval);
+        query_kind_t kind = s_mix[i % (sizeof(s_mix) / sizeof(s_mix[0]))];
+        const query_t *q = kind == QUERY_BROWSE ? &s_browse : kind == QUERY_REVERSE ? &s_reverse
+                           : kind == QUERY_MANY ? &s_many : &s_resolve[i % s_resolve_len];
+        uint16_t id = i;
+        memcpy(packet, q->data, q->len);
+        packet[0] = id >> 8;
+        packet[1] = id & 0xFF;
+        pthread_mutex_lock(&s_lock);
+        s_pending[id].kind = kind;
+        s_pending[id].sent_at = now_ns();
+        pthread_mutex_unlock(&s_lock);
+        sendto(sock, packet, q->len, 0, (const struct sockaddr *)dst, sizeof(*dst));
+        if (!(i % 64)) {
+            peak_heap = MAX(peak_heap, heap_used());
+        }
+    }
+    double seconds = (now_ns() - start) / 1e9;
+    vTaskDelay(pdMS_TO_TICKS(BENCH_DRAIN_MS));
+    size_t heap = heap_used();
+    mdns_get_stats(&after);
+
+    pthread_mutex_lock(&s_lock);
+    memset(s_pending, 0, sizeof(s_pending));
+    for (int k = 0; k < QUERY_KINDS; k++) {
+        answered += s_step.answered[k];
+    }
+    size_t dropped = queries - answered;
+    static uint32_t all[BENCH_MAX_QUERIES];
+    size_t all_len = 0;
+    for (int k = 0; k < QUERY_KINDS; k++) {
+        memcpy(all + all_len, s_step.latency_us[k], s_step.answered[k] * sizeof(uint32_t));
+        all_len += s_step.answered[k];
+        qsort(s_step.latency_us[k], s_step.answered[k], sizeof(uint32_t), compare_u32);
+    }
+    qsort(all, all_len, sizeof(uint32_t), compare_u32);
+
+    printf("rate %5u/s  sent %6.0f/s  answered %6.0f/s  dropped %5u  p50 %6.2f  p90 %6.2f  p99 %6.2f  max %7.2f ms"
+           "  heap %+7d B (peak %+7d B)  rx pool drops %u\n",
+           (unsigned)rate, queries / seconds, answered / seconds, (unsigned)dropped,
+           percentile_ms(all, all_len, 50), percentile_ms(all, all_len, 90), percentile_ms(all, all_len, 99),
+           all_len ? all[all_len - 1] / 1000.0 : 0, (int)(heap - idle_heap), (int)(MAX(peak_heap, heap) - idle_heap),
+           (unsigned)(after.rx_packets.exhausted - before.rx_packets.exhausted));
+    for (int k = 0; k < QUERY_KINDS; k++) {
+        printf("    %-8s answered %6u  p50 %6.2f  p99 %6.2f ms\n", s_kind_names[k], (unsigned)s_step.answered[k],
+               percentile_ms(s_step.latency_us[k], s_step.answered[k], 50),
+               percentile_ms(s_step.latency_us[k], s_step.answered[k], 99));
+    }
+    pthread_mutex_unlock(&s_lock);
+}
+
+void bench_load(esp_netif_t *netif)
+{
+    esp_netif_ip_info_t ip_info = { 0 };
+    if (esp_netif_get_ip_info(netif, &ip_info) != ESP_OK || !ip_info.ip.addr) {
+        ESP_LOGE(TAG, "%s has no IPv4 address", CONFIG_TEST_NETIF_NAME);
+        return;
+    }
+    if (!add_records()) {
+        ESP_LOGE(TAG, "Failed to add services");
+        return;
+    }
+    uint8_t *ip = (uint8_t *)&ip_info.ip.addr;
+    char name[64];
+    snprintf(name, sizeof(name), "%u.%u.%u.%u.in-addr.arpa", ip[3], ip[2], ip[1], ip[0]);
+    query_init(&s_reverse, name, MDNS_TYPE_PTR);
+    vTaskDelay(pdMS_TO_TICKS(BENCH_SETTLE_MS));
+
+    int sock = socket(AF_INET, SOCK_DGRAM, 0);
+    if (sock < 0) {
+        ESP_LOGE(TAG, "Failed to create socket");
+        return;
+    }
+    struct sockaddr_in dst = { .sin_family = AF_INET, .sin_port = htons(5353) };
+    dst.sin_addr.s_addr = ip_info.ip.addr;
+    pthread_t receiver;
+    s_running = true;
+    if (pthread_create(&receiver, NULL, receive_task, (void *)(intptr_t)sock)) {
+        ESP_LOGE(TAG, "Failed to start the receiver");
+        close(sock);
+        return;
+    }
+
+    size_t idle_heap = heap_used();
+    ESP_LOGI(TAG, "Load benchmark, %d s per rate, %d services, responder at " IPSTR, CONFIG_TEST_BENCH_LOAD_SECONDS,
+             CONFIG_MDNS_MAX_SERVICES, IP2STR(&ip_info.ip));
+    for (uint32_t rate = BENCH_MIN_RATE;; rate *= 2) {
+        rate = MIN(rate, CONFIG_TEST_BENCH_LOAD_MAX_RATE);
+        bench_step(sock, &dst, rate, idle_heap);
+        if (rate == CONFIG_TEST_BENCH_LOAD_MAX_RATE) {
+            break;
+        }
+    }
+
+    mdns_stats_t stats;
+    mdns_get_stats(&stats);
+    printf("response cache hits %u misses %u, answers split %u, rx pool peak %u/%u\n",
+           (unsigned)stats.response_cache_hits, (unsigned)stats.response_cache_misses, (unsigned)stats.answers_split,
+           (unsigned)stats.rx_packets.peak, (unsigned)stats.rx_packets.size);
+    s_running = false;
+    pthread_join(receiver, NULL);
+    close(sock);
+}
@@ -0,0 +1,146 @@
+/*
+ * SPDX-FileCopyrightText: 2024 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: Unlicense OR CC0-1.0
+ */
+#include <stdio.h>
+#include <time.h>
+#include <sys/param.h>
+#include "mdns.h"
+#include "esp_log.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "bench.h"
+
+#define BENCH_LOOKUPS       20000
+#define BENCH_MAX_HOSTS     256
+#define BENCH_WAIT_TICKS    pdMS_TO_TICKS(2000)
+
+static const char *TAG = "mdns-bench";
+
+static const size_t s_host_steps[] = { 1, 16, 64, BENCH_MAX_HOSTS };
+
+static uint64_t now_ns(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+/*
+ * Delegated hosts and services are added by the mDNS task, wait until the lookups see them
+ */
+static bool add_host(size_t i)
+{
+    char name[32];
+    snprintf(name, sizeof(name), "bench-host-%u", (unsigned)i);
+    mdns_ip_addr_t addr = { 0 };
+    addr.addr.type = ESP_IPADDR_TYPE_V4;
+    addr.addr.u_addr.ip4.addr = esp_netif_htonl(0xc0a80000 | (uint32_t)i);
+    if (mdns_delegate_hostname_add(name, &addr) != ESP_OK) {
+        return false;
+    }
+    TickType_t start = xTaskGetTickCount();
+    while (!mdns_hostname_exists(name)) {
+        if (xTaskGetTickCount() - start > BENCH_WAIT_TICKS) {
+            return false;
+        }
+        vTaskDelay(1);
+    }
+    return true;
+}
+
+static bool add_service(size_t i, size_t hosts)
+{
+    char instance[32], type[16], host[32];
+    snprintf(instance, sizeof(instance), "Bench Instance %u", (unsigned)i);
+    snprintf(type, sizeof(type), "_bench%u", (unsigned)i);
+    snprintf(host, sizeof(host), "bench-host-%u", (unsigned)(i % hosts));
+    return mdns_service_add_for_host(instance, type, "_tcp", host, 1000 + i, NULL, 0) == ESP_OK;
+}
+
+static bool remove_services(void)
+{
+    if (mdns_service_remove_all() != ESP_OK) {
+        return false;
+    }
+    TickType_t start = xTaskGetTickCount();
+    while (mdns_service_exists("_bench0", "_tcp", NULL)) {
+        if (xTaskGetTickCount() - start > BENCH_WAIT_TICKS) {
+            return false;
+        }
+        vTaskDelay(1);
+    }
+    return true;
+}
+
+/*
+ * Times the lookups done for each received question: a service instance (SRV/TXT), a service type (PTR)
+ * and a host name (A/AAAA), of the most recently added entries and of ones we do not have
+ */
+static void bench_run(size_t hosts, size_t services)
+{
+    char instance[32], type[16], host[32];
+    snprintf(instance, sizeof(instance), "BENCH INSTANCE %u", (unsigned)(services - 1));
+    snprintf(type, sizeof(type), "_BENCH%u", (unsigned)(services - 1));
+    snprintf(host, sizeof(host), "BENCH-HOST-%u", (unsigned)(hosts - 1));
+    size_t found = 0;
+
+    uint64_t start = now_ns();
+    for (int i = 0; i < BENCH_LOOKUPS; i++) {
+        found += mdns_service_exists_with_instance(instance, type, "_tcp", NULL);
+        found += mdns_service_exists_with_instance("Bench Missing", type, "_tcp", NULL);
+    }
+    uint64_t instance_ns = now_ns() - start;
+
+    start = now_ns();
+    for (int i = 0; i < BENCH_LOOKUPS; i++) {
+        found += mdns_service_exists(type, "_tcp", NULL);
+        found += mdns_service_exists("_missing", "_tcp", NULL);
+    }
+    uint64_t type_ns = now_ns() - start;
+
+    start = now_ns();
+    for (int i = 0; i < BENCH_LOOKUPS; i++) {
+        found += mdns_hostname_exists(host);
+        found += mdns_hostname_exists("bench-missing");
+    }
+    uint64_t host_ns = now_ns() - start;
+
+    printf("hosts %4u services %3u  instance %6.1f ns  type %6.1f ns  host %6.1f ns  found %u/%u\n",
+           (unsigned)hosts, (unsigned)services,
+           (double)instance_ns / (2 * BENCH_LOOKUPS), (double)type_ns / (2 * BENCH_LOOKUPS),
+           (double)host_ns / (2 * BENCH_LOOKUPS), (unsigned)found, 3 * BENCH_LOOKUPS);
+}
+
+void bench_lookup(void)
+{
+    ESP_LOGI(TAG, "Lookup benchmark, %d lookups per case", 2 * BENCH_LOOKUPS);
+    size_t hosts = 0;
+    for (size_t h = 0; h < sizeof(s_host_steps) / sizeof(s_host_steps[0]); h++) {
+        for (; hosts < s_host_steps[h]; hosts++) {
+            if (!add_host(hosts)) {
+                ESP_LOGE(TAG, "Failed to add host %u", (unsigned)hosts);
+                return;
+            }
+        }
+        if (!remove_services()) {
+            ESP_LOGE(TAG, "Failed to remove services");
+            return;
+        }
+        size_t services = 0;
+        for (size_t step = 1;; step *= 4) {
+            step = MIN(step, CONFIG_MDNS_MAX_SERVICES);
+            for (; services < step; services++) {
+                if (!add_service(services, hosts)) {
+                    ESP_LOGE(TAG, "Failed to add service %u", (unsigned)services);
+                    return;
+                }
+            }
+            bench_run(hosts, services);
+            if (services == CONFIG_MDNS_MAX_SERVICES) {
+                break;
+            }
+        }
+    }
+}
@@ -8,6 +8,7 @@
 #include "esp_log.h"
 #include "freertos/FreeRTOS.h"
 #include "freertos/task.h"
+#include "bench.h"
 
 static const char *TAG = "mdns-test";
 
@@ -44,6 +45,11 @@ int main(int argc, char *argv[])
     ESP_ERROR_CHECK(mdns_register_netif(sta));
     ESP_ERROR_CHECK(mdns_netif_action(sta, MDNS_EVENT_ENABLE_IP4 | MDNS_EVENT_IP4_REVERSE_LOOKUP | MDNS_EVENT_IP6_REVERSE_LOOKUP));
 
+#ifdef CONFIG_TEST_BENCH_LOOKUP
+    bench_lookup();
+#elif defined(CONFIG_TEST_BENCH_LOAD)
+    bench_load(sta);
+#else
 #ifdef REGISTER_SERVICE
     //set default mDNS instance name
     mdns_instance_name_set("myesp-inst");
@@ -59,6 +65,7 @@ int main(int argc, char *argv[])
     vTaskDelay(pdMS_TO_TICKS(10000));
     query_mdns_host("david-work");
     vTaskDelay(pdMS_TO_TICKS(1000));
+#endif
     esp_netif_destroy(sta);
     mdns_free();
     ESP_LOGI(TAG, "Exit");
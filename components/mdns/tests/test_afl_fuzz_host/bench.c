@@ -0,0 +1,127 @@
+/*
+ * SPDX-FileCopyrightText: 2024 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: Unlicense OR CC0-1.0
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "esp32_mock.h"
+#include "mdns.h"
+#include "mdns_private.h"
+
+#define BENCH_ITERATIONS 20000
+
+//
+// Dependency injected test functions
+void mdns_test_execute_action(void *action);
+mdns_srv_item_t *mdns_test_mdns_get_service_item(const char *service, const char *proto);
+mdns_tx_packet_t *mdns_test_alloc_packet_default(void);
+bool mdns_test_alloc_answer(mdns_out_answer_t **destination, uint16_t type, mdns_service_t *service, bool flush);
+void mdns_test_dispatch_tx_packet(mdns_tx_packet_t *packet);
+void mdns_test_free_tx_packet(mdns_tx_packet_t *packet);
+void mdns_test_response_cache_clear(void);
+void mdns_test_init_di(void);
+extern mdns_server_t *_mdns_server;
+
+static uint64_t now_ns(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+static void execute_last_action(void)
+{
+    mdns_action_t *a = NULL;
+    GetLastItem(&a);
+    mdns_test_execute_action(a);
+}
+
+static int bench_service_add(int i)
+{
+    char instance[32], service[16], id[8];
+    snprintf(instance, sizeof(instance), "Bench Instance %d", i);
+    snprintf(service, sizeof(service), "_bench%d", i);
+    snprintf(id, sizeof(id), "%d", i);
+    mdns_txt_item_t txt[] = { {"board", "esp32"}, {"path", "/"}, {"id", id} };
+    if (mdns_service_add(instance, service, "_tcp", 1000 + i, txt, 3)) {
+        // This is expected failure as the service thread is not running
+    }
+    execute_last_action();
+    return mdns_test_mdns_get_service_item(service, "_tcp") ? ESP_OK : ESP_FAIL;
+}
+
+//
+// Times building a packet with the PTR, SRV and TXT records of every service, the way a browse reply is built,
+// and sending it again from the response cache
+static void bench_build(int services)
+{
+    mdns_tx_packet_t *packet = mdns_test_alloc_packet_default();
+    if (!packet) {
+        abort();
+    }
+    packet->flags = MDNS_FLAGS_QR_AUTHORITATIVE;
+    for (mdns_srv_item_t *s = _mdns_server->services; s; s = s->next) {
+        if (!mdns_test_alloc_answer(&packet->answers, MDNS_TYPE_PTR, s->service, false)
+                || !mdns_test_alloc_answer(&packet->additional, MDNS_TYPE_SRV, s->service, true)
+                || !mdns_test_alloc_answer(&packet->additional, MDNS_TYPE_TXT, s->service, true)) {
+            abort();
+        }
+    }
+    uint64_t start = now_ns();
+    for (int i = 0; i < BENCH_ITERATIONS; i++) {
+        mdns_test_response_cache_clear();
+        mdns_test_dispatch_tx_packet(packet);
+    }
+    uint64_t build = now_ns() - start;
+    start = now_ns();
+    for (int i = 0; i < BENCH_ITERATIONS; i++) {
+        mdns_test_dispatch_tx_packet(packet);
+    }
+    uint64_t cached = now_ns() - start;
+    printf("services %3d  records %3d  build %8.2f us  cached %8.2f us\n", services, 3 * services,
+           (double)build / 1000 / BENCH_ITERATIONS, (double)cached / 1000 / BENCH_ITERATIONS);
+    mdns_test_free_tx_packet(packet);
+}
+
+//
+// Packet build benchmark, the packets go to the mocked UDP write
+//
+int main(int argc, char **argv)
+{
+    mdns_test_init_di();
+    if (mdns_init()) {
+        abort();
+    }
+    for (int i = 0; i < MDNS_MAX_INTERFACES; i++) {
+        _mdns_server->interfaces[i].pcbs[MDNS_IP_PROTOCOL_V4].state = PCB_RUNNING;
+    }
+    if (mdns_hostname_set("bench")) {
+        abort();
+    }
+    execute_last_action();
+
+    int services = 0;
+    for (int step = 1;; step *= 2) {
+        step = step < MDNS_MAX_SERVICES ? step : MDNS_MAX_SERVICES;
+        for (; services < step; services++) {
+            if (bench_service_add(services)) {
+                abort();
+            }
+        }
+        bench_build(services);
+        if (services == MDNS_MAX_SERVICES) {
+            break;
+        }
+    }
+
+    mdns_service_remove_all();
+    execute_last_action();
+    ForceTaskDelete();
+    mdns_free();
+    return 0;
+}
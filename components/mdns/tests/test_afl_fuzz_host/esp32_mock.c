@@ -45,6 +45,11 @@ esp_err_t esp_timer_start_periodic(esp_timer_handle_t timer, uint64_t period)
     return ESP_OK;
 }
 
+esp_err_t esp_timer_start_once(esp_timer_handle_t timer, uint64_t timeout_us)
+{
+    return ESP_OK;
+}
+
 esp_err_t esp_timer_create(const esp_timer_create_args_t *create_args,
                            esp_timer_handle_t *out_handle)
 {
@@ -18,6 +18,12 @@ mdns_search_once_t *(*mdns_test_static_search_init)(const char *name, const char
         mdns_query_notify_t notifier) = NULL;
 esp_err_t         (*mdns_test_static_send_search_action)(mdns_action_type_t type, mdns_search_once_t *search) = NULL;
 void              (*mdns_test_static_search_free)(mdns_search_once_t *search) = NULL;
+mdns_tx_packet_t *(*mdns_test_static_alloc_packet_default)(mdns_if_t tcpip_if, mdns_ip_protocol_t ip_protocol) = NULL;
+bool              (*mdns_test_static_alloc_answer)(mdns_out_answer_t **destination, uint16_t type, mdns_service_t *service,
+        mdns_host_item_t *host, bool flush, bool bye) = NULL;
+void              (*mdns_test_static_dispatch_tx_packet)(mdns_tx_packet_t *p) = NULL;
+void              (*mdns_test_static_free_tx_packet)(mdns_tx_packet_t *packet) = NULL;
+void              (*mdns_test_static_response_cache_clear)(void) = NULL;
 
 static void _mdns_execute_action(mdns_action_t *action);
 static mdns_srv_item_t *_mdns_get_service_item(const char *service, const char *proto, const char *hostname);
@@ -25,6 +31,12 @@ static mdns_search_once_t *_mdns_search_init(const char *name, const char *servi
         uint32_t timeout, uint8_t max_results, mdns_query_notify_t notifier);
 static esp_err_t _mdns_send_search_action(mdns_action_type_t type, mdns_search_once_t *search);
 static void _mdns_search_free(mdns_search_once_t *search);
+static mdns_tx_packet_t *_mdns_alloc_packet_default(mdns_if_t tcpip_if, mdns_ip_protocol_t ip_protocol);
+static bool _mdns_alloc_answer(mdns_out_answer_t **destination, uint16_t type, mdns_service_t *service,
+                               mdns_host_item_t *host, bool flush, bool bye);
+static void _mdns_dispatch_tx_packet(mdns_tx_packet_t *p);
+static void _mdns_free_tx_packet(mdns_tx_packet_t *packet);
+static void _mdns_response_cache_clear(void);
 
 void mdns_test_init_di(void)
 {
@@ -33,6 +45,11 @@ void mdns_test_init_di(void)
     mdns_test_static_search_init = _mdns_search_init;
     mdns_test_static_send_search_action = _mdns_send_search_action;
     mdns_test_static_search_free = _mdns_search_free;
+    mdns_test_static_alloc_packet_default = _mdns_alloc_packet_default;
+    mdns_test_static_alloc_answer = _mdns_alloc_answer;
+    mdns_test_static_dispatch_tx_packet = _mdns_dispatch_tx_packet;
+    mdns_test_static_free_tx_packet = _mdns_free_tx_packet;
+    mdns_test_static_response_cache_clear = _mdns_response_cache_clear;
 }
 
 void mdns_test_execute_action(void *action)
@@ -59,3 +76,28 @@ mdns_srv_item_t *mdns_test_mdns_get_service_item(const char *service, const char
 {
     return mdns_test_static_mdns_get_service_item(service, proto, NULL);
 }
+
+mdns_tx_packet_t *mdns_test_alloc_packet_default(void)
+{
+    return mdns_test_static_alloc_packet_default(0, MDNS_IP_PROTOCOL_V4);
+}
+
+bool mdns_test_alloc_answer(mdns_out_answer_t **destination, uint16_t type, mdns_service_t *service, bool flush)
+{
+    return mdns_test_static_alloc_answer(destination, type, service, NULL, flush, false);
+}
+
+void mdns_test_dispatch_tx_packet(mdns_tx_packet_t *packet)
+{
+    mdns_test_static_dispatch_tx_packet(packet);
+}
+
+void mdns_test_free_tx_packet(mdns_tx_packet_t *packet)
+{
+    mdns_test_static_free_tx_packet(packet);
+}
+
+void mdns_test_response_cache_clear(void)
+{
+    mdns_test_static_response_cache_clear();
+}
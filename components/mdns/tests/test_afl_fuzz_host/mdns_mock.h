@@ -24,3 +24,17 @@ static inline void _mdns_packet_free(mdns_rx_packet_t *packet)
     free(packet->pb);
     free(packet);
 }
+
+static inline esp_err_t _mdns_rx_pool_init(void)
+{
+    return ESP_OK;
+}
+
+static inline void _mdns_rx_pool_deinit(void)
+{
+}
+
+static inline void _mdns_rx_pool_get_stats(mdns_pool_stats_t *stats)
+{
+    memset(stats, 0, sizeof(mdns_pool_stats_t));
+}
@@ -295,6 +295,12 @@
 #define CONFIG_MDNS_TASK_AFFINITY 0x0
 #define CONFIG_MDNS_SERVICE_ADD_TIMEOUT_MS 1
 #define CONFIG_MDNS_TIMER_PERIOD_MS 100
+#define CONFIG_MDNS_RX_POOL_SIZE 8
+#define CONFIG_MDNS_QUESTION_POOL_SIZE 32
+#define CONFIG_MDNS_ACTION_POOL_SIZE 20
+#define CONFIG_MDNS_RESPONSE_CACHE_SIZE 4
+#define CONFIG_MDNS_RESULT_CACHE_SIZE 32
+#define CONFIG_MDNS_RESULT_CACHE_TXT_SIZE 128
 #define CONFIG_MQTT_PROTOCOL_311 1
 #define CONFIG_MQTT_TRANSPORT_SSL 1
 #define CONFIG_MQTT_TRANSPORT_WEBSOCKET 1
@@ -0,0 +1,100 @@
+#include <math.h>
+#include <string.h>
+#include "adc_filter.h"
+
+#define KELVIN_25C 298.15f
+
+bool adc_cic_init(adc_cic_t *cic, size_t num_channels, size_t order, size_t decimation)
+{
+    if (num_channels == 0 || num_channels > ADC_FILTER_MAX_CHANNELS || order == 0 || order > ADC_FILTER_MAX_ORDER ||
+        decimation == 0 || decimation > UINT16_MAX)
+    {
+        return false;
+    }
+    uint64_t gain = 1;
+    for (size_t i = 0; i < order; i++)
+    {
+        gain *= decimation;
+    }
+    if (gain > UINT32_MAX / ((1u << ADC_FILTER_INPUT_BITS) - 1))
+    {
+        return false;
+    }
+    memset(cic, 0, sizeof(*cic));
+    cic->num_channels = num_channels;
+    cic->order = order;
+    cic->decimation = decimation;
+    cic->gain = (uint32_t)gain;
+    return true;
+}
+
+size_t adc_cic_process(adc_cic_t *cic, const uint16_t *frames, size_t num_frames, uint16_t *out, size_t max_out)
+{
+    const size_t nc = cic->num_channels;
+    size_t written = 0;
+    for (size_t f = 0; f < num_frames; f++)
+    {
+        const uint16_t *x = frames + f * nc;
+        uint32_t *integ = cic->integ[0];
+        for (size_t c = 0; c < nc; c++)
+        {
+            integ[c] += x[c];
+        }
+        for (size_t s = 1; s < cic->order; s++)
+        {
+            uint32_t *prev = cic->integ[s - 1];
+            integ = cic->integ[s];
+            for (size_t c = 0; c < nc; c++)
+            {
+                integ[c] += prev[c];
+            }
+        }
+
+        if (++cic->phase < cic->decimation)
+        {
+            continue;
+        }
+        cic->phase = 0;
+
+        // combs at the output rate: y = x - x[n - 1] for each stage
+        uint32_t y[ADC_FILTER_MAX_CHANNELS];
+        memcpy(y, cic->integ[cic->order - 1], nc * sizeof(y[0]));
+        for (size_t s = 0; s < cic->order; s++)
+        {
+            uint32_t *delay = cic->delay[s];
+            for (size_t c = 0; c < nc; c++)
+            {
+                uint32_t in = y[c];
+                y[c] = in - delay[c];
+                delay[c] = in;
+            }
+        }
+        if (written < max_out)
+        {
+            uint16_t *o = out + written * nc;
+            for (size_t c = 0; c < nc; c++)
+            {
+                o[c] = (uint16_t)((y[c] + cic->gain / 2) / cic->gain);
+            }
+            written++;
+        }
+    }
+    return written;
+}
+
+int16_t adc_ntc_temp(uint32_t mv, uint32_t vref_mv, uint32_t series_ohm, uint32_t r0_ohm, uint32_t beta)
+{
+    if (mv == 0 || mv >= vref_mv)
+    {
+        return INT16_MIN;
+    }
+    float r = (float)series_ohm * mv / (vref_mv - mv);
+    float kelvin = 1.0f / (1.0f / KELVIN_25C + logf(r / r0_ohm) / beta);
+    return (int16_t)lroundf((kelvin - 273.15f) * 10);
+}
+
+uint32_t adc_shunt_ma(uint32_t mv, uint32_t shunt_mohm, uint32_t gain)
+{
+    // I = V / (R * gain), mV / mOhm is A
+    return (uint32_t)((uint64_t)mv * 1000 / ((uint64_t)shunt_mohm * gain));
+}
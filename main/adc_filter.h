@@ -0,0 +1,64 @@
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define ADC_FILTER_MAX_CHANNELS 8
+#define ADC_FILTER_MAX_ORDER 3
+#define ADC_FILTER_INPUT_BITS 12 // the gain, decimation ^ order, times full scale must fit 32 bits
+
+/**
+ * @brief Cascaded integrator-comb decimator over interleaved channels
+ *
+ * Order 1 is a moving average over `decimation` samples. The state of every stage is
+ * an array over channels, so the per-sample loops run across channels and vectorize.
+ * Integrators wrap around modulo 2^32, which the combs undo.
+ */
+typedef struct {
+    uint8_t num_channels;
+    uint8_t order;
+    uint16_t decimation;
+    uint16_t phase;                                                  /*!< Frames into the current output */
+    uint32_t gain;                                                   /*!< decimation ^ order */
+    uint32_t integ[ADC_FILTER_MAX_ORDER][ADC_FILTER_MAX_CHANNELS];  /*!< Integrator of each stage */
+    uint32_t delay[ADC_FILTER_MAX_ORDER][ADC_FILTER_MAX_CHANNELS];  /*!< Previous input of each comb */
+} adc_cic_t;
+
+/**
+ * @brief Reset `cic` for `num_channels` channels
+ *
+ * @return false when the channels, order or decimation are out of range, or full scale times the gain overflows
+ */
+bool adc_cic_init(adc_cic_t *cic, size_t num_channels, size_t order, size_t decimation);
+
+/**
+ * @brief Filter `num_frames` frames of `num_channels` interleaved samples
+ *
+ * Every `decimation` frames, one frame of outputs is written to `out`, scaled back to input units.
+ *
+ * @return Number of output frames written, at most `max_out`; frames past it are still filtered
+ */
+size_t adc_cic_process(adc_cic_t *cic, const uint16_t *frames, size_t num_frames, uint16_t *out, size_t max_out);
+
+/**
+ * @brief Temperature of an NTC thermistor between the input and ground, under a series resistor to `vref_mv`
+ *
+ * Uses the Beta equation, with `r0_ohm` the resistance at 25 degrees Celsius.
+ *
+ * @return Temperature in 0.1 degree Celsius, INT16_MIN when the input is at either rail
+ */
+int16_t adc_ntc_temp(uint32_t mv, uint32_t vref_mv, uint32_t series_ohm, uint32_t r0_ohm, uint32_t beta);
+
+/**
+ * @brief Current through a shunt of `shunt_mohm` read through an amplifier of gain `gain`, in milliampere
+ */
+uint32_t adc_shunt_ma(uint32_t mv, uint32_t shunt_mohm, uint32_t gain);
+
+#ifdef __cplusplus
+}
+#endif
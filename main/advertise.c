@@ -0,0 +1,109 @@
+#include <stdio.h>
+#include <string.h>
+#include "sdkconfig.h"
+#include "freertos/FreeRTOS.h"
+#include "esp_timer.h"
+#include "esp_check.h"
+#include "esp_log.h"
+#include "esp_app_desc.h"
+#include "mdns.h"
+#include "device_state.h"
+#include "advertise.h"
+
+#define MDNS_INSTANCE "esp home web server"
+#define TXT_VALUE_LEN 33 // fits a device name
+#define TXT_FIELDS (DEVICE_STATE_NAME | DEVICE_STATE_SPEED | DEVICE_STATE_RPM)
+
+static const char *TAG_MDNS = "MDNS";
+
+enum
+{
+    TXT_NAME,
+    TXT_VERSION,
+    TXT_SPEED,
+    TXT_RPM,
+    TXT_ITEMS,
+};
+
+static const char *const s_keys[TXT_ITEMS] = {"name", "version", "speed", "rpm"};
+static char s_values[TXT_ITEMS][TXT_VALUE_LEN]; // as last pushed
+static esp_timer_handle_t s_timer = NULL;
+static portMUX_TYPE s_lock = portMUX_INITIALIZER_UNLOCKED;
+static int64_t s_pushed_us = 0;
+
+static void format_values(const device_state_t *state, char values[TXT_ITEMS][TXT_VALUE_LEN])
+{
+    snprintf(values[TXT_NAME], TXT_VALUE_LEN, "%s", state->name);
+    snprintf(values[TXT_VERSION], TXT_VALUE_LEN, "%s", esp_app_get_description()->version);
+    snprintf(values[TXT_SPEED], TXT_VALUE_LEN, "%d", (int)state->speed);
+    snprintf(values[TXT_RPM], TXT_VALUE_LEN, "%d", (int)state->rpm);
+}
+
+/* runs on the timer task, the only writer of s_values once advertised */
+static void push_txt(void *arg)
+{
+    device_state_t state;
+    device_state_get(&state);
+    char values[TXT_ITEMS][TXT_VALUE_LEN];
+    format_values(&state, values);
+    for (int i = 0; i < TXT_ITEMS; i++)
+    {
+        if (strcmp(values[i], s_values[i]) == 0)
+        {
+            continue;
+        }
+        esp_err_t err = mdns_service_txt_item_set(ADVERTISE_SERVICE, ADVERTISE_PROTO, s_keys[i], values[i]);
+        if (err != ESP_OK)
+        {
+            ESP_LOGW(TAG_MDNS, "set %s failed: %s", s_keys[i], esp_err_to_name(err));
+            continue;
+        }
+        strcpy(s_values[i], values[i]);
+    }
+    portENTER_CRITICAL(&s_lock);
+    s_pushed_us = esp_timer_get_time();
+    portEXIT_CRITICAL(&s_lock);
+}
+
+static void state_changed_handler(void *arg, esp_event_base_t event_base, int32_t event_id, void *event_data)
+{
+    device_state_event_t *event = (device_state_event_t *)event_data;
+    if (!(event->changed & TXT_FIELDS) || esp_timer_is_active(s_timer))
+    {
+        return;
+    }
+    // the first change after a quiet period goes out at once, later ones wait for the interval
+    portENTER_CRITICAL(&s_lock);
+    int64_t due = s_pushed_us + CONFIG_FCTL_MDNS_TXT_INTERVAL_MS * 1000LL - esp_timer_get_time();
+    portEXIT_CRITICAL(&s_lock);
+    esp_timer_start_once(s_timer, due > 0 ? due : 0);
+}
+
+esp_err_t advertise_start(void)
+{
+    device_state_t state;
+    device_state_get(&state);
+    format_values(&state, s_values);
+    mdns_txt_item_t txt[TXT_ITEMS];
+    for (int i = 0; i < TXT_ITEMS; i++)
+    {
+        txt[i].key = s_keys[i];
+        txt[i].value = s_values[i];
+    }
+
+    ESP_RETURN_ON_ERROR(mdns_init(), TAG_MDNS, "init failed");
+    ESP_RETURN_ON_ERROR(mdns_hostname_set(CONFIG_EXAMPLE_MDNS_HOST_NAME), TAG_MDNS, "set hostname failed");
+    ESP_RETURN_ON_ERROR(mdns_instance_name_set(MDNS_INSTANCE), TAG_MDNS, "set instance name failed");
+    ESP_RETURN_ON_ERROR(mdns_service_add(NULL, "_http", "_tcp", ADVERTISE_PORT, NULL, 0), TAG_MDNS, "add _http failed");
+    ESP_RETURN_ON_ERROR(mdns_service_add(NULL, ADVERTISE_SERVICE, ADVERTISE_PROTO, ADVERTISE_PORT, txt, TXT_ITEMS), TAG_MDNS,
+                        "add %s failed", ADVERTISE_SERVICE);
+    s_pushed_us = esp_timer_get_time();
+
+    const esp_timer_create_args_t timer_args = {
+        .callback = &push_txt,
+        .name = "mdns_txt"};
+    ESP_RETURN_ON_ERROR(esp_timer_create(&timer_args, &s_timer), TAG_MDNS, "create timer failed");
+    ESP_RETURN_ON_ERROR(device_state_subscribe(state_changed_handler, NULL), TAG_MDNS, "subscribe failed");
+    ESP_LOGI(TAG_MDNS, "advertising %s.local", CONFIG_EXAMPLE_MDNS_HOST_NAME);
+    return ESP_OK;
+}
@@ -0,0 +1,24 @@
+#pragma once
+
+#include "esp_err.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define ADVERTISE_SERVICE "_fctl"
+#define ADVERTISE_PROTO "_tcp"
+#define ADVERTISE_PORT 80
+
+/**
+ * @brief Advertise the REST server as _http._tcp and _fctl._tcp over mDNS
+ *
+ * The host name is CONFIG_EXAMPLE_MDNS_HOST_NAME. The TXT records of _fctl._tcp carry the
+ * device name, the firmware version, the speed and the rpm. State changes are pushed at most
+ * once per CONFIG_FCTL_MDNS_TXT_INTERVAL_MS, and only the items that changed.
+ */
+esp_err_t advertise_start(void);
+
+#ifdef __cplusplus
+}
+#endif
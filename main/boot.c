@@ -0,0 +1,181 @@
+#include <string.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/queue.h"
+#include "esp_timer.h"
+#include "esp_check.h"
+#include "esp_log.h"
+#include "boot.h"
+#include "task_plan.h"
+
+#define BOOT_WORKERS 3
+#define BOOT_WORKER_STACK 4096
+#define BOOT_STOP 0xff // ready queue item telling a worker to exit
+
+static const char *TAG_BOOT = "BOOT";
+
+static portMUX_TYPE s_lock = portMUX_INITIALIZER_UNLOCKED;
+static boot_profile_t s_profile;
+
+typedef struct
+{
+    const boot_step_t *steps;
+    QueueHandle_t ready; // indexes of steps whose dependencies completed
+    QueueHandle_t done;  // indexes of completed steps, BOOT_STOP when a worker exits
+} boot_ctx_t;
+
+static void boot_worker(void *arg)
+{
+    boot_ctx_t *ctx = (boot_ctx_t *)arg;
+    uint8_t index;
+    while (xQueueReceive(ctx->ready, &index, portMAX_DELAY) == pdTRUE && index != BOOT_STOP)
+    {
+        boot_step_profile_t *step = &s_profile.steps[index];
+        portENTER_CRITICAL(&s_lock);
+        step->start_us = esp_timer_get_time();
+        step->core = xPortGetCoreID();
+        portEXIT_CRITICAL(&s_lock);
+
+        esp_err_t err = ctx->steps[index].init();
+
+        portENTER_CRITICAL(&s_lock);
+        step->err = err;
+        step->end_us = esp_timer_get_time();
+        portEXIT_CRITICAL(&s_lock);
+        xQueueSend(ctx->done, &index, portMAX_DELAY);
+    }
+    index = BOOT_STOP;
+    xQueueSend(ctx->done, &index, portMAX_DELAY);
+    vTaskDelete(NULL);
+}
+
+/* queue every step whose dependencies completed, skip those with a failed dependency */
+static size_t schedule(boot_ctx_t *ctx, size_t num_steps, uint32_t *started, uint32_t completed, uint32_t *failed)
+{
+    size_t queued = 0;
+    bool skipped;
+    do
+    {
+        skipped = false;
+        for (uint8_t i = 0; i < num_steps; i++)
+        {
+            uint32_t deps = ctx->steps[i].deps;
+            if ((*started & BOOT_DEP(i)) || (deps & ~(completed | *failed)))
+            {
+                continue;
+            }
+            *started |= BOOT_DEP(i);
+            if (deps & *failed)
+            {
+                ESP_LOGW(TAG_BOOT, "%s skipped, a dependency failed", ctx->steps[i].name);
+                portENTER_CRITICAL(&s_lock);
+                s_profile.steps[i].err = ESP_ERR_INVALID_STATE;
+                portEXIT_CRITICAL(&s_lock);
+                *failed |= BOOT_DEP(i);
+                skipped = true;
+                continue;
+            }
+            xQueueSend(ctx->ready, &i, portMAX_DELAY);
+            queued++;
+        }
+    } while (skipped);
+    return queued;
+}
+
+/* called once every worker exited, nothing writes the profile anymore */
+static void log_profile(void)
+{
+    const boot_profile_t *profile = &s_profile;
+    for (size_t i = 0; i < profile->num_steps; i++)
+    {
+        const boot_step_profile_t *step = &profile->steps[i];
+        ESP_LOGI(TAG_BOOT, "%-12s %7lld .. %7lld us, %6lld us on core %d: %s", step->name, (long long)step->start_us,
+                 (long long)step->end_us, (long long)(step->end_us - step->start_us), step->core, esp_err_to_name(step->err));
+    }
+    ESP_LOGI(TAG_BOOT, "boot completed %lld us after reset, %lld us after boot_run", (long long)profile->end_us,
+             (long long)(profile->end_us - profile->start_us));
+}
+
+esp_err_t boot_run(const boot_step_t *steps, size_t num_steps)
+{
+    ESP_RETURN_ON_FALSE(steps && num_steps <= BOOT_MAX_STEPS, ESP_ERR_INVALID_ARG, TAG_BOOT, "invalid argument");
+
+    portENTER_CRITICAL(&s_lock);
+    memset(&s_profile, 0, sizeof(s_profile));
+    s_profile.start_us = esp_timer_get_time();
+    s_profile.num_steps = num_steps;
+    for (size_t i = 0; i < num_steps; i++)
+    {
+        s_profile.steps[i].name = steps[i].name;
+        s_profile.steps[i].core = -1;
+    }
+    portEXIT_CRITICAL(&s_lock);
+
+    boot_ctx_t ctx = {
+        .steps = steps,
+        .ready = xQueueCreate(BOOT_MAX_STEPS + BOOT_WORKERS, sizeof(uint8_t)),
+        .done = xQueueCreate(BOOT_MAX_STEPS + BOOT_WORKERS, sizeof(uint8_t)),
+    };
+    ESP_RETURN_ON_FALSE(ctx.ready && ctx.done, ESP_ERR_NO_MEM, TAG_BOOT, "no memory for queues");
+
+    int workers = 0;
+    for (int i = 0; i < BOOT_WORKERS; i++)
+    {
+        if (task_plan_create(boot_worker, "boot", BOOT_WORKER_STACK, &ctx, TASK_ROLE_BOOT, NULL) == ESP_OK)
+        {
+            workers++;
+        }
+    }
+
+    uint32_t started = 0, completed = 0, failed = 0;
+    size_t running = workers ? schedule(&ctx, num_steps, &started, completed, &failed) : 0;
+    while (running > 0)
+    {
+        uint8_t index;
+        xQueueReceive(ctx.done, &index, portMAX_DELAY);
+        running--;
+        completed |= BOOT_DEP(index);
+        if (s_profile.steps[index].err != ESP_OK)
+        {
+            ESP_LOGE(TAG_BOOT, "%s failed: %s", steps[index].name, esp_err_to_name(s_profile.steps[index].err));
+            failed |= BOOT_DEP(index);
+        }
+        running += schedule(&ctx, num_steps, &started, completed, &failed);
+    }
+    for (uint8_t i = 0; i < num_steps; i++)
+    {
+        if (!(started & BOOT_DEP(i)))
+        {
+            ESP_LOGE(TAG_BOOT, "%s never ready, dependency cycle or unknown step", steps[i].name);
+            s_profile.steps[i].err = ESP_ERR_INVALID_ARG;
+            failed |= BOOT_DEP(i);
+        }
+    }
+
+    // wait for the workers to exit before deleting the queues they use
+    for (int i = 0; i < workers; i++)
+    {
+        uint8_t stop = BOOT_STOP;
+        xQueueSend(ctx.ready, &stop, portMAX_DELAY);
+    }
+    for (int i = 0; i < workers; i++)
+    {
+        uint8_t index;
+        xQueueReceive(ctx.done, &index, portMAX_DELAY);
+    }
+    vQueueDelete(ctx.ready);
+    vQueueDelete(ctx.done);
+
+    portENTER_CRITICAL(&s_lock);
+    s_profile.end_us = esp_timer_get_time();
+    portEXIT_CRITICAL(&s_lock);
+    log_profile();
+    return failed ? ESP_FAIL : ESP_OK;
+}
+
+void boot_get_profile(boot_profile_t *profile)
+{
+    portENTER_CRITICAL(&s_lock);
+    *profile = s_profile;
+    portEXIT_CRITICAL(&s_lock);
+}
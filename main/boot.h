@@ -0,0 +1,65 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include "esp_err.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define BOOT_MAX_STEPS 32
+
+/**
+ * @brief Bit of step `index` in boot_step_t::deps
+ */
+#define BOOT_DEP(index) (1u << (index))
+
+/**
+ * @brief One subsystem initialization
+ */
+typedef struct {
+    const char *name;
+    esp_err_t (*init)(void);
+    uint32_t deps; /*!< BOOT_DEP() of the steps that must complete before this one */
+} boot_step_t;
+
+/**
+ * @brief Start and end of a step, in microseconds since reset
+ */
+typedef struct {
+    const char *name;
+    int64_t start_us; /*!< 0 if the step did not run */
+    int64_t end_us;   /*!< 0 while the step is running */
+    esp_err_t err;    /*!< Result of the step, ESP_ERR_INVALID_STATE if skipped because a dependency failed */
+    int core;         /*!< Core the step ran on */
+} boot_step_profile_t;
+
+/**
+ * @brief Boot time profile
+ */
+typedef struct {
+    int64_t start_us; /*!< boot_run() entry, in microseconds since reset */
+    int64_t end_us;   /*!< Completion of the last step, 0 while booting */
+    size_t num_steps;
+    boot_step_profile_t steps[BOOT_MAX_STEPS];
+} boot_profile_t;
+
+/**
+ * @brief Run the steps on worker tasks, each as soon as all its dependencies completed
+ *
+ * Independent steps run concurrently. A step whose dependency failed is skipped.
+ * Blocks until every step completed or was skipped.
+ *
+ * @return ESP_OK if all steps succeeded, ESP_FAIL otherwise
+ */
+esp_err_t boot_run(const boot_step_t *steps, size_t num_steps);
+
+/**
+ * @brief Take a copy of the boot time profile, may be called while booting
+ */
+void boot_get_profile(boot_profile_t *profile);
+
+#ifdef __cplusplus
+}
+#endif
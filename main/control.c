@@ -0,0 +1,127 @@
+#include <string.h>
+#include "sdkconfig.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/semphr.h"
+#include "esp_timer.h"
+#include "esp_check.h"
+#include "esp_log.h"
+#include "task_plan.h"
+#include "rpm.h"
+#include "sensor.h"
+#include "fan_curve.h"
+#include "failsafe.h"
+#include "fan_cal.h"
+#include "control.h"
+
+#define CONTROL_TASK_STACK 3072
+#define LATE_BUCKETS 20 // bucket i counts delays below 2^(i+1) us, the last one everything above
+
+static const char *TAG_CONTROL = "CONTROL";
+
+static portMUX_TYPE s_lock = portMUX_INITIALIZER_UNLOCKED;
+static uint32_t s_buckets[LATE_BUCKETS];
+static uint32_t s_cycles = 0;
+static uint64_t s_late_sum_us = 0;
+static uint32_t s_late_max_us = 0;
+
+static void record_late(uint32_t late_us)
+{
+    int bucket = 0;
+    while (bucket < LATE_BUCKETS - 1 && late_us >= (2u << bucket))
+    {
+        bucket++;
+    }
+    portENTER_CRITICAL(&s_lock);
+    s_buckets[bucket]++;
+    s_cycles++;
+    s_late_sum_us += late_us;
+    if (late_us > s_late_max_us)
+    {
+        s_late_max_us = late_us;
+    }
+    portEXIT_CRITICAL(&s_lock);
+}
+
+static void control_task(void *arg)
+{
+    // the tach interrupt is allocated on this core
+    rpm_init();
+    xSemaphoreGive((SemaphoreHandle_t)arg);
+
+    const TickType_t period = pdMS_TO_TICKS(CONFIG_FCTL_CONTROL_PERIOD_MS);
+    TickType_t wake = xTaskGetTickCount();
+    // start on a tick edge, the schedule is measured from there
+    xTaskDelayUntil(&wake, 1);
+    int64_t start_us = esp_timer_get_time();
+    for (uint32_t cycle = 1;; cycle++)
+    {
+        xTaskDelayUntil(&wake, period);
+        int64_t late = esp_timer_get_time() - start_us - (int64_t)cycle * CONFIG_FCTL_CONTROL_PERIOD_MS * 1000;
+        record_late(late > 0 ? (uint32_t)late : 0);
+        failsafe_heartbeat();
+
+        rpm_update();
+        sensor_poll();
+        // a calibration sweep owns the fan until it ends
+        if (!fan_cal_update())
+        {
+            fan_curve_update();
+        }
+    }
+}
+
+esp_err_t control_start(void)
+{
+    if (sensor_init() != ESP_OK)
+    {
+        ESP_LOGW(TAG_CONTROL, "no on-board temperature sensor");
+    }
+    SemaphoreHandle_t ready = xSemaphoreCreateBinary();
+    ESP_RETURN_ON_FALSE(ready, ESP_ERR_NO_MEM, TAG_CONTROL, "create semaphore failed");
+    esp_err_t err = task_plan_create(control_task, "control", CONTROL_TASK_STACK, ready, TASK_ROLE_CONTROL, NULL);
+    if (err == ESP_OK)
+    {
+        xSemaphoreTake(ready, portMAX_DELAY);
+    }
+    vSemaphoreDelete(ready);
+    return err;
+}
+
+void control_get_stats(control_stats_t *stats)
+{
+    task_placement_t placement = task_plan_get(TASK_ROLE_CONTROL);
+    uint32_t buckets[LATE_BUCKETS];
+
+    portENTER_CRITICAL(&s_lock);
+    memcpy(buckets, s_buckets, sizeof(buckets));
+    stats->cycles = s_cycles;
+    stats->late_avg_us = s_cycles ? (uint32_t)(s_late_sum_us / s_cycles) : 0;
+    stats->late_max_us = s_late_max_us;
+    portEXIT_CRITICAL(&s_lock);
+
+    stats->period_us = CONFIG_FCTL_CONTROL_PERIOD_MS * 1000;
+    stats->core = placement.core == tskNO_AFFINITY ? -1 : (int)placement.core;
+    stats->priority = placement.priority;
+    stats->late_p99_us = 0;
+    uint32_t below = 0;
+    for (int i = 0; i < LATE_BUCKETS && stats->cycles; i++)
+    {
+        below += buckets[i];
+        if ((uint64_t)below * 100 >= (uint64_t)stats->cycles * 99)
+        {
+            stats->late_p99_us = i < LATE_BUCKETS - 1 && (2u << i) < stats->late_max_us ? (2u << i) : stats->late_max_us;
+            break;
+        }
+    }
+}
+
+void control_reset_stats(void)
+{
+    portENTER_CRITICAL(&s_lock);
+    memset(s_buckets, 0, sizeof(s_buckets));
+    s_cycles = 0;
+    s_late_sum_us = 0;
+    s_late_max_us = 0;
+    portEXIT_CRITICAL(&s_lock);
+}
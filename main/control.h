@@ -0,0 +1,40 @@
+#pragma once
+
+#include <stdint.h>
+#include "esp_err.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @brief Timing of the control loop, how late each period started
+ */
+typedef struct {
+    uint32_t period_us;   /*!< Control period */
+    uint32_t cycles;      /*!< Periods run since the last reset */
+    uint32_t late_avg_us; /*!< Average delay of the wake-up behind schedule */
+    uint32_t late_p99_us; /*!< 99th percentile of the delay, upper bound of its power of two bucket */
+    uint32_t late_max_us; /*!< Worst delay */
+    int core;             /*!< Core the loop is pinned to, -1 when not pinned */
+    uint32_t priority;    /*!< Priority of the loop */
+} control_stats_t;
+
+/**
+ * @brief Start the control task, which owns the tach interrupt and the fan curve, and wait for its interrupt to be installed
+ */
+esp_err_t control_start(void);
+
+/**
+ * @brief Get the timing of the control loop
+ */
+void control_get_stats(control_stats_t *stats);
+
+/**
+ * @brief Restart the timing statistics
+ */
+void control_reset_stats(void);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,542 @@
+#include <string.h>
+#include <stdio.h>
+#include <stdarg.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include "sdkconfig.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/queue.h"
+#include "esp_memory_utils.h"
+#include "esp_check.h"
+#include "esp_log.h"
+#include "deferred_log.h"
+#include "task_plan.h"
+
+#define LOG_TASK_STACK 3072
+#define LOG_RECORD_DATA 120      // argument bytes of one queued message
+#define LOG_LINE_MAX 256         // longest line written out
+#define RATE_SLOTS 16            // distinct messages tracked by the rate limiter
+#define RATE_WINDOW_MS 1000
+#define TAG_NONE 0xff
+
+static const char *TAG_LOG = "LOG";
+
+typedef enum
+{
+    ARG_NONE, // %%
+    ARG_INT,
+    ARG_LONG,
+    ARG_LLONG,
+    ARG_SIZE,
+    ARG_DOUBLE,
+    ARG_PTR,
+    ARG_STR,
+    ARG_BAD, // not deferrable, formatted by the caller
+} arg_type_t;
+
+/* one conversion, `spec` keeps the flags, '*' width or precision and length modifiers */
+typedef struct
+{
+    char spec[16];
+    uint8_t stars;
+    arg_type_t type;
+} conv_t;
+
+/*
+ * A queued message: the format pointer, which must stay valid, and its arguments
+ * packed in order. When the arguments could not be packed, `format` is NULL and
+ * `data` holds the formatted text.
+ */
+typedef struct
+{
+    const char *format;
+    uint8_t len;
+    uint8_t tag; // offset of the tag string in data
+    char data[LOG_RECORD_DATA];
+} log_record_t;
+
+typedef struct
+{
+    uint32_t hash;
+    uint32_t window_ms; // start of the current window
+    uint32_t count;      // messages in the current window
+    uint32_t suppressed; // not reported yet
+    char tag[16];
+} rate_slot_t;
+
+static vprintf_like_t s_orig_vprintf = NULL;
+static QueueHandle_t s_queue = NULL;
+static portMUX_TYPE s_lock = portMUX_INITIALIZER_UNLOCKED;
+static rate_slot_t s_rate[RATE_SLOTS];
+static deferred_log_stats_t s_stats; // counters and per tag table, under s_lock
+static char s_line[LOG_LINE_MAX];    // owned by the drain task
+
+static int out(const char *format, ...)
+{
+    va_list args;
+    va_start(args, format);
+    int ret = s_orig_vprintf(format, args);
+    va_end(args);
+    return ret;
+}
+
+/* parse the conversion after a '%', returns the character following it */
+static const char *parse_conv(const char *p, conv_t *conv)
+{
+    size_t n = 0;
+    conv->stars = 0;
+    conv->type = ARG_BAD;
+    conv->spec[n++] = '%';
+    while (*p && strchr("-+ #0123456789.*hljztL", *p))
+    {
+        if (n >= sizeof(conv->spec) - 2)
+        {
+            conv->spec[n] = '\0';
+            return p;
+        }
+        conv->stars += *p == '*';
+        conv->spec[n++] = *p++;
+    }
+    char c = *p;
+    if (!c)
+    {
+        conv->spec[n] = '\0';
+        return p;
+    }
+    conv->spec[n++] = c;
+    conv->spec[n] = '\0';
+    p++;
+
+    const char *len = conv->spec + strcspn(conv->spec, "hljztL");
+    switch (c)
+    {
+    case '%':
+        conv->type = ARG_NONE;
+        break;
+    case 'd':
+    case 'i':
+    case 'u':
+    case 'x':
+    case 'X':
+    case 'o':
+    case 'c':
+        if (len[0] == 'l' && len[1] == 'l')
+        {
+            conv->type = ARG_LLONG;
+        }
+        else if (len[0] == 'l')
+        {
+            conv->type = ARG_LONG;
+        }
+        else if (len[0] == 'j')
+        {
+            conv->type = ARG_LLONG;
+        }
+        else if (len[0] == 'z' || len[0] == 't')
+        {
+            conv->type = ARG_SIZE;
+        }
+        else if (len[0] == 'h' || len[0] == '\0')
+        {
+            conv->type = ARG_INT;
+        }
+        break;
+    case 'f':
+    case 'F':
+    case 'e':
+    case 'E':
+    case 'g':
+    case 'G':
+    case 'a':
+    case 'A':
+        conv->type = len[0] == 'L' ? ARG_BAD : ARG_DOUBLE;
+        break;
+    case 'p':
+        conv->type = ARG_PTR;
+        break;
+    case 's':
+        conv->type = len[0] == '\0' ? ARG_STR : ARG_BAD;
+        break;
+    default:
+        break;
+    }
+    return p;
+}
+
+#define PACK(rec, type, value)                                     \
+    do                                                             \
+    {                                                              \
+        type value_ = (value);                                     \
+        if ((rec)->len + sizeof(value_) > LOG_RECORD_DATA)         \
+        {                                                          \
+            return false;                                          \
+        }                                                          \
+        memcpy((rec)->data + (rec)->len, &value_, sizeof(value_)); \
+        (rec)->len += sizeof(value_);                              \
+    } while (0)
+
+#define UNPACK(data, pos, type) ({ type value_; memcpy(&value_, (data) + (pos), sizeof(value_)); (pos) += sizeof(value_); value_; })
+
+/*
+ * Copy the arguments of `rec->format`. Strings are copied, truncated when they do not fit.
+ * The tag is the string following the timestamp of LOG_FORMAT.
+ */
+static bool pack(log_record_t *rec, va_list args)
+{
+    int index = 0;
+    bool after_int = false;
+    rec->len = 0;
+    rec->tag = TAG_NONE;
+    for (const char *p = rec->format; *p;)
+    {
+        if (*p++ != '%')
+        {
+            continue;
+        }
+        conv_t conv;
+        p = parse_conv(p, &conv);
+        int star = 0; // last '*' argument, the precision when it has one
+        for (int i = 0; i < conv.stars; i++)
+        {
+            star = va_arg(args, int);
+            PACK(rec, int, star);
+        }
+        switch (conv.type)
+        {
+        case ARG_NONE:
+            continue;
+        case ARG_INT:
+            PACK(rec, int, va_arg(args, int));
+            break;
+        case ARG_LONG:
+            PACK(rec, long, va_arg(args, long));
+            break;
+        case ARG_LLONG:
+            PACK(rec, long long, va_arg(args, long long));
+            break;
+        case ARG_SIZE:
+            PACK(rec, size_t, va_arg(args, size_t));
+            break;
+        case ARG_DOUBLE:
+            PACK(rec, double, va_arg(args, double));
+            break;
+        case ARG_PTR:
+            PACK(rec, void *, va_arg(args, void *));
+            break;
+        case ARG_STR:
+        {
+            const char *str = va_arg(args, const char *);
+            if (!str)
+            {
+                str = "(null)";
+            }
+            size_t room = LOG_RECORD_DATA - rec->len;
+            if (room == 0)
+            {
+                return false;
+            }
+            // a precision bounds the read, the string need not be terminated
+            size_t n = room - 1;
+            const char *dot = strchr(conv.spec, '.');
+            int precision = !dot ? -1 : dot[1] == '*' ? star : atoi(dot + 1);
+            if (precision >= 0 && (size_t)precision < n)
+            {
+                n = precision;
+            }
+            n = strnlen(str, n);
+            if (index == 1 && after_int)
+            {
+                rec->tag = rec->len;
+            }
+            memcpy(rec->data + rec->len, str, n);
+            rec->data[rec->len + n] = '\0';
+            rec->len += n + 1;
+            break;
+        }
+        default:
+            return false;
+        }
+        after_int = index == 0 && (conv.type == ARG_INT || conv.type == ARG_LONG);
+        index++;
+    }
+    return true;
+}
+
+static void unpack(const log_record_t *rec)
+{
+    size_t pos = 0;
+    size_t n = 0;
+    const char *p = rec->format;
+    while (*p && n < sizeof(s_line) - 1)
+    {
+        if (*p != '%')
+        {
+            s_line[n++] = *p++;
+            continue;
+        }
+        conv_t conv;
+        p = parse_conv(p + 1, &conv);
+        if (conv.type == ARG_NONE)
+        {
+            s_line[n++] = '%';
+            continue;
+        }
+
+        // '*' become the packed width and precision
+        char spec[40];
+        size_t s = 0;
+        for (const char *c = conv.spec; *c && s < sizeof(spec) - 12; c++)
+        {
+            if (*c == '*')
+            {
+                s += snprintf(spec + s, sizeof(spec) - s, "%d", UNPACK(rec->data, pos, int));
+            }
+            else
+            {
+                spec[s++] = *c;
+            }
+        }
+        spec[s] = '\0';
+
+        size_t room = sizeof(s_line) - n;
+        int len = 0;
+        switch (conv.type)
+        {
+        case ARG_INT:
+            len = snprintf(s_line + n, room, spec, UNPACK(rec->data, pos, int));
+            break;
+        case ARG_LONG:
+            len = snprintf(s_line + n, room, spec, UNPACK(rec->data, pos, long));
+            break;
+        case ARG_LLONG:
+            len = snprintf(s_line + n, room, spec, UNPACK(rec->data, pos, long long));
+            break;
+        case ARG_SIZE:
+            len = snprintf(s_line + n, room, spec, UNPACK(rec->data, pos, size_t));
+            break;
+        case ARG_DOUBLE:
+            len = snprintf(s_line + n, room, spec, UNPACK(rec->data, pos, double));
+            break;
+        case ARG_PTR:
+            len = snprintf(s_line + n, room, spec, UNPACK(rec->data, pos, void *));
+            break;
+        case ARG_STR:
+            len = snprintf(s_line + n, room, spec, rec->data + pos);
+            pos += strlen(rec->data + pos) + 1;
+            break;
+        default:
+            break;
+        }
+        n += len < 0 ? 0 : ((size_t)len < room ? (size_t)len : room - 1);
+    }
+    s_line[n] = '\0';
+    if (*p)
+    {
+        s_line[n - 1] = '\n'; // truncated
+    }
+}
+
+static uint32_t hash_record(const log_record_t *rec)
+{
+    // FNV-1a over the format and the arguments from the tag on, leaving out the timestamp
+    uint32_t hash = 2166136261u;
+    uintptr_t format = (uintptr_t)rec->format;
+    for (size_t i = 0; i < sizeof(format); i++)
+    {
+        hash = (hash ^ ((format >> (i * 8)) & 0xff)) * 16777619u;
+    }
+    for (size_t i = rec->tag; i < rec->len; i++)
+    {
+        hash = (hash ^ (uint8_t)rec->data[i]) * 16777619u;
+    }
+    return hash;
+}
+
+/* count one more suppressed or dropped message of `tag`, under s_lock */
+static void count_tag(const char *tag, bool dropped)
+{
+    for (size_t i = 0; i < DEFERRED_LOG_MAX_TAGS; i++)
+    {
+        deferred_log_tag_stats_t *entry = &s_stats.tags[i];
+        if (i == s_stats.num_tags)
+        {
+            strlcpy(entry->tag, tag, sizeof(entry->tag));
+            s_stats.num_tags++;
+        }
+        else if (strncmp(entry->tag, tag, sizeof(entry->tag) - 1) != 0)
+        {
+            continue;
+        }
+        if (dropped)
+        {
+            entry->dropped++;
+        }
+        else
+        {
+            entry->suppressed++;
+        }
+        return;
+    }
+}
+
+/* whether the message is over CONFIG_FCTL_LOG_RATE_LIMIT in its window, under s_lock */
+static bool rate_limited(const log_record_t *rec, uint32_t now_ms)
+{
+    uint32_t hash = hash_record(rec);
+    rate_slot_t *slot = NULL;
+    rate_slot_t *oldest = &s_rate[0];
+    for (size_t i = 0; i < RATE_SLOTS; i++)
+    {
+        if (s_rate[i].count && s_rate[i].hash == hash)
+        {
+            slot = &s_rate[i];
+            break;
+        }
+        if (s_rate[i].window_ms < oldest->window_ms)
+        {
+            oldest = &s_rate[i];
+        }
+    }
+    if (!slot)
+    {
+        slot = oldest;
+        slot->hash = hash;
+        slot->count = 0;
+        slot->suppressed = 0;
+        slot->window_ms = now_ms;
+        strlcpy(slot->tag, rec->data + rec->tag, sizeof(slot->tag));
+    }
+    if (now_ms - slot->window_ms >= RATE_WINDOW_MS)
+    {
+        slot->window_ms = now_ms;
+        slot->count = 0;
+    }
+    if (slot->count < CONFIG_FCTL_LOG_RATE_LIMIT)
+    {
+        slot->count++;
+        return false;
+    }
+    slot->suppressed++;
+    s_stats.suppressed++;
+    count_tag(slot->tag, false);
+    return true;
+}
+
+static int deferred_vprintf(const char *format, va_list args)
+{
+    log_record_t rec = {.format = format};
+    va_list copy;
+    va_copy(copy, args);
+    bool packed = esp_ptr_in_drom(format) && pack(&rec, copy);
+    va_end(copy);
+
+    if (packed && rec.tag != TAG_NONE && CONFIG_FCTL_LOG_RATE_LIMIT > 0)
+    {
+        uint32_t now_ms = esp_log_timestamp();
+        portENTER_CRITICAL(&s_lock);
+        bool limited = rate_limited(&rec, now_ms);
+        portEXIT_CRITICAL(&s_lock);
+        if (limited)
+        {
+            return 0;
+        }
+    }
+    if (!packed)
+    {
+        // the format may not outlive the call, or an argument cannot be copied
+        rec.format = NULL;
+        rec.tag = TAG_NONE;
+        vsnprintf(rec.data, sizeof(rec.data), format, args);
+        rec.len = strlen(rec.data);
+    }
+
+    if (xQueueSend(s_queue, &rec, 0) != pdTRUE)
+    {
+        portENTER_CRITICAL(&s_lock);
+        s_stats.dropped++;
+        count_tag(rec.tag != TAG_NONE ? rec.data + rec.tag : "", true);
+        portEXIT_CRITICAL(&s_lock);
+        return 0;
+    }
+    portENTER_CRITICAL(&s_lock);
+    s_stats.queued++;
+    s_stats.formatted += !packed;
+    portEXIT_CRITICAL(&s_lock);
+    return 0;
+}
+
+/* report the messages suppressed since the last report */
+static void report_suppressed(void)
+{
+    for (size_t i = 0; i < RATE_SLOTS; i++)
+    {
+        char tag[sizeof(s_rate[i].tag)];
+        portENTER_CRITICAL(&s_lock);
+        uint32_t suppressed = s_rate[i].suppressed;
+        s_rate[i].suppressed = 0;
+        memcpy(tag, s_rate[i].tag, sizeof(tag));
+        portEXIT_CRITICAL(&s_lock);
+        if (suppressed)
+        {
+            out(LOG_FORMAT(W, "%" PRIu32 " identical messages suppressed"), esp_log_timestamp(), tag, suppressed);
+        }
+    }
+}
+
+static void deferred_log_task(void *arg)
+{
+    log_record_t rec;
+    TickType_t next_report = xTaskGetTickCount() + pdMS_TO_TICKS(RATE_WINDOW_MS);
+    for (;;)
+    {
+        TickType_t now = xTaskGetTickCount();
+        if ((int32_t)(next_report - now) <= 0)
+        {
+            report_suppressed();
+            next_report = now + pdMS_TO_TICKS(RATE_WINDOW_MS);
+            continue;
+        }
+        if (xQueueReceive(s_queue, &rec, next_report - now) != pdTRUE)
+        {
+            continue;
+        }
+        if (rec.format)
+        {
+            unpack(&rec);
+            out("%s", s_line);
+        }
+        else
+        {
+            out("%s", rec.data);
+        }
+        portENTER_CRITICAL(&s_lock);
+        s_stats.written++;
+        portEXIT_CRITICAL(&s_lock);
+    }
+}
+
+esp_err_t deferred_log_start(void)
+{
+#if CONFIG_FCTL_LOG_DEFERRED
+    ESP_RETURN_ON_FALSE(!s_queue, ESP_ERR_INVALID_STATE, TAG_LOG, "already started");
+    s_queue = xQueueCreate(CONFIG_FCTL_LOG_QUEUE_LEN, sizeof(log_record_t));
+    ESP_RETURN_ON_FALSE(s_queue, ESP_ERR_NO_MEM, TAG_LOG, "create queue failed");
+    esp_err_t err = task_plan_create(deferred_log_task, "log", LOG_TASK_STACK, NULL, TASK_ROLE_BACKGROUND, NULL);
+    if (err != ESP_OK)
+    {
+        vQueueDelete(s_queue);
+        s_queue = NULL;
+        return err;
+    }
+    s_orig_vprintf = esp_log_set_vprintf(deferred_vprintf);
+#endif
+    return ESP_OK;
+}
+
+void deferred_log_get_stats(deferred_log_stats_t *stats)
+{
+    portENTER_CRITICAL(&s_lock);
+    *stats = s_stats;
+    portEXIT_CRITICAL(&s_lock);
+}
@@ -0,0 +1,50 @@
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+#include "esp_err.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define DEFERRED_LOG_MAX_TAGS 16
+
+/**
+ * @brief Counters of one log tag
+ */
+typedef struct {
+    char tag[16];
+    uint32_t suppressed; /*!< Identical messages over CONFIG_FCTL_LOG_RATE_LIMIT per second */
+    uint32_t dropped;    /*!< Messages lost because the queue was full */
+} deferred_log_tag_stats_t;
+
+/**
+ * @brief Counters of the deferred log backend
+ */
+typedef struct {
+    uint32_t queued;     /*!< Messages accepted */
+    uint32_t written;    /*!< Messages formatted and written out */
+    uint32_t suppressed; /*!< Messages rate limited */
+    uint32_t dropped;    /*!< Messages lost because the queue was full */
+    uint32_t formatted;  /*!< Messages formatted by the caller because their arguments could not be deferred */
+    size_t num_tags;
+    deferred_log_tag_stats_t tags[DEFERRED_LOG_MAX_TAGS];
+} deferred_log_stats_t;
+
+/**
+ * @brief Install the deferred backend with esp_log_set_vprintf
+ *
+ * Log calls copy their format pointer and arguments into a queue and return.
+ * A low priority task formats and writes them through the previous vprintf.
+ */
+esp_err_t deferred_log_start(void);
+
+/**
+ * @brief Get the counters, per tag for tags that suppressed or dropped messages
+ */
+void deferred_log_get_stats(deferred_log_stats_t *stats);
+
+#ifdef __cplusplus
+}
+#endif
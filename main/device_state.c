@@ -0,0 +1,161 @@
+#include <string.h>
+#include <stddef.h>
+#include <stdatomic.h>
+#include "freertos/FreeRTOS.h"
+#include "esp_log.h"
+#include "device_state.h"
+#include "task_plan.h"
+
+#define STATE_EVENT_QUEUE_SIZE 16
+#define STATE_EVENT_TASK_STACK 4096
+
+static const char *TAG_STATE = "STATE";
+
+ESP_EVENT_DEFINE_BASE(DEVICE_STATE_EVENT);
+
+/*
+ * Sequence lock: writers serialize on the spinlock and make the sequence odd while the
+ * state is being modified, readers retry until they copied the state under one even sequence.
+ */
+static portMUX_TYPE s_lock = portMUX_INITIALIZER_UNLOCKED;
+static atomic_uint s_seq = 0;
+static device_state_t s_state = {
+    .name = "fctl",
+};
+
+static esp_event_loop_handle_t s_loop = NULL;
+static atomic_uint s_missed = 0; // fields of notifications that could not be posted
+static atomic_uint s_dropped = 0;
+
+esp_err_t device_state_init(void)
+{
+    // only persistence listens, it can wait for idle time
+    task_placement_t placement = task_plan_get(TASK_ROLE_BACKGROUND);
+    esp_event_loop_args_t loop_args = {
+        .queue_size = STATE_EVENT_QUEUE_SIZE,
+        .task_name = "state_evt",
+        .task_priority = placement.priority,
+        .task_stack_size = STATE_EVENT_TASK_STACK,
+        .task_core_id = placement.core};
+    return esp_event_loop_create(&loop_args, &s_loop);
+}
+
+void device_state_get(device_state_t *state)
+{
+    unsigned seq;
+    do
+    {
+        seq = atomic_load_explicit(&s_seq, memory_order_acquire);
+        if (seq & 1)
+        {
+            continue;
+        }
+        memcpy(state, (const void *)&s_state, sizeof(*state));
+        atomic_thread_fence(memory_order_acquire);
+    } while ((seq & 1) || seq != atomic_load_explicit(&s_seq, memory_order_relaxed));
+}
+
+uint32_t device_state_version(void)
+{
+    device_state_t state;
+    device_state_get(&state);
+    return state.version;
+}
+
+esp_err_t device_state_subscribe(esp_event_handler_t handler, void *arg)
+{
+    return esp_event_handler_register_with(s_loop, DEVICE_STATE_EVENT, DEVICE_STATE_EVENT_CHANGED, handler, arg);
+}
+
+uint32_t device_state_get_dropped(void)
+{
+    return atomic_load(&s_dropped);
+}
+
+static void notify(uint32_t field, uint32_t version)
+{
+    device_state_event_t evt = {
+        .version = version,
+        .changed = field | atomic_exchange(&s_missed, 0),
+    };
+    if (!s_loop || esp_event_post_to(s_loop, DEVICE_STATE_EVENT, DEVICE_STATE_EVENT_CHANGED, &evt, sizeof(evt), 0) != ESP_OK)
+    {
+        atomic_fetch_or(&s_missed, evt.changed);
+        if (s_loop)
+        {
+            atomic_fetch_add(&s_dropped, 1);
+        }
+    }
+}
+
+static void update(uint32_t field, size_t offset, const void *value, size_t size)
+{
+    uint8_t *member = (uint8_t *)&s_state + offset;
+    uint32_t version = 0;
+
+    portENTER_CRITICAL(&s_lock);
+    bool changed = memcmp(member, value, size) != 0;
+    if (changed)
+    {
+        unsigned seq = atomic_load_explicit(&s_seq, memory_order_relaxed);
+        atomic_store_explicit(&s_seq, seq + 1, memory_order_relaxed);
+        atomic_thread_fence(memory_order_release);
+        memcpy(member, value, size);
+        version = ++s_state.version;
+        atomic_store_explicit(&s_seq, seq + 2, memory_order_release);
+    }
+    portEXIT_CRITICAL(&s_lock);
+
+    if (changed)
+    {
+        notify(field, version);
+    }
+}
+
+#define UPDATE(field, member, value)                                                   \
+    do                                                                                 \
+    {                                                                                  \
+        __typeof__(s_state.member) value_ = (value);                                   \
+        update(field, offsetof(device_state_t, member), &value_, sizeof(value_));      \
+    } while (0)
+
+void device_state_set_speed(int32_t speed)
+{
+    UPDATE(DEVICE_STATE_SPEED, speed, speed);
+}
+
+void device_state_set_rpm(int32_t rpm)
+{
+    UPDATE(DEVICE_STATE_RPM, rpm, rpm);
+}
+
+void device_state_set_stalled(bool stalled)
+{
+    UPDATE(DEVICE_STATE_STALLED, stalled, stalled);
+}
+
+void device_state_set_alarm(bool alarm)
+{
+    UPDATE(DEVICE_STATE_ALARM, alarm, alarm);
+}
+
+void device_state_set_connected(bool connected)
+{
+    UPDATE(DEVICE_STATE_CONNECTED, connected, connected);
+}
+
+void device_state_set_wifi_mode(int32_t mode)
+{
+    UPDATE(DEVICE_STATE_WIFI_MODE, wifi_mode, mode);
+}
+
+void device_state_set_name(const char *name)
+{
+    char value[DEVICE_NAME_MAX_LEN] = {0};
+    strlcpy(value, name, sizeof(value));
+    if (strlen(name) >= sizeof(value))
+    {
+        ESP_LOGW(TAG_STATE, "name truncated to %d characters", DEVICE_NAME_MAX_LEN - 1);
+    }
+    update(DEVICE_STATE_NAME, offsetof(device_state_t, name), value, sizeof(value));
+}
@@ -0,0 +1,97 @@
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "esp_err.h"
+#include "esp_event.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define DEVICE_NAME_MAX_LEN 32
+
+ESP_EVENT_DECLARE_BASE(DEVICE_STATE_EVENT);
+
+/**
+ * @brief Event ids posted on the device state event loop
+ */
+enum {
+    DEVICE_STATE_EVENT_CHANGED, /*!< One or more fields changed, data is device_state_event_t */
+};
+
+/**
+ * @brief Fields of the device state, used as a bit mask in change notifications
+ */
+typedef enum {
+    DEVICE_STATE_SPEED = 1 << 0,
+    DEVICE_STATE_RPM = 1 << 1,
+    DEVICE_STATE_STALLED = 1 << 2,
+    DEVICE_STATE_ALARM = 1 << 3,
+    DEVICE_STATE_CONNECTED = 1 << 4,
+    DEVICE_STATE_WIFI_MODE = 1 << 5,
+    DEVICE_STATE_NAME = 1 << 6,
+} device_state_field_t;
+
+/**
+ * @brief Current values of the device
+ */
+typedef struct {
+    uint32_t version;  /*!< Incremented on every change */
+    int32_t speed;     /*!< Commanded fan speed, in percent */
+    int32_t rpm;       /*!< Last measured fan speed */
+    bool stalled;      /*!< Fan commanded on but the tach reports no rotation */
+    bool alarm;        /*!< Any other fault */
+    bool connected;    /*!< Station interface has an IP address */
+    int32_t wifi_mode; /*!< wifi_mode_t currently configured */
+    char name[DEVICE_NAME_MAX_LEN];
+} device_state_t;
+
+/**
+ * @brief Data of DEVICE_STATE_EVENT_CHANGED
+ */
+typedef struct {
+    uint32_t version; /*!< Version after the change */
+    uint32_t changed; /*!< Mask of device_state_field_t that changed */
+} device_state_event_t;
+
+/**
+ * @brief Create the state event loop, must be called before any update is expected to be notified
+ */
+esp_err_t device_state_init(void);
+
+/**
+ * @brief Take a consistent copy of the state
+ *
+ * Lock-free, never blocks writers and may be called from any core.
+ */
+void device_state_get(device_state_t *state);
+
+/**
+ * @brief Get the current version without copying the state
+ */
+uint32_t device_state_version(void);
+
+/**
+ * @brief Register a handler for DEVICE_STATE_EVENT_CHANGED on the state event loop
+ */
+esp_err_t device_state_subscribe(esp_event_handler_t handler, void *arg);
+
+/**
+ * @brief Get the number of notifications that could not be posted because the event queue was full
+ *
+ * Fields of a dropped notification are reported with the next one.
+ */
+uint32_t device_state_get_dropped(void);
+
+void device_state_set_speed(int32_t speed);
+void device_state_set_rpm(int32_t rpm);
+void device_state_set_stalled(bool stalled);
+void device_state_set_alarm(bool alarm);
+void device_state_set_connected(bool connected);
+void device_state_set_wifi_mode(int32_t mode);
+void device_state_set_name(const char *name);
+
+#ifdef __cplusplus
+}
+#endif
@@ -17,15 +17,24 @@
 #include "esp_netif.h"
 #include "esp_event.h"
 #include "esp_log.h"
-#include "mdns.h"
+#include "esp_check.h"
 #include "lwip/apps/netbiosns.h"
 #include "esp_wifi.h"
 #include "esp_mac.h"
 #include "freertos/FreeRTOS.h"
 #include "freertos/task.h"
 #include "freertos/event_groups.h"
-
-#define MDNS_INSTANCE "esp home web server"
+#include "device_state.h"
+#include "boot.h"
+#include "sys_stats.h"
+#include "deferred_log.h"
+#include "control.h"
+#include "fan_curve.h"
+#include "fan_cal.h"
+#include "sensing.h"
+#include "failsafe.h"
+#include "advertise.h"
+#include "fleet.h"
 
 static const char *TAG = "example";
 static EventGroupHandle_t s_wifi_event_group;
@@ -36,9 +45,10 @@ esp_err_t start_rest_server(const char *base_path);
 void init_nvs(void);
 esp_err_t read_fan_speed(int32_t *fan_speed);
 void start_led(void);
+void fan_early_init(void);
 void fan_init(int speed);
-void start_rpm_timer(void);
-void led_set_color(uint32_t hue);
+void load_device_name(void);
+esp_err_t start_state_persistence(void);
 
 esp_err_t init_fs(void)
 {
@@ -79,19 +89,113 @@ esp_err_t init_fs(void)
     return ESP_OK;
 }
 
-void app_main(void)
+static int32_t s_fan_speed = 0;
+
+static esp_err_t boot_nvs(void)
 {
     init_nvs();
-    int32_t fan_speed = 0;
-    read_fan_speed(&fan_speed);
-    start_rpm_timer();
-    fan_init((int)fan_speed);
-    start_led();
-    led_set_color(240 * fan_speed / 100);
+    return ESP_OK;
+}
 
-    esp_event_loop_create_default();
+static esp_err_t boot_settings(void)
+{
+    read_fan_speed(&s_fan_speed);
+    load_device_name();
+    if (fan_curve_load() != ESP_OK)
+    {
+        ESP_LOGW(TAG, "fan curve not loaded, the speed stays manual");
+    }
+    if (fan_cal_load() != ESP_OK)
+    {
+        ESP_LOGW(TAG, "fan calibration not loaded");
+    }
+    return ESP_OK;
+}
+
+static esp_err_t boot_fan(void)
+{
+    fan_init((int)s_fan_speed);
+    return ESP_OK;
+}
+
+static esp_err_t boot_led(void)
+{
+    start_led();
+    return ESP_OK;
+}
 
+static esp_err_t boot_wifi(void)
+{
+    ESP_RETURN_ON_ERROR(esp_event_loop_create_default(), TAG, "create default event loop failed");
     init_wifi();
+    return ESP_OK;
+}
+
+static esp_err_t boot_fs(void)
+{
+    // the API is still served without the web UI
     init_fs();
-    start_rest_server(CONFIG_EXAMPLE_WEB_MOUNT_POINT);
+    return ESP_OK;
+}
+
+static esp_err_t boot_rest(void)
+{
+    return start_rest_server(CONFIG_EXAMPLE_WEB_MOUNT_POINT);
+}
+
+enum
+{
+    BOOT_STATE,
+    BOOT_NVS,
+    BOOT_SETTINGS,
+    BOOT_CONTROL,
+    BOOT_FAILSAFE,
+    BOOT_FAN,
+    BOOT_PERSIST,
+    BOOT_LED,
+    BOOT_WIFI,
+    BOOT_FS,
+    BOOT_REST,
+    BOOT_STATS,
+    BOOT_SENSING,
+    BOOT_MDNS,
+    BOOT_FLEET,
+};
+
+static const boot_step_t boot_steps[] = {
+    [BOOT_STATE] = {"state", device_state_init, 0},
+    [BOOT_NVS] = {"nvs", boot_nvs, 0},
+    [BOOT_SETTINGS] = {"settings", boot_settings, BOOT_DEP(BOOT_STATE) | BOOT_DEP(BOOT_NVS)},
+    // the fan curve drives the speed once the settings were applied
+    [BOOT_CONTROL] = {"control", control_start, BOOT_DEP(BOOT_STATE) | BOOT_DEP(BOOT_FAN)},
+    // watches the heartbeat of the control loop
+    [BOOT_FAILSAFE] = {"failsafe", failsafe_start, BOOT_DEP(BOOT_CONTROL)},
+    [BOOT_FAN] = {"fan", boot_fan, BOOT_DEP(BOOT_SETTINGS)},
+    // after the loaded settings were applied, so they are not written back
+    [BOOT_PERSIST] = {"persist", start_state_persistence, BOOT_DEP(BOOT_SETTINGS) | BOOT_DEP(BOOT_FAN)},
+    [BOOT_LED] = {"led", boot_led, BOOT_DEP(BOOT_STATE)},
+    [BOOT_WIFI] = {"wifi", boot_wifi, BOOT_DEP(BOOT_STATE) | BOOT_DEP(BOOT_NVS)},
+    [BOOT_FS] = {"fs", boot_fs, 0},
+    // handlers drive the fan and the wifi driver, and report the loaded name
+    [BOOT_REST] = {"rest", boot_rest, BOOT_DEP(BOOT_SETTINGS) | BOOT_DEP(BOOT_FAN) | BOOT_DEP(BOOT_WIFI) | BOOT_DEP(BOOT_FS)},
+    [BOOT_STATS] = {"stats", sys_stats_start, 0},
+    [BOOT_SENSING] = {"sensing", sensing_start, 0},
+    // needs the network interfaces, and advertises the loaded name
+    [BOOT_MDNS] = {"mdns", advertise_start, BOOT_DEP(BOOT_SETTINGS) | BOOT_DEP(BOOT_WIFI)},
+    [BOOT_FLEET] = {"fleet", fleet_start, BOOT_DEP(BOOT_MDNS)},
+};
+
+void app_main(void)
+{
+    // fans stay uncontrolled until the PWM is driven, do it before anything else
+    fan_early_init();
+    // before the boot steps, so their logs do not delay each other
+    if (deferred_log_start() != ESP_OK)
+    {
+        ESP_LOGW(TAG, "logging synchronously");
+    }
+    if (boot_run(boot_steps, sizeof(boot_steps) / sizeof(boot_steps[0])) != ESP_OK)
+    {
+        ESP_LOGW(TAG, "boot completed with errors");
+    }
 }
@@ -0,0 +1,160 @@
+#include <stdatomic.h>
+#include "sdkconfig.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "esp_timer.h"
+#include "esp_check.h"
+#include "esp_log.h"
+#include "task_plan.h"
+#include "device_state.h"
+#include "sensor.h"
+#include "failsafe.h"
+
+#define FAILSAFE_TASK_STACK 3072
+
+// one late control period must not trip the failsafe
+_Static_assert(CONFIG_FCTL_FAILSAFE_HEARTBEAT_MS >= 3 * CONFIG_FCTL_CONTROL_PERIOD_MS,
+               "CONFIG_FCTL_FAILSAFE_HEARTBEAT_MS must be at least 3 control periods");
+
+static const char *TAG_FAILSAFE = "FAILSAFE";
+
+void fan_force_speed(int speed);
+void fan_release(void);
+void fan_hold(void);
+
+static portMUX_TYPE s_lock = portMUX_INITIALIZER_UNLOCKED;
+static failsafe_status_t s_status = {.sensor = -1};
+static atomic_uint s_beats = 0;
+
+/* first fault present now, reads nothing the network tasks may hold */
+static failsafe_cause_t check(int64_t now_us, int64_t beat_us, int *sensor, int16_t *temp)
+{
+    for (int id = 0; id < SENSOR_MAX; id++)
+    {
+        sensor_reading_t reading;
+        if (sensor_get(id, &reading) == ESP_OK && reading.temp >= CONFIG_FCTL_FAILSAFE_TEMP_C * 10)
+        {
+            *sensor = id;
+            *temp = reading.temp;
+            return FAILSAFE_TEMPERATURE;
+        }
+    }
+    device_state_t state;
+    device_state_get(&state);
+    if (state.stalled)
+    {
+        return FAILSAFE_STALL;
+    }
+    if (beat_us && now_us - beat_us > CONFIG_FCTL_FAILSAFE_HEARTBEAT_MS * 1000)
+    {
+        return FAILSAFE_HEARTBEAT;
+    }
+    return FAILSAFE_NONE;
+}
+
+static void failsafe_task(void *arg)
+{
+    const TickType_t period = pdMS_TO_TICKS(CONFIG_FCTL_FAILSAFE_PERIOD_MS);
+    unsigned last_beats = 0;
+    int64_t beat_us = 0; // when the heartbeat last changed, 0 until the control loop runs
+    int64_t ok_us = esp_timer_get_time();
+    TickType_t wake = xTaskGetTickCount();
+    for (;;)
+    {
+        xTaskDelayUntil(&wake, period);
+        int64_t now = esp_timer_get_time();
+        unsigned beats = atomic_load(&s_beats);
+        if (beats != last_beats)
+        {
+            last_beats = beats;
+            beat_us = now;
+        }
+
+        int sensor = -1;
+        int16_t temp = 0;
+        failsafe_cause_t cause = check(now, beat_us, &sensor, &temp);
+        portENTER_CRITICAL(&s_lock);
+        s_status.checks++;
+        bool latched = s_status.latched;
+        portEXIT_CRITICAL(&s_lock);
+        if (cause == FAILSAFE_NONE)
+        {
+            ok_us = now;
+        }
+        if (latched)
+        {
+            // the first forced write may have raced a speed change, keep the floor on the output until cleared
+            fan_hold();
+            continue;
+        }
+        if (cause == FAILSAFE_NONE)
+        {
+            continue;
+        }
+
+        // fans first, everything else after
+        fan_force_speed(CONFIG_FCTL_FAILSAFE_SPEED);
+        uint32_t reaction = (uint32_t)(esp_timer_get_time() - ok_us);
+        portENTER_CRITICAL(&s_lock);
+        s_status.latched = true;
+        s_status.cause = cause;
+        s_status.sensor = sensor;
+        s_status.temp = temp;
+        s_status.tripped_us = now;
+        s_status.trips++;
+        s_status.reaction_us = reaction;
+        if (reaction > s_status.reaction_max_us)
+        {
+            s_status.reaction_max_us = reaction;
+        }
+        portEXIT_CRITICAL(&s_lock);
+        device_state_set_alarm(true);
+        ESP_LOGE(TAG_FAILSAFE, "%s fault, fans forced to %d%% in %u us", failsafe_cause_name(cause), CONFIG_FCTL_FAILSAFE_SPEED,
+                 (unsigned)reaction);
+    }
+}
+
+esp_err_t failsafe_start(void)
+{
+    return task_plan_create(failsafe_task, "failsafe", FAILSAFE_TASK_STACK, NULL, TASK_ROLE_FAILSAFE, NULL);
+}
+
+void failsafe_heartbeat(void)
+{
+    atomic_fetch_add(&s_beats, 1);
+}
+
+void failsafe_clear(void)
+{
+    // released before unlatching, so a new trip is not undone
+    fan_release();
+    device_state_set_alarm(false);
+    portENTER_CRITICAL(&s_lock);
+    s_status.latched = false;
+    s_status.cause = FAILSAFE_NONE;
+    s_status.sensor = -1;
+    portEXIT_CRITICAL(&s_lock);
+    ESP_LOGI(TAG_FAILSAFE, "cleared");
+}
+
+void failsafe_get(failsafe_status_t *status)
+{
+    portENTER_CRITICAL(&s_lock);
+    *status = s_status;
+    portEXIT_CRITICAL(&s_lock);
+}
+
+const char *failsafe_cause_name(failsafe_cause_t cause)
+{
+    switch (cause)
+    {
+    case FAILSAFE_TEMPERATURE:
+        return "temperature";
+    case FAILSAFE_STALL:
+        return "stall";
+    case FAILSAFE_HEARTBEAT:
+        return "heartbeat";
+    default:
+        return "none";
+    }
+}
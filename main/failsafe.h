@@ -0,0 +1,63 @@
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "esp_err.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @brief Fault that tripped the failsafe
+ */
+typedef enum {
+    FAILSAFE_NONE,
+    FAILSAFE_TEMPERATURE, /*!< A temperature input reached CONFIG_FCTL_FAILSAFE_TEMP_C */
+    FAILSAFE_STALL,       /*!< The fan stalled while commanded on */
+    FAILSAFE_HEARTBEAT,   /*!< The control loop stopped running */
+} failsafe_cause_t;
+
+/**
+ * @brief State of the failsafe and its reaction times
+ */
+typedef struct {
+    bool latched;             /*!< Fans held at the safe speed until cleared */
+    failsafe_cause_t cause;   /*!< Fault of the latched trip */
+    int sensor;               /*!< Input of a temperature trip, -1 otherwise */
+    int16_t temp;             /*!< Its temperature, in 0.1 degree Celsius */
+    int64_t tripped_us;       /*!< Time since boot of the latched trip */
+    uint32_t trips;           /*!< Trips since boot */
+    uint32_t checks;          /*!< Checks run since boot */
+    uint32_t reaction_us;     /*!< From the last check without fault to the forced speed, of the last trip */
+    uint32_t reaction_max_us; /*!< Worst reaction time since boot */
+} failsafe_status_t;
+
+/**
+ * @brief Start the failsafe task, after the control loop
+ */
+esp_err_t failsafe_start(void);
+
+/**
+ * @brief Signal that the control loop ran, called every control period
+ */
+void failsafe_heartbeat(void);
+
+/**
+ * @brief Release the fans and clear the latch, a fault still present trips again at the next check
+ */
+void failsafe_clear(void);
+
+/**
+ * @brief Get the state of the failsafe
+ */
+void failsafe_get(failsafe_status_t *status);
+
+/**
+ * @brief Name of `cause`, as reported by the REST API
+ */
+const char *failsafe_cause_name(failsafe_cause_t cause);
+
+#ifdef __cplusplus
+}
+#endif
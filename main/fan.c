@@ -7,20 +7,76 @@
    CONDITIONS OF ANY KIND, either express or implied.
 */
 #include <stdio.h>
+#include <stddef.h>
 #include "driver/ledc.h"
 #include "esp_err.h"
+#include "esp_timer.h"
+#include "esp_attr.h"
+#include "esp_system.h"
+#include "esp_rom_crc.h"
 #include "esp_log.h"
 #include "freertos/FreeRTOS.h"
 #include "freertos/task.h"
+#include "freertos/semphr.h"
+#include "device_state.h"
+#include "trace.h"
 
 #define FAN_IO (18)           // Define the output GPIO
 #define PWM_FREQUENCY (25000) // Frequency in Hertz. Set frequency at 5 kHz
+#define SPIN_UP_US (1000000)  // full speed kick before the requested speed is applied
+#define RETAINED_MAGIC 0x46414e31
+#define FORCE_LOCK_MS 10      // longest the failsafe waits for a speed change in progress
 
 static const char *TAG_FAN = "FAN";
+static esp_timer_handle_t s_spin_up_timer = NULL;
 void set_fan_speed(int speed);
+esp_err_t write_fan_speed(int32_t fan_speed);
 
-void fan_init(int speed)
+/* last requested speed, kept in RTC memory across every reset but power-on; a failsafe speed is never retained */
+typedef struct
+{
+    uint32_t magic;
+    int32_t speed;
+    uint32_t crc;
+} fan_retained_t;
+
+static RTC_NOINIT_ATTR fan_retained_t s_retained;
+static bool s_restored = false;  // early init drove the retained speed
+static int64_t s_first_pwm_us = 0;
+static SemaphoreHandle_t s_lock = NULL;
+static volatile int s_requested = 0; // last speed asked for, applied again when the failsafe releases the fans
+static volatile int s_floor = 0; // lowest speed while the failsafe holds the fans
+
+static uint32_t retained_crc(const fan_retained_t *retained)
+{
+    return esp_rom_crc32_le(0, (const uint8_t *)retained, offsetof(fan_retained_t, crc));
+}
+
+static void retain_speed(int speed)
+{
+    s_retained.magic = RETAINED_MAGIC;
+    s_retained.speed = speed;
+    s_retained.crc = retained_crc(&s_retained);
+}
+
+/* the fan input is inverted: duty 0 is full speed */
+static uint32_t speed_to_duty(int speed)
+{
+    return 255 * (100 - speed) / 100;
+}
+
+static void spin_up_done(void *arg)
+{
+    // apply the latest speed, it may have been changed during the kick
+    set_fan_speed(s_requested);
+}
+
+void fan_early_init(void)
 {
+    s_lock = xSemaphoreCreateMutex();
+    s_restored = s_retained.magic == RETAINED_MAGIC && s_retained.crc == retained_crc(&s_retained) &&
+                 s_retained.speed >= 0 && s_retained.speed <= 100;
+
     // Prepare and then apply the LEDC PWM timer configuration
     ledc_timer_config_t ledc_timer = {
         .speed_mode = LEDC_HIGH_SPEED_MODE,
@@ -30,28 +86,115 @@ void fan_init(int speed)
         .clk_cfg = LEDC_AUTO_CLK};
     ESP_ERROR_CHECK(ledc_timer_config(&ledc_timer));
 
-    // Prepare and then apply the LEDC PWM channel configuration
+    // Prepare and then apply the LEDC PWM channel configuration, full speed until the settings are loaded
     ledc_channel_config_t ledc_channel = {
         .speed_mode = LEDC_HIGH_SPEED_MODE,
         .channel = LEDC_CHANNEL_0,
         .timer_sel = LEDC_TIMER_0,
         .intr_type = LEDC_INTR_DISABLE,
         .gpio_num = FAN_IO,
-        .duty = 0, // Set duty to 0%
+        .duty = s_restored ? speed_to_duty(s_retained.speed) : 0,
         .hpoint = 0};
     ESP_ERROR_CHECK(ledc_channel_config(&ledc_channel));
+    s_first_pwm_us = esp_timer_get_time();
 
-    vTaskDelay(1000 / portTICK_PERIOD_MS);
-    set_fan_speed(speed);
+    ESP_LOGI(TAG_FAN, "pwm driven %lld us after reset (reason %d), %s", (long long)s_first_pwm_us, (int)esp_reset_reason(),
+             s_restored ? "retained speed" : "full speed");
 }
 
-void set_fan_speed(int speed)
+void fan_init(int speed)
+{
+    if (s_restored)
+    {
+        // the retained speed is written on every change, NVS may lag behind it
+        if (s_retained.speed != speed)
+        {
+            ESP_LOGW(TAG_FAN, "retained speed %d differs from stored %d, keeping retained", (int)s_retained.speed, speed);
+            write_fan_speed(s_retained.speed);
+        }
+        set_fan_speed(s_retained.speed);
+        return;
+    }
+
+    // cold start: the early init drives the spin-up kick, the timer ends it without blocking the boot
+    retain_speed(speed);
+    s_requested = speed;
+    device_state_set_speed(speed);
+    const esp_timer_create_args_t spin_up_timer_args = {
+        .callback = &spin_up_done,
+        .name = "fan_spin_up"};
+    ESP_ERROR_CHECK(esp_timer_create(&spin_up_timer_args, &s_spin_up_timer));
+    ESP_ERROR_CHECK(esp_timer_start_once(s_spin_up_timer, SPIN_UP_US));
+}
+
+void fan_get_boot_timing(int64_t *first_pwm_us, bool *restored)
+{
+    *first_pwm_us = s_first_pwm_us;
+    *restored = s_restored;
+}
+
+/* drives the operator's speed, never below the failsafe floor; the caller holds the lock when it can */
+static void apply_speed(void)
 {
-    ESP_LOGI(TAG_FAN, "start set pwm duty: %d", (int)(255 * speed / 100));
+    int speed = s_requested > s_floor ? s_requested : s_floor;
+    ESP_LOGD(TAG_FAN, "start set pwm duty: %d", (int)(255 * speed / 100));
+    trace_instant(TRACE_FAN_SPEED, speed, speed_to_duty(speed));
 
-    esp_err_t err = ledc_set_duty(LEDC_HIGH_SPEED_MODE, LEDC_CHANNEL_0, (int)(255 * (100 - speed) / 100));
+    // a reset while the failsafe holds the fans restores the operator's speed, the failsafe trips again if needed
+    retain_speed(s_requested);
+    esp_err_t err = ledc_set_duty(LEDC_HIGH_SPEED_MODE, LEDC_CHANNEL_0, speed_to_duty(speed));
     ESP_ERROR_CHECK(err);
 
     err = ledc_update_duty(LEDC_HIGH_SPEED_MODE, LEDC_CHANNEL_0);
     ESP_ERROR_CHECK(err);
-}
\ No newline at end of file
+
+    device_state_set_speed(speed);
+}
+
+void set_fan_speed(int speed)
+{
+    xSemaphoreTake(s_lock, portMAX_DELAY);
+    s_requested = speed;
+    apply_speed();
+    xSemaphoreGive(s_lock);
+}
+
+int fan_get_setpoint(void)
+{
+    return s_requested;
+}
+
+void fan_force_speed(int speed)
+{
+    // a speed change stuck in progress must not keep the fans from the failsafe
+    bool locked = xSemaphoreTake(s_lock, pdMS_TO_TICKS(FORCE_LOCK_MS)) == pdTRUE;
+    s_floor = speed;
+    apply_speed();
+    if (locked)
+    {
+        xSemaphoreGive(s_lock);
+    }
+}
+
+void fan_hold(void)
+{
+    if (s_floor == 0 || xSemaphoreTake(s_lock, pdMS_TO_TICKS(FORCE_LOCK_MS)) != pdTRUE)
+    {
+        return;
+    }
+    // a change that raced a forced write without the lock may have left the output below the floor
+    if (s_floor != 0 && ledc_get_duty(LEDC_HIGH_SPEED_MODE, LEDC_CHANNEL_0) > speed_to_duty(s_floor))
+    {
+        ESP_LOGW(TAG_FAN, "output below the failsafe floor, forcing %d%% again", s_floor);
+        apply_speed();
+    }
+    xSemaphoreGive(s_lock);
+}
+
+void fan_release(void)
+{
+    xSemaphoreTake(s_lock, portMAX_DELAY);
+    s_floor = 0;
+    apply_speed();
+    xSemaphoreGive(s_lock);
+}
@@ -0,0 +1,458 @@
+#include <string.h>
+#include "sdkconfig.h"
+#include "freertos/FreeRTOS.h"
+#include "esp_timer.h"
+#include "esp_check.h"
+#include "esp_log.h"
+#include "device_state.h"
+#include "rpm.h"
+#include "fan_cal.h"
+
+#define CAL_KEY "fan_cal"
+#define CAL_BLOB_VERSION 1
+#define CAL_BLOB_HEADER 4      // version, minimum start speed, minimum run speed, number of points
+#define CAL_BLOB_POINT 3       // speed, rpm (little endian)
+#define SETTLE_PERCENT 3       // a reading this close to the previous one is steady
+#define SETTLE_READINGS 2      // steady readings in a row before a speed has settled
+#define SETTLE_MAX_READINGS 10 // a speed that does not settle keeps its last reading
+#define STOP_PULSES 3          // fewer pulses in a reading are a fan coasting to a stop
+#define STOP_READINGS 3        // readings without pulses before the fan counts as standing still
+#define STOP_MAX_READINGS 30
+
+static const char *TAG_CAL = "FAN_CAL";
+
+void set_fan_speed(int speed);
+int fan_get_setpoint(void);
+esp_err_t read_blob(char *key, void *value, size_t *length);
+esp_err_t write_blob(char *key, const void *value, size_t length);
+
+typedef enum
+{
+    PHASE_DOWN, // from full speed until the fan stops
+    PHASE_STOP, // at 0 until it stands still
+    PHASE_UP,   // from the minimum run speed until it starts
+} phase_t;
+
+/* sweep state, owned by the control loop */
+typedef struct
+{
+    bool active;
+    uint32_t run; // sweep started by fan_cal_start() that this state belongs to
+    phase_t phase;
+    uint8_t speed;
+    uint8_t restore_speed;
+    uint8_t readings;        // at this speed
+    uint8_t zero_readings;   // in a row without pulses
+    uint8_t steady_readings; // in a row close to the previous one
+    uint32_t last_rpm;
+    uint32_t window_pulses;
+    int64_t window_us;
+    int64_t start_us;
+    uint8_t min_run;
+    uint8_t num_points;
+    fan_cal_point_t points[FAN_CAL_MAX_POINTS]; // running speeds of the down sweep, decreasing speed
+} sweep_t;
+
+static portMUX_TYPE s_lock = portMUX_INITIALIZER_UNLOCKED;
+static fan_cal_model_t s_model;
+static fan_cal_progress_t s_progress = {.reason = ""};
+static uint32_t s_runs = 0; // sweeps started, a new one may start before the control loop saw the last one end
+static int s_abort_speed = -1; // manual speed that stopped the sweep, applied by the control loop
+static sweep_t s_sweep;
+
+/* pool adjacent violators: least squares non-decreasing fit of rpm over increasing speed */
+static void fit_monotone(fan_cal_point_t *points, int num_points)
+{
+    uint32_t sum[FAN_CAL_MAX_POINTS];
+    uint8_t count[FAN_CAL_MAX_POINTS];
+    int blocks = 0;
+    for (int i = 0; i < num_points; i++)
+    {
+        sum[blocks] = points[i].rpm;
+        count[blocks] = 1;
+        blocks++;
+        // merge while the mean of a block is above the mean of the next one
+        while (blocks > 1 && (uint64_t)sum[blocks - 2] * count[blocks - 1] > (uint64_t)sum[blocks - 1] * count[blocks - 2])
+        {
+            sum[blocks - 2] += sum[blocks - 1];
+            count[blocks - 2] += count[blocks - 1];
+            blocks--;
+        }
+    }
+    for (int b = 0, i = 0; b < blocks; b++)
+    {
+        uint16_t mean = (sum[b] + count[b] / 2) / count[b];
+        for (int k = 0; k < count[b]; k++)
+        {
+            points[i++].rpm = mean;
+        }
+    }
+}
+
+static esp_err_t save(const fan_cal_model_t *model)
+{
+    uint8_t blob[CAL_BLOB_HEADER + FAN_CAL_MAX_POINTS * CAL_BLOB_POINT] = {
+        CAL_BLOB_VERSION, model->min_start, model->min_run, model->num_points};
+    uint8_t *p = blob + CAL_BLOB_HEADER;
+    for (int i = 0; i < model->num_points; i++)
+    {
+        *p++ = model->points[i].speed;
+        *p++ = model->points[i].rpm & 0xff;
+        *p++ = model->points[i].rpm >> 8;
+    }
+    return write_blob(CAL_KEY, blob, p - blob);
+}
+
+esp_err_t fan_cal_load(void)
+{
+    uint8_t blob[CAL_BLOB_HEADER + FAN_CAL_MAX_POINTS * CAL_BLOB_POINT];
+    size_t length = sizeof(blob);
+    esp_err_t err = read_blob(CAL_KEY, blob, &length);
+    if (err != ESP_OK)
+    {
+        // never calibrated
+        return err == ESP_ERR_NVS_NOT_FOUND ? ESP_OK : err;
+    }
+    fan_cal_model_t model = {
+        .valid = true,
+        .min_start = blob[1],
+        .min_run = blob[2],
+        .num_points = blob[3]};
+    ESP_RETURN_ON_FALSE(length >= CAL_BLOB_HEADER && blob[0] == CAL_BLOB_VERSION && model.num_points >= 1 &&
+                            model.num_points <= FAN_CAL_MAX_POINTS && length == CAL_BLOB_HEADER + model.num_points * CAL_BLOB_POINT,
+                        ESP_ERR_INVALID_VERSION, TAG_CAL, "stored model not readable");
+    const uint8_t *p = blob + CAL_BLOB_HEADER;
+    for (int i = 0; i < model.num_points; i++, p += CAL_BLOB_POINT)
+    {
+        model.points[i].speed = p[0];
+        model.points[i].rpm = p[1] | p[2] << 8;
+        ESP_RETURN_ON_FALSE(i == 0 || (model.points[i].speed > model.points[i - 1].speed && model.points[i].rpm >= model.points[i - 1].rpm),
+                            ESP_ERR_INVALID_VERSION, TAG_CAL, "stored model not monotone");
+    }
+    portENTER_CRITICAL(&s_lock);
+    s_model = model;
+    portEXIT_CRITICAL(&s_lock);
+    ESP_LOGI(TAG_CAL, "loaded %u points, start %u%%, run %u%%", model.num_points, model.min_start, model.min_run);
+    return ESP_OK;
+}
+
+esp_err_t fan_cal_start(int step)
+{
+    ESP_RETURN_ON_FALSE(step >= FAN_CAL_MIN_STEP && step <= FAN_CAL_MAX_STEP, ESP_ERR_INVALID_ARG, TAG_CAL, "step %d", step);
+    esp_err_t err = ESP_OK;
+    portENTER_CRITICAL(&s_lock);
+    if (s_progress.state == FAN_CAL_RUNNING)
+    {
+        err = ESP_ERR_INVALID_STATE;
+    }
+    else
+    {
+        // the control loop picks it up at its next period
+        s_progress = (fan_cal_progress_t){.state = FAN_CAL_RUNNING, .step = step, .speed = 100, .reason = ""};
+        s_runs++;
+    }
+    portEXIT_CRITICAL(&s_lock);
+    return err;
+}
+
+static void finish(fan_cal_state_t state, const char *reason)
+{
+    portENTER_CRITICAL(&s_lock);
+    if (s_progress.state == FAN_CAL_RUNNING)
+    {
+        s_progress.state = state;
+        s_progress.reason = reason;
+    }
+    portEXIT_CRITICAL(&s_lock);
+}
+
+bool fan_cal_abort(int speed)
+{
+    portENTER_CRITICAL(&s_lock);
+    bool running = s_progress.state == FAN_CAL_RUNNING;
+    if (running)
+    {
+        s_progress.state = FAN_CAL_ABORTED;
+        s_progress.reason = "speed set manually";
+        s_abort_speed = speed;
+    }
+    portEXIT_CRITICAL(&s_lock);
+    return running;
+}
+
+bool fan_cal_running(void)
+{
+    portENTER_CRITICAL(&s_lock);
+    bool running = s_progress.state == FAN_CAL_RUNNING;
+    portEXIT_CRITICAL(&s_lock);
+    return running;
+}
+
+static void set_speed(int speed)
+{
+    s_sweep.speed = speed;
+    s_sweep.readings = 0;
+    s_sweep.zero_readings = 0;
+    s_sweep.steady_readings = 0;
+    s_sweep.window_pulses = rpm_get_pulses();
+    s_sweep.window_us = esp_timer_get_time();
+    set_fan_speed(speed);
+    portENTER_CRITICAL(&s_lock);
+    s_progress.speed = speed;
+    portEXIT_CRITICAL(&s_lock);
+}
+
+static void complete(void)
+{
+    fan_cal_model_t model = {
+        .valid = true,
+        .min_start = s_sweep.speed,
+        .min_run = s_sweep.min_run,
+        .num_points = s_sweep.num_points};
+    for (int i = 0; i < s_sweep.num_points; i++)
+    {
+        model.points[i] = s_sweep.points[s_sweep.num_points - 1 - i];
+    }
+    fit_monotone(model.points, model.num_points);
+    portENTER_CRITICAL(&s_lock);
+    s_model = model;
+    portEXIT_CRITICAL(&s_lock);
+    ESP_LOGI(TAG_CAL, "%u points, start %u%%, run %u%%, %u rpm at full speed", model.num_points, model.min_start, model.min_run,
+             model.points[model.num_points - 1].rpm);
+    save(&model);
+    finish(FAN_CAL_DONE, "");
+}
+
+/* one settled reading at the current speed, returns the next speed or -1 when the sweep ended */
+static int next_speed(uint32_t rpm, uint8_t step)
+{
+    switch (s_sweep.phase)
+    {
+    case PHASE_DOWN:
+        if (rpm > 0)
+        {
+            s_sweep.points[s_sweep.num_points++] = (fan_cal_point_t){.speed = s_sweep.speed, .rpm = rpm > UINT16_MAX ? UINT16_MAX : rpm};
+            s_sweep.min_run = s_sweep.speed;
+            if (s_sweep.speed == 0)
+            {
+                // turns without drive, nothing to start
+                complete();
+                return -1;
+            }
+            return s_sweep.speed > step ? s_sweep.speed - step : 0;
+        }
+        if (s_sweep.num_points == 0)
+        {
+            finish(FAN_CAL_FAILED, "no tach pulses at full speed");
+            return -1;
+        }
+        s_sweep.phase = PHASE_STOP;
+        return 0;
+    case PHASE_STOP:
+        s_sweep.phase = PHASE_UP;
+        return s_sweep.min_run;
+    case PHASE_UP:
+        if (rpm > 0)
+        {
+            complete();
+            return -1;
+        }
+        if (s_sweep.speed >= 100)
+        {
+            finish(FAN_CAL_FAILED, "fan does not start");
+            return -1;
+        }
+        return s_sweep.speed + step > 100 ? 100 : s_sweep.speed + step;
+    }
+    return -1;
+}
+
+bool fan_cal_update(void)
+{
+    portENTER_CRITICAL(&s_lock);
+    bool running = s_progress.state == FAN_CAL_RUNNING;
+    uint8_t step = s_progress.step;
+    uint32_t run = s_runs;
+    int abort_speed = s_abort_speed;
+    s_abort_speed = -1;
+    portEXIT_CRITICAL(&s_lock);
+
+    if (s_sweep.active && (!running || s_sweep.run != run))
+    {
+        // done, failed or aborted: whoever stopped the sweep owns the speed
+        s_sweep.active = false;
+        rpm_set_stall_check(true);
+    }
+    if (abort_speed >= 0)
+    {
+        // after any sweep step this task applied before it saw the abort
+        set_fan_speed(abort_speed);
+    }
+    if (!running)
+    {
+        return false;
+    }
+
+    device_state_t state;
+    device_state_get(&state);
+    int64_t now = esp_timer_get_time();
+    if (!s_sweep.active)
+    {
+        memset(&s_sweep, 0, sizeof(s_sweep));
+        s_sweep.active = true;
+        s_sweep.run = run;
+        // not the state speed, which is the forced one while the failsafe holds the fans
+        s_sweep.restore_speed = fan_get_setpoint();
+        s_sweep.start_us = now;
+        // the sweep stops the fan on purpose
+        rpm_set_stall_check(false);
+        ESP_LOGI(TAG_CAL, "sweep in steps of %u%%", step);
+        set_speed(100);
+        return true;
+    }
+    if (state.alarm)
+    {
+        // the failsafe holds the fans, the readings would not match the speed; it releases them to the
+        // operator's speed, not to a sweep step
+        set_fan_speed(s_sweep.restore_speed);
+        finish(FAN_CAL_ABORTED, "failsafe");
+        return true;
+    }
+
+    portENTER_CRITICAL(&s_lock);
+    s_progress.elapsed_ms = (now - s_sweep.start_us) / 1000;
+    portEXIT_CRITICAL(&s_lock);
+    int64_t window = now - s_sweep.window_us;
+    if (window < CONFIG_FCTL_FAN_CAL_WINDOW_MS * 1000)
+    {
+        return true;
+    }
+    uint32_t pulses = rpm_get_pulses();
+    uint32_t count = pulses - s_sweep.window_pulses;
+    uint32_t rpm = count < STOP_PULSES ? 0 : (uint64_t)count * 60000000 / ((uint64_t)window * RPM_PULSES_PER_REV);
+    uint32_t pulse_rpm = 60000000 / ((uint64_t)window * RPM_PULSES_PER_REV);
+    s_sweep.window_pulses = pulses;
+    s_sweep.window_us = now;
+    s_sweep.readings++;
+
+    uint32_t settled;
+    bool steady;
+    if (s_sweep.phase == PHASE_STOP)
+    {
+        s_sweep.zero_readings = count == 0 ? s_sweep.zero_readings + 1 : 0;
+        steady = s_sweep.zero_readings >= STOP_READINGS;
+        if (!steady && s_sweep.readings >= STOP_MAX_READINGS)
+        {
+            finish(FAN_CAL_FAILED, "fan does not stop");
+            set_fan_speed(s_sweep.restore_speed);
+            return true;
+        }
+        settled = 0;
+    }
+    else
+    {
+        uint32_t diff = rpm > s_sweep.last_rpm ? rpm - s_sweep.last_rpm : s_sweep.last_rpm - rpm;
+        uint32_t tolerance = s_sweep.last_rpm * SETTLE_PERCENT / 100;
+        tolerance = tolerance > 2 * pulse_rpm ? tolerance : 2 * pulse_rpm;
+        // at low speeds the tolerance of two pulses lets one pair of readings of a fan still coasting match
+        s_sweep.steady_readings = s_sweep.readings >= 2 && diff <= tolerance ? s_sweep.steady_readings + 1 : 0;
+        steady = s_sweep.steady_readings >= SETTLE_READINGS || s_sweep.readings >= SETTLE_MAX_READINGS;
+        settled = rpm == 0 ? 0 : (rpm + s_sweep.last_rpm) / 2;
+        s_sweep.last_rpm = rpm;
+    }
+    if (!steady)
+    {
+        return true;
+    }
+
+    ESP_LOGD(TAG_CAL, "%u%%: %u rpm", s_sweep.speed, (unsigned)settled);
+    int speed = next_speed(settled, step);
+    if (speed < 0)
+    {
+        set_fan_speed(s_sweep.restore_speed);
+        return true;
+    }
+    set_speed(speed);
+    return true;
+}
+
+void fan_cal_get(fan_cal_model_t *model, fan_cal_progress_t *progress)
+{
+    portENTER_CRITICAL(&s_lock);
+    *model = s_model;
+    *progress = s_progress;
+    portEXIT_CRITICAL(&s_lock);
+}
+
+int fan_cal_speed_for_rpm(uint32_t rpm)
+{
+    fan_cal_model_t model;
+    portENTER_CRITICAL(&s_lock);
+    model = s_model;
+    portEXIT_CRITICAL(&s_lock);
+    if (!model.valid)
+    {
+        return -1;
+    }
+    const fan_cal_point_t *points = model.points;
+    int last = model.num_points - 1;
+    if (rpm == 0)
+    {
+        return 0;
+    }
+    int speed;
+    if (rpm <= points[0].rpm)
+    {
+        speed = points[0].speed;
+    }
+    else if (rpm >= points[last].rpm)
+    {
+        speed = points[last].speed;
+    }
+    else
+    {
+        // first segment ending above `rpm`, flat segments are skipped
+        int k = 0;
+        while (points[k + 1].rpm <= rpm)
+        {
+            k++;
+        }
+        uint32_t num = (uint32_t)(points[k + 1].speed - points[k].speed) * (rpm - points[k].rpm);
+        uint32_t den = points[k + 1].rpm - points[k].rpm;
+        speed = points[k].speed + (num + den - 1) / den;
+    }
+
+    // the points were measured on a turning fan, a stopped one needs the start speed to get going
+    device_state_t state;
+    device_state_get(&state);
+    if ((state.rpm == 0 || state.stalled) && speed < model.min_start)
+    {
+        speed = model.min_start;
+    }
+    return speed;
+}
+
+uint32_t fan_cal_rpm_at(int speed)
+{
+    fan_cal_model_t model;
+    portENTER_CRITICAL(&s_lock);
+    model = s_model;
+    portEXIT_CRITICAL(&s_lock);
+    if (!model.valid || speed < model.points[0].speed)
+    {
+        return 0;
+    }
+    const fan_cal_point_t *points = model.points;
+    int k = 0;
+    while (k < model.num_points - 1 && speed >= points[k + 1].speed)
+    {
+        k++;
+    }
+    if (k == model.num_points - 1)
+    {
+        return points[k].rpm;
+    }
+    uint32_t num = (uint32_t)(points[k + 1].rpm - points[k].rpm) * (speed - points[k].speed);
+    uint32_t den = points[k + 1].speed - points[k].speed;
+    return points[k].rpm + (num + den / 2) / den;
+}
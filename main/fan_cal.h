@@ -0,0 +1,113 @@
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "esp_err.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define FAN_CAL_MIN_STEP 5
+#define FAN_CAL_MAX_STEP 50
+#define FAN_CAL_MAX_POINTS (100 / FAN_CAL_MIN_STEP + 1)
+
+/**
+ * @brief Steady-state speed of the fan at one commanded speed
+ */
+typedef struct {
+    uint8_t speed; /*!< Commanded speed, in percent */
+    uint16_t rpm;  /*!< Measured speed */
+} fan_cal_point_t;
+
+/**
+ * @brief Speed to RPM model of the fan, from a calibration sweep
+ */
+typedef struct {
+    bool valid;        /*!< A calibration completed */
+    uint8_t min_start; /*!< Lowest speed starting the fan from standstill */
+    uint8_t min_run;   /*!< Lowest speed keeping it turning */
+    uint8_t num_points;
+    fan_cal_point_t points[FAN_CAL_MAX_POINTS]; /*!< From min_run up, strictly increasing speed, non-decreasing rpm */
+} fan_cal_model_t;
+
+/**
+ * @brief State of the calibration sweep
+ */
+typedef enum {
+    FAN_CAL_IDLE,
+    FAN_CAL_RUNNING,
+    FAN_CAL_DONE,
+    FAN_CAL_FAILED,
+    FAN_CAL_ABORTED,
+} fan_cal_state_t;
+
+/**
+ * @brief Progress of the last calibration sweep
+ */
+typedef struct {
+    fan_cal_state_t state;
+    uint8_t step;        /*!< Speed step of the sweep, in percent */
+    uint8_t speed;       /*!< Speed being measured */
+    uint32_t elapsed_ms; /*!< Since the sweep started */
+    const char *reason;  /*!< Why the sweep failed or was aborted */
+} fan_cal_progress_t;
+
+/**
+ * @brief Load the model stored in NVS
+ */
+esp_err_t fan_cal_load(void);
+
+/**
+ * @brief Start a sweep in steps of `step` percent, run by the control loop
+ *
+ * The sweep goes down from full speed until the fan stops, then up until it starts again.
+ * Each step waits for two tach readings of CONFIG_FCTL_FAN_CAL_WINDOW_MS in a row to agree with the previous one.
+ *
+ * @return ESP_ERR_INVALID_STATE while a sweep runs, ESP_ERR_INVALID_ARG for a step out of range
+ */
+esp_err_t fan_cal_start(int step);
+
+/**
+ * @brief Stop the sweep, when the speed is set manually
+ *
+ * The control loop applies `speed` at its next period, after any sweep step it was applying.
+ *
+ * @return true if a sweep was stopped, false if none runs and the caller sets the speed itself
+ */
+bool fan_cal_abort(int speed);
+
+/**
+ * @brief Whether a sweep drives the fan
+ */
+bool fan_cal_running(void);
+
+/**
+ * @brief Advance the sweep, called from the control loop
+ *
+ * @return true while the sweep drives the fan
+ */
+bool fan_cal_update(void);
+
+/**
+ * @brief Get the model and the progress of the last sweep
+ */
+void fan_cal_get(fan_cal_model_t *model, fan_cal_progress_t *progress);
+
+/**
+ * @brief Lowest speed expected to turn the fan at `rpm`, interpolated in the model
+ *
+ * While the fan stands still or is stalled, at least the minimum start speed.
+ *
+ * @return -1 without a model
+ */
+int fan_cal_speed_for_rpm(uint32_t rpm);
+
+/**
+ * @brief Expected rpm at `speed`, 0 below the minimum run speed or without a model
+ */
+uint32_t fan_cal_rpm_at(int speed);
+
+#ifdef __cplusplus
+}
+#endif
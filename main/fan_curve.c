@@ -0,0 +1,218 @@
+#include <string.h>
+#include "sdkconfig.h"
+#include "freertos/FreeRTOS.h"
+#include "esp_check.h"
+#include "esp_log.h"
+#include "sensor.h"
+#include "fan_curve.h"
+
+#define CURVE_KEY "fan_curve"
+#define CURVE_BLOB_VERSION 1
+#define CURVE_BLOB_HEADER 5 // version, enabled, sensor, hysteresis, number of points
+#define CURVE_BLOB_POINT 3  // temperature (little endian), speed
+#define CURVE_TEMP_MIN (-400)
+#define CURVE_TEMP_MAX 1500
+
+static const char *TAG_CURVE = "FAN_CURVE";
+
+void set_fan_speed(int speed);
+int fan_get_setpoint(void);
+esp_err_t read_blob(char *key, void *value, size_t *length);
+esp_err_t write_blob(char *key, const void *value, size_t length);
+
+/* curve and its table: lut[i] is the speed at base + i degrees */
+typedef struct
+{
+    fan_curve_t curve;
+    int16_t base;
+    uint8_t lut_len;
+    uint8_t lut[FAN_CURVE_LUT_SIZE];
+} compiled_curve_t;
+
+static portMUX_TYPE s_lock = portMUX_INITIALIZER_UNLOCKED;
+static compiled_curve_t s_compiled;
+
+static int32_t floor_div10(int32_t value)
+{
+    return value >= 0 ? value / 10 : -((-value + 9) / 10);
+}
+
+static esp_err_t validate(const fan_curve_t *curve)
+{
+    ESP_RETURN_ON_FALSE(curve->sensor < SENSOR_MAX, ESP_ERR_INVALID_ARG, TAG_CURVE, "unknown sensor %u", curve->sensor);
+    ESP_RETURN_ON_FALSE(curve->num_points >= 1 && curve->num_points <= FAN_CURVE_MAX_POINTS, ESP_ERR_INVALID_ARG, TAG_CURVE,
+                        "%u points", curve->num_points);
+    for (int i = 0; i < curve->num_points; i++)
+    {
+        const fan_curve_point_t *point = &curve->points[i];
+        ESP_RETURN_ON_FALSE(point->speed <= 100 && point->temp >= CURVE_TEMP_MIN && point->temp <= CURVE_TEMP_MAX,
+                            ESP_ERR_INVALID_ARG, TAG_CURVE, "point %d out of range", i);
+        ESP_RETURN_ON_FALSE(i == 0 || point->temp > curve->points[i - 1].temp, ESP_ERR_INVALID_ARG, TAG_CURVE,
+                            "point %d not above the previous one", i);
+    }
+    int32_t span = floor_div10(curve->points[curve->num_points - 1].temp + 9) - floor_div10(curve->points[0].temp);
+    ESP_RETURN_ON_FALSE(span < FAN_CURVE_LUT_SIZE, ESP_ERR_INVALID_ARG, TAG_CURVE, "curve spans %d degrees", (int)span);
+    return ESP_OK;
+}
+
+/* linear interpolation between the breakpoints around `temp`, rounded */
+static uint8_t interpolate(const fan_curve_t *curve, int32_t temp)
+{
+    const fan_curve_point_t *points = curve->points;
+    int last = curve->num_points - 1;
+    if (temp <= points[0].temp)
+    {
+        return points[0].speed;
+    }
+    if (temp >= points[last].temp)
+    {
+        return points[last].speed;
+    }
+    int k = 0;
+    while (temp >= points[k + 1].temp)
+    {
+        k++;
+    }
+    int32_t num = (int32_t)(points[k + 1].speed - points[k].speed) * (temp - points[k].temp);
+    int32_t den = points[k + 1].temp - points[k].temp;
+    return points[k].speed + (num >= 0 ? (num + den / 2) / den : (num - den / 2) / den);
+}
+
+static void compile(const fan_curve_t *curve, compiled_curve_t *compiled)
+{
+    compiled->curve = *curve;
+    compiled->base = floor_div10(curve->points[0].temp);
+    compiled->lut_len = floor_div10(curve->points[curve->num_points - 1].temp + 9) - compiled->base + 1;
+    for (int i = 0; i < compiled->lut_len; i++)
+    {
+        compiled->lut[i] = interpolate(curve, (compiled->base + i) * 10);
+    }
+}
+
+static uint8_t lookup(const compiled_curve_t *compiled, int32_t temp)
+{
+    int32_t i = floor_div10(temp) - compiled->base;
+    i = i < 0 ? 0 : (i >= compiled->lut_len ? compiled->lut_len - 1 : i);
+    return compiled->lut[i];
+}
+
+static esp_err_t save(const fan_curve_t *curve)
+{
+    uint8_t blob[CURVE_BLOB_HEADER + FAN_CURVE_MAX_POINTS * CURVE_BLOB_POINT] = {
+        CURVE_BLOB_VERSION, curve->enabled, curve->sensor, curve->hysteresis, curve->num_points};
+    uint8_t *p = blob + CURVE_BLOB_HEADER;
+    for (int i = 0; i < curve->num_points; i++)
+    {
+        *p++ = (uint16_t)curve->points[i].temp & 0xff;
+        *p++ = (uint16_t)curve->points[i].temp >> 8;
+        *p++ = curve->points[i].speed;
+    }
+    return write_blob(CURVE_KEY, blob, p - blob);
+}
+
+esp_err_t fan_curve_load(void)
+{
+    uint8_t blob[CURVE_BLOB_HEADER + FAN_CURVE_MAX_POINTS * CURVE_BLOB_POINT];
+    size_t length = sizeof(blob);
+    esp_err_t err = read_blob(CURVE_KEY, blob, &length);
+    if (err != ESP_OK)
+    {
+        // no curve yet, the fan stays manual
+        return err == ESP_ERR_NVS_NOT_FOUND ? ESP_OK : err;
+    }
+    fan_curve_t curve = {
+        .enabled = blob[1],
+        .sensor = blob[2],
+        .hysteresis = blob[3],
+        .num_points = blob[4]};
+    ESP_RETURN_ON_FALSE(length >= CURVE_BLOB_HEADER && blob[0] == CURVE_BLOB_VERSION && curve.num_points <= FAN_CURVE_MAX_POINTS &&
+                            length == CURVE_BLOB_HEADER + curve.num_points * CURVE_BLOB_POINT,
+                        ESP_ERR_INVALID_VERSION, TAG_CURVE, "stored curve not readable");
+    const uint8_t *p = blob + CURVE_BLOB_HEADER;
+    for (int i = 0; i < curve.num_points; i++, p += CURVE_BLOB_POINT)
+    {
+        curve.points[i].temp = (int16_t)(p[0] | p[1] << 8);
+        curve.points[i].speed = p[2];
+    }
+    ESP_RETURN_ON_ERROR(validate(&curve), TAG_CURVE, "stored curve invalid");
+
+    compiled_curve_t compiled;
+    compile(&curve, &compiled);
+    portENTER_CRITICAL(&s_lock);
+    s_compiled = compiled;
+    portEXIT_CRITICAL(&s_lock);
+    ESP_LOGI(TAG_CURVE, "loaded %u points on sensor %u, %s", curve.num_points, curve.sensor, curve.enabled ? "enabled" : "disabled");
+    return ESP_OK;
+}
+
+esp_err_t fan_curve_set(const fan_curve_t *curve)
+{
+    ESP_RETURN_ON_ERROR(validate(curve), TAG_CURVE, "invalid curve");
+    compiled_curve_t compiled;
+    compile(curve, &compiled);
+    portENTER_CRITICAL(&s_lock);
+    s_compiled = compiled;
+    portEXIT_CRITICAL(&s_lock);
+    return save(curve);
+}
+
+void fan_curve_get(fan_curve_t *curve)
+{
+    portENTER_CRITICAL(&s_lock);
+    *curve = s_compiled.curve;
+    portEXIT_CRITICAL(&s_lock);
+}
+
+void fan_curve_disable(void)
+{
+    fan_curve_t curve;
+    portENTER_CRITICAL(&s_lock);
+    bool was_enabled = s_compiled.curve.enabled;
+    s_compiled.curve.enabled = false;
+    curve = s_compiled.curve;
+    portEXIT_CRITICAL(&s_lock);
+    if (was_enabled)
+    {
+        save(&curve);
+    }
+}
+
+bool fan_curve_enabled(void)
+{
+    portENTER_CRITICAL(&s_lock);
+    bool enabled = s_compiled.curve.enabled;
+    portEXIT_CRITICAL(&s_lock);
+    return enabled;
+}
+
+void fan_curve_update(void)
+{
+    compiled_curve_t compiled;
+    portENTER_CRITICAL(&s_lock);
+    bool enabled = s_compiled.curve.enabled;
+    if (enabled)
+    {
+        compiled = s_compiled;
+    }
+    portEXIT_CRITICAL(&s_lock);
+    sensor_reading_t reading;
+    // without a fresh reading the speed is held
+    if (!enabled || sensor_get(compiled.curve.sensor, &reading) != ESP_OK)
+    {
+        return;
+    }
+
+    // the setpoint, not the output: a failsafe floor must not read as the curve's own speed
+    int speed = fan_get_setpoint();
+    int target = lookup(&compiled, reading.temp);
+    if (target < speed)
+    {
+        // slow down only once the temperature fell by the hysteresis
+        int relaxed = lookup(&compiled, reading.temp + compiled.curve.hysteresis);
+        target = relaxed < speed ? relaxed : speed;
+    }
+    if (target != speed)
+    {
+        set_fan_speed(target);
+    }
+}
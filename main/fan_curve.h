@@ -0,0 +1,68 @@
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "sdkconfig.h"
+#include "esp_err.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define FAN_CURVE_MAX_POINTS CONFIG_FCTL_CURVE_MAX_POINTS
+#define FAN_CURVE_LUT_SIZE 128 // one entry per degree, the curve spans at most this many degrees
+
+/**
+ * @brief One breakpoint of a curve
+ */
+typedef struct {
+    int16_t temp;  /*!< Temperature, in 0.1 degree Celsius */
+    uint8_t speed; /*!< Fan speed at this temperature, in percent */
+} fan_curve_point_t;
+
+/**
+ * @brief Speed as a function of a temperature input
+ */
+typedef struct {
+    bool enabled;       /*!< The curve drives the fan, manual speeds disable it */
+    uint8_t sensor;     /*!< Temperature input, see sensor.h */
+    uint8_t hysteresis; /*!< Drop below the temperature of the current speed before slowing down, in 0.1 degree Celsius */
+    uint8_t num_points;
+    fan_curve_point_t points[FAN_CURVE_MAX_POINTS]; /*!< Sorted by strictly increasing temperature */
+} fan_curve_t;
+
+/**
+ * @brief Load the curve stored in NVS
+ */
+esp_err_t fan_curve_load(void);
+
+/**
+ * @brief Validate, compile and store a curve
+ *
+ * @return ESP_ERR_INVALID_ARG when the points are not sorted, out of range, or span more than FAN_CURVE_LUT_SIZE degrees
+ */
+esp_err_t fan_curve_set(const fan_curve_t *curve);
+
+/**
+ * @brief Get the current curve
+ */
+void fan_curve_get(fan_curve_t *curve);
+
+/**
+ * @brief Stop driving the fan from the curve, when the speed is set manually
+ */
+void fan_curve_disable(void);
+
+/**
+ * @brief Whether the curve drives the fan
+ */
+bool fan_curve_enabled(void);
+
+/**
+ * @brief Apply the curve to the latest temperature, called from the control loop
+ */
+void fan_curve_update(void);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,404 @@
+#include <string.h>
+#include <stdlib.h>
+#include <strings.h>
+#include "sdkconfig.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "esp_check.h"
+#include "esp_log.h"
+#include "fleet.h"
+
+#if CONFIG_FCTL_FLEET
+#include <stdio.h>
+#include "freertos/queue.h"
+#include "freertos/semphr.h"
+#include "esp_timer.h"
+#include "esp_netif.h"
+#include "esp_http_client.h"
+#include "mdns.h"
+#include "cJSON.h"
+#include "task_plan.h"
+#include "advertise.h"
+
+#define FLEET_TASK_STACK 4096
+#define FLEET_FETCH_STACK 6144
+#define FLEET_EXPIRE_ROUNDS 3  // browses in a row a peer may be missing from
+#define FLEET_RESPONSE_MAX 512 // body of GET /api/state
+#define FLEET_RESOLVE_MS 500   // A query for a peer announced without address
+
+static const char *TAG_FLEET = "FLEET";
+
+typedef struct {
+    bool used;
+    uint8_t missed; // browses in a row without the peer
+    fleet_peer_t peer;
+} fleet_entry_t;
+
+static SemaphoreHandle_t s_lock = NULL; // entries and status
+static fleet_entry_t s_entries[CONFIG_FCTL_FLEET_MAX_PEERS];
+static fleet_status_t s_status = {.enabled = true, .max_peers = CONFIG_FCTL_FLEET_MAX_PEERS};
+static TaskHandle_t s_task = NULL;
+static QueueHandle_t s_jobs = NULL; // entry indexes to fetch
+static QueueHandle_t s_done = NULL; // one item per finished fetch
+
+/* called with s_lock held */
+static fleet_entry_t *find_entry(const char *instance, bool add)
+{
+    fleet_entry_t *free_entry = NULL;
+    for (int i = 0; i < CONFIG_FCTL_FLEET_MAX_PEERS; i++)
+    {
+        fleet_entry_t *entry = &s_entries[i];
+        if (entry->used && !strcasecmp(entry->peer.instance, instance))
+        {
+            return entry;
+        }
+        free_entry = !entry->used && !free_entry ? entry : free_entry;
+    }
+    if (!add || !free_entry)
+    {
+        return NULL;
+    }
+    memset(free_entry, 0, sizeof(*free_entry));
+    free_entry->used = true;
+    strlcpy(free_entry->peer.instance, instance, sizeof(free_entry->peer.instance));
+    return free_entry;
+}
+
+static bool is_own_address(uint32_t ip)
+{
+    static const char *const ifkeys[] = {"WIFI_STA_DEF", "WIFI_AP_DEF"};
+    for (int i = 0; i < sizeof(ifkeys) / sizeof(ifkeys[0]); i++)
+    {
+        esp_netif_ip_info_t info;
+        esp_netif_t *netif = esp_netif_get_handle_from_ifkey(ifkeys[i]);
+        if (netif && esp_netif_get_ip_info(netif, &info) == ESP_OK && info.ip.addr == ip)
+        {
+            return true;
+        }
+    }
+    return false;
+}
+
+/* called with s_lock held, the TXT records fill in until the first successful fetch */
+static void update_from_result(fleet_peer_t *peer, const mdns_result_t *result, int64_t now)
+{
+    peer->seen_us = now;
+    peer->port = result->port ? result->port : peer->port;
+    if (result->hostname)
+    {
+        strlcpy(peer->host, result->hostname, sizeof(peer->host));
+    }
+    for (const mdns_ip_addr_t *addr = result->addr; addr; addr = addr->next)
+    {
+        if (addr->addr.type == ESP_IPADDR_TYPE_V4)
+        {
+            peer->ip = addr->addr.u_addr.ip4.addr;
+            break;
+        }
+    }
+    for (size_t i = 0; i < result->txt_count; i++)
+    {
+        const mdns_txt_item_t *item = &result->txt[i];
+        if (!item->value)
+        {
+            continue;
+        }
+        if (!strcmp(item->key, "version"))
+        {
+            strlcpy(peer->version, item->value, sizeof(peer->version));
+        }
+        else if (peer->fetched_us)
+        {
+            continue;
+        }
+        else if (!strcmp(item->key, "name"))
+        {
+            strlcpy(peer->name, item->value, sizeof(peer->name));
+        }
+        else if (!strcmp(item->key, "speed"))
+        {
+            peer->speed = atoi(item->value);
+        }
+        else if (!strcmp(item->key, "rpm"))
+        {
+            peer->rpm = atoi(item->value);
+        }
+    }
+}
+
+static void browse(void)
+{
+    mdns_search_once_t *search = mdns_query_async_new(NULL, ADVERTISE_SERVICE, ADVERTISE_PROTO, MDNS_TYPE_PTR,
+                                                      CONFIG_FCTL_FLEET_BROWSE_MS, CONFIG_FCTL_FLEET_MAX_PEERS, NULL);
+    if (!search)
+    {
+        ESP_LOGW(TAG_FLEET, "browse failed");
+        return;
+    }
+    mdns_result_t *results = NULL;
+    // the search ends after CONFIG_FCTL_FLEET_BROWSE_MS, or once enough peers answered
+    while (!mdns_query_async_get_results(search, CONFIG_FCTL_FLEET_BROWSE_MS, &results, NULL))
+    {
+    }
+    mdns_query_async_delete(search);
+
+    int64_t now = esp_timer_get_time();
+    xSemaphoreTake(s_lock, portMAX_DELAY);
+    for (int i = 0; i < CONFIG_FCTL_FLEET_MAX_PEERS; i++)
+    {
+        s_entries[i].missed++;
+    }
+    for (const mdns_result_t *result = results; result; result = result->next)
+    {
+        // found once per interface and address family
+        if (!result->instance_name)
+        {
+            continue;
+        }
+        fleet_entry_t *entry = find_entry(result->instance_name, true);
+        if (!entry)
+        {
+            s_status.dropped++;
+            continue;
+        }
+        entry->missed = 0;
+        update_from_result(&entry->peer, result, now);
+        if (entry->peer.ip && is_own_address(entry->peer.ip))
+        {
+            entry->used = false;
+        }
+    }
+    for (int i = 0; i < CONFIG_FCTL_FLEET_MAX_PEERS; i++)
+    {
+        if (s_entries[i].used && s_entries[i].missed >= FLEET_EXPIRE_ROUNDS)
+        {
+            ESP_LOGI(TAG_FLEET, "%s gone", s_entries[i].peer.instance);
+            s_entries[i].used = false;
+        }
+    }
+    xSemaphoreGive(s_lock);
+    mdns_query_results_free(results);
+}
+
+static void parse_state(fleet_peer_t *peer, const char *body)
+{
+    cJSON *root = cJSON_Parse(body);
+    cJSON *speed = cJSON_GetObjectItem(root, "speed");
+    cJSON *rpm = cJSON_GetObjectItem(root, "rpm");
+    cJSON *name = cJSON_GetObjectItem(root, "name");
+    if (!cJSON_IsNumber(speed) || !cJSON_IsNumber(rpm))
+    {
+        peer->status = FLEET_PEER_BAD_RESPONSE;
+        cJSON_Delete(root);
+        return;
+    }
+    peer->speed = speed->valueint;
+    peer->rpm = rpm->valueint;
+    peer->stalled = cJSON_IsTrue(cJSON_GetObjectItem(root, "stalled"));
+    peer->alarm = cJSON_IsTrue(cJSON_GetObjectItem(root, "alarm"));
+    if (cJSON_IsString(name))
+    {
+        strlcpy(peer->name, name->valuestring, sizeof(peer->name));
+    }
+    peer->status = FLEET_PEER_OK;
+    peer->fetched_us = esp_timer_get_time();
+    cJSON_Delete(root);
+}
+
+/* GET /api/state from `peer`, runs on a fetch task without s_lock */
+static void fetch(fleet_peer_t *peer)
+{
+    int64_t start = esp_timer_get_time();
+    if (!peer->ip)
+    {
+        esp_ip4_addr_t addr;
+        if (!peer->host[0] || mdns_query_a(peer->host, FLEET_RESOLVE_MS, &addr) != ESP_OK)
+        {
+            peer->status = FLEET_PEER_NO_ADDRESS;
+            return;
+        }
+        peer->ip = addr.addr;
+    }
+
+    char url[48];
+    esp_ip4_addr_t ip = {.addr = peer->ip};
+    snprintf(url, sizeof(url), "http://" IPSTR ":%u/api/state", IP2STR(&ip), peer->port);
+    esp_http_client_config_t config = {
+        .url = url,
+        .timeout_ms = CONFIG_FCTL_FLEET_TIMEOUT_MS,
+    };
+    char body[FLEET_RESPONSE_MAX];
+    int len = -1;
+    peer->http_status = 0;
+    esp_http_client_handle_t client = esp_http_client_init(&config);
+    if (client && esp_http_client_open(client, 0) == ESP_OK && esp_http_client_fetch_headers(client) >= 0)
+    {
+        peer->http_status = esp_http_client_get_status_code(client);
+        len = esp_http_client_read_response(client, body, sizeof(body) - 1);
+    }
+    if (client)
+    {
+        esp_http_client_close(client);
+        esp_http_client_cleanup(client);
+    }
+    peer->latency_ms = (uint32_t)((esp_timer_get_time() - start) / 1000);
+
+    if (!peer->http_status)
+    {
+        // the client reports both the same way, only the time tells them apart
+        peer->status = peer->latency_ms >= CONFIG_FCTL_FLEET_TIMEOUT_MS ? FLEET_PEER_TIMEOUT : FLEET_PEER_UNREACHABLE;
+        return;
+    }
+    if (peer->http_status != 200 || len <= 0)
+    {
+        peer->status = FLEET_PEER_BAD_RESPONSE;
+        return;
+    }
+    body[len] = '\0';
+    parse_state(peer, body);
+}
+
+static void fetch_task(void *arg)
+{
+    uint8_t index;
+    for (;;)
+    {
+        xQueueReceive(s_jobs, &index, portMAX_DELAY);
+        xSemaphoreTake(s_lock, portMAX_DELAY);
+        fleet_peer_t peer = s_entries[index].peer;
+        xSemaphoreGive(s_lock);
+
+        fetch(&peer);
+        // entries only go away between rounds, this one is still the peer fetched
+        xSemaphoreTake(s_lock, portMAX_DELAY);
+        s_entries[index].peer = peer;
+        xSemaphoreGive(s_lock);
+        xQueueSend(s_done, &index, portMAX_DELAY);
+    }
+}
+
+static void run_round(void)
+{
+    int64_t start = esp_timer_get_time();
+    browse();
+    int64_t browsed = esp_timer_get_time();
+
+    int jobs = 0;
+    xSemaphoreTake(s_lock, portMAX_DELAY);
+    for (uint8_t i = 0; i < CONFIG_FCTL_FLEET_MAX_PEERS; i++)
+    {
+        // peers missing from this browse keep their last state
+        if (s_entries[i].used && !s_entries[i].missed)
+        {
+            xQueueSend(s_jobs, &i, 0);
+            jobs++;
+        }
+    }
+    xSemaphoreGive(s_lock);
+    for (uint8_t index; jobs > 0; jobs--)
+    {
+        xQueueReceive(s_done, &index, portMAX_DELAY);
+    }
+
+    int64_t now = esp_timer_get_time();
+    xSemaphoreTake(s_lock, portMAX_DELAY);
+    s_status.rounds++;
+    s_status.updated_us = now;
+    s_status.browse_ms = (uint32_t)((browsed - start) / 1000);
+    s_status.round_ms = (uint32_t)((now - start) / 1000);
+    xSemaphoreGive(s_lock);
+}
+
+static void fleet_task(void *arg)
+{
+    for (;;)
+    {
+        run_round();
+        ulTaskNotifyTake(pdTRUE, pdMS_TO_TICKS(CONFIG_FCTL_FLEET_PERIOD_S * 1000));
+    }
+}
+
+esp_err_t fleet_start(void)
+{
+    s_lock = xSemaphoreCreateMutex();
+    s_jobs = xQueueCreate(CONFIG_FCTL_FLEET_MAX_PEERS, sizeof(uint8_t));
+    s_done = xQueueCreate(CONFIG_FCTL_FLEET_MAX_PEERS, sizeof(uint8_t));
+    ESP_RETURN_ON_FALSE(s_lock && s_jobs && s_done, ESP_ERR_NO_MEM, TAG_FLEET, "no memory");
+    for (int i = 0; i < CONFIG_FCTL_FLEET_FETCHERS; i++)
+    {
+        ESP_RETURN_ON_ERROR(task_plan_create(fetch_task, "fleet_fetch", FLEET_FETCH_STACK, NULL, TASK_ROLE_NETWORK, NULL), TAG_FLEET,
+                            "create fetch task failed");
+    }
+    return task_plan_create(fleet_task, "fleet", FLEET_TASK_STACK, NULL, TASK_ROLE_NETWORK, &s_task);
+}
+
+esp_err_t fleet_refresh(void)
+{
+    ESP_RETURN_ON_FALSE(s_task, ESP_ERR_INVALID_STATE, TAG_FLEET, "not running");
+    xTaskNotifyGive(s_task);
+    return ESP_OK;
+}
+
+static int compare_instance(const void *a, const void *b)
+{
+    return strcasecmp(((const fleet_peer_t *)a)->instance, ((const fleet_peer_t *)b)->instance);
+}
+
+size_t fleet_get(fleet_status_t *status, fleet_peer_t *peers, size_t max)
+{
+    size_t n = 0;
+    if (!s_lock)
+    {
+        *status = s_status;
+        return 0;
+    }
+    xSemaphoreTake(s_lock, portMAX_DELAY);
+    *status = s_status;
+    for (int i = 0; i < CONFIG_FCTL_FLEET_MAX_PEERS && n < max; i++)
+    {
+        if (s_entries[i].used)
+        {
+            peers[n++] = s_entries[i].peer;
+        }
+    }
+    xSemaphoreGive(s_lock);
+    qsort(peers, n, sizeof(*peers), compare_instance);
+    return n;
+}
+
+#else
+esp_err_t fleet_start(void)
+{
+    return ESP_OK;
+}
+
+esp_err_t fleet_refresh(void)
+{
+    return ESP_ERR_INVALID_STATE;
+}
+
+size_t fleet_get(fleet_status_t *status, fleet_peer_t *peers, size_t max)
+{
+    memset(status, 0, sizeof(*status));
+    return 0;
+}
+#endif
+
+const char *fleet_peer_status_name(fleet_peer_status_t status)
+{
+    switch (status)
+    {
+    case FLEET_PEER_OK:
+        return "ok";
+    case FLEET_PEER_NO_ADDRESS:
+        return "no_address";
+    case FLEET_PEER_UNREACHABLE:
+        return "unreachable";
+    case FLEET_PEER_TIMEOUT:
+        return "timeout";
+    case FLEET_PEER_BAD_RESPONSE:
+        return "bad_response";
+    default:
+        return "pending";
+    }
+}
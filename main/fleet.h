@@ -0,0 +1,93 @@
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include "esp_err.h"
+#include "device_state.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define FLEET_NAME_LEN 64
+
+/**
+ * @brief Outcome of the last state fetch from a peer
+ */
+typedef enum {
+    FLEET_PEER_PENDING,      /*!< Not fetched yet */
+    FLEET_PEER_OK,
+    FLEET_PEER_NO_ADDRESS,   /*!< The browse gave no IPv4 address and the A query failed */
+    FLEET_PEER_UNREACHABLE,  /*!< The connection failed */
+    FLEET_PEER_TIMEOUT,      /*!< No answer within CONFIG_FCTL_FLEET_TIMEOUT_MS */
+    FLEET_PEER_BAD_RESPONSE, /*!< Not a 200 with the JSON of GET /api/state */
+} fleet_peer_status_t;
+
+/**
+ * @brief A peer controller found by browsing _fctl._tcp
+ */
+typedef struct {
+    char instance[FLEET_NAME_LEN];  /*!< mDNS service instance name */
+    char host[FLEET_NAME_LEN];      /*!< mDNS host name, without .local */
+    uint32_t ip;                    /*!< IPv4 address, in network order */
+    uint16_t port;
+    char version[32];               /*!< Firmware version, from the TXT records */
+    char name[DEVICE_NAME_MAX_LEN]; /*!< From the last successful fetch, or the TXT records */
+    int32_t speed;
+    int32_t rpm;
+    bool stalled;
+    bool alarm;
+    fleet_peer_status_t status;
+    int http_status;     /*!< Of the last fetch, 0 without a response */
+    uint32_t latency_ms; /*!< Of the last fetch */
+    int64_t seen_us;     /*!< Last browse that found the peer */
+    int64_t fetched_us;  /*!< Last successful fetch, 0 if none */
+} fleet_peer_t;
+
+/**
+ * @brief State of the aggregator
+ */
+typedef struct {
+    bool enabled;       /*!< CONFIG_FCTL_FLEET */
+    size_t max_peers;   /*!< Peers tracked at most */
+    uint32_t rounds;    /*!< Browse and fetch rounds completed */
+    int64_t updated_us; /*!< End of the last round */
+    uint32_t browse_ms; /*!< Duration of the browse of the last round */
+    uint32_t round_ms;  /*!< Duration of the last round */
+    uint32_t dropped;   /*!< Peers ignored because max_peers were tracked */
+} fleet_status_t;
+
+/**
+ * @brief Start browsing peers every CONFIG_FCTL_FLEET_PERIOD_S, after mDNS
+ *
+ * Each round browses _fctl._tcp, then fetches GET /api/state from every peer found with at
+ * most CONFIG_FCTL_FLEET_FETCHERS requests in flight. Peers missing from three browses in a
+ * row are forgotten.
+ *
+ * @return ESP_OK without doing anything when CONFIG_FCTL_FLEET is disabled
+ */
+esp_err_t fleet_start(void);
+
+/**
+ * @brief Start a round now instead of at the end of the period
+ *
+ * @return ESP_ERR_INVALID_STATE when the aggregator does not run
+ */
+esp_err_t fleet_refresh(void);
+
+/**
+ * @brief Copy the state of the aggregator and up to `max` peers, sorted by instance name
+ *
+ * @return Number of peers copied
+ */
+size_t fleet_get(fleet_status_t *status, fleet_peer_t *peers, size_t max);
+
+/**
+ * @brief Name of `status`, as reported by the REST API
+ */
+const char *fleet_peer_status_name(fleet_peer_status_t status);
+
+#ifdef __cplusplus
+}
+#endif
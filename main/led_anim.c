@@ -0,0 +1,129 @@
+#include <string.h>
+#include "sdkconfig.h"
+#include "freertos/FreeRTOS.h"
+#include "esp_timer.h"
+#include "esp_check.h"
+#include "esp_log.h"
+#include "led_color.h"
+#include "device_state.h"
+#include "led_anim.h"
+#include "trace.h"
+
+#define LED_BRIGHTNESS 25        // out of 255, brightness of the solid layer
+#define BREATH_PERIOD_MS 3000    // breathing period while not connected
+#define BREATH_MIN_PERCENT 20    // lowest breathing level, in percent of LED_BRIGHTNESS
+#define PULSE_REVOLUTIONS 10     // one pulse every this many fan revolutions
+#define PULSE_MS 80              // length of an RPM pulse
+#define FAULT_BLINK_MS 250       // half period of the fault blink
+#define FAULT_HUE 0              // red
+
+static const char *TAG_ANIM = "LED_ANIM";
+
+static led_strip_handle_t s_strip = NULL;
+static led_rgb_t s_pixels[CONFIG_FCTL_LED_STRIP_NUM_PIXELS];
+static uint32_t s_pulse_phase = 0; // rpm x ms, one pulse every PULSE_REVOLUTIONS * 60000
+static uint32_t s_pulse_left_ms = 0;
+static led_anim_stats_t s_stats;
+
+/* triangle wave over `period_ms`, 0..255 */
+static uint32_t triangle(uint32_t now_ms, uint32_t period_ms)
+{
+    uint32_t t = now_ms % period_ms;
+    uint32_t half = period_ms / 2;
+    return (t < half ? t : period_ms - t) * 255 / half;
+}
+
+static void render_fill(uint32_t hue, uint8_t brightness)
+{
+    led_rgb_t rgb = led_color_hsv2rgb(hue, 100, 100);
+    led_color_gamma_span(&rgb, 1, brightness);
+    for (size_t i = 0; i < CONFIG_FCTL_LED_STRIP_NUM_PIXELS; i++)
+    {
+        s_pixels[i] = rgb;
+    }
+}
+
+/* layers from bottom to top: solid speed color, breathing, rpm pulse, fault blink */
+static void render(const device_state_t *state, uint32_t now_ms)
+{
+    if (state->stalled || state->alarm)
+    {
+        bool on = (now_ms / FAULT_BLINK_MS) & 1;
+        render_fill(FAULT_HUE, on ? LED_BRIGHTNESS : 0);
+        return;
+    }
+
+    uint32_t level = LED_BRIGHTNESS;
+    if (!state->connected)
+    {
+        uint32_t breath = BREATH_MIN_PERCENT + triangle(now_ms, BREATH_PERIOD_MS) * (100 - BREATH_MIN_PERCENT) / 255;
+        level = level * breath / 100;
+    }
+
+    s_pulse_phase += (uint32_t)state->rpm * CONFIG_FCTL_LED_ANIM_INTERVAL_MS;
+    if (s_pulse_phase >= PULSE_REVOLUTIONS * 60000)
+    {
+        s_pulse_phase %= PULSE_REVOLUTIONS * 60000;
+        s_pulse_left_ms = PULSE_MS;
+    }
+    if (s_pulse_left_ms > 0)
+    {
+        level *= 2;
+        s_pulse_left_ms = s_pulse_left_ms > CONFIG_FCTL_LED_ANIM_INTERVAL_MS ? s_pulse_left_ms - CONFIG_FCTL_LED_ANIM_INTERVAL_MS : 0;
+    }
+
+    render_fill(240 * state->speed / 100, level > 255 ? 255 : level);
+}
+
+static void led_anim_timer_callback(void *arg)
+{
+    int64_t start = esp_timer_get_time();
+
+    device_state_t state;
+    device_state_get(&state);
+
+    render(&state, (uint32_t)(start / 1000));
+    for (size_t i = 0; i < CONFIG_FCTL_LED_STRIP_NUM_PIXELS; i++)
+    {
+        led_strip_set_pixel(s_strip, i, s_pixels[i].r, s_pixels[i].g, s_pixels[i].b);
+    }
+    // the strip drops frames identical to the one on the wire, a frame still being sent must not
+    // block the esp_timer task, this one is dropped and the next tick draws a newer one
+    if (led_strip_try_refresh(s_strip) == ESP_ERR_TIMEOUT)
+    {
+        s_stats.busy++;
+    }
+
+    uint32_t cost = (uint32_t)(esp_timer_get_time() - start);
+    trace_span(TRACE_LED_FRAME, (uint32_t)start, s_stats.frames, cost);
+    s_stats.frames++;
+    s_stats.last_us = cost;
+    s_stats.avg_us = s_stats.frames == 1 ? cost : s_stats.avg_us + ((int32_t)cost - (int32_t)s_stats.avg_us) / 8;
+    if (cost > s_stats.max_us)
+    {
+        s_stats.max_us = cost;
+    }
+}
+
+esp_err_t led_anim_start(led_strip_handle_t strip)
+{
+    ESP_RETURN_ON_FALSE(strip, ESP_ERR_INVALID_ARG, TAG_ANIM, "invalid argument");
+    s_strip = strip;
+    s_stats.interval_ms = CONFIG_FCTL_LED_ANIM_INTERVAL_MS;
+
+    const esp_timer_create_args_t anim_timer_args = {
+        .callback = &led_anim_timer_callback,
+        .name = "led_anim"};
+    esp_timer_handle_t anim_timer;
+    ESP_RETURN_ON_ERROR(esp_timer_create(&anim_timer_args, &anim_timer), TAG_ANIM, "create timer failed");
+    return esp_timer_start_periodic(anim_timer, CONFIG_FCTL_LED_ANIM_INTERVAL_MS * 1000);
+}
+
+void led_anim_get_stats(led_anim_stats_t *stats)
+{
+    *stats = s_stats;
+    if (s_strip)
+    {
+        led_strip_get_stats(s_strip, &stats->pushed, NULL);
+    }
+}
@@ -0,0 +1,36 @@
+#pragma once
+
+#include <stdint.h>
+#include "esp_err.h"
+#include "led_strip.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @brief Cost of rendering and pushing frames
+ */
+typedef struct {
+    uint32_t frames;      /*!< Frames rendered */
+    uint32_t pushed;      /*!< Frames sent to the strip because pixels changed */
+    uint32_t busy;        /*!< Frames dropped because the previous one was still being sent */
+    uint32_t last_us;     /*!< Cost of the last frame, in microseconds */
+    uint32_t avg_us;      /*!< Moving average of the frame cost, in microseconds */
+    uint32_t max_us;      /*!< Worst frame cost, in microseconds */
+    uint32_t interval_ms; /*!< Frame interval, in milliseconds */
+} led_anim_stats_t;
+
+/**
+ * @brief Start rendering the device state onto `strip` every CONFIG_FCTL_LED_ANIM_INTERVAL_MS
+ */
+esp_err_t led_anim_start(led_strip_handle_t strip);
+
+/**
+ * @brief Get the per-frame CPU cost of the animation engine
+ */
+void led_anim_get_stats(led_anim_stats_t *stats);
+
+#ifdef __cplusplus
+}
+#endif
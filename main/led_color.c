@@ -0,0 +1,127 @@
+#include "led_color.h"
+
+/*
+ * Gamma 2.2 is approximated as t^2 * (0.7 + 0.3t), close enough for an 8-bit LED and
+ * cheap enough to be folded into a constant table by the compiler.
+ */
+#define GAMMA8(x) ((uint8_t)(((x) * (x) * (7 * 255 + 3 * (x)) + 5 * 255 * 255) / (10 * 255 * 255)))
+#define GAMMA8_4(x) GAMMA8(x), GAMMA8((x) + 1), GAMMA8((x) + 2), GAMMA8((x) + 3)
+#define GAMMA8_16(x) GAMMA8_4(x), GAMMA8_4((x) + 4), GAMMA8_4((x) + 8), GAMMA8_4((x) + 12)
+#define GAMMA8_64(x) GAMMA8_16(x), GAMMA8_16((x) + 16), GAMMA8_16((x) + 32), GAMMA8_16((x) + 48)
+
+const uint8_t led_gamma8_table[256] = {
+    GAMMA8_64(0), GAMMA8_64(64), GAMMA8_64(128), GAMMA8_64(192)};
+
+enum
+{
+    SEL_MAX,
+    SEL_MIN,
+    SEL_RISE,
+    SEL_FALL,
+};
+
+// which of {max, min, rising, falling} drives r, g and b in each 60 degree hue sector
+static const uint8_t s_sector_select[6][3] = {
+    {SEL_MAX, SEL_RISE, SEL_MIN},
+    {SEL_FALL, SEL_MAX, SEL_MIN},
+    {SEL_MIN, SEL_MAX, SEL_RISE},
+    {SEL_MIN, SEL_FALL, SEL_MAX},
+    {SEL_RISE, SEL_MIN, SEL_MAX},
+    {SEL_MAX, SEL_MIN, SEL_FALL},
+};
+
+/* h must already be in [0,360), divisions are by constants and compile to multiplies */
+static inline led_rgb_t hsv2rgb(uint32_t h, uint32_t s, uint32_t v)
+{
+    s = s < 100 ? s : 100;
+    v = v < 100 ? v : 100;
+    uint32_t rgb_max = v * 255 / 100;
+    uint32_t rgb_min = rgb_max * (100 - s) / 100;
+    uint32_t sector = h / 60;
+    uint32_t rgb_adj = (rgb_max - rgb_min) * (h - sector * 60) / 60;
+
+    const uint8_t c[4] = {
+        [SEL_MAX] = rgb_max,
+        [SEL_MIN] = rgb_min,
+        [SEL_RISE] = rgb_min + rgb_adj,
+        [SEL_FALL] = rgb_max - rgb_adj,
+    };
+    const uint8_t *sel = s_sector_select[sector];
+    return (led_rgb_t){.r = c[sel[0]], .g = c[sel[1]], .b = c[sel[2]]};
+}
+
+led_rgb_t led_color_hsv2rgb(uint32_t h, uint32_t s, uint32_t v)
+{
+    return hsv2rgb(h % 360, s, v);
+}
+
+void led_color_hsv2rgb_span(const led_hsv_t *hsv, led_rgb_t *rgb, size_t count)
+{
+    for (size_t i = 0; i < count; i++)
+    {
+        rgb[i] = hsv2rgb(hsv[i].h % 360, hsv[i].s, hsv[i].v);
+    }
+}
+
+void led_color_gamma_span(led_rgb_t *rgb, size_t count, uint8_t brightness)
+{
+    for (size_t i = 0; i < count; i++)
+    {
+        rgb[i].r = led_gamma8_table[rgb[i].r] * brightness / 255;
+        rgb[i].g = led_gamma8_table[rgb[i].g] * brightness / 255;
+        rgb[i].b = led_gamma8_table[rgb[i].b] * brightness / 255;
+    }
+}
+
+/**
+ * @brief Simple helper function, converting HSV color space to RGB color space
+ *
+ * Wiki: https://en.wikipedia.org/wiki/HSL_and_HSV
+ *
+ */
+void led_strip_hsv2rgb(uint32_t h, uint32_t s, uint32_t v, uint32_t *r, uint32_t *g, uint32_t *b)
+{
+    h %= 360; // h -> [0,360]
+    uint32_t rgb_max = v * 2.55f;
+    uint32_t rgb_min = rgb_max * (100 - s) / 100.0f;
+
+    uint32_t i = h / 60;
+    uint32_t diff = h % 60;
+
+    // RGB adjustment amount by hue
+    uint32_t rgb_adj = (rgb_max - rgb_min) * diff / 60;
+
+    switch (i)
+    {
+    case 0:
+        *r = rgb_max;
+        *g = rgb_min + rgb_adj;
+        *b = rgb_min;
+        break;
+    case 1:
+        *r = rgb_max - rgb_adj;
+        *g = rgb_max;
+        *b = rgb_min;
+        break;
+    case 2:
+        *r = rgb_min;
+        *g = rgb_max;
+        *b = rgb_min + rgb_adj;
+        break;
+    case 3:
+        *r = rgb_min;
+        *g = rgb_max - rgb_adj;
+        *b = rgb_max;
+        break;
+    case 4:
+        *r = rgb_min + rgb_adj;
+        *g = rgb_min;
+        *b = rgb_max;
+        break;
+    default:
+        *r = rgb_max;
+        *g = rgb_min;
+        *b = rgb_max - rgb_adj;
+        break;
+    }
+}
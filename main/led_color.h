@@ -0,0 +1,62 @@
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @brief HSV pixel, hue in [0,360), saturation and value in [0,100]
+ */
+typedef struct {
+    uint16_t h;
+    uint8_t s;
+    uint8_t v;
+} led_hsv_t;
+
+/**
+ * @brief 8-bit RGB pixel
+ */
+typedef struct {
+    uint8_t r;
+    uint8_t g;
+    uint8_t b;
+} led_rgb_t;
+
+/**
+ * @brief 8-bit gamma correction table, generated by the compiler
+ */
+extern const uint8_t led_gamma8_table[256];
+
+static inline uint8_t led_color_gamma8(uint8_t x)
+{
+    return led_gamma8_table[x];
+}
+
+/**
+ * @brief Convert one HSV color to linear RGB using integer arithmetic only
+ *
+ * The hue wraps around 360, saturation and value above 100 are clamped.
+ */
+led_rgb_t led_color_hsv2rgb(uint32_t h, uint32_t s, uint32_t v);
+
+/**
+ * @brief Convert a span of HSV pixels to linear RGB, with the same input ranges as led_color_hsv2rgb()
+ */
+void led_color_hsv2rgb_span(const led_hsv_t *hsv, led_rgb_t *rgb, size_t count);
+
+/**
+ * @brief Gamma-correct a span of RGB pixels in place and scale them to `brightness`/255
+ */
+void led_color_gamma_span(led_rgb_t *rgb, size_t count, uint8_t brightness);
+
+/**
+ * @brief Floating point HSV to RGB conversion, kept as the reference for the integer kernel
+ */
+void led_strip_hsv2rgb(uint32_t h, uint32_t s, uint32_t v, uint32_t *r, uint32_t *g, uint32_t *b);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,207 @@
+#include <stdlib.h>
+#include <string.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h"
+#include "esp_check.h"
+#include "esp_log.h"
+#include "esp_heap_caps.h"
+#include "driver/rmt_tx.h"
+#include "led_strip_encoder.h"
+#include "led_strip.h"
+
+#define LED_STRIP_BYTES_PER_PIXEL 3
+
+static const char *TAG_STRIP = "LED_STRIP";
+
+typedef struct led_strip_t
+{
+    rmt_channel_handle_t chan;
+    rmt_encoder_handle_t encoder;
+    SemaphoreHandle_t done_sem; // given by the done callback, held while a frame is on the wire
+    uint8_t *front;             // last frame handed to the RMT channel
+    uint8_t *back;              // frame being drawn
+    size_t num_pixels;
+    bool has_frame; // front holds a frame that has been sent at least once
+    uint32_t sent;
+    uint32_t skipped;
+} led_strip_t;
+
+static bool IRAM_ATTR led_strip_tx_done_cb(rmt_channel_handle_t chan, const rmt_tx_done_event_data_t *edata, void *user_ctx)
+{
+    led_strip_t *strip = (led_strip_t *)user_ctx;
+    BaseType_t task_woken = pdFALSE;
+    xSemaphoreGiveFromISR(strip->done_sem, &task_woken);
+    return task_woken == pdTRUE;
+}
+
+esp_err_t led_strip_new(const led_strip_config_t *config, led_strip_handle_t *ret_strip)
+{
+    esp_err_t ret = ESP_OK;
+    led_strip_t *strip = NULL;
+    ESP_GOTO_ON_FALSE(config && ret_strip && config->num_pixels > 0, ESP_ERR_INVALID_ARG, err, TAG_STRIP, "invalid argument");
+    strip = calloc(1, sizeof(led_strip_t));
+    ESP_GOTO_ON_FALSE(strip, ESP_ERR_NO_MEM, err, TAG_STRIP, "no mem for led strip");
+
+    size_t frame_size = config->num_pixels * LED_STRIP_BYTES_PER_PIXEL;
+    strip->num_pixels = config->num_pixels;
+    strip->front = heap_caps_calloc(1, frame_size, MALLOC_CAP_DMA | MALLOC_CAP_INTERNAL);
+    strip->back = heap_caps_calloc(1, frame_size, MALLOC_CAP_DMA | MALLOC_CAP_INTERNAL);
+    ESP_GOTO_ON_FALSE(strip->front && strip->back, ESP_ERR_NO_MEM, err, TAG_STRIP, "no mem for frame buffers");
+
+    strip->done_sem = xSemaphoreCreateBinary();
+    ESP_GOTO_ON_FALSE(strip->done_sem, ESP_ERR_NO_MEM, err, TAG_STRIP, "no mem for done semaphore");
+    // nothing is on the wire yet
+    xSemaphoreGive(strip->done_sem);
+
+    ESP_LOGI(TAG_STRIP, "Create RMT TX channel, %d pixels", (int)config->num_pixels);
+    rmt_tx_channel_config_t tx_chan_config = {
+        .clk_src = RMT_CLK_SRC_DEFAULT, // select source clock
+        .gpio_num = config->gpio_num,
+        .mem_block_symbols = 64, // increase the block size can make the LED less flickering
+        .resolution_hz = config->resolution_hz,
+        .trans_queue_depth = 4, // set the number of transactions that can be pending in the background
+    };
+    ESP_GOTO_ON_ERROR(rmt_new_tx_channel(&tx_chan_config, &strip->chan), err, TAG_STRIP, "create RMT TX channel failed");
+
+    led_strip_encoder_config_t encoder_config = {
+        .resolution = config->resolution_hz,
+    };
+    ESP_GOTO_ON_ERROR(rmt_new_led_strip_encoder(&encoder_config, &strip->encoder), err, TAG_STRIP, "install led strip encoder failed");
+
+    rmt_tx_event_callbacks_t cbs = {
+        .on_trans_done = led_strip_tx_done_cb,
+    };
+    ESP_GOTO_ON_ERROR(rmt_tx_register_event_callbacks(strip->chan, &cbs, strip), err, TAG_STRIP, "register done callback failed");
+    ESP_GOTO_ON_ERROR(rmt_enable(strip->chan), err, TAG_STRIP, "enable RMT TX channel failed");
+
+    *ret_strip = strip;
+    return ESP_OK;
+err:
+    if (strip)
+    {
+        if (strip->encoder)
+        {
+            rmt_del_encoder(strip->encoder);
+        }
+        if (strip->chan)
+        {
+            rmt_del_channel(strip->chan);
+        }
+        if (strip->done_sem)
+        {
+            vSemaphoreDelete(strip->done_sem);
+        }
+        free(strip->front);
+        free(strip->back);
+        free(strip);
+    }
+    return ret;
+}
+
+esp_err_t led_strip_set_pixel(led_strip_handle_t strip, size_t index, uint8_t red, uint8_t green, uint8_t blue)
+{
+    ESP_RETURN_ON_FALSE(strip && index < strip->num_pixels, ESP_ERR_INVALID_ARG, TAG_STRIP, "invalid argument");
+    // wire order of the status LED: green, blue, red
+    uint8_t *pixel = &strip->back[index * LED_STRIP_BYTES_PER_PIXEL];
+    pixel[0] = green;
+    pixel[1] = blue;
+    pixel[2] = red;
+    return ESP_OK;
+}
+
+esp_err_t led_strip_fill(led_strip_handle_t strip, uint8_t red, uint8_t green, uint8_t blue)
+{
+    ESP_RETURN_ON_FALSE(strip, ESP_ERR_INVALID_ARG, TAG_STRIP, "invalid argument");
+    for (size_t i = 0; i < strip->num_pixels; i++)
+    {
+        led_strip_set_pixel(strip, i, red, green, blue);
+    }
+    return ESP_OK;
+}
+
+/* waits up to `wait` for the previous frame, ESP_ERR_TIMEOUT if it is still on the wire */
+static esp_err_t strip_refresh(led_strip_handle_t strip, TickType_t wait)
+{
+    size_t frame_size = strip->num_pixels * LED_STRIP_BYTES_PER_PIXEL;
+    if (strip->has_frame && memcmp(strip->front, strip->back, frame_size) == 0)
+    {
+        strip->skipped++;
+        return ESP_OK;
+    }
+
+    // the front buffer belongs to the RMT channel until the done callback fires
+    if (xSemaphoreTake(strip->done_sem, wait) != pdTRUE)
+    {
+        return ESP_ERR_TIMEOUT;
+    }
+
+    uint8_t *frame = strip->back;
+    strip->back = strip->front;
+    strip->front = frame;
+
+    rmt_transmit_config_t tx_config = {
+        .loop_count = 0,
+    };
+    esp_err_t err = rmt_transmit(strip->chan, strip->encoder, strip->front, frame_size, &tx_config);
+    if (err != ESP_OK)
+    {
+        xSemaphoreGive(strip->done_sem);
+        return err;
+    }
+    strip->has_frame = true;
+    strip->sent++;
+    // keep drawing on top of the frame just sent
+    memcpy(strip->back, strip->front, frame_size);
+    return ESP_OK;
+}
+
+esp_err_t led_strip_refresh(led_strip_handle_t strip)
+{
+    ESP_RETURN_ON_FALSE(strip, ESP_ERR_INVALID_ARG, TAG_STRIP, "invalid argument");
+    esp_err_t err = strip_refresh(strip, pdMS_TO_TICKS(100));
+    ESP_RETURN_ON_FALSE(err != ESP_ERR_TIMEOUT, err, TAG_STRIP, "previous frame not done");
+    return err;
+}
+
+esp_err_t led_strip_try_refresh(led_strip_handle_t strip)
+{
+    ESP_RETURN_ON_FALSE(strip, ESP_ERR_INVALID_ARG, TAG_STRIP, "invalid argument");
+    return strip_refresh(strip, 0);
+}
+
+esp_err_t led_strip_wait_done(led_strip_handle_t strip, int timeout_ms)
+{
+    ESP_RETURN_ON_FALSE(strip, ESP_ERR_INVALID_ARG, TAG_STRIP, "invalid argument");
+    return rmt_tx_wait_all_done(strip->chan, timeout_ms);
+}
+
+size_t led_strip_get_num_pixels(led_strip_handle_t strip)
+{
+    return strip ? strip->num_pixels : 0;
+}
+
+void led_strip_get_stats(led_strip_handle_t strip, uint32_t *sent, uint32_t *skipped)
+{
+    if (sent)
+    {
+        *sent = strip->sent;
+    }
+    if (skipped)
+    {
+        *skipped = strip->skipped;
+    }
+}
+
+esp_err_t led_strip_del(led_strip_handle_t strip)
+{
+    ESP_RETURN_ON_FALSE(strip, ESP_ERR_INVALID_ARG, TAG_STRIP, "invalid argument");
+    rmt_tx_wait_all_done(strip->chan, -1);
+    rmt_disable(strip->chan);
+    rmt_del_channel(strip->chan);
+    rmt_del_encoder(strip->encoder);
+    vSemaphoreDelete(strip->done_sem);
+    free(strip->front);
+    free(strip->back);
+    free(strip);
+    return ESP_OK;
+}
@@ -0,0 +1,96 @@
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+#include "esp_err.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @brief Handle of an addressable LED strip
+ */
+typedef struct led_strip_t *led_strip_handle_t;
+
+/**
+ * @brief Type of led strip configuration
+ */
+typedef struct {
+    int gpio_num;           /*!< GPIO the strip data line is connected to */
+    uint32_t resolution_hz; /*!< RMT tick resolution, in Hz */
+    size_t num_pixels;      /*!< Number of pixels on the strip */
+} led_strip_config_t;
+
+/**
+ * @brief Create an LED strip with double-buffered frame storage
+ *
+ * Two frame buffers of `num_pixels` GRB pixels are allocated from DMA-capable memory.
+ * Pixels are drawn into the back buffer, the front buffer is owned by the RMT channel
+ * while a frame is on the wire.
+ *
+ * @param[in] config Strip configuration
+ * @param[out] ret_strip Returned strip handle
+ * @return
+ *      - ESP_ERR_INVALID_ARG for any invalid arguments
+ *      - ESP_ERR_NO_MEM out of memory when allocating frame buffers
+ *      - ESP_OK if creating the strip successfully
+ */
+esp_err_t led_strip_new(const led_strip_config_t *config, led_strip_handle_t *ret_strip);
+
+/**
+ * @brief Set one pixel in the back buffer, nothing is sent until led_strip_refresh()
+ */
+esp_err_t led_strip_set_pixel(led_strip_handle_t strip, size_t index, uint8_t red, uint8_t green, uint8_t blue);
+
+/**
+ * @brief Set every pixel in the back buffer to the same color
+ */
+esp_err_t led_strip_fill(led_strip_handle_t strip, uint8_t red, uint8_t green, uint8_t blue);
+
+/**
+ * @brief Send the back buffer to the strip
+ *
+ * Waits for the previous frame to finish, swaps front and back buffers and queues the new
+ * front buffer for transmission. A frame identical to the last one sent is skipped.
+ *
+ * @return
+ *      - ESP_ERR_TIMEOUT if the previous frame did not complete in time
+ *      - ESP_OK if the frame was queued or skipped
+ */
+esp_err_t led_strip_refresh(led_strip_handle_t strip);
+
+/**
+ * @brief Send the back buffer to the strip if the previous frame is done, never blocks
+ *
+ * Safe to call from an esp_timer callback. The back buffer is kept when the frame is not sent.
+ *
+ * @return
+ *      - ESP_ERR_TIMEOUT if the previous frame is still on the wire, nothing is sent
+ *      - ESP_OK if the frame was queued or skipped
+ */
+esp_err_t led_strip_try_refresh(led_strip_handle_t strip);
+
+/**
+ * @brief Block until the frame on the wire has been sent
+ */
+esp_err_t led_strip_wait_done(led_strip_handle_t strip, int timeout_ms);
+
+/**
+ * @brief Get the number of pixels of the strip
+ */
+size_t led_strip_get_num_pixels(led_strip_handle_t strip);
+
+/**
+ * @brief Get the number of frames sent and skipped because nothing changed
+ */
+void led_strip_get_stats(led_strip_handle_t strip, uint32_t *sent, uint32_t *skipped);
+
+/**
+ * @brief Delete the strip, release the RMT channel and the frame buffers
+ */
+esp_err_t led_strip_del(led_strip_handle_t strip);
+
+#ifdef __cplusplus
+}
+#endif
@@ -7,25 +7,38 @@
    CONDITIONS OF ANY KIND, either express or implied.
 */
 #include <string.h>
+#include <stdlib.h>
 #include <fcntl.h>
 #include "esp_http_server.h"
 #include "esp_chip_info.h"
 #include "esp_random.h"
+#include "esp_system.h"
 #include "esp_log.h"
 #include "esp_vfs.h"
+#include "esp_timer.h"
+#include "esp_netif.h"
 #include "cJSON.h"
 #include "esp_wifi.h"
+#include "led_anim.h"
+#include "device_state.h"
+#include "boot.h"
+#include "sys_stats.h"
+#include "trace.h"
+#include "deferred_log.h"
+#include "task_plan.h"
+#include "control.h"
+#include "fan_curve.h"
+#include "fan_cal.h"
+#include "sensor.h"
+#include "sensing.h"
+#include "failsafe.h"
+#include "fleet.h"
 
 static const char *REST_TAG = "esp-rest";
 void set_fan_speed(int speed);
-esp_err_t read_fan_speed(int32_t *fan_speed);
-esp_err_t write_fan_speed(int32_t fan_speed);
-void led_set_color(uint32_t hue);
-extern int rpm;
-uint16_t wifi_scan(wifi_ap_record_t *ap_info, int size);
+void fan_get_boot_timing(int64_t *first_pwm_us, bool *restored);
+uint16_t wifi_scan(wifi_ap_record_t *ap_info, uint16_t size);
 void config_sta(char *ssid, char *password);
-esp_err_t read_str(char *key, char *value);
-esp_err_t write_str(char *key, char *value);
 
 #define REST_CHECK(a, str, goto_tag, ...)                                              \
     do                                                                                 \
@@ -150,8 +163,10 @@ static esp_err_t rest_common_get_handler(httpd_req_t *req)
 static esp_err_t rpm_get_handler(httpd_req_t *req)
 {
     httpd_resp_set_type(req, "application/json");
+    device_state_t state;
+    device_state_get(&state);
     cJSON *root = cJSON_CreateObject();
-    cJSON_AddNumberToObject(root, "rpm", rpm);
+    cJSON_AddNumberToObject(root, "rpm", state.rpm);
     const char *json_str = cJSON_Print(root);
     httpd_resp_sendstr(req, json_str);
     free((void *)json_str);
@@ -160,20 +175,178 @@ static esp_err_t rpm_get_handler(httpd_req_t *req)
     return ESP_OK;
 }
 
-static esp_err_t fan_speed_get_handler(httpd_req_t *req)
+static esp_err_t led_stats_get_handler(httpd_req_t *req)
 {
     httpd_resp_set_type(req, "application/json");
+    led_anim_stats_t stats;
+    led_anim_get_stats(&stats);
     cJSON *root = cJSON_CreateObject();
-    int32_t fan_speed = 0;
-    esp_err_t err = read_fan_speed(&fan_speed);
-    if (ESP_OK != err)
+    cJSON_AddNumberToObject(root, "frames", stats.frames);
+    cJSON_AddNumberToObject(root, "pushed", stats.pushed);
+    cJSON_AddNumberToObject(root, "busy", stats.busy);
+    cJSON_AddNumberToObject(root, "interval_ms", stats.interval_ms);
+    cJSON_AddNumberToObject(root, "last_us", stats.last_us);
+    cJSON_AddNumberToObject(root, "avg_us", stats.avg_us);
+    cJSON_AddNumberToObject(root, "max_us", stats.max_us);
+    const char *json_str = cJSON_Print(root);
+    httpd_resp_sendstr(req, json_str);
+    free((void *)json_str);
+    cJSON_Delete(root);
+
+    return ESP_OK;
+}
+
+static esp_err_t boot_get_handler(httpd_req_t *req)
+{
+    boot_profile_t *profile = malloc(sizeof(boot_profile_t));
+    if (!profile)
     {
-        cJSON_AddNumberToObject(root, "speed", 0);
+        httpd_resp_send_err(req, HTTPD_500_INTERNAL_SERVER_ERROR, "No memory for boot profile");
+        return ESP_FAIL;
     }
-    else
+    boot_get_profile(profile);
+    int64_t first_pwm_us;
+    bool pwm_restored;
+    fan_get_boot_timing(&first_pwm_us, &pwm_restored);
+
+    httpd_resp_set_type(req, "application/json");
+    cJSON *root = cJSON_CreateObject();
+    cJSON_AddNumberToObject(root, "reset_reason", esp_reset_reason());
+    cJSON_AddNumberToObject(root, "pwm_us", first_pwm_us);
+    cJSON_AddBoolToObject(root, "pwm_restored", pwm_restored);
+    cJSON_AddNumberToObject(root, "start_us", profile->start_us);
+    cJSON_AddNumberToObject(root, "end_us", profile->end_us);
+    cJSON *steps = cJSON_AddArrayToObject(root, "steps");
+    for (size_t i = 0; i < profile->num_steps; i++)
     {
-        cJSON_AddNumberToObject(root, "speed", fan_speed);
+        const boot_step_profile_t *step = &profile->steps[i];
+        cJSON *item = cJSON_CreateObject();
+        cJSON_AddStringToObject(item, "name", step->name);
+        cJSON_AddNumberToObject(item, "start_us", step->start_us);
+        cJSON_AddNumberToObject(item, "end_us", step->end_us);
+        cJSON_AddNumberToObject(item, "core", step->core);
+        cJSON_AddStringToObject(item, "status", esp_err_to_name(step->err));
+        cJSON_AddItemToArray(steps, item);
     }
+    free(profile);
+    const char *json_str = cJSON_Print(root);
+    httpd_resp_sendstr(req, json_str);
+    free((void *)json_str);
+    cJSON_Delete(root);
+
+    return ESP_OK;
+}
+
+static esp_err_t sys_stats_get_handler(httpd_req_t *req)
+{
+    sys_stats_t *stats = malloc(sizeof(sys_stats_t));
+    if (!stats)
+    {
+        httpd_resp_send_err(req, HTTPD_500_INTERNAL_SERVER_ERROR, "No memory for stats");
+        return ESP_FAIL;
+    }
+    if (sys_stats_get(stats) != ESP_OK)
+    {
+        free(stats);
+        httpd_resp_send_err(req, HTTPD_500_INTERNAL_SERVER_ERROR, "Statistics not available");
+        return ESP_FAIL;
+    }
+
+    httpd_resp_set_type(req, "application/json");
+    cJSON *root = cJSON_CreateObject();
+    cJSON_AddNumberToObject(root, "samples", stats->samples);
+    cJSON_AddNumberToObject(root, "period_ms", stats->period_ms);
+    cJSON_AddNumberToObject(root, "sample_us", stats->sample_us);
+    cJSON *heap = cJSON_AddObjectToObject(root, "heap");
+    cJSON_AddNumberToObject(heap, "free", stats->heap_free);
+    cJSON_AddNumberToObject(heap, "min_free", stats->heap_min_free);
+    cJSON_AddNumberToObject(heap, "largest_block", stats->heap_largest_block);
+    cJSON_AddNumberToObject(heap, "fragmentation", stats->heap_fragmentation);
+    cJSON_AddNumberToObject(root, "dropped_tasks", stats->dropped_tasks);
+    cJSON *tasks = cJSON_AddArrayToObject(root, "tasks");
+    for (size_t i = 0; i < stats->num_tasks; i++)
+    {
+        const sys_task_stats_t *task = &stats->tasks[i];
+        cJSON *item = cJSON_CreateObject();
+        cJSON_AddStringToObject(item, "name", task->name);
+        cJSON_AddNumberToObject(item, "priority", task->priority);
+        cJSON_AddNumberToObject(item, "core", task->core);
+        cJSON_AddNumberToObject(item, "stack_free", task->stack_free);
+        cJSON *cpu = cJSON_AddArrayToObject(item, "cpu");
+        for (int w = 0; w < SYS_STATS_WINDOWS; w++)
+        {
+            // two decimals
+            cJSON_AddItemToArray(cpu, cJSON_CreateNumber((int)(task->cpu[w] * 100 + 0.5f) / 100.0));
+        }
+        cJSON_AddItemToArray(tasks, item);
+    }
+    free(stats);
+
+    control_stats_t control_stats;
+    control_get_stats(&control_stats);
+    cJSON *control = cJSON_AddObjectToObject(root, "control");
+    cJSON_AddNumberToObject(control, "period_us", control_stats.period_us);
+    cJSON_AddNumberToObject(control, "cycles", control_stats.cycles);
+    cJSON_AddNumberToObject(control, "late_avg_us", control_stats.late_avg_us);
+    cJSON_AddNumberToObject(control, "late_p99_us", control_stats.late_p99_us);
+    cJSON_AddNumberToObject(control, "late_max_us", control_stats.late_max_us);
+    cJSON_AddNumberToObject(control, "core", control_stats.core);
+    cJSON_AddNumberToObject(control, "priority", control_stats.priority);
+
+    deferred_log_stats_t *log_stats = malloc(sizeof(deferred_log_stats_t));
+    if (log_stats)
+    {
+        deferred_log_get_stats(log_stats);
+        cJSON *log = cJSON_AddObjectToObject(root, "log");
+        cJSON_AddNumberToObject(log, "queued", log_stats->queued);
+        cJSON_AddNumberToObject(log, "written", log_stats->written);
+        cJSON_AddNumberToObject(log, "formatted", log_stats->formatted);
+        cJSON_AddNumberToObject(log, "suppressed", log_stats->suppressed);
+        cJSON_AddNumberToObject(log, "dropped", log_stats->dropped);
+        cJSON *log_tags = cJSON_AddArrayToObject(log, "tags");
+        for (size_t i = 0; i < log_stats->num_tags; i++)
+        {
+            cJSON *item = cJSON_CreateObject();
+            cJSON_AddStringToObject(item, "tag", log_stats->tags[i].tag);
+            cJSON_AddNumberToObject(item, "suppressed", log_stats->tags[i].suppressed);
+            cJSON_AddNumberToObject(item, "dropped", log_stats->tags[i].dropped);
+            cJSON_AddItemToArray(log_tags, item);
+        }
+        free(log_stats);
+    }
+    const char *json_str = cJSON_Print(root);
+    httpd_resp_sendstr(req, json_str);
+    free((void *)json_str);
+    cJSON_Delete(root);
+
+    return ESP_OK;
+}
+
+static esp_err_t trace_write_chunk(void *ctx, const void *data, size_t len)
+{
+    return httpd_resp_send_chunk((httpd_req_t *)ctx, data, len);
+}
+
+static esp_err_t trace_get_handler(httpd_req_t *req)
+{
+    httpd_resp_set_type(req, "application/octet-stream");
+    httpd_resp_set_hdr(req, "Content-Disposition", "attachment; filename=\"trace.bin\"");
+    if (trace_dump(trace_write_chunk, req) != ESP_OK)
+    {
+        // the connection is closed when the handler fails
+        return ESP_FAIL;
+    }
+    httpd_resp_send_chunk(req, NULL, 0);
+    return ESP_OK;
+}
+
+static esp_err_t fan_speed_get_handler(httpd_req_t *req)
+{
+    httpd_resp_set_type(req, "application/json");
+    device_state_t state;
+    device_state_get(&state);
+    cJSON *root = cJSON_CreateObject();
+    cJSON_AddNumberToObject(root, "speed", state.speed);
     const char *json_str = cJSON_Print(root);
     httpd_resp_sendstr(req, json_str);
     free((void *)json_str);
@@ -208,31 +381,425 @@ static esp_err_t fan_speed_put_handler(httpd_req_t *req)
     buf[total_len] = '\0';
 
     cJSON *root = cJSON_Parse(buf);
-    int speed = cJSON_GetObjectItem(root, "speed")->valueint;
+    cJSON *rpm = cJSON_GetObjectItem(root, "rpm");
+    int speed;
+    if (cJSON_IsNumber(rpm))
+    {
+        // {"rpm": 1200} goes through the calibrated model
+        speed = rpm->valuedouble >= 0 ? fan_cal_speed_for_rpm((uint32_t)rpm->valuedouble) : -1;
+        if (speed < 0)
+        {
+            cJSON_Delete(root);
+            httpd_resp_send_err(req, HTTPD_400_BAD_REQUEST, "Fan not calibrated");
+            return ESP_FAIL;
+        }
+    }
+    else
+    {
+        speed = cJSON_GetObjectItem(root, "speed")->valueint;
+    }
     ESP_LOGI(REST_TAG, "Fan control: speed = %d", speed);
-    ESP_ERROR_CHECK(write_fan_speed(speed));
     cJSON_Delete(root);
     httpd_resp_set_type(req, "application/json");
     httpd_resp_sendstr(req, "{\"status\": \"ok\"}");
-    set_fan_speed(speed);
-    led_set_color(240 * speed / 100);
+    // a manual speed takes over from the fan curve and a calibration sweep
+    fan_curve_disable();
+    if (!fan_cal_abort(speed))
+    {
+        set_fan_speed(speed);
+    }
     return ESP_OK;
 }
 
-static esp_err_t name_get_handler(httpd_req_t *req)
+/* receive and parse a JSON body, NULL after an error response */
+static cJSON *recv_json(httpd_req_t *req)
 {
+    int total_len = req->content_len;
+    int cur_len = 0;
+    char *buf = ((rest_server_context_t *)(req->user_ctx))->scratch;
+    if (total_len >= SCRATCH_BUFSIZE)
+    {
+        httpd_resp_send_err(req, HTTPD_500_INTERNAL_SERVER_ERROR, "content too long");
+        return NULL;
+    }
+    while (cur_len < total_len)
+    {
+        int received = httpd_req_recv(req, buf + cur_len, total_len - cur_len);
+        if (received <= 0)
+        {
+            httpd_resp_send_err(req, HTTPD_500_INTERNAL_SERVER_ERROR, "Failed to receive body");
+            return NULL;
+        }
+        cur_len += received;
+    }
+    buf[total_len] = '\0';
+    cJSON *root = cJSON_Parse(buf);
+    if (!root)
+    {
+        httpd_resp_send_err(req, HTTPD_400_BAD_REQUEST, "Invalid JSON");
+    }
+    return root;
+}
+
+static esp_err_t fan_curve_get_handler(httpd_req_t *req)
+{
+    fan_curve_t curve;
+    fan_curve_get(&curve);
     httpd_resp_set_type(req, "application/json");
     cJSON *root = cJSON_CreateObject();
-    char name[128];
-    esp_err_t err = read_str("name", &name);
-    if (ESP_OK != err)
+    cJSON_AddBoolToObject(root, "enabled", curve.enabled);
+    cJSON_AddNumberToObject(root, "sensor", curve.sensor);
+    cJSON_AddNumberToObject(root, "hysteresis", curve.hysteresis / 10.0);
+    cJSON *points = cJSON_AddArrayToObject(root, "points");
+    for (int i = 0; i < curve.num_points; i++)
     {
-        cJSON_AddStringToObject(root, "name", "fctl");
+        cJSON *point = cJSON_CreateObject();
+        cJSON_AddNumberToObject(point, "temp", curve.points[i].temp / 10.0);
+        cJSON_AddNumberToObject(point, "speed", curve.points[i].speed);
+        cJSON_AddItemToArray(points, point);
     }
-    else
+    const char *json_str = cJSON_Print(root);
+    httpd_resp_sendstr(req, json_str);
+    free((void *)json_str);
+    cJSON_Delete(root);
+    return ESP_OK;
+}
+
+/* {"enabled": true, "sensor": 1, "hysteresis": 2, "points": [{"temp": 30, "speed": 20}, ...]}, temperatures in degrees Celsius */
+static esp_err_t fan_curve_put_handler(httpd_req_t *req)
+{
+    cJSON *root = recv_json(req);
+    if (!root)
+    {
+        return ESP_FAIL;
+    }
+    fan_curve_t curve = {0};
+    cJSON *enabled = cJSON_GetObjectItem(root, "enabled");
+    cJSON *sensor = cJSON_GetObjectItem(root, "sensor");
+    cJSON *hysteresis = cJSON_GetObjectItem(root, "hysteresis");
+    cJSON *points = cJSON_GetObjectItem(root, "points");
+    bool valid = cJSON_IsNumber(sensor) && cJSON_IsArray(points) && cJSON_GetArraySize(points) <= FAN_CURVE_MAX_POINTS &&
+                 (!hysteresis || (cJSON_IsNumber(hysteresis) && hysteresis->valuedouble >= 0 && hysteresis->valuedouble <= 25));
+    if (valid)
+    {
+        curve.enabled = !enabled || cJSON_IsTrue(enabled);
+        curve.sensor = sensor->valueint < 0 || sensor->valueint > 255 ? 255 : sensor->valueint;
+        curve.hysteresis = hysteresis ? (uint8_t)(hysteresis->valuedouble * 10 + 0.5) : 0;
+        cJSON *point;
+        cJSON_ArrayForEach(point, points)
+        {
+            cJSON *temp = cJSON_GetObjectItem(point, "temp");
+            cJSON *speed = cJSON_GetObjectItem(point, "speed");
+            if (!cJSON_IsNumber(temp) || !cJSON_IsNumber(speed) || temp->valuedouble < -40 || temp->valuedouble > 150 ||
+                speed->valueint < 0 || speed->valueint > 100)
+            {
+                valid = false;
+                break;
+            }
+            curve.points[curve.num_points].temp = (int16_t)(temp->valuedouble * 10 + (temp->valuedouble < 0 ? -0.5 : 0.5));
+            curve.points[curve.num_points].speed = speed->valueint;
+            curve.num_points++;
+        }
+    }
+    cJSON_Delete(root);
+    if (!valid || fan_curve_set(&curve) != ESP_OK)
+    {
+        httpd_resp_send_err(req, HTTPD_400_BAD_REQUEST, "Invalid curve");
+        return ESP_FAIL;
+    }
+    httpd_resp_set_type(req, "application/json");
+    httpd_resp_sendstr(req, "{\"status\": \"ok\"}");
+    return ESP_OK;
+}
+
+static esp_err_t fan_calibration_get_handler(httpd_req_t *req)
+{
+    static const char *states[] = {"idle", "running", "done", "failed", "aborted"};
+    fan_cal_model_t model;
+    fan_cal_progress_t progress;
+    fan_cal_get(&model, &progress);
+    httpd_resp_set_type(req, "application/json");
+    cJSON *root = cJSON_CreateObject();
+    cJSON_AddStringToObject(root, "state", states[progress.state]);
+    if (progress.state != FAN_CAL_IDLE)
+    {
+        cJSON_AddNumberToObject(root, "step", progress.step);
+        cJSON_AddNumberToObject(root, "speed", progress.speed);
+        cJSON_AddNumberToObject(root, "elapsed_ms", progress.elapsed_ms);
+    }
+    if (progress.reason[0])
+    {
+        cJSON_AddStringToObject(root, "reason", progress.reason);
+    }
+    cJSON_AddBoolToObject(root, "valid", model.valid);
+    if (model.valid)
+    {
+        cJSON_AddNumberToObject(root, "min_start", model.min_start);
+        cJSON_AddNumberToObject(root, "min_run", model.min_run);
+        cJSON *points = cJSON_AddArrayToObject(root, "points");
+        for (int i = 0; i < model.num_points; i++)
+        {
+            cJSON *point = cJSON_CreateObject();
+            cJSON_AddNumberToObject(point, "speed", model.points[i].speed);
+            cJSON_AddNumberToObject(point, "rpm", model.points[i].rpm);
+            cJSON_AddItemToArray(points, point);
+        }
+    }
+    const char *json_str = cJSON_Print(root);
+    httpd_resp_sendstr(req, json_str);
+    free((void *)json_str);
+    cJSON_Delete(root);
+    return ESP_OK;
+}
+
+/* {"step": 5}, optional */
+static esp_err_t fan_calibration_post_handler(httpd_req_t *req)
+{
+    int step = FAN_CAL_MIN_STEP;
+    if (req->content_len > 0)
+    {
+        cJSON *root = recv_json(req);
+        if (!root)
+        {
+            return ESP_FAIL;
+        }
+        cJSON *item = cJSON_GetObjectItem(root, "step");
+        step = cJSON_IsNumber(item) ? item->valueint : item ? -1 : step;
+        cJSON_Delete(root);
+    }
+    esp_err_t err = fan_cal_start(step);
+    if (err == ESP_ERR_INVALID_ARG)
+    {
+        httpd_resp_send_err(req, HTTPD_400_BAD_REQUEST, "Invalid step");
+        return ESP_FAIL;
+    }
+    httpd_resp_set_type(req, "application/json");
+    if (err != ESP_OK)
+    {
+        httpd_resp_set_status(req, "409 Conflict");
+        httpd_resp_sendstr(req, "{\"status\": \"running\"}");
+        return ESP_OK;
+    }
+    httpd_resp_set_status(req, "202 Accepted");
+    httpd_resp_sendstr(req, "{\"status\": \"started\"}");
+    return ESP_OK;
+}
+
+static esp_err_t sensors_get_handler(httpd_req_t *req)
+{
+    httpd_resp_set_type(req, "application/json");
+    cJSON *root = cJSON_CreateArray();
+    for (uint8_t id = 0; id < SENSOR_MAX; id++)
+    {
+        sensor_reading_t reading;
+        esp_err_t err = sensor_get(id, &reading);
+        cJSON *item = cJSON_CreateObject();
+        cJSON_AddNumberToObject(item, "id", id);
+        cJSON_AddBoolToObject(item, "onboard", reading.onboard);
+        if (reading.valid)
+        {
+            cJSON_AddNumberToObject(item, "temperature", reading.temp / 10.0);
+            cJSON_AddNumberToObject(item, "age_ms", reading.age_ms);
+        }
+        cJSON_AddBoolToObject(item, "fresh", err == ESP_OK);
+        cJSON_AddItemToArray(root, item);
+    }
+    const char *json_str = cJSON_Print(root);
+    httpd_resp_sendstr(req, json_str);
+    free((void *)json_str);
+    cJSON_Delete(root);
+    return ESP_OK;
+}
+
+static esp_err_t sensing_get_handler(httpd_req_t *req)
+{
+    sensing_values_t values;
+    sensing_get(&values);
+    httpd_resp_set_type(req, "application/json");
+    cJSON *root = cJSON_CreateObject();
+    cJSON_AddBoolToObject(root, "running", values.running);
+    cJSON_AddNumberToObject(root, "sample_hz", values.sample_hz);
+    cJSON_AddNumberToObject(root, "output_hz", values.output_hz);
+    cJSON_AddNumberToObject(root, "outputs", values.outputs);
+    cJSON_AddNumberToObject(root, "overruns", values.overruns);
+    cJSON *ntc = cJSON_AddArrayToObject(root, "ntc");
+    for (int i = 0; i < SENSING_NTC_CHANNELS; i++)
     {
-        cJSON_AddStringToObject(root, "name", name);
+        cJSON *item = cJSON_CreateObject();
+        cJSON_AddNumberToObject(item, "sensor", SENSOR_NTC_FIRST + i);
+        cJSON_AddNumberToObject(item, "mv", values.ntc_mv[i]);
+        if (values.ntc_temp[i] != INT16_MIN)
+        {
+            cJSON_AddNumberToObject(item, "temperature", values.ntc_temp[i] / 10.0);
+        }
+        cJSON_AddItemToArray(ntc, item);
     }
+    cJSON *current = cJSON_AddObjectToObject(root, "current");
+    cJSON_AddNumberToObject(current, "mv", values.current_mv);
+    cJSON_AddNumberToObject(current, "ma", values.current_ma);
+    const char *json_str = cJSON_Print(root);
+    httpd_resp_sendstr(req, json_str);
+    free((void *)json_str);
+    cJSON_Delete(root);
+    return ESP_OK;
+}
+
+static esp_err_t failsafe_get_handler(httpd_req_t *req)
+{
+    failsafe_status_t status;
+    failsafe_get(&status);
+    httpd_resp_set_type(req, "application/json");
+    cJSON *root = cJSON_CreateObject();
+    cJSON_AddBoolToObject(root, "latched", status.latched);
+    cJSON_AddStringToObject(root, "cause", failsafe_cause_name(status.cause));
+    if (status.cause == FAILSAFE_TEMPERATURE)
+    {
+        cJSON_AddNumberToObject(root, "sensor", status.sensor);
+        cJSON_AddNumberToObject(root, "temperature", status.temp / 10.0);
+    }
+    if (status.latched)
+    {
+        cJSON_AddNumberToObject(root, "tripped_ms", (double)(status.tripped_us / 1000));
+    }
+    cJSON_AddNumberToObject(root, "trips", status.trips);
+    cJSON_AddNumberToObject(root, "checks", status.checks);
+    cJSON_AddNumberToObject(root, "reaction_us", status.reaction_us);
+    cJSON_AddNumberToObject(root, "reaction_max_us", status.reaction_max_us);
+    cJSON_AddNumberToObject(root, "period_ms", CONFIG_FCTL_FAILSAFE_PERIOD_MS);
+    cJSON_AddNumberToObject(root, "safe_speed", CONFIG_FCTL_FAILSAFE_SPEED);
+    cJSON_AddNumberToObject(root, "temp_limit", CONFIG_FCTL_FAILSAFE_TEMP_C);
+    const char *json_str = cJSON_Print(root);
+    httpd_resp_sendstr(req, json_str);
+    free((void *)json_str);
+    cJSON_Delete(root);
+    return ESP_OK;
+}
+
+static esp_err_t failsafe_delete_handler(httpd_req_t *req)
+{
+    failsafe_clear();
+    httpd_resp_set_type(req, "application/json");
+    httpd_resp_sendstr(req, "{\"status\": \"ok\"}");
+    return ESP_OK;
+}
+
+static esp_err_t fleet_get_handler(httpd_req_t *req)
+{
+    fleet_status_t status;
+    fleet_get(&status, NULL, 0);
+    fleet_peer_t *peers = status.max_peers ? calloc(status.max_peers, sizeof(fleet_peer_t)) : NULL;
+    size_t num_peers = peers ? fleet_get(&status, peers, status.max_peers) : 0;
+    int64_t now = esp_timer_get_time();
+    device_state_t state;
+    device_state_get(&state);
+
+    httpd_resp_set_type(req, "application/json");
+    cJSON *root = cJSON_CreateObject();
+    cJSON_AddBoolToObject(root, "enabled", status.enabled);
+    cJSON_AddNumberToObject(root, "rounds", status.rounds);
+    if (status.rounds)
+    {
+        cJSON_AddNumberToObject(root, "updated_ms", (double)((now - status.updated_us) / 1000));
+        cJSON_AddNumberToObject(root, "browse_ms", status.browse_ms);
+        cJSON_AddNumberToObject(root, "round_ms", status.round_ms);
+    }
+    cJSON_AddNumberToObject(root, "dropped", status.dropped);
+    cJSON *self = cJSON_AddObjectToObject(root, "self");
+    cJSON_AddStringToObject(self, "name", state.name);
+    cJSON_AddNumberToObject(self, "speed", state.speed);
+    cJSON_AddNumberToObject(self, "rpm", state.rpm);
+    cJSON_AddBoolToObject(self, "stalled", state.stalled);
+    cJSON_AddBoolToObject(self, "alarm", state.alarm);
+    cJSON *array = cJSON_AddArrayToObject(root, "peers");
+    for (size_t i = 0; i < num_peers; i++)
+    {
+        const fleet_peer_t *peer = &peers[i];
+        cJSON *item = cJSON_CreateObject();
+        char ip[16] = "";
+        if (peer->ip)
+        {
+            esp_ip4_addr_t addr = {.addr = peer->ip};
+            snprintf(ip, sizeof(ip), IPSTR, IP2STR(&addr));
+        }
+        cJSON_AddStringToObject(item, "instance", peer->instance);
+        cJSON_AddStringToObject(item, "host", peer->host);
+        cJSON_AddStringToObject(item, "ip", ip);
+        cJSON_AddNumberToObject(item, "port", peer->port);
+        cJSON_AddStringToObject(item, "version", peer->version);
+        cJSON_AddStringToObject(item, "name", peer->name);
+        cJSON_AddNumberToObject(item, "speed", peer->speed);
+        cJSON_AddNumberToObject(item, "rpm", peer->rpm);
+        cJSON_AddBoolToObject(item, "stalled", peer->stalled);
+        cJSON_AddBoolToObject(item, "alarm", peer->alarm);
+        cJSON_AddStringToObject(item, "status", fleet_peer_status_name(peer->status));
+        cJSON_AddNumberToObject(item, "http_status", peer->http_status);
+        cJSON_AddNumberToObject(item, "latency_ms", peer->latency_ms);
+        cJSON_AddNumberToObject(item, "seen_ms", (double)((now - peer->seen_us) / 1000));
+        if (peer->fetched_us)
+        {
+            // how old the state shown is
+            cJSON_AddNumberToObject(item, "age_ms", (double)((now - peer->fetched_us) / 1000));
+        }
+        cJSON_AddItemToArray(array, item);
+    }
+    free(peers);
+    const char *json_str = cJSON_Print(root);
+    httpd_resp_sendstr(req, json_str);
+    free((void *)json_str);
+    cJSON_Delete(root);
+    return ESP_OK;
+}
+
+static esp_err_t fleet_post_handler(httpd_req_t *req)
+{
+    httpd_resp_set_type(req, "application/json");
+    if (fleet_refresh() != ESP_OK)
+    {
+        httpd_resp_set_status(req, "409 Conflict");
+        httpd_resp_sendstr(req, "{\"status\": \"disabled\"}");
+        return ESP_OK;
+    }
+    httpd_resp_set_status(req, "202 Accepted");
+    httpd_resp_sendstr(req, "{\"status\": \"refreshing\"}");
+    return ESP_OK;
+}
+
+/* PUT /api/sensor/{id} {"temperature": 41.5}, pushed by hosts */
+static esp_err_t sensor_put_handler(httpd_req_t *req)
+{
+    char *end;
+    long id = strtol(req->uri + strlen("/api/sensor/"), &end, 10);
+    if (end == req->uri + strlen("/api/sensor/") || (*end && *end != '?') || id < 0 || id >= SENSOR_MAX)
+    {
+        httpd_resp_send_err(req, HTTPD_404_NOT_FOUND, "Unknown sensor");
+        return ESP_FAIL;
+    }
+    cJSON *root = recv_json(req);
+    if (!root)
+    {
+        return ESP_FAIL;
+    }
+    cJSON *temperature = cJSON_GetObjectItem(root, "temperature");
+    bool valid = cJSON_IsNumber(temperature) && temperature->valuedouble >= -100 && temperature->valuedouble <= 300;
+    double value = valid ? temperature->valuedouble : 0;
+    cJSON_Delete(root);
+    if (!valid || sensor_set((uint8_t)id, (int16_t)(value * 10 + (value < 0 ? -0.5 : 0.5))) != ESP_OK)
+    {
+        httpd_resp_send_err(req, HTTPD_400_BAD_REQUEST, "Invalid temperature");
+        return ESP_FAIL;
+    }
+    httpd_resp_set_type(req, "application/json");
+    httpd_resp_sendstr(req, "{\"status\": \"ok\"}");
+    return ESP_OK;
+}
+
+static esp_err_t name_get_handler(httpd_req_t *req)
+{
+    httpd_resp_set_type(req, "application/json");
+    device_state_t state;
+    device_state_get(&state);
+    cJSON *root = cJSON_CreateObject();
+    cJSON_AddStringToObject(root, "name", state.name);
     const char *json_str = cJSON_Print(root);
     httpd_resp_sendstr(req, json_str);
     free((void *)json_str);
@@ -269,7 +836,7 @@ static esp_err_t name_put_handler(httpd_req_t *req)
     cJSON *root = cJSON_Parse(buf);
     char *name = cJSON_GetObjectItem(root, "name")->valuestring;
     ESP_LOGI(REST_TAG, "set name = %s", name);
-    ESP_ERROR_CHECK(write_str("name", name));
+    device_state_set_name(name);
     cJSON_Delete(root);
     httpd_resp_set_type(req, "application/json");
     httpd_resp_sendstr(req, "{\"status\": \"ok\"}");
@@ -279,10 +846,32 @@ static esp_err_t name_put_handler(httpd_req_t *req)
 static esp_err_t mode_get_handler(httpd_req_t *req)
 {
     httpd_resp_set_type(req, "application/json");
+    device_state_t state;
+    device_state_get(&state);
     cJSON *root = cJSON_CreateObject();
-    wifi_mode_t mode;
-    esp_wifi_get_mode(&mode);
-    cJSON_AddNumberToObject(root, "mode", (int)mode);
+    cJSON_AddNumberToObject(root, "mode", state.wifi_mode);
+    const char *json_str = cJSON_Print(root);
+    httpd_resp_sendstr(req, json_str);
+    free((void *)json_str);
+    cJSON_Delete(root);
+
+    return ESP_OK;
+}
+
+static esp_err_t state_get_handler(httpd_req_t *req)
+{
+    httpd_resp_set_type(req, "application/json");
+    device_state_t state;
+    device_state_get(&state);
+    cJSON *root = cJSON_CreateObject();
+    cJSON_AddNumberToObject(root, "version", state.version);
+    cJSON_AddStringToObject(root, "name", state.name);
+    cJSON_AddNumberToObject(root, "speed", state.speed);
+    cJSON_AddNumberToObject(root, "rpm", state.rpm);
+    cJSON_AddBoolToObject(root, "stalled", state.stalled);
+    cJSON_AddBoolToObject(root, "alarm", state.alarm);
+    cJSON_AddBoolToObject(root, "connected", state.connected);
+    cJSON_AddNumberToObject(root, "mode", state.wifi_mode);
     const char *json_str = cJSON_Print(root);
     httpd_resp_sendstr(req, json_str);
     free((void *)json_str);
@@ -298,7 +887,7 @@ static esp_err_t wifi_scan_get_handler(httpd_req_t *req)
 
     wifi_ap_record_t ap_info[10];
     memset(ap_info, 0, sizeof(ap_info));
-    uint16_t ap_count = wifi_scan(&ap_info, 10);
+    uint16_t ap_count = wifi_scan(ap_info, 10);
     for (int i = 0; (i < 10) && (i < ap_count); i++)
     {
         cJSON *item = cJSON_CreateObject();
@@ -343,7 +932,6 @@ static esp_err_t wifi_sta_post_handler(httpd_req_t *req)
     cJSON *root = cJSON_Parse(buf);
     char *ssid = cJSON_GetObjectItem(root, "ssid")->valuestring;
     char *password = cJSON_GetObjectItem(root, "password")->valuestring;
-    ESP_LOGI(REST_TAG, "ssid = %s, password = %s", ssid, password);
     httpd_resp_set_type(req, "application/json");
     httpd_resp_sendstr(req, "{\"status\": \"ok\"}");
     config_sta(ssid, password);
@@ -360,7 +948,10 @@ esp_err_t start_rest_server(const char *base_path)
 
     httpd_handle_t server = NULL;
     httpd_config_t config = HTTPD_DEFAULT_CONFIG();
-    config.max_uri_handlers = 16;
+    config.max_uri_handlers = 28;
+    task_placement_t placement = task_plan_get(TASK_ROLE_NETWORK);
+    config.core_id = placement.core;
+    config.task_priority = placement.priority;
     config.uri_match_fn = httpd_uri_match_wildcard;
 
     ESP_LOGI(REST_TAG, "Starting HTTP Server");
@@ -422,6 +1013,118 @@ esp_err_t start_rest_server(const char *base_path)
         .user_ctx = rest_context};
     httpd_register_uri_handler(server, &mode_get_uri);
 
+    httpd_uri_t state_get_uri = {
+        .uri = "/api/state",
+        .method = HTTP_GET,
+        .handler = state_get_handler,
+        .user_ctx = rest_context};
+    httpd_register_uri_handler(server, &state_get_uri);
+
+    httpd_uri_t led_stats_get_uri = {
+        .uri = "/api/led/stats",
+        .method = HTTP_GET,
+        .handler = led_stats_get_handler,
+        .user_ctx = rest_context};
+    httpd_register_uri_handler(server, &led_stats_get_uri);
+
+    httpd_uri_t boot_get_uri = {
+        .uri = "/api/boot",
+        .method = HTTP_GET,
+        .handler = boot_get_handler,
+        .user_ctx = rest_context};
+    httpd_register_uri_handler(server, &boot_get_uri);
+
+    httpd_uri_t sys_stats_get_uri = {
+        .uri = "/api/sys/stats",
+        .method = HTTP_GET,
+        .handler = sys_stats_get_handler,
+        .user_ctx = rest_context};
+    httpd_register_uri_handler(server, &sys_stats_get_uri);
+
+    httpd_uri_t fan_curve_get_uri = {
+        .uri = "/api/fan/curve",
+        .method = HTTP_GET,
+        .handler = fan_curve_get_handler,
+        .user_ctx = rest_context};
+    httpd_register_uri_handler(server, &fan_curve_get_uri);
+
+    httpd_uri_t fan_curve_put_uri = {
+        .uri = "/api/fan/curve",
+        .method = HTTP_PUT,
+        .handler = fan_curve_put_handler,
+        .user_ctx = rest_context};
+    httpd_register_uri_handler(server, &fan_curve_put_uri);
+
+    httpd_uri_t sensors_get_uri = {
+        .uri = "/api/sensors",
+        .method = HTTP_GET,
+        .handler = sensors_get_handler,
+        .user_ctx = rest_context};
+    httpd_register_uri_handler(server, &sensors_get_uri);
+
+    httpd_uri_t sensing_get_uri = {
+        .uri = "/api/sensing",
+        .method = HTTP_GET,
+        .handler = sensing_get_handler,
+        .user_ctx = rest_context};
+    httpd_register_uri_handler(server, &sensing_get_uri);
+
+    httpd_uri_t fan_calibration_get_uri = {
+        .uri = "/api/fan/calibration",
+        .method = HTTP_GET,
+        .handler = fan_calibration_get_handler,
+        .user_ctx = rest_context};
+    httpd_register_uri_handler(server, &fan_calibration_get_uri);
+
+    httpd_uri_t fan_calibration_post_uri = {
+        .uri = "/api/fan/calibration",
+        .method = HTTP_POST,
+        .handler = fan_calibration_post_handler,
+        .user_ctx = rest_context};
+    httpd_register_uri_handler(server, &fan_calibration_post_uri);
+
+    httpd_uri_t failsafe_get_uri = {
+        .uri = "/api/failsafe",
+        .method = HTTP_GET,
+        .handler = failsafe_get_handler,
+        .user_ctx = rest_context};
+    httpd_register_uri_handler(server, &failsafe_get_uri);
+
+    httpd_uri_t failsafe_delete_uri = {
+        .uri = "/api/failsafe",
+        .method = HTTP_DELETE,
+        .handler = failsafe_delete_handler,
+        .user_ctx = rest_context};
+    httpd_register_uri_handler(server, &failsafe_delete_uri);
+
+    httpd_uri_t sensor_put_uri = {
+        .uri = "/api/sensor/*",
+        .method = HTTP_PUT,
+        .handler = sensor_put_handler,
+        .user_ctx = rest_context};
+    httpd_register_uri_handler(server, &sensor_put_uri);
+
+    httpd_uri_t fleet_get_uri = {
+        .uri = "/api/fleet",
+        .method = HTTP_GET,
+        .handler = fleet_get_handler,
+        .user_ctx = rest_context};
+    httpd_register_uri_handler(server, &fleet_get_uri);
+
+    httpd_uri_t fleet_post_uri = {
+        .uri = "/api/fleet",
+        .method = HTTP_POST,
+        .handler = fleet_post_handler,
+        .user_ctx = rest_context};
+    httpd_register_uri_handler(server, &fleet_post_uri);
+
+    httpd_uri_t trace_get_uri = {
+        .uri = "/api/trace",
+        .method = HTTP_GET,
+        .handler = trace_get_handler,
+        .user_ctx = rest_context};
+    httpd_register_uri_handler(server, &trace_get_uri);
+
     /* URI handler for getting web server files */
     httpd_uri_t common_get_uri = {
         .uri = "/*",
@@ -18,19 +18,24 @@
 #include "freertos/task.h"
 #include "freertos/queue.h"
 #include "driver/gpio.h"
+#include "device_state.h"
+#include "rpm.h"
 
 #define GPIO_RPM 26
+#define STALL_SAMPLES 2 // rpm samples reading zero while commanded on before a stall is reported
 
-static void periodic_timer_callback(void *arg);
-static int count = 0;
-  int rpm = 0;
+static int zero_rpm_samples = 0;
+static volatile uint32_t s_pulses = 0;
+static uint32_t s_window_pulses = 0; // pulses at the start of the current window
+static int64_t s_window_us = 0;
+static bool s_stall_check = true;
 
 static void IRAM_ATTR gpio_isr_handler(void *arg)
 {
-    count++;
+    s_pulses++;
 }
 
-void start_rpm_timer(void)
+void rpm_init(void)
 {
     // zero-initialize the config structure.
     gpio_config_t io_conf = {};
@@ -51,22 +56,36 @@ void start_rpm_timer(void)
     gpio_install_isr_service(0);
     // hook isr handler for specific gpio pin
     gpio_isr_handler_add(GPIO_RPM, gpio_isr_handler, (void *)GPIO_RPM);
+    s_window_us = esp_timer_get_time();
+}
 
-    const esp_timer_create_args_t periodic_timer_args = {
-        .callback = &periodic_timer_callback,
-        /* name is optional, but may help identify the timer when debugging */
-        .name = "periodic"};
+void rpm_update(void)
+{
+    // the window ends on the first call after RPM_PERIOD_MS, the speed is scaled by its measured length
+    int64_t now = esp_timer_get_time();
+    int64_t window = now - s_window_us;
+    if (window < RPM_PERIOD_MS * 1000LL)
+    {
+        return;
+    }
+    uint32_t pulses = s_pulses;
+    int rpm = (uint64_t)(pulses - s_window_pulses) * 60000000 / ((uint64_t)window * RPM_PULSES_PER_REV);
+    s_window_pulses = pulses;
+    s_window_us = now;
 
-    esp_timer_handle_t periodic_timer;
-    ESP_ERROR_CHECK(esp_timer_create(&periodic_timer_args, &periodic_timer));
-    /* The timer has been created but is not running yet */
+    device_state_t state;
+    device_state_get(&state);
+    zero_rpm_samples = (s_stall_check && state.speed > 0 && rpm == 0) ? zero_rpm_samples + 1 : 0;
+    device_state_set_rpm(rpm);
+    device_state_set_stalled(zero_rpm_samples >= STALL_SAMPLES);
+}
 
-    /* Start the timers */
-    ESP_ERROR_CHECK(esp_timer_start_periodic(periodic_timer, 3000000));
+uint32_t rpm_get_pulses(void)
+{
+    return s_pulses;
 }
 
-static void periodic_timer_callback(void *arg)
+void rpm_set_stall_check(bool enabled)
 {
-    rpm = count * 20 / 2;
-    count = 0;
+    s_stall_check = enabled;
 }
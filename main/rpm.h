@@ -0,0 +1,35 @@
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define RPM_PERIOD_MS 3000 // tach pulses are counted over at least this period
+#define RPM_PULSES_PER_REV 2
+
+/**
+ * @brief Configure the tach input, its interrupt is allocated on the calling core
+ */
+void rpm_init(void);
+
+/**
+ * @brief Publish the speed once RPM_PERIOD_MS passed since the last one, called every control period
+ */
+void rpm_update(void);
+
+/**
+ * @brief Get the number of tach pulses since boot, for measurements over other windows
+ */
+uint32_t rpm_get_pulses(void);
+
+/**
+ * @brief Enable or disable stall detection, disabled while the fan is stopped on purpose
+ */
+void rpm_set_stall_check(bool enabled);
+
+#ifdef __cplusplus
+}
+#endif
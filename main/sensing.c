@@ -0,0 +1,226 @@
+#include <string.h>
+#include "sdkconfig.h"
+#include "freertos/FreeRTOS.h"
+#include "esp_check.h"
+#include "esp_log.h"
+#include "sensing.h"
+
+#if CONFIG_FCTL_SENSING
+#include "esp_attr.h"
+#include "esp_adc/adc_continuous.h"
+#include "esp_adc/adc_cali.h"
+#include "esp_adc/adc_cali_scheme.h"
+#include "adc_filter.h"
+#include "sensor.h"
+#include "task_plan.h"
+
+#define SENSING_TASK_STACK 4096
+#define SENSING_ATTEN ADC_ATTEN_DB_11
+#define SENSING_VREF_MV 3300                  // supply of the thermistor dividers
+#define SENSING_FULL_SCALE_MV 3100            // without calibration, at SENSING_ATTEN
+#define SENSING_NTC0_CHANNEL ADC_CHANNEL_6    // GPIO34
+#define SENSING_NTC1_CHANNEL ADC_CHANNEL_7    // GPIO35
+#define SENSING_CURRENT_CHANNEL ADC_CHANNEL_3 // GPIO39
+#define SENSING_NUM_CHANNELS (SENSING_NTC_CHANNELS + 1)
+#define SENSING_FRAME_BYTES 256               // DMA conversion frame, the driver interrupts once per frame
+#define SENSING_POOL_BYTES 1024
+#define SENSING_CIC_ORDER 2
+#define SENSING_RESULTS (SENSING_FRAME_BYTES / SOC_ADC_DIGI_RESULT_BYTES)
+#define SENSING_MAX_FRAMES (SENSING_RESULTS / SENSING_NUM_CHANNELS + 1) // whole frames completed by one read
+// decimated frames one read can complete, the filter phase carries over from the read before
+#define SENSING_MAX_OUTPUTS ((SENSING_MAX_FRAMES + CONFIG_FCTL_SENSING_DECIMATION - 1) / CONFIG_FCTL_SENSING_DECIMATION)
+
+#if CONFIG_IDF_TARGET_ESP32 || CONFIG_IDF_TARGET_ESP32S2
+#define SENSING_FORMAT ADC_DIGI_OUTPUT_FORMAT_TYPE1
+#define RESULT_CHANNEL(p) ((p)->type1.channel)
+#define RESULT_DATA(p) ((p)->type1.data)
+#else
+#define SENSING_FORMAT ADC_DIGI_OUTPUT_FORMAT_TYPE2
+#define RESULT_CHANNEL(p) ((p)->type2.channel)
+#define RESULT_DATA(p) ((p)->type2.data)
+#endif
+
+static const char *TAG_SENSING = "SENSING";
+
+// frame slot of each channel: thermistors first, then the current shunt
+static const adc_channel_t s_channels[SENSING_NUM_CHANNELS] = {SENSING_NTC0_CHANNEL, SENSING_NTC1_CHANNEL, SENSING_CURRENT_CHANNEL};
+
+static adc_continuous_handle_t s_adc = NULL;
+static adc_cali_handle_t s_cali = NULL;
+static adc_cic_t s_cic;
+#endif
+
+static portMUX_TYPE s_lock = portMUX_INITIALIZER_UNLOCKED;
+static sensing_values_t s_values;
+
+#if CONFIG_FCTL_SENSING
+static bool IRAM_ATTR on_pool_ovf(adc_continuous_handle_t handle, const adc_continuous_evt_data_t *edata, void *user_data)
+{
+    portENTER_CRITICAL_ISR(&s_lock);
+    s_values.overruns++;
+    portEXIT_CRITICAL_ISR(&s_lock);
+    return false;
+}
+
+static int raw_to_mv(uint16_t raw)
+{
+    int mv;
+    if (!s_cali || adc_cali_raw_to_voltage(s_cali, raw, &mv) != ESP_OK)
+    {
+        mv = raw * SENSING_FULL_SCALE_MV / ((1 << SOC_ADC_DIGI_MAX_BITWIDTH) - 1);
+    }
+    return mv;
+}
+
+/* calibrate one decimated frame and hand it to the fan curve and telemetry */
+static void publish(const uint16_t *raw)
+{
+    sensing_values_t values;
+    for (int i = 0; i < SENSING_NTC_CHANNELS; i++)
+    {
+        values.ntc_mv[i] = raw_to_mv(raw[i]);
+        values.ntc_temp[i] = adc_ntc_temp(values.ntc_mv[i], SENSING_VREF_MV, CONFIG_FCTL_SENSING_NTC_SERIES_OHM,
+                                          CONFIG_FCTL_SENSING_NTC_R0_OHM, CONFIG_FCTL_SENSING_NTC_BETA);
+        if (values.ntc_temp[i] != INT16_MIN)
+        {
+            sensor_publish(SENSOR_NTC_FIRST + i, values.ntc_temp[i]);
+        }
+    }
+    values.current_mv = raw_to_mv(raw[SENSING_NTC_CHANNELS]);
+    values.current_ma = adc_shunt_ma(values.current_mv, CONFIG_FCTL_SENSING_SHUNT_MOHM, CONFIG_FCTL_SENSING_SHUNT_GAIN);
+
+    portENTER_CRITICAL(&s_lock);
+    memcpy(s_values.ntc_mv, values.ntc_mv, sizeof(values.ntc_mv));
+    memcpy(s_values.ntc_temp, values.ntc_temp, sizeof(values.ntc_temp));
+    s_values.current_mv = values.current_mv;
+    s_values.current_ma = values.current_ma;
+    s_values.outputs++;
+    portEXIT_CRITICAL(&s_lock);
+}
+
+static void sensing_task(void *arg)
+{
+    uint8_t buf[SENSING_FRAME_BYTES];
+    uint16_t frames[SENSING_MAX_FRAMES * SENSING_NUM_CHANNELS];
+    uint16_t out[SENSING_MAX_OUTPUTS * SENSING_NUM_CHANNELS];
+    uint16_t frame[SENSING_NUM_CHANNELS];
+    // adc_cic_process drops what does not fit
+    _Static_assert(sizeof(out) / sizeof(frame) >= SENSING_MAX_OUTPUTS, "sensing output buffer smaller than one read");
+    uint32_t filled = 0; // slots of `frame` holding a sample
+
+    for (;;)
+    {
+        uint32_t len = 0;
+        if (adc_continuous_read(s_adc, buf, sizeof(buf), &len, ADC_MAX_DELAY) != ESP_OK)
+        {
+            continue;
+        }
+
+        // the pattern converts every channel in turn, rebuild the frames from the channel of each result
+        size_t num_frames = 0;
+        for (uint32_t i = 0; i + SOC_ADC_DIGI_RESULT_BYTES <= len; i += SOC_ADC_DIGI_RESULT_BYTES)
+        {
+            const adc_digi_output_data_t *result = (const adc_digi_output_data_t *)&buf[i];
+            for (int slot = 0; slot < SENSING_NUM_CHANNELS; slot++)
+            {
+                if (s_channels[slot] == RESULT_CHANNEL(result))
+                {
+                    frame[slot] = RESULT_DATA(result);
+                    filled |= 1u << slot;
+                    break;
+                }
+            }
+            if (filled == (1u << SENSING_NUM_CHANNELS) - 1)
+            {
+                memcpy(&frames[num_frames * SENSING_NUM_CHANNELS], frame, sizeof(frame));
+                num_frames++;
+                filled = 0;
+            }
+        }
+
+        size_t outputs = adc_cic_process(&s_cic, frames, num_frames, out, sizeof(out) / sizeof(frame));
+        for (size_t i = 0; i < outputs; i++)
+        {
+            publish(&out[i * SENSING_NUM_CHANNELS]);
+        }
+    }
+}
+
+static void calibration_init(void)
+{
+    esp_err_t err = ESP_ERR_NOT_SUPPORTED;
+#if ADC_CALI_SCHEME_CURVE_FITTING_SUPPORTED
+    adc_cali_curve_fitting_config_t cali_config = {
+        .unit_id = ADC_UNIT_1,
+        .atten = SENSING_ATTEN,
+        .bitwidth = ADC_BITWIDTH_DEFAULT};
+    err = adc_cali_create_scheme_curve_fitting(&cali_config, &s_cali);
+#elif ADC_CALI_SCHEME_LINE_FITTING_SUPPORTED
+    adc_cali_line_fitting_config_t cali_config = {
+        .unit_id = ADC_UNIT_1,
+        .atten = SENSING_ATTEN,
+        .bitwidth = ADC_BITWIDTH_DEFAULT};
+    err = adc_cali_create_scheme_line_fitting(&cali_config, &s_cali);
+#endif
+    if (err != ESP_OK)
+    {
+        s_cali = NULL;
+        ESP_LOGW(TAG_SENSING, "no ADC calibration (%s), using nominal full scale", esp_err_to_name(err));
+    }
+}
+#endif
+
+esp_err_t sensing_start(void)
+{
+#if CONFIG_FCTL_SENSING
+    ESP_RETURN_ON_FALSE(adc_cic_init(&s_cic, SENSING_NUM_CHANNELS, SENSING_CIC_ORDER, CONFIG_FCTL_SENSING_DECIMATION),
+                        ESP_ERR_INVALID_ARG, TAG_SENSING, "decimation %d too large", CONFIG_FCTL_SENSING_DECIMATION);
+
+    adc_continuous_handle_cfg_t handle_config = {
+        .max_store_buf_size = SENSING_POOL_BYTES,
+        .conv_frame_size = SENSING_FRAME_BYTES};
+    ESP_RETURN_ON_ERROR(adc_continuous_new_handle(&handle_config, &s_adc), TAG_SENSING, "create ADC handle failed");
+
+    adc_digi_pattern_config_t pattern[SENSING_NUM_CHANNELS];
+    for (int i = 0; i < SENSING_NUM_CHANNELS; i++)
+    {
+        pattern[i] = (adc_digi_pattern_config_t){
+            .atten = SENSING_ATTEN,
+            .channel = s_channels[i],
+            .unit = ADC_UNIT_1,
+            .bit_width = SOC_ADC_DIGI_MAX_BITWIDTH};
+    }
+    adc_continuous_config_t config = {
+        .pattern_num = SENSING_NUM_CHANNELS,
+        .adc_pattern = pattern,
+        .sample_freq_hz = CONFIG_FCTL_SENSING_SAMPLE_HZ,
+        .conv_mode = ADC_CONV_SINGLE_UNIT_1,
+        .format = SENSING_FORMAT};
+    ESP_RETURN_ON_ERROR(adc_continuous_config(s_adc, &config), TAG_SENSING, "configure ADC failed");
+    adc_continuous_evt_cbs_t callbacks = {
+        .on_pool_ovf = on_pool_ovf};
+    ESP_RETURN_ON_ERROR(adc_continuous_register_event_callbacks(s_adc, &callbacks, NULL), TAG_SENSING, "register callbacks failed");
+    calibration_init();
+
+    for (int i = 0; i < SENSING_NTC_CHANNELS; i++)
+    {
+        sensor_claim(SENSOR_NTC_FIRST + i);
+    }
+    s_values.running = true;
+    s_values.sample_hz = CONFIG_FCTL_SENSING_SAMPLE_HZ;
+    s_values.output_hz = CONFIG_FCTL_SENSING_SAMPLE_HZ / SENSING_NUM_CHANNELS / CONFIG_FCTL_SENSING_DECIMATION;
+    // next to the control loop it feeds
+    ESP_RETURN_ON_ERROR(task_plan_create(sensing_task, "sensing", SENSING_TASK_STACK, NULL, TASK_ROLE_CONTROL, NULL),
+                        TAG_SENSING, "create task failed");
+    return adc_continuous_start(s_adc);
+#else
+    return ESP_OK;
+#endif
+}
+
+void sensing_get(sensing_values_t *values)
+{
+    portENTER_CRITICAL(&s_lock);
+    *values = s_values;
+    portEXIT_CRITICAL(&s_lock);
+}
@@ -0,0 +1,42 @@
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "esp_err.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define SENSING_NTC_CHANNELS 2
+
+/**
+ * @brief Latest decimated values of the ADC sensing pipeline
+ */
+typedef struct {
+    bool running;                        /*!< CONFIG_FCTL_SENSING is enabled and the ADC runs */
+    uint32_t sample_hz;                  /*!< Conversions per second, over all channels */
+    uint32_t output_hz;                  /*!< Decimated values per second and channel */
+    uint32_t outputs;                    /*!< Decimated frames since start */
+    uint32_t overruns;                   /*!< DMA pool overflows, conversions were lost */
+    uint16_t ntc_mv[SENSING_NTC_CHANNELS];
+    int16_t ntc_temp[SENSING_NTC_CHANNELS]; /*!< 0.1 degree Celsius, INT16_MIN when disconnected */
+    uint16_t current_mv;
+    uint32_t current_ma;                 /*!< Fan current */
+} sensing_values_t;
+
+/**
+ * @brief Start sampling the thermistors and the fan current shunt with the ADC continuous driver
+ *
+ * Thermistors are published as sensors SENSOR_NTC_FIRST and up, for the fan curve.
+ */
+esp_err_t sensing_start(void);
+
+/**
+ * @brief Get the latest values
+ */
+void sensing_get(sensing_values_t *values);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,113 @@
+#include "sdkconfig.h"
+#include "soc/soc_caps.h"
+#include "freertos/FreeRTOS.h"
+#include "esp_timer.h"
+#include "esp_check.h"
+#include "esp_log.h"
+#if SOC_TEMP_SENSOR_SUPPORTED
+#include "driver/temperature_sensor.h"
+#endif
+#include "sensor.h"
+
+#define ONBOARD_POLL_US 1000000
+
+static const char *TAG_SENSOR = "SENSOR";
+
+typedef struct
+{
+    bool valid;
+    int16_t temp;
+    int64_t updated_us;
+} sensor_slot_t;
+
+static portMUX_TYPE s_lock = portMUX_INITIALIZER_UNLOCKED;
+static sensor_slot_t s_sensors[SENSOR_MAX];
+static uint32_t s_onboard = 0; // ids claimed by sensors of the board
+#if SOC_TEMP_SENSOR_SUPPORTED
+static temperature_sensor_handle_t s_chip_sensor = NULL;
+#endif
+
+void sensor_publish(uint8_t id, int16_t temp)
+{
+    portENTER_CRITICAL(&s_lock);
+    s_sensors[id].valid = true;
+    s_sensors[id].temp = temp;
+    s_sensors[id].updated_us = esp_timer_get_time();
+    portEXIT_CRITICAL(&s_lock);
+}
+
+esp_err_t sensor_init(void)
+{
+#if SOC_TEMP_SENSOR_SUPPORTED
+    temperature_sensor_config_t config = TEMPERATURE_SENSOR_CONFIG_DEFAULT(-10, 80);
+    ESP_RETURN_ON_ERROR(temperature_sensor_install(&config, &s_chip_sensor), TAG_SENSOR, "install on-board sensor failed");
+    ESP_RETURN_ON_ERROR(temperature_sensor_enable(s_chip_sensor), TAG_SENSOR, "enable on-board sensor failed");
+    return sensor_claim(SENSOR_ONBOARD);
+#else
+    return ESP_OK;
+#endif
+}
+
+void sensor_poll(void)
+{
+#if SOC_TEMP_SENSOR_SUPPORTED
+    static int64_t s_last_poll_us = 0;
+    int64_t now = esp_timer_get_time();
+    if (!s_chip_sensor || now - s_last_poll_us < ONBOARD_POLL_US)
+    {
+        return;
+    }
+    s_last_poll_us = now;
+    float celsius;
+    if (temperature_sensor_get_celsius(s_chip_sensor, &celsius) == ESP_OK)
+    {
+        sensor_publish(SENSOR_ONBOARD, (int16_t)(celsius * 10));
+    }
+#endif
+}
+
+static bool is_onboard(uint8_t id)
+{
+    portENTER_CRITICAL(&s_lock);
+    bool onboard = s_onboard & (1u << id);
+    portEXIT_CRITICAL(&s_lock);
+    return onboard;
+}
+
+esp_err_t sensor_claim(uint8_t id)
+{
+    ESP_RETURN_ON_FALSE(id < SENSOR_MAX, ESP_ERR_INVALID_ARG, TAG_SENSOR, "unknown sensor %u", id);
+    portENTER_CRITICAL(&s_lock);
+    s_onboard |= 1u << id;
+    portEXIT_CRITICAL(&s_lock);
+    return ESP_OK;
+}
+
+esp_err_t sensor_set(uint8_t id, int16_t temp)
+{
+    ESP_RETURN_ON_FALSE(id < SENSOR_MAX, ESP_ERR_INVALID_ARG, TAG_SENSOR, "unknown sensor %u", id);
+    ESP_RETURN_ON_FALSE(!is_onboard(id), ESP_ERR_NOT_SUPPORTED, TAG_SENSOR, "sensor %u is on-board", id);
+    sensor_publish(id, temp);
+    return ESP_OK;
+}
+
+esp_err_t sensor_get(uint8_t id, sensor_reading_t *reading)
+{
+    if (id >= SENSOR_MAX)
+    {
+        return ESP_ERR_INVALID_ARG;
+    }
+    portENTER_CRITICAL(&s_lock);
+    sensor_slot_t slot = s_sensors[id];
+    portEXIT_CRITICAL(&s_lock);
+
+    reading->valid = slot.valid;
+    reading->onboard = is_onboard(id);
+    reading->temp = slot.temp;
+    reading->age_ms = slot.valid ? (uint32_t)((esp_timer_get_time() - slot.updated_us) / 1000) : 0;
+    if (!slot.valid)
+    {
+        return ESP_ERR_NOT_FOUND;
+    }
+    return reading->age_ms > CONFIG_FCTL_SENSOR_TIMEOUT_S * 1000 ? ESP_ERR_TIMEOUT : ESP_OK;
+}
@@ -0,0 +1,61 @@
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "esp_err.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define SENSOR_MAX 6     // temperature inputs
+#define SENSOR_ONBOARD 0 // the chip sensor, when the chip has one
+#define SENSOR_NTC_FIRST 4 // thermistors of the ADC sensing pipeline
+
+/**
+ * @brief Latest reading of a temperature input
+ */
+typedef struct {
+    bool valid;       /*!< A reading was received */
+    bool onboard;     /*!< Measured by the board, not pushed */
+    int16_t temp;     /*!< Temperature, in 0.1 degree Celsius */
+    uint32_t age_ms;  /*!< Time since the reading */
+} sensor_reading_t;
+
+/**
+ * @brief Install the on-board temperature sensor, when the chip has one
+ */
+esp_err_t sensor_init(void);
+
+/**
+ * @brief Read the on-board sensor, called from the control loop
+ */
+void sensor_poll(void);
+
+/**
+ * @brief Reserve `id` for a sensor of the board, hosts can no longer push to it
+ */
+esp_err_t sensor_claim(uint8_t id);
+
+/**
+ * @brief Store a temperature measured by the board, in 0.1 degree Celsius
+ */
+void sensor_publish(uint8_t id, int16_t temp);
+
+/**
+ * @brief Store a temperature pushed by a host, in 0.1 degree Celsius
+ *
+ * @return ESP_ERR_INVALID_ARG for an unknown id, ESP_ERR_NOT_SUPPORTED for a sensor of the board
+ */
+esp_err_t sensor_set(uint8_t id, int16_t temp);
+
+/**
+ * @brief Get the latest reading of `id`
+ *
+ * @return ESP_ERR_NOT_FOUND before the first reading, ESP_ERR_TIMEOUT when older than CONFIG_FCTL_SENSOR_TIMEOUT_S
+ */
+esp_err_t sensor_get(uint8_t id, sensor_reading_t *reading);
+
+#ifdef __cplusplus
+}
+#endif
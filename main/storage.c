@@ -2,156 +2,228 @@
 #include "nvs_flash.h"
 #include "nvs.h"
 #include "esp_log.h"
+#include "device_state.h"
+#include "trace.h"
+#include "fan_curve.h"
+#include "fan_cal.h"
 
 #define STORAGE_NAMESPACE "storage"
 #define NVS_READ_STR_LENGTH 1024
 
 static const char *TAG_NVS = "NVS";
+int fan_get_setpoint(void);
 
 esp_err_t write_int(char *key, int32_t value)
 {
+    uint32_t start = trace_now();
     nvs_handle_t nvs_handle;
     esp_err_t res = nvs_open(STORAGE_NAMESPACE, NVS_READWRITE, &nvs_handle);
     if (res != ESP_OK)
     {
-        ESP_LOGI(TAG_NVS, "Error (%s) opening NVS handle!", esp_err_to_name(res));
+        ESP_LOGE(TAG_NVS, "Error (%s) opening NVS handle!", esp_err_to_name(res));
     }
     else
     {
         // Write
-        ESP_LOGI(TAG_NVS, "Updating %s in NVS ... ", key);
+        ESP_LOGD(TAG_NVS, "Updating %s in NVS ... ", key);
         res = nvs_set_i32(nvs_handle, key, value);
 
         if (res != ESP_OK)
         {
-            ESP_LOGI(TAG_NVS, "Error (%s) set!", esp_err_to_name(res));
+            ESP_LOGE(TAG_NVS, "Error (%s) set!", esp_err_to_name(res));
         }
         else
         {
-            ESP_LOGI(TAG_NVS, "Done set %s", key);
+            ESP_LOGD(TAG_NVS, "Done set %s", key);
         }
 
         // Commit written value.
         // After setting any values, nvs_commit() must be called to ensure changes are written
         // to flash storage. Implementations may write to storage at other times,
         // but this is not guaranteed.
-        ESP_LOGI(TAG_NVS, "Committing updates in NVS ... ");
+        ESP_LOGD(TAG_NVS, "Committing updates in NVS ... ");
         res = nvs_commit(nvs_handle);
         if (res != ESP_OK)
         {
-            ESP_LOGI(TAG_NVS, "Error (%s) commit!", esp_err_to_name(res));
+            ESP_LOGE(TAG_NVS, "Error (%s) commit!", esp_err_to_name(res));
         }
         else
         {
-            ESP_LOGI(TAG_NVS, "Done commit");
+            ESP_LOGD(TAG_NVS, "Done commit");
         }
 
         // Close
         nvs_close(nvs_handle);
     }
+    trace_span(TRACE_NVS_WRITE, start, trace_tag(key), res);
     return res;
 }
 
 esp_err_t read_int(char *key, int32_t *value)
 {
+    uint32_t start = trace_now();
     nvs_handle_t nvs_handle;
     esp_err_t res = nvs_open(STORAGE_NAMESPACE, NVS_READWRITE, &nvs_handle);
     if (res != ESP_OK)
     {
-        ESP_LOGI(TAG_NVS, "Error (%s) opening NVS handle!\n", esp_err_to_name(res));
+        ESP_LOGE(TAG_NVS, "Error (%s) opening NVS handle!\n", esp_err_to_name(res));
     }
     else
     {
-        ESP_LOGI(TAG_NVS, "Reading %s from NVS ... ", key);
+        ESP_LOGD(TAG_NVS, "Reading %s from NVS ... ", key);
         res = nvs_get_i32(nvs_handle, key, value);
         switch (res)
         {
         case ESP_OK:
-            ESP_LOGI(TAG_NVS, "Done, %s = %d", key, (int)*value);
+            ESP_LOGD(TAG_NVS, "Done, %s = %d", key, (int)*value);
             break;
         case ESP_ERR_NVS_NOT_FOUND:
-            ESP_LOGI(TAG_NVS, "The value is not initialized yet!\n");
+            ESP_LOGD(TAG_NVS, "The value is not initialized yet!\n");
             break;
         default:
-            ESP_LOGI(TAG_NVS, "Error reading %s: %s", key, esp_err_to_name(res));
+            ESP_LOGE(TAG_NVS, "Error reading %s: %s", key, esp_err_to_name(res));
         }
 
         nvs_close(nvs_handle);
     }
+    trace_span(TRACE_NVS_READ, start, trace_tag(key), res);
     return res;
 }
 
 esp_err_t write_str(char *key, char *value)
 {
+    uint32_t start = trace_now();
     nvs_handle_t nvs_handle;
     esp_err_t res = nvs_open(STORAGE_NAMESPACE, NVS_READWRITE, &nvs_handle);
     if (res != ESP_OK)
     {
-        ESP_LOGI(TAG_NVS, "Error (%s) opening NVS handle!", esp_err_to_name(res));
+        ESP_LOGE(TAG_NVS, "Error (%s) opening NVS handle!", esp_err_to_name(res));
     }
     else
     {
         // Write
-        ESP_LOGI(TAG_NVS, "Updating %s in NVS ... ", key);
+        ESP_LOGD(TAG_NVS, "Updating %s in NVS ... ", key);
         res = nvs_set_str(nvs_handle, key, value);
 
         if (res != ESP_OK)
         {
-            ESP_LOGI(TAG_NVS, "Error (%s) set!", esp_err_to_name(res));
+            ESP_LOGE(TAG_NVS, "Error (%s) set!", esp_err_to_name(res));
         }
         else
         {
-            ESP_LOGI(TAG_NVS, "Done set %s", key);
+            ESP_LOGD(TAG_NVS, "Done set %s", key);
         }
 
         // Commit written value.
         // After setting any values, nvs_commit() must be called to ensure changes are written
         // to flash storage. Implementations may write to storage at other times,
         // but this is not guaranteed.
-        ESP_LOGI(TAG_NVS, "Committing updates in NVS ... ");
+        ESP_LOGD(TAG_NVS, "Committing updates in NVS ... ");
         res = nvs_commit(nvs_handle);
         if (res != ESP_OK)
         {
-            ESP_LOGI(TAG_NVS, "Error (%s) commit!", esp_err_to_name(res));
+            ESP_LOGE(TAG_NVS, "Error (%s) commit!", esp_err_to_name(res));
         }
         else
         {
-            ESP_LOGI(TAG_NVS, "Done commit");
+            ESP_LOGD(TAG_NVS, "Done commit");
         }
 
         // Close
         nvs_close(nvs_handle);
     }
+    trace_span(TRACE_NVS_WRITE, start, trace_tag(key), res);
     return res;
 }
 
 esp_err_t read_str(char *key, char *value)
 {
+    uint32_t start = trace_now();
     nvs_handle_t nvs_handle;
     esp_err_t res = nvs_open(STORAGE_NAMESPACE, NVS_READWRITE, &nvs_handle);
     if (res != ESP_OK)
     {
-        ESP_LOGI(TAG_NVS, "Error (%s) opening NVS handle!\n", esp_err_to_name(res));
+        ESP_LOGE(TAG_NVS, "Error (%s) opening NVS handle!\n", esp_err_to_name(res));
     }
     else
     {
-        ESP_LOGI(TAG_NVS, "Reading %s from NVS ... ", key);
+        ESP_LOGD(TAG_NVS, "Reading %s from NVS ... ", key);
         size_t len = NVS_READ_STR_LENGTH;
         res = nvs_get_str(nvs_handle, key, value, &len);
         switch (res)
         {
         case ESP_OK:
-            ESP_LOGI(TAG_NVS, "Done, %s = %s", key, value);
+            ESP_LOGD(TAG_NVS, "Done, %s = %s", key, value);
             break;
         case ESP_ERR_NVS_NOT_FOUND:
-            ESP_LOGI(TAG_NVS, "The value is not initialized yet!");
+            ESP_LOGD(TAG_NVS, "The value is not initialized yet!");
             break;
         default:
-            ESP_LOGI(TAG_NVS, "Error reading %s: %s", key, esp_err_to_name(res));
+            ESP_LOGE(TAG_NVS, "Error reading %s: %s", key, esp_err_to_name(res));
         }
 
         nvs_close(nvs_handle);
     }
+    trace_span(TRACE_NVS_READ, start, trace_tag(key), res);
+    return res;
+}
+
+esp_err_t write_blob(char *key, const void *value, size_t length)
+{
+    uint32_t start = trace_now();
+    nvs_handle_t nvs_handle;
+    esp_err_t res = nvs_open(STORAGE_NAMESPACE, NVS_READWRITE, &nvs_handle);
+    if (res != ESP_OK)
+    {
+        ESP_LOGE(TAG_NVS, "Error (%s) opening NVS handle!", esp_err_to_name(res));
+    }
+    else
+    {
+        ESP_LOGD(TAG_NVS, "Updating %s in NVS, %u bytes ... ", key, (unsigned)length);
+        res = nvs_set_blob(nvs_handle, key, value, length);
+        if (res == ESP_OK)
+        {
+            res = nvs_commit(nvs_handle);
+        }
+        if (res != ESP_OK)
+        {
+            ESP_LOGE(TAG_NVS, "Error (%s) writing %s!", esp_err_to_name(res), key);
+        }
+        nvs_close(nvs_handle);
+    }
+    trace_span(TRACE_NVS_WRITE, start, trace_tag(key), res);
+    return res;
+}
+
+/* `length` is the size of `value` on entry, of the blob on return */
+esp_err_t read_blob(char *key, void *value, size_t *length)
+{
+    uint32_t start = trace_now();
+    nvs_handle_t nvs_handle;
+    esp_err_t res = nvs_open(STORAGE_NAMESPACE, NVS_READWRITE, &nvs_handle);
+    if (res != ESP_OK)
+    {
+        ESP_LOGE(TAG_NVS, "Error (%s) opening NVS handle!", esp_err_to_name(res));
+    }
+    else
+    {
+        ESP_LOGD(TAG_NVS, "Reading %s from NVS ... ", key);
+        res = nvs_get_blob(nvs_handle, key, value, length);
+        switch (res)
+        {
+        case ESP_OK:
+            ESP_LOGD(TAG_NVS, "Done, %s is %u bytes", key, (unsigned)*length);
+            break;
+        case ESP_ERR_NVS_NOT_FOUND:
+            ESP_LOGD(TAG_NVS, "The value is not initialized yet!");
+            break;
+        default:
+            ESP_LOGE(TAG_NVS, "Error reading %s: %s", key, esp_err_to_name(res));
+        }
+
+        nvs_close(nvs_handle);
+    }
+    trace_span(TRACE_NVS_READ, start, trace_tag(key), res);
     return res;
 }
 
@@ -175,6 +247,42 @@ esp_err_t write_ssid(char *ssid)
     return write_str("ssid", ssid);
 }
 
+void load_device_name(void)
+{
+    char name[NVS_READ_STR_LENGTH];
+    if (read_str("name", name) == ESP_OK)
+    {
+        device_state_set_name(name);
+    }
+}
+
+static void state_persist_handler(void *arg, esp_event_base_t event_base, int32_t event_id, void *event_data)
+{
+    device_state_event_t *event = (device_state_event_t *)event_data;
+    if (!(event->changed & (DEVICE_STATE_SPEED | DEVICE_STATE_NAME)))
+    {
+        return;
+    }
+
+    device_state_t state;
+    device_state_get(&state);
+    // speeds driven by the fan curve or a calibration sweep are not worth a flash write,
+    // the state holds the failsafe speed while it is latched and the setpoint is stored instead
+    if ((event->changed & DEVICE_STATE_SPEED) && !fan_curve_enabled() && !fan_cal_running())
+    {
+        write_fan_speed(fan_get_setpoint());
+    }
+    if (event->changed & DEVICE_STATE_NAME)
+    {
+        write_str("name", state.name);
+    }
+}
+
+esp_err_t start_state_persistence(void)
+{
+    return device_state_subscribe(state_persist_handler, NULL);
+}
+
 void init_nvs(void)
 {
     // Initialize NVS
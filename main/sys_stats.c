@@ -0,0 +1,187 @@
+#include <string.h>
+#include "sdkconfig.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/timers.h"
+#include "freertos/semphr.h"
+#include "esp_heap_caps.h"
+#include "esp_timer.h"
+#include "esp_check.h"
+#include "esp_log.h"
+#include "sys_stats.h"
+
+#define STATUS_MAX_TASKS 40 // uxTaskGetSystemState fails if the array cannot hold every task
+#define FINE_SLOTS 10       // run time counters of the last 10 samples
+#define COARSE_SLOTS 7      // one every FINE_SLOTS samples, the oldest is 60 to 69 samples back
+
+#define SYS_STATS_SUPPORTED (CONFIG_FREERTOS_USE_TRACE_FACILITY && CONFIG_FREERTOS_GENERATE_RUN_TIME_STATS)
+
+static const char *TAG_STATS = "SYS_STATS";
+
+static SemaphoreHandle_t s_lock = NULL;
+static sys_stats_t s_stats;
+
+#if SYS_STATS_SUPPORTED
+/*
+ * Run time counter history of a task. A window is the difference between the current
+ * counter and the one recorded at its start, divided by the total run time elapsed meanwhile.
+ */
+typedef struct
+{
+    TaskHandle_t handle;
+    UBaseType_t number; // handles of deleted tasks are reused, task numbers are not
+    bool seen;
+    uint32_t fine[FINE_SLOTS];
+    uint32_t coarse[COARSE_SLOTS];
+} task_history_t;
+
+static TaskStatus_t s_status[STATUS_MAX_TASKS];
+static task_history_t s_history[SYS_STATS_MAX_TASKS];
+static task_history_t s_total; // total run time, same layout
+
+static void history_fill(task_history_t *history, uint32_t value)
+{
+    for (int i = 0; i < FINE_SLOTS; i++)
+    {
+        history->fine[i] = value;
+    }
+    for (int i = 0; i < COARSE_SLOTS; i++)
+    {
+        history->coarse[i] = value;
+    }
+}
+
+/* counter deltas over the windows ending at sample `n`, then record `now` */
+static void history_push(task_history_t *history, uint32_t n, uint32_t now, uint32_t delta[SYS_STATS_WINDOWS])
+{
+    delta[0] = now - history->fine[(n + FINE_SLOTS - 1) % FINE_SLOTS];
+    delta[1] = now - history->fine[n % FINE_SLOTS];
+    history->fine[n % FINE_SLOTS] = now;
+    if (n % FINE_SLOTS == 0)
+    {
+        history->coarse[(n / FINE_SLOTS) % COARSE_SLOTS] = now;
+    }
+    delta[2] = now - history->coarse[(n / FINE_SLOTS + 1) % COARSE_SLOTS];
+}
+
+static task_history_t *history_find(const TaskStatus_t *status, uint32_t n)
+{
+    task_history_t *free_slot = NULL;
+    for (int i = 0; i < SYS_STATS_MAX_TASKS; i++)
+    {
+        task_history_t *history = &s_history[i];
+        if (history->handle == status->xHandle && history->number == status->xTaskNumber)
+        {
+            return history;
+        }
+        if (!history->handle && !free_slot)
+        {
+            free_slot = history;
+        }
+    }
+    if (free_slot)
+    {
+        free_slot->handle = status->xHandle;
+        free_slot->number = status->xTaskNumber;
+        // tasks seen on the first sample may have run for a while, later ones start from zero
+        history_fill(free_slot, n == 0 ? status->ulRunTimeCounter : 0);
+    }
+    return free_slot;
+}
+
+static void sample(TimerHandle_t timer)
+{
+    // the timer task must not block: while a reader copies the stats this sample is skipped, the windows stretch by one
+    if (xSemaphoreTake(s_lock, 0) != pdTRUE)
+    {
+        return;
+    }
+    int64_t start = esp_timer_get_time();
+
+    uint32_t total = 0;
+    UBaseType_t count = uxTaskGetSystemState(s_status, STATUS_MAX_TASKS, &total);
+    multi_heap_info_t heap;
+    heap_caps_get_info(&heap, MALLOC_CAP_8BIT);
+
+    uint32_t n = s_stats.samples;
+    if (n == 0)
+    {
+        history_fill(&s_total, total);
+    }
+    uint32_t total_delta[SYS_STATS_WINDOWS];
+    history_push(&s_total, n, total, total_delta);
+
+    for (int i = 0; i < SYS_STATS_MAX_TASKS; i++)
+    {
+        s_history[i].seen = false;
+    }
+    s_stats.num_tasks = 0;
+    s_stats.dropped_tasks = count == 0 ? uxTaskGetNumberOfTasks() : 0;
+    for (UBaseType_t i = 0; i < count; i++)
+    {
+        const TaskStatus_t *status = &s_status[i];
+        task_history_t *history = history_find(status, n);
+        if (!history)
+        {
+            s_stats.dropped_tasks++;
+            continue;
+        }
+        history->seen = true;
+
+        uint32_t delta[SYS_STATS_WINDOWS];
+        history_push(history, n, status->ulRunTimeCounter, delta);
+        sys_task_stats_t *task = &s_stats.tasks[s_stats.num_tasks++];
+        strlcpy(task->name, status->pcTaskName, sizeof(task->name));
+        task->priority = status->uxCurrentPriority;
+        task->core = status->xCoreID == tskNO_AFFINITY ? -1 : status->xCoreID;
+        task->stack_free = status->usStackHighWaterMark;
+        for (int w = 0; w < SYS_STATS_WINDOWS; w++)
+        {
+            task->cpu[w] = total_delta[w] ? 100.0f * delta[w] / total_delta[w] : 0;
+        }
+    }
+    // forget deleted tasks
+    for (int i = 0; i < SYS_STATS_MAX_TASKS; i++)
+    {
+        if (!s_history[i].seen)
+        {
+            s_history[i].handle = NULL;
+        }
+    }
+
+    s_stats.heap_free = heap.total_free_bytes;
+    s_stats.heap_min_free = heap.minimum_free_bytes;
+    s_stats.heap_largest_block = heap.largest_free_block;
+    s_stats.heap_fragmentation = heap.total_free_bytes ? 100 - heap.largest_free_block * 100 / heap.total_free_bytes : 0;
+    s_stats.samples = n + 1;
+    s_stats.sample_us = (uint32_t)(esp_timer_get_time() - start);
+    xSemaphoreGive(s_lock);
+}
+#endif
+
+esp_err_t sys_stats_start(void)
+{
+#if SYS_STATS_SUPPORTED
+    s_lock = xSemaphoreCreateMutex();
+    ESP_RETURN_ON_FALSE(s_lock, ESP_ERR_NO_MEM, TAG_STATS, "no memory for mutex");
+    s_stats.period_ms = CONFIG_FCTL_SYS_STATS_PERIOD_MS;
+
+    // the timer task runs at priority 1, sampling never delays control or API tasks
+    TimerHandle_t timer = xTimerCreate("sys_stats", pdMS_TO_TICKS(CONFIG_FCTL_SYS_STATS_PERIOD_MS), pdTRUE, NULL, sample);
+    ESP_RETURN_ON_FALSE(timer, ESP_ERR_NO_MEM, TAG_STATS, "create timer failed");
+    ESP_RETURN_ON_FALSE(xTimerStart(timer, portMAX_DELAY) == pdPASS, ESP_FAIL, TAG_STATS, "start timer failed");
+    return ESP_OK;
+#else
+    ESP_LOGW(TAG_STATS, "enable FREERTOS_USE_TRACE_FACILITY and FREERTOS_GENERATE_RUN_TIME_STATS");
+    return ESP_ERR_NOT_SUPPORTED;
+#endif
+}
+
+esp_err_t sys_stats_get(sys_stats_t *stats)
+{
+    ESP_RETURN_ON_FALSE(s_lock, ESP_ERR_INVALID_STATE, TAG_STATS, "not started");
+    xSemaphoreTake(s_lock, portMAX_DELAY);
+    *stats = s_stats;
+    xSemaphoreGive(s_lock);
+    return stats->samples ? ESP_OK : ESP_ERR_INVALID_STATE;
+}
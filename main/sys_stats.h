@@ -0,0 +1,57 @@
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+#include "esp_err.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define SYS_STATS_MAX_TASKS 24
+#define SYS_STATS_WINDOWS 3 // last period, last 10 periods, last 60 periods
+
+/**
+ * @brief Usage of one task
+ */
+typedef struct {
+    char name[16];
+    uint32_t priority;
+    int32_t core;                   /*!< Core the task is pinned to, -1 for no affinity */
+    uint32_t stack_free;            /*!< Minimum free stack since the task started, in bytes */
+    float cpu[SYS_STATS_WINDOWS];   /*!< Percent of one core over the last 1, 10 and 60 periods */
+} sys_task_stats_t;
+
+/**
+ * @brief Last sample of the system statistics
+ */
+typedef struct {
+    uint32_t samples;            /*!< Number of samples taken */
+    uint32_t period_ms;          /*!< Sampling period */
+    uint32_t sample_us;          /*!< Cost of the last sample */
+    uint32_t heap_free;          /*!< Free heap, in bytes */
+    uint32_t heap_min_free;      /*!< Lowest free heap since boot, in bytes */
+    uint32_t heap_largest_block; /*!< Largest allocatable block, in bytes */
+    uint32_t heap_fragmentation; /*!< Percent of the free heap not in the largest block */
+    uint32_t dropped_tasks;      /*!< Tasks not tracked because SYS_STATS_MAX_TASKS was reached */
+    size_t num_tasks;
+    sys_task_stats_t tasks[SYS_STATS_MAX_TASKS];
+} sys_stats_t;
+
+/**
+ * @brief Start sampling every CONFIG_FCTL_SYS_STATS_PERIOD_MS on the FreeRTOS timer task
+ *
+ * Requires CONFIG_FREERTOS_USE_TRACE_FACILITY and CONFIG_FREERTOS_GENERATE_RUN_TIME_STATS.
+ */
+esp_err_t sys_stats_start(void);
+
+/**
+ * @brief Copy the last sample
+ *
+ * @return ESP_ERR_INVALID_STATE if no sample was taken yet
+ */
+esp_err_t sys_stats_get(sys_stats_t *stats);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,46 @@
+#include "sdkconfig.h"
+#include "esp_check.h"
+#include "esp_log.h"
+#include "task_plan.h"
+
+#define DEFAULT_PRIORITY 5 // of httpd and event loop tasks when nothing is configured
+
+static const char *TAG_PLAN = "TASK_PLAN";
+
+static const task_placement_t s_plan[TASK_ROLE_MAX] = {
+    [TASK_ROLE_CONTROL] = {CONFIG_FCTL_CONTROL_CORE, CONFIG_FCTL_CONTROL_PRIORITY},
+    [TASK_ROLE_NETWORK] = {CONFIG_FCTL_NETWORK_CORE, CONFIG_FCTL_NETWORK_PRIORITY},
+    [TASK_ROLE_BOOT] = {tskNO_AFFINITY, DEFAULT_PRIORITY},
+    [TASK_ROLE_BACKGROUND] = {tskNO_AFFINITY, CONFIG_FCTL_BACKGROUND_PRIORITY},
+    [TASK_ROLE_FAILSAFE] = {CONFIG_FCTL_CONTROL_CORE, CONFIG_FCTL_FAILSAFE_PRIORITY},
+};
+
+static bool s_enabled = CONFIG_FCTL_TASK_PLAN;
+
+task_placement_t task_plan_get(task_role_t role)
+{
+    if (!s_enabled || role >= TASK_ROLE_MAX)
+    {
+        // the failsafe keeps its priority, it must preempt whatever hangs
+        return (task_placement_t){tskNO_AFFINITY, role == TASK_ROLE_FAILSAFE ? CONFIG_FCTL_FAILSAFE_PRIORITY : DEFAULT_PRIORITY};
+    }
+    task_placement_t placement = s_plan[role];
+#if CONFIG_FREERTOS_UNICORE
+    placement.core = tskNO_AFFINITY;
+#endif
+    return placement;
+}
+
+esp_err_t task_plan_create(TaskFunction_t fn, const char *name, uint32_t stack, void *arg, task_role_t role, TaskHandle_t *handle)
+{
+    task_placement_t placement = task_plan_get(role);
+    ESP_RETURN_ON_FALSE(xTaskCreatePinnedToCore(fn, name, stack, arg, placement.priority, handle, placement.core) == pdPASS,
+                        ESP_ERR_NO_MEM, TAG_PLAN, "create task %s failed", name);
+    ESP_LOGD(TAG_PLAN, "%s on core %d, priority %u", name, (int)placement.core, (unsigned)placement.priority);
+    return ESP_OK;
+}
+
+void task_plan_set_enabled(bool enabled)
+{
+    s_enabled = enabled;
+}
@@ -0,0 +1,55 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "esp_err.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @brief What a task does, decides its core and priority
+ */
+typedef enum {
+    TASK_ROLE_CONTROL,    /*!< Tach interrupt and control loop, on the application core */
+    TASK_ROLE_NETWORK,    /*!< httpd, next to Wi-Fi and lwIP on the protocol core */
+    TASK_ROLE_BOOT,       /*!< Boot workers */
+    TASK_ROLE_BACKGROUND, /*!< Persistence and logging, at idle priority */
+    TASK_ROLE_FAILSAFE,   /*!< Thermal failsafe, above the control loop on its core */
+    TASK_ROLE_MAX,
+} task_role_t;
+
+/**
+ * @brief Core and priority of a role
+ */
+typedef struct {
+    BaseType_t core;      /*!< Core the tasks are pinned to, or tskNO_AFFINITY */
+    UBaseType_t priority; /*!< FreeRTOS priority */
+} task_placement_t;
+
+/**
+ * @brief Get the placement of `role`
+ */
+task_placement_t task_plan_get(task_role_t role);
+
+/**
+ * @brief Create a task placed according to its role
+ *
+ * Every task of the firmware is created here.
+ */
+esp_err_t task_plan_create(TaskFunction_t fn, const char *name, uint32_t stack, void *arg, task_role_t role, TaskHandle_t *handle);
+
+/**
+ * @brief Use the plan, or leave every task unpinned at the default priority
+ *
+ * Defaults to CONFIG_FCTL_TASK_PLAN. Only takes effect on tasks created afterwards,
+ * meant to be called before app_main to compare both.
+ */
+void task_plan_set_enabled(bool enabled);
+
+#ifdef __cplusplus
+}
+#endif
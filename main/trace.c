@@ -0,0 +1,137 @@
+#include <string.h>
+#include <stdatomic.h>
+#include "sdkconfig.h"
+#include "freertos/FreeRTOS.h"
+#include "esp_check.h"
+#include "trace.h"
+
+#define TRACE_EVENTS CONFIG_FCTL_TRACE_EVENTS_PER_CORE
+#define TRACE_VERSION 1
+#define TRACE_FLAG_INSTANT 0x01
+#define DUMP_CHUNK_EVENTS 32
+
+_Static_assert((TRACE_EVENTS & (TRACE_EVENTS - 1)) == 0, "CONFIG_FCTL_TRACE_EVENTS_PER_CORE must be a power of two");
+
+static const char *TAG_TRACE = "TRACE";
+
+/* name(a0,a1) of every trace_id_t, the labels name the arguments in the converted trace */
+static const char *const trace_names[TRACE_ID_MAX] = {
+    [TRACE_FAN_SPEED] = "fan_speed(speed,duty)",
+    [TRACE_NVS_READ] = "nvs_read(key,err)",
+    [TRACE_NVS_WRITE] = "nvs_write(key,err)",
+    [TRACE_LED_FRAME] = "led_frame(frame,cost_us)",
+};
+
+/* record as dumped, little endian */
+typedef struct __attribute__((packed))
+{
+    uint32_t ts_us;
+    uint32_t dur_us;
+    uint16_t id;
+    uint8_t core;
+    uint8_t flags;
+    uint32_t a0;
+    uint32_t a1;
+} trace_record_t;
+
+/* seq is the slot's event index + 1 once the record is complete, 0 while it is written */
+typedef struct
+{
+    atomic_uint seq;
+    trace_record_t record;
+} trace_slot_t;
+
+typedef struct __attribute__((packed))
+{
+    char magic[4];
+    uint16_t version;
+    uint16_t num_ids;
+    uint16_t num_cores;
+    uint16_t record_size;
+    uint64_t now_us; // to unwrap the 32-bit timestamps
+} trace_header_t;
+
+static trace_slot_t s_rings[portNUM_PROCESSORS][TRACE_EVENTS];
+static atomic_uint s_heads[portNUM_PROCESSORS];
+
+static void record(trace_id_t id, uint32_t ts_us, uint32_t dur_us, uint8_t flags, uint32_t a0, uint32_t a1)
+{
+    // a task moved to the other core meanwhile still gets a slot of its own
+    BaseType_t core = xPortGetCoreID();
+    unsigned index = atomic_fetch_add_explicit(&s_heads[core], 1, memory_order_relaxed);
+    trace_slot_t *slot = &s_rings[core][index & (TRACE_EVENTS - 1)];
+
+    atomic_store_explicit(&slot->seq, 0, memory_order_relaxed);
+    atomic_thread_fence(memory_order_release);
+    slot->record = (trace_record_t){
+        .ts_us = ts_us,
+        .dur_us = dur_us,
+        .id = id,
+        .core = core,
+        .flags = flags,
+        .a0 = a0,
+        .a1 = a1,
+    };
+    atomic_store_explicit(&slot->seq, index + 1, memory_order_release);
+}
+
+void trace_instant(trace_id_t id, uint32_t a0, uint32_t a1)
+{
+    record(id, trace_now(), 0, TRACE_FLAG_INSTANT, a0, a1);
+}
+
+void trace_span(trace_id_t id, uint32_t start_us, uint32_t a0, uint32_t a1)
+{
+    record(id, start_us, trace_now() - start_us, 0, a0, a1);
+}
+
+esp_err_t trace_dump(esp_err_t (*write)(void *ctx, const void *data, size_t len), void *ctx)
+{
+    ESP_RETURN_ON_FALSE(write, ESP_ERR_INVALID_ARG, TAG_TRACE, "invalid argument");
+
+    trace_header_t header = {
+        .magic = {'F', 'T', 'R', 'C'},
+        .version = TRACE_VERSION,
+        .num_ids = TRACE_ID_MAX,
+        .num_cores = portNUM_PROCESSORS,
+        .record_size = sizeof(trace_record_t),
+        .now_us = esp_timer_get_time(),
+    };
+    ESP_RETURN_ON_ERROR(write(ctx, &header, sizeof(header)), TAG_TRACE, "write failed");
+    for (int i = 0; i < TRACE_ID_MAX; i++)
+    {
+        uint8_t len = strlen(trace_names[i]);
+        ESP_RETURN_ON_ERROR(write(ctx, &len, 1), TAG_TRACE, "write failed");
+        ESP_RETURN_ON_ERROR(write(ctx, trace_names[i], len), TAG_TRACE, "write failed");
+    }
+
+    trace_record_t chunk[DUMP_CHUNK_EVENTS];
+    for (int core = 0; core < portNUM_PROCESSORS; core++)
+    {
+        unsigned head = atomic_load_explicit(&s_heads[core], memory_order_acquire);
+        unsigned index = head > TRACE_EVENTS ? head - TRACE_EVENTS : 0;
+        size_t n = 0;
+        for (; index != head; index++)
+        {
+            trace_slot_t *slot = &s_rings[core][index & (TRACE_EVENTS - 1)];
+            unsigned seq = atomic_load_explicit(&slot->seq, memory_order_acquire);
+            chunk[n] = slot->record;
+            atomic_thread_fence(memory_order_acquire);
+            // skip records being written or already overwritten by a newer event
+            if (seq != index + 1 || atomic_load_explicit(&slot->seq, memory_order_relaxed) != seq)
+            {
+                continue;
+            }
+            if (++n == DUMP_CHUNK_EVENTS)
+            {
+                ESP_RETURN_ON_ERROR(write(ctx, chunk, n * sizeof(chunk[0])), TAG_TRACE, "write failed");
+                n = 0;
+            }
+        }
+        if (n)
+        {
+            ESP_RETURN_ON_ERROR(write(ctx, chunk, n * sizeof(chunk[0])), TAG_TRACE, "write failed");
+        }
+    }
+    return ESP_OK;
+}
@@ -0,0 +1,66 @@
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+#include "esp_err.h"
+#include "esp_timer.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @brief Traced events, names and argument labels are in the dump
+ */
+typedef enum {
+    TRACE_FAN_SPEED, /*!< Instant, a0 speed, a1 LEDC duty */
+    TRACE_NVS_READ,  /*!< Span, a0 trace_tag() of the key, a1 result */
+    TRACE_NVS_WRITE, /*!< Span, a0 trace_tag() of the key, a1 result */
+    TRACE_LED_FRAME, /*!< Span, a0 frame number, a1 CPU cost in microseconds */
+    TRACE_ID_MAX,
+} trace_id_t;
+
+/**
+ * @brief Timestamp to pass to trace_span(), in microseconds since boot, wraps after 71 minutes
+ */
+static inline uint32_t trace_now(void)
+{
+    return (uint32_t)esp_timer_get_time();
+}
+
+/**
+ * @brief Pack the first 4 characters of `str` into an event argument
+ */
+static inline uint32_t trace_tag(const char *str)
+{
+    uint32_t tag = 0;
+    for (int i = 0; i < 4 && str[i]; i++)
+    {
+        tag |= (uint32_t)(uint8_t)str[i] << (8 * i);
+    }
+    return tag;
+}
+
+/**
+ * @brief Record an event without duration
+ *
+ * Lock-free and never blocks: the event goes to the ring of the calling core,
+ * overwriting the oldest one once CONFIG_FCTL_TRACE_EVENTS_PER_CORE are recorded.
+ */
+void trace_instant(trace_id_t id, uint32_t a0, uint32_t a1);
+
+/**
+ * @brief Record an event that started at `start_us` (from trace_now()) and ends now
+ */
+void trace_span(trace_id_t id, uint32_t start_us, uint32_t a0, uint32_t a1);
+
+/**
+ * @brief Write the rings in the binary format read by tools/trace_to_chrome.py
+ *
+ * Events recorded while dumping may be missing. Stops at the first error of `write`.
+ */
+esp_err_t trace_dump(esp_err_t (*write)(void *ctx, const void *data, size_t len), void *ctx);
+
+#ifdef __cplusplus
+}
+#endif
@@ -7,6 +7,7 @@
 #include "freertos/task.h"
 #include "freertos/event_groups.h"
 #include "string.h"
+#include "device_state.h"
 
 #define AP_SSID "fctl"
 #define AP_PWD "12345678"
@@ -49,6 +50,7 @@ void wifi_event_handler(void *arg, esp_event_base_t event_base, int32_t event_id
             break;
         case WIFI_EVENT_STA_DISCONNECTED:
             ESP_LOGI(TAG_WIFI, "sta disconnected");
+            device_state_set_connected(false);
             wifi_mode_t mode;
             esp_wifi_get_mode(&mode);
             if (wifi_retry_num < WIFI_MAXIMUM_RETRY)
@@ -103,6 +105,7 @@ void wifi_event_handler(void *arg, esp_event_base_t event_base, int32_t event_id
             ip_event_got_ip_t *event = (ip_event_got_ip_t *)event_data;
             ESP_LOGI(TAG_WIFI, "got ip:" IPSTR, IP2STR(&event->ip_info.ip));
             wifi_retry_num = 0;
+            device_state_set_connected(true);
             xEventGroupSetBits(s_wifi_event_group, WIFI_CONNECTED_BIT);
         }
     }
@@ -143,12 +146,11 @@ uint16_t wifi_scan(wifi_ap_record_t *ap_info, uint16_t size)
 void config_sta(char *ssid, char *password)
 {
     wifi_retry_num = 0;
-    ESP_LOGI(TAG_WIFI, "start wifi sta mode, ssid: %s, password: %s", ssid, password);
     esp_wifi_disconnect();
 
     strncpy((char *)sta_config.sta.ssid, ssid, 32);
     strncpy((char *)sta_config.sta.password, password, 64);
-    ESP_LOGI(TAG_WIFI, "ssid: %s, password: %s", (char *)sta_config.sta.ssid, (char *)sta_config.sta.password);
+    ESP_LOGI(TAG_WIFI, "start wifi sta mode, ssid: %.32s", (char *)sta_config.sta.ssid);
 
     esp_err_t err = esp_wifi_set_config(ESP_IF_WIFI_STA, &sta_config);
     if (ESP_OK != err)
@@ -172,6 +174,7 @@ void config_sta(char *ssid, char *password)
 void stop_ap(void)
 {
     ESP_ERROR_CHECK(esp_wifi_set_mode(WIFI_MODE_STA));
+    device_state_set_wifi_mode(WIFI_MODE_STA);
 }
 
 void init_wifi(void)
@@ -188,6 +191,7 @@ void init_wifi(void)
     ESP_ERROR_CHECK(esp_wifi_init(&cfg));
 
     ESP_ERROR_CHECK(esp_event_handler_register(WIFI_EVENT, ESP_EVENT_ANY_ID, &wifi_event_handler, NULL));
+    ESP_ERROR_CHECK(esp_event_handler_register(IP_EVENT, IP_EVENT_STA_GOT_IP, &wifi_event_handler, NULL));
 
     const char *ssid = AP_SSID;
     const char *password = AP_PWD;
@@ -197,6 +201,7 @@ void init_wifi(void)
     ap_config.ap.max_connection = 16;
 
     ESP_ERROR_CHECK(esp_wifi_set_mode(WIFI_MODE_APSTA));
+    device_state_set_wifi_mode(WIFI_MODE_APSTA);
     ESP_ERROR_CHECK(esp_wifi_set_config(ESP_IF_WIFI_AP, &ap_config));
     // ESP_ERROR_CHECK(esp_wifi_set_config(ESP_IF_WIFI_STA, &sta_config));
 
@@ -0,0 +1,71 @@
+#include <stdio.h>
+#include <time.h>
+#include "led_color.h"
+
+#define BENCH_PIXELS 1024
+#define BENCH_ROUNDS 2000
+
+static double now_s(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static led_hsv_t hsv[BENCH_PIXELS];
+static led_rgb_t rgb[BENCH_PIXELS];
+static volatile uint32_t sink;
+
+static void report(const char *name, double seconds)
+{
+    printf("%-16s %8.2f Mpixel/s\n", name, (double)BENCH_PIXELS * BENCH_ROUNDS / seconds / 1e6);
+}
+
+int main(void)
+{
+    for (int i = 0; i < BENCH_PIXELS; i++)
+    {
+        hsv[i] = (led_hsv_t){.h = (i * 7) % 360, .s = 100, .v = (i * 3) % 101};
+    }
+
+    double t = now_s();
+    for (int n = 0; n < BENCH_ROUNDS; n++)
+    {
+        for (int i = 0; i < BENCH_PIXELS; i++)
+        {
+            uint32_t r, g, b;
+            led_strip_hsv2rgb(hsv[i].h, hsv[i].s, hsv[i].v, &r, &g, &b);
+            sink += r + g + b;
+        }
+    }
+    report("float", now_s() - t);
+
+    t = now_s();
+    for (int n = 0; n < BENCH_ROUNDS; n++)
+    {
+        for (int i = 0; i < BENCH_PIXELS; i++)
+        {
+            led_rgb_t c = led_color_hsv2rgb(hsv[i].h, hsv[i].s, hsv[i].v);
+            sink += c.r + c.g + c.b;
+        }
+    }
+    report("integer", now_s() - t);
+
+    t = now_s();
+    for (int n = 0; n < BENCH_ROUNDS; n++)
+    {
+        led_color_hsv2rgb_span(hsv, rgb, BENCH_PIXELS);
+        sink += rgb[n % BENCH_PIXELS].r;
+    }
+    report("integer span", now_s() - t);
+
+    t = now_s();
+    for (int n = 0; n < BENCH_ROUNDS; n++)
+    {
+        led_color_hsv2rgb_span(hsv, rgb, BENCH_PIXELS);
+        led_color_gamma_span(rgb, BENCH_PIXELS, 255);
+        sink += rgb[n % BENCH_PIXELS].r;
+    }
+    report("span + gamma", now_s() - t);
+    return 0;
+}
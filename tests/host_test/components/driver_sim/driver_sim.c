@@ -0,0 +1,658 @@
+/*
+ * Simulated LEDC, GPIO and RMT TX.
+ *
+ * LEDC latches duties in memory. The tach input is fed by a thread that either plays a
+ * scripted waveform or runs a first order fan model driven by LEDC channel 0, whose duty
+ * is inverted like on the board (duty 0 is full speed). The model stops below a minimum
+ * drive and needs a higher one to start again. RMT TX encodes synchronously,
+ * keeps a copy of the payload and fires the done callback before rmt_transmit returns.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <pthread.h>
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "driver/gpio.h"
+#include "driver/ledc.h"
+#include "driver/rmt_tx.h"
+#include "sim_driver.h"
+
+#define TACH_STEP_MS 1
+#define TACH_SCRIPT_MAX_STEPS 64
+
+static const char *TAG = "driver_sim";
+static pthread_mutex_t s_lock = PTHREAD_MUTEX_INITIALIZER;
+
+/* LEDC */
+
+typedef struct
+{
+    bool configured;
+    uint32_t max_duty;
+    uint32_t pending;
+    uint32_t duty;
+    int64_t updated_us;
+} sim_ledc_channel_t;
+
+static ledc_timer_bit_t s_ledc_timer_res[LEDC_SPEED_MODE_MAX][LEDC_TIMER_MAX];
+static uint32_t s_ledc_timer_freq[LEDC_SPEED_MODE_MAX][LEDC_TIMER_MAX];
+static sim_ledc_channel_t s_ledc[LEDC_SPEED_MODE_MAX][LEDC_CHANNEL_MAX];
+
+esp_err_t ledc_timer_config(const ledc_timer_config_t *timer_conf)
+{
+    if (!timer_conf || timer_conf->speed_mode >= LEDC_SPEED_MODE_MAX || timer_conf->timer_num >= LEDC_TIMER_MAX ||
+        timer_conf->duty_resolution < LEDC_TIMER_1_BIT || timer_conf->duty_resolution >= LEDC_TIMER_BIT_MAX)
+    {
+        return ESP_ERR_INVALID_ARG;
+    }
+    pthread_mutex_lock(&s_lock);
+    s_ledc_timer_res[timer_conf->speed_mode][timer_conf->timer_num] = timer_conf->duty_resolution;
+    s_ledc_timer_freq[timer_conf->speed_mode][timer_conf->timer_num] = timer_conf->freq_hz;
+    pthread_mutex_unlock(&s_lock);
+    return ESP_OK;
+}
+
+esp_err_t ledc_channel_config(const ledc_channel_config_t *ledc_conf)
+{
+    if (!ledc_conf || ledc_conf->speed_mode >= LEDC_SPEED_MODE_MAX || ledc_conf->channel >= LEDC_CHANNEL_MAX ||
+        ledc_conf->timer_sel >= LEDC_TIMER_MAX)
+    {
+        return ESP_ERR_INVALID_ARG;
+    }
+    pthread_mutex_lock(&s_lock);
+    ledc_timer_bit_t res = s_ledc_timer_res[ledc_conf->speed_mode][ledc_conf->timer_sel];
+    if (res == 0)
+    {
+        pthread_mutex_unlock(&s_lock);
+        ESP_LOGE(TAG, "LEDC timer %d not configured", ledc_conf->timer_sel);
+        return ESP_ERR_INVALID_STATE;
+    }
+    sim_ledc_channel_t *chan = &s_ledc[ledc_conf->speed_mode][ledc_conf->channel];
+    chan->configured = true;
+    chan->max_duty = (1U << res) - 1;
+    chan->pending = ledc_conf->duty;
+    chan->duty = ledc_conf->duty;
+    chan->updated_us = esp_timer_get_time();
+    pthread_mutex_unlock(&s_lock);
+    return ESP_OK;
+}
+
+static sim_ledc_channel_t *ledc_channel(ledc_mode_t speed_mode, ledc_channel_t channel)
+{
+    if (speed_mode >= LEDC_SPEED_MODE_MAX || channel >= LEDC_CHANNEL_MAX || !s_ledc[speed_mode][channel].configured)
+    {
+        return NULL;
+    }
+    return &s_ledc[speed_mode][channel];
+}
+
+esp_err_t ledc_set_duty(ledc_mode_t speed_mode, ledc_channel_t channel, uint32_t duty)
+{
+    esp_err_t err = ESP_OK;
+    pthread_mutex_lock(&s_lock);
+    sim_ledc_channel_t *chan = ledc_channel(speed_mode, channel);
+    if (!chan || duty > chan->max_duty + 1)
+    {
+        err = ESP_ERR_INVALID_ARG;
+    }
+    else
+    {
+        chan->pending = duty;
+    }
+    pthread_mutex_unlock(&s_lock);
+    return err;
+}
+
+esp_err_t ledc_update_duty(ledc_mode_t speed_mode, ledc_channel_t channel)
+{
+    esp_err_t err = ESP_OK;
+    pthread_mutex_lock(&s_lock);
+    sim_ledc_channel_t *chan = ledc_channel(speed_mode, channel);
+    if (!chan)
+    {
+        err = ESP_ERR_INVALID_ARG;
+    }
+    else
+    {
+        chan->duty = chan->pending;
+        chan->updated_us = esp_timer_get_time();
+    }
+    pthread_mutex_unlock(&s_lock);
+    return err;
+}
+
+uint32_t ledc_get_duty(ledc_mode_t speed_mode, ledc_channel_t channel)
+{
+    pthread_mutex_lock(&s_lock);
+    sim_ledc_channel_t *chan = ledc_channel(speed_mode, channel);
+    uint32_t duty = chan ? chan->duty : 0;
+    pthread_mutex_unlock(&s_lock);
+    return duty;
+}
+
+uint32_t ledc_get_freq(ledc_mode_t speed_mode, ledc_timer_t timer_num)
+{
+    if (speed_mode >= LEDC_SPEED_MODE_MAX || timer_num >= LEDC_TIMER_MAX)
+    {
+        return 0;
+    }
+    return s_ledc_timer_freq[speed_mode][timer_num];
+}
+
+esp_err_t ledc_stop(ledc_mode_t speed_mode, ledc_channel_t channel, uint32_t idle_level)
+{
+    esp_err_t err = ESP_OK;
+    pthread_mutex_lock(&s_lock);
+    sim_ledc_channel_t *chan = ledc_channel(speed_mode, channel);
+    if (!chan)
+    {
+        err = ESP_ERR_INVALID_ARG;
+    }
+    else
+    {
+        chan->duty = idle_level ? chan->max_duty + 1 : 0;
+        chan->pending = chan->duty;
+        chan->updated_us = esp_timer_get_time();
+    }
+    pthread_mutex_unlock(&s_lock);
+    return err;
+}
+
+void sim_ledc_get(ledc_mode_t speed_mode, ledc_channel_t channel, uint32_t *duty, int64_t *updated_us)
+{
+    pthread_mutex_lock(&s_lock);
+    sim_ledc_channel_t *chan = ledc_channel(speed_mode, channel);
+    if (duty)
+    {
+        *duty = chan ? chan->duty : 0;
+    }
+    if (updated_us)
+    {
+        *updated_us = chan ? chan->updated_us : 0;
+    }
+    pthread_mutex_unlock(&s_lock);
+}
+
+/* GPIO */
+
+typedef struct
+{
+    gpio_mode_t mode;
+    gpio_int_type_t intr_type;
+    uint32_t level;
+    gpio_isr_t isr;
+    void *isr_arg;
+} sim_gpio_t;
+
+static sim_gpio_t s_gpio[GPIO_NUM_MAX];
+static bool s_isr_service;
+
+static void tach_start(void);
+
+esp_err_t gpio_config(const gpio_config_t *pGPIOConfig)
+{
+    if (!pGPIOConfig || pGPIOConfig->pin_bit_mask >> GPIO_NUM_MAX)
+    {
+        return ESP_ERR_INVALID_ARG;
+    }
+    pthread_mutex_lock(&s_lock);
+    for (int i = 0; i < GPIO_NUM_MAX; i++)
+    {
+        if (pGPIOConfig->pin_bit_mask & (1ULL << i))
+        {
+            s_gpio[i].mode = pGPIOConfig->mode;
+            s_gpio[i].intr_type = pGPIOConfig->intr_type;
+        }
+    }
+    pthread_mutex_unlock(&s_lock);
+    return ESP_OK;
+}
+
+esp_err_t gpio_reset_pin(gpio_num_t gpio_num)
+{
+    if (gpio_num < 0 || gpio_num >= GPIO_NUM_MAX)
+    {
+        return ESP_ERR_INVALID_ARG;
+    }
+    pthread_mutex_lock(&s_lock);
+    memset(&s_gpio[gpio_num], 0, sizeof(s_gpio[gpio_num]));
+    pthread_mutex_unlock(&s_lock);
+    return ESP_OK;
+}
+
+esp_err_t gpio_set_intr_type(gpio_num_t gpio_num, gpio_int_type_t intr_type)
+{
+    if (gpio_num < 0 || gpio_num >= GPIO_NUM_MAX)
+    {
+        return ESP_ERR_INVALID_ARG;
+    }
+    pthread_mutex_lock(&s_lock);
+    s_gpio[gpio_num].intr_type = intr_type;
+    pthread_mutex_unlock(&s_lock);
+    return ESP_OK;
+}
+
+esp_err_t gpio_install_isr_service(int intr_alloc_flags)
+{
+    pthread_mutex_lock(&s_lock);
+    bool installed = s_isr_service;
+    s_isr_service = true;
+    pthread_mutex_unlock(&s_lock);
+    if (installed)
+    {
+        return ESP_ERR_INVALID_STATE;
+    }
+    tach_start();
+    return ESP_OK;
+}
+
+void gpio_uninstall_isr_service(void)
+{
+    pthread_mutex_lock(&s_lock);
+    s_isr_service = false;
+    pthread_mutex_unlock(&s_lock);
+}
+
+esp_err_t gpio_isr_handler_add(gpio_num_t gpio_num, gpio_isr_t isr_handler, void *args)
+{
+    if (gpio_num < 0 || gpio_num >= GPIO_NUM_MAX)
+    {
+        return ESP_ERR_INVALID_ARG;
+    }
+    pthread_mutex_lock(&s_lock);
+    esp_err_t err = s_isr_service ? ESP_OK : ESP_ERR_INVALID_STATE;
+    if (err == ESP_OK)
+    {
+        s_gpio[gpio_num].isr = isr_handler;
+        s_gpio[gpio_num].isr_arg = args;
+    }
+    pthread_mutex_unlock(&s_lock);
+    return err;
+}
+
+esp_err_t gpio_isr_handler_remove(gpio_num_t gpio_num)
+{
+    if (gpio_num < 0 || gpio_num >= GPIO_NUM_MAX)
+    {
+        return ESP_ERR_INVALID_ARG;
+    }
+    pthread_mutex_lock(&s_lock);
+    s_gpio[gpio_num].isr = NULL;
+    pthread_mutex_unlock(&s_lock);
+    return ESP_OK;
+}
+
+esp_err_t gpio_set_level(gpio_num_t gpio_num, uint32_t level)
+{
+    if (gpio_num < 0 || gpio_num >= GPIO_NUM_MAX)
+    {
+        return ESP_ERR_INVALID_ARG;
+    }
+    pthread_mutex_lock(&s_lock);
+    s_gpio[gpio_num].level = level ? 1 : 0;
+    pthread_mutex_unlock(&s_lock);
+    return ESP_OK;
+}
+
+int gpio_get_level(gpio_num_t gpio_num)
+{
+    if (gpio_num < 0 || gpio_num >= GPIO_NUM_MAX)
+    {
+        return 0;
+    }
+    pthread_mutex_lock(&s_lock);
+    int level = s_gpio[gpio_num].level;
+    pthread_mutex_unlock(&s_lock);
+    return level;
+}
+
+/* tach */
+
+static gpio_num_t s_tach_gpio = SIM_TACH_GPIO_DEFAULT;
+static sim_tach_step_t s_script[TACH_SCRIPT_MAX_STEPS];
+static size_t s_script_len;
+static size_t s_script_pos;
+static uint32_t s_script_elapsed_ms;
+static bool s_script_loop;
+static double s_tach_rpm;
+static pthread_once_t s_tach_once = PTHREAD_ONCE_INIT;
+
+void sim_tach_set_gpio(gpio_num_t gpio_num)
+{
+    pthread_mutex_lock(&s_lock);
+    s_tach_gpio = gpio_num;
+    pthread_mutex_unlock(&s_lock);
+}
+
+void sim_tach_set_script(const sim_tach_step_t *steps, size_t num_steps, bool loop)
+{
+    pthread_mutex_lock(&s_lock);
+    s_script_len = num_steps < TACH_SCRIPT_MAX_STEPS ? num_steps : TACH_SCRIPT_MAX_STEPS;
+    memcpy(s_script, steps, s_script_len * sizeof(*steps));
+    s_script_pos = 0;
+    s_script_elapsed_ms = 0;
+    s_script_loop = loop;
+    pthread_mutex_unlock(&s_lock);
+}
+
+uint32_t sim_tach_get_rpm(void)
+{
+    pthread_mutex_lock(&s_lock);
+    uint32_t rpm = (uint32_t)(s_tach_rpm + 0.5);
+    pthread_mutex_unlock(&s_lock);
+    return rpm;
+}
+
+static void tach_load_script_env(void)
+{
+    const char *env = getenv("FCTL_TACH_SCRIPT");
+    if (!env)
+    {
+        return;
+    }
+    sim_tach_step_t steps[TACH_SCRIPT_MAX_STEPS];
+    size_t n = 0;
+    const char *p = env;
+    unsigned ms, rpm;
+    int used;
+    while (n < TACH_SCRIPT_MAX_STEPS && sscanf(p, "%u:%u%n", &ms, &rpm, &used) == 2)
+    {
+        steps[n++] = (sim_tach_step_t){.duration_ms = ms, .rpm = rpm};
+        p += used;
+        if (*p != ',')
+        {
+            break;
+        }
+        p++;
+    }
+    ESP_LOGI(TAG, "tach script: %d steps", (int)n);
+    sim_tach_set_script(steps, n, false);
+}
+
+/* rpm the tach should report now, called with s_lock held every TACH_STEP_MS */
+static double tach_target_rpm(bool *scripted)
+{
+    while (s_script_pos < s_script_len && s_script_elapsed_ms >= s_script[s_script_pos].duration_ms)
+    {
+        s_script_elapsed_ms = 0;
+        if (++s_script_pos == s_script_len && s_script_loop)
+        {
+            s_script_pos = 0;
+        }
+    }
+    if (s_script_pos < s_script_len)
+    {
+        s_script_elapsed_ms += TACH_STEP_MS;
+        *scripted = true;
+        return s_script[s_script_pos].rpm;
+    }
+
+    *scripted = false;
+    sim_ledc_channel_t *pwm = ledc_channel(LEDC_HIGH_SPEED_MODE, LEDC_CHANNEL_0);
+    if (!pwm)
+    {
+        return 0;
+    }
+    double drive = (double)(pwm->max_duty - (pwm->duty > pwm->max_duty ? pwm->max_duty : pwm->duty)) / pwm->max_duty;
+    // a stopped fan needs more drive to start than it needs to keep turning
+    double threshold = s_tach_rpm < 1 ? SIM_FAN_START_DRIVE : SIM_FAN_RUN_DRIVE;
+    return drive >= threshold ? drive * SIM_FAN_MAX_RPM : 0;
+}
+
+static void *tach_task(void *arg)
+{
+    pthread_setname_np(pthread_self(), "sim_tach");
+    double phase = 0;
+    struct timespec next;
+    clock_gettime(CLOCK_MONOTONIC, &next);
+    for (;;)
+    {
+        next.tv_nsec += TACH_STEP_MS * 1000000L;
+        if (next.tv_nsec >= 1000000000L)
+        {
+            next.tv_nsec -= 1000000000L;
+            next.tv_sec++;
+        }
+        clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &next, NULL);
+
+        pthread_mutex_lock(&s_lock);
+        bool scripted;
+        double target = tach_target_rpm(&scripted);
+        if (scripted)
+        {
+            s_tach_rpm = target;
+        }
+        else
+        {
+            s_tach_rpm += (target - s_tach_rpm) * TACH_STEP_MS / SIM_FAN_TIME_CONSTANT_MS;
+        }
+        phase += s_tach_rpm * SIM_TACH_PULSES_PER_REV * TACH_STEP_MS / 60000.0;
+        int pulses = (int)phase;
+        phase -= pulses;
+
+        gpio_isr_t isr = NULL;
+        void *isr_arg = NULL;
+        if (s_isr_service && s_tach_gpio >= 0 && s_tach_gpio < GPIO_NUM_MAX)
+        {
+            sim_gpio_t *pin = &s_gpio[s_tach_gpio];
+            if (pin->intr_type != GPIO_INTR_DISABLE)
+            {
+                isr = pin->isr;
+                isr_arg = pin->isr_arg;
+            }
+        }
+        pthread_mutex_unlock(&s_lock);
+
+        for (int i = 0; isr && i < pulses; i++)
+        {
+            isr(isr_arg);
+        }
+    }
+    return NULL;
+}
+
+static void tach_init_once(void)
+{
+    tach_load_script_env();
+    pthread_t thread;
+    pthread_create(&thread, NULL, tach_task, NULL);
+    pthread_detach(thread);
+}
+
+static void tach_start(void)
+{
+    pthread_once(&s_tach_once, tach_init_once);
+}
+
+/* RMT TX */
+
+struct rmt_channel_t
+{
+    int gpio_num;
+    bool enabled;
+    rmt_tx_done_callback_t on_trans_done;
+    void *user_data;
+};
+
+typedef struct
+{
+    rmt_encoder_t base;
+    size_t symbols_per_byte;
+} sim_encoder_t;
+
+static uint8_t *s_rmt_frame;
+static size_t s_rmt_frame_len;
+static uint32_t s_rmt_frames;
+
+static size_t sim_encode(rmt_encoder_t *encoder, rmt_channel_handle_t tx_channel, const void *primary_data, size_t data_size,
+                         rmt_encode_state_t *ret_state)
+{
+    sim_encoder_t *sim = __containerof(encoder, sim_encoder_t, base);
+    *ret_state = RMT_ENCODING_COMPLETE;
+    // the copy encoder takes whole symbols
+    return sim->symbols_per_byte ? data_size * sim->symbols_per_byte : data_size / sizeof(rmt_symbol_word_t);
+}
+
+static esp_err_t sim_encoder_reset(rmt_encoder_t *encoder)
+{
+    return ESP_OK;
+}
+
+static esp_err_t sim_encoder_del(rmt_encoder_t *encoder)
+{
+    free(__containerof(encoder, sim_encoder_t, base));
+    return ESP_OK;
+}
+
+static esp_err_t sim_encoder_new(size_t symbols_per_byte, rmt_encoder_handle_t *ret_encoder)
+{
+    if (!ret_encoder)
+    {
+        return ESP_ERR_INVALID_ARG;
+    }
+    sim_encoder_t *sim = calloc(1, sizeof(*sim));
+    if (!sim)
+    {
+        return ESP_ERR_NO_MEM;
+    }
+    sim->base.encode = sim_encode;
+    sim->base.reset = sim_encoder_reset;
+    sim->base.del = sim_encoder_del;
+    sim->symbols_per_byte = symbols_per_byte;
+    *ret_encoder = &sim->base;
+    return ESP_OK;
+}
+
+esp_err_t rmt_new_bytes_encoder(const rmt_bytes_encoder_config_t *config, rmt_encoder_handle_t *ret_encoder)
+{
+    return sim_encoder_new(8, ret_encoder);
+}
+
+esp_err_t rmt_new_copy_encoder(const rmt_copy_encoder_config_t *config, rmt_encoder_handle_t *ret_encoder)
+{
+    return sim_encoder_new(0, ret_encoder);
+}
+
+esp_err_t rmt_del_encoder(rmt_encoder_handle_t encoder)
+{
+    return encoder ? encoder->del(encoder) : ESP_ERR_INVALID_ARG;
+}
+
+esp_err_t rmt_encoder_reset(rmt_encoder_handle_t encoder)
+{
+    return encoder ? encoder->reset(encoder) : ESP_ERR_INVALID_ARG;
+}
+
+esp_err_t rmt_new_tx_channel(const rmt_tx_channel_config_t *config, rmt_channel_handle_t *ret_chan)
+{
+    if (!config || !ret_chan || config->resolution_hz == 0)
+    {
+        return ESP_ERR_INVALID_ARG;
+    }
+    struct rmt_channel_t *chan = calloc(1, sizeof(*chan));
+    if (!chan)
+    {
+        return ESP_ERR_NO_MEM;
+    }
+    chan->gpio_num = config->gpio_num;
+    *ret_chan = chan;
+    return ESP_OK;
+}
+
+esp_err_t rmt_tx_register_event_callbacks(rmt_channel_handle_t tx_channel, const rmt_tx_event_callbacks_t *cbs, void *user_data)
+{
+    if (!tx_channel || !cbs)
+    {
+        return ESP_ERR_INVALID_ARG;
+    }
+    tx_channel->on_trans_done = cbs->on_trans_done;
+    tx_channel->user_data = user_data;
+    return ESP_OK;
+}
+
+esp_err_t rmt_enable(rmt_channel_handle_t channel)
+{
+    if (!channel)
+    {
+        return ESP_ERR_INVALID_ARG;
+    }
+    channel->enabled = true;
+    return ESP_OK;
+}
+
+esp_err_t rmt_disable(rmt_channel_handle_t channel)
+{
+    if (!channel)
+    {
+        return ESP_ERR_INVALID_ARG;
+    }
+    channel->enabled = false;
+    return ESP_OK;
+}
+
+esp_err_t rmt_del_channel(rmt_channel_handle_t channel)
+{
+    free(channel);
+    return ESP_OK;
+}
+
+esp_err_t rmt_transmit(rmt_channel_handle_t tx_channel, rmt_encoder_handle_t encoder, const void *payload, size_t payload_bytes,
+                       const rmt_transmit_config_t *config)
+{
+    if (!tx_channel || !encoder || !payload || !config)
+    {
+        return ESP_ERR_INVALID_ARG;
+    }
+    if (!tx_channel->enabled)
+    {
+        return ESP_ERR_INVALID_STATE;
+    }
+
+    rmt_tx_done_event_data_t edata = {0};
+    rmt_encode_state_t state = RMT_ENCODING_RESET;
+    do
+    {
+        edata.num_symbols += encoder->encode(encoder, tx_channel, payload, payload_bytes, &state);
+    } while (!(state & RMT_ENCODING_COMPLETE));
+
+    pthread_mutex_lock(&s_lock);
+    uint8_t *frame = realloc(s_rmt_frame, payload_bytes);
+    if (frame)
+    {
+        memcpy(frame, payload, payload_bytes);
+        s_rmt_frame = frame;
+        s_rmt_frame_len = payload_bytes;
+        s_rmt_frames++;
+    }
+    pthread_mutex_unlock(&s_lock);
+
+    if (tx_channel->on_trans_done)
+    {
+        tx_channel->on_trans_done(tx_channel, &edata, tx_channel->user_data);
+    }
+    return ESP_OK;
+}
+
+esp_err_t rmt_tx_wait_all_done(rmt_channel_handle_t tx_channel, int timeout_ms)
+{
+    return tx_channel ? ESP_OK : ESP_ERR_INVALID_ARG;
+}
+
+uint32_t sim_rmt_get_last_frame(uint8_t *buf, size_t size, size_t *len)
+{
+    pthread_mutex_lock(&s_lock);
+    size_t n = s_rmt_frame_len < size ? s_rmt_frame_len : size;
+    if (buf && n)
+    {
+        memcpy(buf, s_rmt_frame, n);
+    }
+    if (len)
+    {
+        *len = s_rmt_frame_len;
+    }
+    uint32_t frames = s_rmt_frames;
+    pthread_mutex_unlock(&s_lock);
+    return frames;
+}
@@ -0,0 +1,62 @@
+/*
+ * Hooks into the simulated peripherals, for host tests and benchmarks
+ */
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+#include "driver/ledc.h"
+#include "driver/gpio.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define SIM_TACH_GPIO_DEFAULT 26     // GPIO_RPM of rpm.c
+#define SIM_TACH_PULSES_PER_REV 2
+#define SIM_FAN_MAX_RPM 3000         // fan model speed at 100% drive
+#define SIM_FAN_TIME_CONSTANT_MS 400 // fan model spin-up/spin-down time constant
+#define SIM_FAN_RUN_DRIVE 0.20       // lowest drive keeping the fan model turning
+#define SIM_FAN_START_DRIVE 0.30     // lowest drive starting it from standstill
+
+/**
+ * @brief One step of a scripted tach waveform
+ */
+typedef struct {
+    uint32_t duration_ms; /*!< Time this step lasts */
+    uint32_t rpm;         /*!< Rotation speed reported by the tach during the step */
+} sim_tach_step_t;
+
+/**
+ * @brief Get the duty last latched by ledc_update_duty and the esp_timer time it was latched at
+ */
+void sim_ledc_get(ledc_mode_t speed_mode, ledc_channel_t channel, uint32_t *duty, int64_t *updated_us);
+
+/**
+ * @brief Select the GPIO the tach pulses are delivered to
+ */
+void sim_tach_set_gpio(gpio_num_t gpio_num);
+
+/**
+ * @brief Play a tach waveform instead of the fan model
+ *
+ * The fan model, driven by the inverted duty of LEDC channel 0, resumes after the last step
+ * unless `loop` is set. A script can also be given with FCTL_TACH_SCRIPT="ms:rpm,ms:rpm,...".
+ */
+void sim_tach_set_script(const sim_tach_step_t *steps, size_t num_steps, bool loop);
+
+/**
+ * @brief Get the rpm the tach currently generates
+ */
+uint32_t sim_tach_get_rpm(void);
+
+/**
+ * @brief Copy the payload of the last RMT transmission
+ *
+ * @return Number of transmissions since start, 0 if nothing was sent
+ */
+uint32_t sim_rmt_get_last_frame(uint8_t *buf, size_t size, size_t *len);
+
+#ifdef __cplusplus
+}
+#endif
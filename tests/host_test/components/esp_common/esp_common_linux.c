@@ -0,0 +1,218 @@
+/*
+ * esp_err, esp_log, esp_random and heap_caps on the Linux host
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#include <malloc.h>
+#include <time.h>
+#include "sdkconfig.h"
+#include "esp_err.h"
+#include "esp_log.h"
+#include "esp_random.h"
+#include "esp_heap_caps.h"
+
+#define SIM_HEAP_SIZE (320 * 1024)
+#define LOG_TAG_LEVELS 16
+
+typedef struct
+{
+    esp_err_t code;
+    const char *name;
+} esp_err_msg_t;
+
+static const esp_err_msg_t esp_err_msg_table[] = {
+    {ESP_OK, "ESP_OK"},
+    {ESP_FAIL, "ESP_FAIL"},
+    {ESP_ERR_NO_MEM, "ESP_ERR_NO_MEM"},
+    {ESP_ERR_INVALID_ARG, "ESP_ERR_INVALID_ARG"},
+    {ESP_ERR_INVALID_STATE, "ESP_ERR_INVALID_STATE"},
+    {ESP_ERR_INVALID_SIZE, "ESP_ERR_INVALID_SIZE"},
+    {ESP_ERR_NOT_FOUND, "ESP_ERR_NOT_FOUND"},
+    {ESP_ERR_NOT_SUPPORTED, "ESP_ERR_NOT_SUPPORTED"},
+    {ESP_ERR_TIMEOUT, "ESP_ERR_TIMEOUT"},
+    {ESP_ERR_INVALID_RESPONSE, "ESP_ERR_INVALID_RESPONSE"},
+    {ESP_ERR_INVALID_CRC, "ESP_ERR_INVALID_CRC"},
+    {ESP_ERR_INVALID_VERSION, "ESP_ERR_INVALID_VERSION"},
+    {ESP_ERR_NOT_FINISHED, "ESP_ERR_NOT_FINISHED"},
+    {ESP_ERR_NVS_NOT_INITIALIZED, "ESP_ERR_NVS_NOT_INITIALIZED"},
+    {ESP_ERR_NVS_NOT_FOUND, "ESP_ERR_NVS_NOT_FOUND"},
+    {ESP_ERR_NVS_TYPE_MISMATCH, "ESP_ERR_NVS_TYPE_MISMATCH"},
+    {ESP_ERR_NVS_READ_ONLY, "ESP_ERR_NVS_READ_ONLY"},
+    {ESP_ERR_NVS_INVALID_HANDLE, "ESP_ERR_NVS_INVALID_HANDLE"},
+    {ESP_ERR_NVS_INVALID_LENGTH, "ESP_ERR_NVS_INVALID_LENGTH"},
+    {ESP_ERR_NVS_NO_FREE_PAGES, "ESP_ERR_NVS_NO_FREE_PAGES"},
+    {ESP_ERR_NVS_NEW_VERSION_FOUND, "ESP_ERR_NVS_NEW_VERSION_FOUND"},
+};
+
+const char *esp_err_to_name(esp_err_t code)
+{
+    for (size_t i = 0; i < sizeof(esp_err_msg_table) / sizeof(esp_err_msg_table[0]); i++)
+    {
+        if (esp_err_msg_table[i].code == code)
+        {
+            return esp_err_msg_table[i].name;
+        }
+    }
+    return "UNKNOWN ERROR";
+}
+
+void _esp_error_check_failed(esp_err_t rc, const char *file, int line, const char *function, const char *expression)
+{
+    fprintf(stderr, "ESP_ERROR_CHECK failed: esp_err_t 0x%x (%s) at %s:%d\nfunction: %s\nexpression: %s\n",
+            rc, esp_err_to_name(rc), file, line, function, expression);
+    abort();
+}
+
+/* log */
+
+static vprintf_like_t s_log_vprintf = &vprintf;
+static esp_log_level_t s_log_default_level = CONFIG_LOG_DEFAULT_LEVEL;
+static struct
+{
+    char tag[32];
+    esp_log_level_t level;
+} s_log_tag_levels[LOG_TAG_LEVELS];
+static pthread_mutex_t s_log_lock = PTHREAD_MUTEX_INITIALIZER;
+
+vprintf_like_t esp_log_set_vprintf(vprintf_like_t func)
+{
+    pthread_mutex_lock(&s_log_lock);
+    vprintf_like_t orig = s_log_vprintf;
+    s_log_vprintf = func;
+    pthread_mutex_unlock(&s_log_lock);
+    return orig;
+}
+
+void esp_log_level_set(const char *tag, esp_log_level_t level)
+{
+    pthread_mutex_lock(&s_log_lock);
+    if (strcmp(tag, "*") == 0)
+    {
+        s_log_default_level = level;
+        memset(s_log_tag_levels, 0, sizeof(s_log_tag_levels));
+    }
+    else
+    {
+        for (int i = 0; i < LOG_TAG_LEVELS; i++)
+        {
+            if (s_log_tag_levels[i].tag[0] == '\0' || strcmp(s_log_tag_levels[i].tag, tag) == 0)
+            {
+                strncpy(s_log_tag_levels[i].tag, tag, sizeof(s_log_tag_levels[i].tag) - 1);
+                s_log_tag_levels[i].level = level;
+                break;
+            }
+        }
+    }
+    pthread_mutex_unlock(&s_log_lock);
+}
+
+esp_log_level_t esp_log_level_get(const char *tag)
+{
+    esp_log_level_t level = s_log_default_level;
+    pthread_mutex_lock(&s_log_lock);
+    for (int i = 0; i < LOG_TAG_LEVELS && s_log_tag_levels[i].tag[0]; i++)
+    {
+        if (strcmp(s_log_tag_levels[i].tag, tag) == 0)
+        {
+            level = s_log_tag_levels[i].level;
+            break;
+        }
+    }
+    pthread_mutex_unlock(&s_log_lock);
+    return level;
+}
+
+static struct timespec s_log_start;
+
+__attribute__((constructor)) static void esp_log_init_timestamp(void)
+{
+    clock_gettime(CLOCK_MONOTONIC, &s_log_start);
+}
+
+uint32_t esp_log_timestamp(void)
+{
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (uint32_t)((now.tv_sec - s_log_start.tv_sec) * 1000 + (now.tv_nsec - s_log_start.tv_nsec) / 1000000);
+}
+
+void esp_log_writev(esp_log_level_t level, const char *tag, const char *format, va_list args)
+{
+    if (level > esp_log_level_get(tag))
+    {
+        return;
+    }
+    s_log_vprintf(format, args);
+}
+
+void esp_log_write(esp_log_level_t level, const char *tag, const char *format, ...)
+{
+    va_list args;
+    va_start(args, format);
+    esp_log_writev(level, tag, format, args);
+    va_end(args);
+}
+
+/* random */
+
+uint32_t esp_random(void)
+{
+    return (uint32_t)random();
+}
+
+/* heap, backed by malloc with a fixed nominal heap size */
+
+static size_t s_min_free = SIM_HEAP_SIZE;
+
+void *heap_caps_malloc(size_t size, uint32_t caps)
+{
+    return malloc(size);
+}
+
+void *heap_caps_calloc(size_t n, size_t size, uint32_t caps)
+{
+    return calloc(n, size);
+}
+
+void heap_caps_free(void *ptr)
+{
+    free(ptr);
+}
+
+size_t heap_caps_get_free_size(uint32_t caps)
+{
+    struct mallinfo2 info = mallinfo2();
+    size_t used = info.uordblks < SIM_HEAP_SIZE ? info.uordblks : SIM_HEAP_SIZE;
+    size_t free_size = SIM_HEAP_SIZE - used;
+    if (free_size < s_min_free)
+    {
+        s_min_free = free_size;
+    }
+    return free_size;
+}
+
+size_t heap_caps_get_minimum_free_size(uint32_t caps)
+{
+    heap_caps_get_free_size(caps);
+    return s_min_free;
+}
+
+size_t heap_caps_get_largest_free_block(uint32_t caps)
+{
+    return heap_caps_get_free_size(caps);
+}
+
+void heap_caps_get_info(multi_heap_info_t *info, uint32_t caps)
+{
+    struct mallinfo2 mi = mallinfo2();
+    memset(info, 0, sizeof(*info));
+    info->total_free_bytes = heap_caps_get_free_size(caps);
+    info->total_allocated_bytes = SIM_HEAP_SIZE - info->total_free_bytes;
+    info->largest_free_block = info->total_free_bytes;
+    info->minimum_free_bytes = s_min_free;
+    info->free_blocks = mi.ordblks;
+    info->allocated_blocks = 0;
+    info->total_blocks = mi.ordblks;
+}
@@ -0,0 +1,13 @@
+#pragma once
+
+#define IRAM_ATTR
+#define DRAM_ATTR
+#define IRAM_DATA_ATTR
+#define RTC_DATA_ATTR
+#define RTC_NOINIT_ATTR
+#define NOINLINE_ATTR __attribute__((noinline))
+#define FORCE_INLINE_ATTR static inline __attribute__((always_inline))
+
+#ifndef __containerof
+#define __containerof(ptr, type, member) ((type *)((char *)(ptr) - __builtin_offsetof(type, member)))
+#endif
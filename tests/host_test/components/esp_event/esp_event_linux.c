@@ -0,0 +1,310 @@
+/*
+ * esp_event on the Linux host: each loop owns a FreeRTOS queue and a dispatch task.
+ * Event data is copied on post, exactly like the target implementation.
+ */
+#include <stdlib.h>
+#include <string.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/queue.h"
+#include "esp_event.h"
+
+#define DEFAULT_LOOP_QUEUE_SIZE 32
+#define DEFAULT_LOOP_TASK_STACK 2304
+#define DEFAULT_LOOP_TASK_PRIORITY 20
+
+typedef struct handler_node
+{
+    esp_event_base_t base;
+    int32_t id;
+    esp_event_handler_t handler;
+    void *arg;
+    struct handler_node *next;
+} handler_node_t;
+
+typedef struct
+{
+    esp_event_base_t base;
+    int32_t id;
+    void *data;
+} event_post_t;
+
+typedef struct
+{
+    QueueHandle_t queue;
+    TaskHandle_t task;
+    portMUX_TYPE lock;
+    handler_node_t *handlers;
+} event_loop_t;
+
+static event_loop_t *s_default_loop = NULL;
+
+static void event_loop_task(void *arg)
+{
+    event_loop_t *loop = arg;
+    event_post_t post;
+    for (;;)
+    {
+        if (xQueueReceive(loop->queue, &post, portMAX_DELAY) != pdTRUE)
+        {
+            continue;
+        }
+        // handlers run with the lock held so that unregistering waits for a running handler
+        portENTER_CRITICAL(&loop->lock);
+        for (handler_node_t *node = loop->handlers; node; node = node->next)
+        {
+            bool base_match = node->base == ESP_EVENT_ANY_BASE || node->base == post.base;
+            bool id_match = node->id == ESP_EVENT_ANY_ID || node->id == post.id;
+            if (base_match && id_match)
+            {
+                node->handler(node->arg, post.base, post.id, post.data);
+            }
+        }
+        portEXIT_CRITICAL(&loop->lock);
+        free(post.data);
+    }
+}
+
+esp_err_t esp_event_loop_create(const esp_event_loop_args_t *event_loop_args, esp_event_loop_handle_t *event_loop)
+{
+    if (!event_loop_args || !event_loop || event_loop_args->queue_size <= 0)
+    {
+        return ESP_ERR_INVALID_ARG;
+    }
+    event_loop_t *loop = calloc(1, sizeof(*loop));
+    if (!loop)
+    {
+        return ESP_ERR_NO_MEM;
+    }
+    portMUX_INITIALIZE(&loop->lock);
+    loop->queue = xQueueCreate(event_loop_args->queue_size, sizeof(event_post_t));
+    if (!loop->queue)
+    {
+        free(loop);
+        return ESP_ERR_NO_MEM;
+    }
+    if (event_loop_args->task_name)
+    {
+        if (xTaskCreatePinnedToCore(event_loop_task, event_loop_args->task_name, event_loop_args->task_stack_size, loop,
+                                    event_loop_args->task_priority, &loop->task, event_loop_args->task_core_id) != pdPASS)
+        {
+            vQueueDelete(loop->queue);
+            free(loop);
+            return ESP_FAIL;
+        }
+    }
+    *event_loop = loop;
+    return ESP_OK;
+}
+
+esp_err_t esp_event_loop_delete(esp_event_loop_handle_t event_loop)
+{
+    event_loop_t *loop = event_loop;
+    if (loop->task)
+    {
+        vTaskDelete(loop->task);
+    }
+    for (handler_node_t *node = loop->handlers, *next; node; node = next)
+    {
+        next = node->next;
+        free(node);
+    }
+    vQueueDelete(loop->queue);
+    free(loop);
+    return ESP_OK;
+}
+
+esp_err_t esp_event_loop_create_default(void)
+{
+    if (s_default_loop)
+    {
+        return ESP_ERR_INVALID_STATE;
+    }
+    esp_event_loop_args_t loop_args = {
+        .queue_size = DEFAULT_LOOP_QUEUE_SIZE,
+        .task_name = "sys_evt",
+        .task_priority = DEFAULT_LOOP_TASK_PRIORITY,
+        .task_stack_size = DEFAULT_LOOP_TASK_STACK,
+        .task_core_id = 0};
+    esp_event_loop_handle_t loop;
+    esp_err_t err = esp_event_loop_create(&loop_args, &loop);
+    if (err == ESP_OK)
+    {
+        s_default_loop = loop;
+    }
+    return err;
+}
+
+esp_err_t esp_event_loop_delete_default(void)
+{
+    if (!s_default_loop)
+    {
+        return ESP_ERR_INVALID_STATE;
+    }
+    esp_event_loop_delete(s_default_loop);
+    s_default_loop = NULL;
+    return ESP_OK;
+}
+
+esp_err_t esp_event_handler_instance_register_with(esp_event_loop_handle_t event_loop, esp_event_base_t event_base, int32_t event_id,
+                                                   esp_event_handler_t event_handler, void *event_handler_arg,
+                                                   esp_event_handler_instance_t *instance)
+{
+    event_loop_t *loop = event_loop;
+    if (!loop || !event_handler)
+    {
+        return ESP_ERR_INVALID_ARG;
+    }
+    handler_node_t *node = calloc(1, sizeof(*node));
+    if (!node)
+    {
+        return ESP_ERR_NO_MEM;
+    }
+    node->base = event_base;
+    node->id = event_id;
+    node->handler = event_handler;
+    node->arg = event_handler_arg;
+
+    // handlers are called in registration order
+    portENTER_CRITICAL(&loop->lock);
+    handler_node_t **it = &loop->handlers;
+    while (*it)
+    {
+        it = &(*it)->next;
+    }
+    *it = node;
+    portEXIT_CRITICAL(&loop->lock);
+    if (instance)
+    {
+        *instance = node;
+    }
+    return ESP_OK;
+}
+
+esp_err_t esp_event_handler_register_with(esp_event_loop_handle_t event_loop, esp_event_base_t event_base, int32_t event_id,
+                                          esp_event_handler_t event_handler, void *event_handler_arg)
+{
+    return esp_event_handler_instance_register_with(event_loop, event_base, event_id, event_handler, event_handler_arg, NULL);
+}
+
+esp_err_t esp_event_handler_register(esp_event_base_t event_base, int32_t event_id,
+                                     esp_event_handler_t event_handler, void *event_handler_arg)
+{
+    if (!s_default_loop)
+    {
+        return ESP_ERR_INVALID_STATE;
+    }
+    return esp_event_handler_register_with(s_default_loop, event_base, event_id, event_handler, event_handler_arg);
+}
+
+esp_err_t esp_event_handler_instance_register(esp_event_base_t event_base, int32_t event_id, esp_event_handler_t event_handler,
+                                              void *event_handler_arg, esp_event_handler_instance_t *instance)
+{
+    if (!s_default_loop)
+    {
+        return ESP_ERR_INVALID_STATE;
+    }
+    return esp_event_handler_instance_register_with(s_default_loop, event_base, event_id, event_handler, event_handler_arg, instance);
+}
+
+static esp_err_t handler_unregister(event_loop_t *loop, esp_event_base_t event_base, int32_t event_id,
+                                    esp_event_handler_t event_handler, handler_node_t *instance)
+{
+    if (!loop)
+    {
+        return ESP_ERR_INVALID_ARG;
+    }
+    esp_err_t err = ESP_ERR_NOT_FOUND;
+    portENTER_CRITICAL(&loop->lock);
+    for (handler_node_t **it = &loop->handlers; *it; it = &(*it)->next)
+    {
+        handler_node_t *node = *it;
+        bool match = instance ? node == instance
+                              : node->base == event_base && node->id == event_id && node->handler == event_handler;
+        if (match)
+        {
+            *it = node->next;
+            free(node);
+            err = ESP_OK;
+            break;
+        }
+    }
+    portEXIT_CRITICAL(&loop->lock);
+    return err;
+}
+
+esp_err_t esp_event_handler_unregister_with(esp_event_loop_handle_t event_loop, esp_event_base_t event_base, int32_t event_id,
+                                            esp_event_handler_t event_handler)
+{
+    return handler_unregister(event_loop, event_base, event_id, event_handler, NULL);
+}
+
+esp_err_t esp_event_handler_unregister(esp_event_base_t event_base, int32_t event_id, esp_event_handler_t event_handler)
+{
+    return handler_unregister(s_default_loop, event_base, event_id, event_handler, NULL);
+}
+
+esp_err_t esp_event_handler_instance_unregister_with(esp_event_loop_handle_t event_loop, esp_event_base_t event_base, int32_t event_id,
+                                                     esp_event_handler_instance_t instance)
+{
+    return handler_unregister(event_loop, event_base, event_id, NULL, instance);
+}
+
+esp_err_t esp_event_post_to(esp_event_loop_handle_t event_loop, esp_event_base_t event_base, int32_t event_id,
+                            const void *event_data, size_t event_data_size, TickType_t ticks_to_wait)
+{
+    event_loop_t *loop = event_loop;
+    if (!loop)
+    {
+        return ESP_ERR_INVALID_ARG;
+    }
+    event_post_t post = {
+        .base = event_base,
+        .id = event_id,
+    };
+    if (event_data && event_data_size)
+    {
+        post.data = malloc(event_data_size);
+        if (!post.data)
+        {
+            return ESP_ERR_NO_MEM;
+        }
+        memcpy(post.data, event_data, event_data_size);
+    }
+    if (xQueueSend(loop->queue, &post, ticks_to_wait) != pdTRUE)
+    {
+        free(post.data);
+        return ESP_ERR_TIMEOUT;
+    }
+    return ESP_OK;
+}
+
+esp_err_t esp_event_post(esp_event_base_t event_base, int32_t event_id, const void *event_data, size_t event_data_size,
+                         TickType_t ticks_to_wait)
+{
+    if (!s_default_loop)
+    {
+        return ESP_ERR_INVALID_STATE;
+    }
+    return esp_event_post_to(s_default_loop, event_base, event_id, event_data, event_data_size, ticks_to_wait);
+}
+
+esp_err_t esp_event_isr_post_to(esp_event_loop_handle_t event_loop, esp_event_base_t event_base, int32_t event_id,
+                                const void *event_data, size_t event_data_size, BaseType_t *task_unblocked)
+{
+    if (task_unblocked)
+    {
+        *task_unblocked = pdFALSE;
+    }
+    return esp_event_post_to(event_loop, event_base, event_id, event_data, event_data_size, 0) == ESP_OK ? ESP_OK : ESP_FAIL;
+}
+
+esp_err_t esp_event_isr_post(esp_event_base_t event_base, int32_t event_id, const void *event_data, size_t event_data_size,
+                             BaseType_t *task_unblocked)
+{
+    if (!s_default_loop)
+    {
+        return ESP_ERR_INVALID_STATE;
+    }
+    return esp_event_isr_post_to(s_default_loop, event_base, event_id, event_data, event_data_size, task_unblocked);
+}
@@ -0,0 +1,312 @@
+/*
+ * esp_http_client on the Linux host: one request per connection, answered with
+ * Content-Length, chunked or until the server closes
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <unistd.h>
+#include <netdb.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include "esp_log.h"
+#include "esp_http_client.h"
+#include "bsd_string.h"
+
+#define SIM_HTTP_DEFAULT_TIMEOUT_MS 5000
+#define SIM_HTTP_HEADER_MAX 2048
+#define SIM_HTTP_BUF_SIZE 1024
+
+struct esp_http_client
+{
+    char host[128];
+    char port[8];
+    char path[256];
+    esp_http_client_method_t method;
+    int timeout_ms;
+    int fd;
+    int status;
+    int64_t content_length; // -1 when unknown
+    int64_t remaining;      // body bytes left with a Content-Length, or in the current chunk
+    bool chunked;
+    bool done;
+    char buf[SIM_HTTP_BUF_SIZE];
+    size_t buf_pos;
+    size_t buf_len;
+};
+
+static const char *TAG = "http_client_sim";
+static const char *const s_methods[] = {"GET", "POST", "PUT", "DELETE"};
+
+esp_http_client_handle_t esp_http_client_init(const esp_http_client_config_t *config)
+{
+    if (!config || !config->url || strncmp(config->url, "http://", 7) != 0)
+    {
+        return NULL;
+    }
+    struct esp_http_client *client = calloc(1, sizeof(*client));
+    if (!client)
+    {
+        return NULL;
+    }
+    const char *host = config->url + 7;
+    const char *path = strchr(host, '/');
+    const char *port = memchr(host, ':', path ? (size_t)(path - host) : strlen(host));
+    size_t host_len = port ? (size_t)(port - host) : path ? (size_t)(path - host) : strlen(host);
+    snprintf(client->host, sizeof(client->host), "%.*s", (int)host_len, host);
+    if (port)
+    {
+        size_t port_len = path ? (size_t)(path - port - 1) : strlen(port + 1);
+        snprintf(client->port, sizeof(client->port), "%.*s", (int)port_len, port + 1);
+    }
+    else
+    {
+        strlcpy(client->port, "80", sizeof(client->port));
+    }
+    strlcpy(client->path, path ? path : "/", sizeof(client->path));
+    client->method = config->method <= HTTP_METHOD_DELETE ? config->method : HTTP_METHOD_GET;
+    client->timeout_ms = config->timeout_ms > 0 ? config->timeout_ms : SIM_HTTP_DEFAULT_TIMEOUT_MS;
+    client->fd = -1;
+    return client;
+}
+
+static int connect_with_timeout(struct esp_http_client *client)
+{
+    struct addrinfo hints = {.ai_family = AF_INET, .ai_socktype = SOCK_STREAM};
+    struct addrinfo *res = NULL;
+    if (getaddrinfo(client->host, client->port, &hints, &res) != 0 || !res)
+    {
+        return -1;
+    }
+    int fd = socket(AF_INET, SOCK_STREAM, 0);
+    if (fd < 0)
+    {
+        freeaddrinfo(res);
+        return -1;
+    }
+    int flags = fcntl(fd, F_GETFL);
+    fcntl(fd, F_SETFL, flags | O_NONBLOCK);
+    int ret = connect(fd, res->ai_addr, res->ai_addrlen);
+    freeaddrinfo(res);
+    if (ret != 0 && errno == EINPROGRESS)
+    {
+        struct pollfd pfd = {.fd = fd, .events = POLLOUT};
+        int err = 0;
+        socklen_t len = sizeof(err);
+        ret = poll(&pfd, 1, client->timeout_ms) == 1 && getsockopt(fd, SOL_SOCKET, SO_ERROR, &err, &len) == 0 && !err ? 0 : -1;
+    }
+    if (ret != 0)
+    {
+        close(fd);
+        return -1;
+    }
+    fcntl(fd, F_SETFL, flags);
+    struct timeval timeout = {.tv_sec = client->timeout_ms / 1000, .tv_usec = (client->timeout_ms % 1000) * 1000};
+    setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+    setsockopt(fd, SOL_SOCKET, SO_SNDTIMEO, &timeout, sizeof(timeout));
+    return fd;
+}
+
+static int send_all(int fd, const char *buf, size_t len)
+{
+    while (len > 0)
+    {
+        ssize_t n = send(fd, buf, len, MSG_NOSIGNAL);
+        if (n <= 0)
+        {
+            return -1;
+        }
+        buf += n;
+        len -= n;
+    }
+    return 0;
+}
+
+esp_err_t esp_http_client_open(esp_http_client_handle_t client, int write_len)
+{
+    if (!client)
+    {
+        return ESP_ERR_INVALID_ARG;
+    }
+    client->fd = connect_with_timeout(client);
+    if (client->fd < 0)
+    {
+        ESP_LOGD(TAG, "connect to %s:%s failed", client->host, client->port);
+        return ESP_ERR_HTTP_CONNECT;
+    }
+    char head[512];
+    int n = snprintf(head, sizeof(head), "%s %s HTTP/1.1\r\nHost: %s\r\nConnection: close\r\n", s_methods[client->method],
+                     client->path, client->host);
+    if (write_len > 0)
+    {
+        n += snprintf(head + n, sizeof(head) - n, "Content-Length: %d\r\n", write_len);
+    }
+    n += snprintf(head + n, sizeof(head) - n, "\r\n");
+    if (send_all(client->fd, head, n) != 0)
+    {
+        return ESP_ERR_HTTP_WRITE_DATA;
+    }
+    return ESP_OK;
+}
+
+int esp_http_client_write(esp_http_client_handle_t client, const char *buffer, int len)
+{
+    return client && client->fd >= 0 && send_all(client->fd, buffer, len) == 0 ? len : -1;
+}
+
+/* next byte of the response, -1 on timeout, error or close */
+static int next_byte(struct esp_http_client *client)
+{
+    if (client->buf_pos == client->buf_len)
+    {
+        ssize_t n = recv(client->fd, client->buf, sizeof(client->buf), 0);
+        if (n <= 0)
+        {
+            return -1;
+        }
+        client->buf_pos = 0;
+        client->buf_len = n;
+    }
+    return (unsigned char)client->buf[client->buf_pos++];
+}
+
+/* one CRLF terminated line without the CRLF */
+static int read_line(struct esp_http_client *client, char *line, size_t size)
+{
+    size_t len = 0;
+    for (int c; (c = next_byte(client)) >= 0;)
+    {
+        if (c == '\n')
+        {
+            len -= len && line[len - 1] == '\r';
+            line[len] = '\0';
+            return (int)len;
+        }
+        if (len + 1 < size)
+        {
+            line[len++] = (char)c;
+        }
+    }
+    return -1;
+}
+
+int64_t esp_http_client_fetch_headers(esp_http_client_handle_t client)
+{
+    if (!client || client->fd < 0)
+    {
+        return ESP_FAIL;
+    }
+    char line[SIM_HTTP_HEADER_MAX];
+    if (read_line(client, line, sizeof(line)) < 0 || sscanf(line, "HTTP/1.%*d %d", &client->status) != 1)
+    {
+        return ESP_FAIL;
+    }
+    client->content_length = -1;
+    for (;;)
+    {
+        int len = read_line(client, line, sizeof(line));
+        if (len < 0)
+        {
+            return ESP_FAIL;
+        }
+        if (len == 0)
+        {
+            break;
+        }
+        if (!strncasecmp(line, "Content-Length:", 15))
+        {
+            client->content_length = strtoll(line + 15, NULL, 10);
+        }
+        else if (!strncasecmp(line, "Transfer-Encoding:", 18) && strcasestr(line + 18, "chunked"))
+        {
+            client->chunked = true;
+        }
+    }
+    client->remaining = client->chunked ? 0 : client->content_length;
+    client->done = client->remaining == 0 && !client->chunked;
+    return client->chunked ? 0 : client->content_length;
+}
+
+int esp_http_client_get_status_code(esp_http_client_handle_t client)
+{
+    return client ? client->status : -1;
+}
+
+int esp_http_client_read(esp_http_client_handle_t client, char *buffer, int len)
+{
+    int total = 0;
+    while (client && client->fd >= 0 && !client->done && total < len)
+    {
+        if (client->chunked && client->remaining == 0)
+        {
+            char line[32];
+            int n = read_line(client, line, sizeof(line));
+            if (n == 0)
+            {
+                // end of the previous chunk
+                n = read_line(client, line, sizeof(line));
+            }
+            if (n < 0)
+            {
+                return total ? total : -1;
+            }
+            client->remaining = strtoll(line, NULL, 16);
+            if (client->remaining == 0)
+            {
+                client->done = true;
+                break;
+            }
+        }
+        int c = next_byte(client);
+        if (c < 0)
+        {
+            // a body without length ends with the connection
+            client->done = client->content_length < 0 && !client->chunked;
+            return total || client->done ? total : -1;
+        }
+        buffer[total++] = (char)c;
+        client->remaining -= client->remaining > 0;
+        client->done = !client->chunked && client->content_length >= 0 && client->remaining == 0;
+    }
+    return total;
+}
+
+int esp_http_client_read_response(esp_http_client_handle_t client, char *buffer, int len)
+{
+    int total = 0;
+    while (total < len)
+    {
+        int n = esp_http_client_read(client, buffer + total, len - total);
+        if (n < 0)
+        {
+            return total ? total : -1;
+        }
+        if (n == 0)
+        {
+            break;
+        }
+        total += n;
+    }
+    return total;
+}
+
+esp_err_t esp_http_client_close(esp_http_client_handle_t client)
+{
+    if (client && client->fd >= 0)
+    {
+        close(client->fd);
+        client->fd = -1;
+    }
+    return ESP_OK;
+}
+
+esp_err_t esp_http_client_cleanup(esp_http_client_handle_t client)
+{
+    esp_http_client_close(client);
+    free(client);
+    return ESP_OK;
+}
@@ -0,0 +1,910 @@
+/*
+ * esp_http_server on the Linux host, serving real TCP connections on 127.0.0.1.
+ *
+ * Like the target server, a single task multiplexes every session with select() and runs
+ * URI handlers inline, so handler cost and head-of-line blocking show up in host benchmarks
+ * the same way they do on the device. Sessions are kept alive between requests.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <errno.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/select.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <arpa/inet.h>
+#include "esp_log.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "esp_http_server.h"
+
+#define SESS_BUF_SIZE 2048
+#define HOST_FALLBACK_PORT 8080
+#define HTTPD_SOCK_ERR_FAIL -1
+#define HTTPD_SOCK_ERR_TIMEOUT -3
+
+static const char *TAG = "httpd";
+
+typedef struct
+{
+    int fd;
+    uint32_t last_used;
+    size_t len;
+    char buf[SESS_BUF_SIZE];
+} sess_t;
+
+typedef struct
+{
+    httpd_work_fn_t fn;
+    void *arg;
+} work_t;
+
+typedef struct
+{
+    httpd_config_t config;
+    int listen_fd;
+    int ctrl_fd[2]; // pipe waking the server task for queued work and stop
+    uint16_t port;
+    TaskHandle_t task;
+    volatile bool stop;
+    httpd_uri_t *handlers;
+    sess_t *sessions;
+    uint32_t use_counter;
+} server_t;
+
+typedef struct
+{
+    sess_t *sess;
+    char headers[SESS_BUF_SIZE]; // header lines of the request, NUL terminated
+    size_t body_left;
+    const char *status;
+    const char *type;
+    const char **resp_fields;
+    const char **resp_values;
+    size_t resp_count;
+    bool headers_sent;
+    bool chunked;
+    bool close;
+} req_aux_t;
+
+static uint16_t s_last_port;
+
+uint16_t sim_httpd_get_port(void)
+{
+    return s_last_port;
+}
+
+bool httpd_uri_match_wildcard(const char *uri_template, const char *uri_to_match, size_t match_upto)
+{
+    const size_t tpl_len = strlen(uri_template);
+    size_t exact_match_chars = tpl_len;
+
+    // "*" at the end matches any tail, "?" makes the preceding "/" optional
+    const char last = (const char)(tpl_len > 0 ? uri_template[tpl_len - 1] : 0);
+    const char prevlast = (const char)(tpl_len > 1 ? uri_template[tpl_len - 2] : 0);
+    const bool asterisk = last == '*' || (prevlast == '*' && last == '?');
+    const bool quest = last == '?' || (prevlast == '?' && last == '*');
+
+    if (asterisk)
+    {
+        exact_match_chars--;
+    }
+    if (quest)
+    {
+        exact_match_chars--;
+    }
+    if (quest && exact_match_chars > 0 && uri_template[exact_match_chars - 1] == '/')
+    {
+        // the slash itself is optional
+        exact_match_chars--;
+        if (match_upto < exact_match_chars || strncmp(uri_template, uri_to_match, exact_match_chars) != 0)
+        {
+            return false;
+        }
+        if (match_upto == exact_match_chars)
+        {
+            return true;
+        }
+        if (uri_to_match[exact_match_chars] != '/')
+        {
+            return false;
+        }
+        return asterisk || match_upto == exact_match_chars + 1;
+    }
+    if (match_upto < exact_match_chars || strncmp(uri_template, uri_to_match, exact_match_chars) != 0)
+    {
+        return false;
+    }
+    return asterisk || match_upto == exact_match_chars;
+}
+
+/* sockets */
+
+static int send_all(int fd, const char *buf, size_t len)
+{
+    while (len > 0)
+    {
+        ssize_t n = send(fd, buf, len, MSG_NOSIGNAL);
+        if (n < 0)
+        {
+            if (errno == EINTR)
+            {
+                continue;
+            }
+            return HTTPD_SOCK_ERR_FAIL;
+        }
+        buf += n;
+        len -= n;
+    }
+    return 0;
+}
+
+static void sess_close(sess_t *sess)
+{
+    if (sess->fd >= 0)
+    {
+        close(sess->fd);
+        sess->fd = -1;
+        sess->len = 0;
+    }
+}
+
+static void sess_consume(sess_t *sess, size_t n)
+{
+    memmove(sess->buf, sess->buf + n, sess->len - n);
+    sess->len -= n;
+}
+
+/* requests */
+
+static const char *find_header(const char *headers, const char *field, size_t *value_len)
+{
+    size_t field_len = strlen(field);
+    for (const char *line = headers; line && *line; line = strstr(line, "\r\n") ? strstr(line, "\r\n") + 2 : NULL)
+    {
+        if (strncasecmp(line, field, field_len) == 0 && line[field_len] == ':')
+        {
+            const char *value = line + field_len + 1;
+            while (*value == ' ' || *value == '\t')
+            {
+                value++;
+            }
+            const char *end = strstr(value, "\r\n");
+            *value_len = end ? (size_t)(end - value) : strlen(value);
+            return value;
+        }
+    }
+    return NULL;
+}
+
+static int parse_method(const char *method, size_t len)
+{
+    static const struct
+    {
+        const char *name;
+        int method;
+    } methods[] = {
+        {"DELETE", HTTP_DELETE},
+        {"GET", HTTP_GET},
+        {"HEAD", HTTP_HEAD},
+        {"POST", HTTP_POST},
+        {"PUT", HTTP_PUT},
+        {"OPTIONS", HTTP_OPTIONS},
+        {"PATCH", HTTP_PATCH},
+    };
+    for (size_t i = 0; i < sizeof(methods) / sizeof(methods[0]); i++)
+    {
+        if (strlen(methods[i].name) == len && strncmp(methods[i].name, method, len) == 0)
+        {
+            return methods[i].method;
+        }
+    }
+    return -1;
+}
+
+static esp_err_t send_headers(httpd_req_t *r, ssize_t content_len)
+{
+    req_aux_t *aux = r->aux;
+    char head[SESS_BUF_SIZE];
+    int n = snprintf(head, sizeof(head), "HTTP/1.1 %s\r\nContent-Type: %s\r\n", aux->status, aux->type);
+    if (content_len >= 0)
+    {
+        n += snprintf(head + n, sizeof(head) - n, "Content-Length: %zd\r\n", content_len);
+    }
+    else
+    {
+        n += snprintf(head + n, sizeof(head) - n, "Transfer-Encoding: chunked\r\n");
+    }
+    for (size_t i = 0; i < aux->resp_count && n < (int)sizeof(head); i++)
+    {
+        n += snprintf(head + n, sizeof(head) - n, "%s: %s\r\n", aux->resp_fields[i], aux->resp_values[i]);
+    }
+    if (aux->close && n < (int)sizeof(head))
+    {
+        n += snprintf(head + n, sizeof(head) - n, "Connection: close\r\n");
+    }
+    if (n + 2 >= (int)sizeof(head))
+    {
+        return ESP_ERR_HTTPD_RESP_HDR;
+    }
+    n += snprintf(head + n, sizeof(head) - n, "\r\n");
+    aux->headers_sent = true;
+    return send_all(aux->sess->fd, head, n) == 0 ? ESP_OK : ESP_ERR_HTTPD_RESP_SEND;
+}
+
+esp_err_t httpd_resp_set_status(httpd_req_t *r, const char *status)
+{
+    if (!r || !r->aux || !status)
+    {
+        return ESP_ERR_INVALID_ARG;
+    }
+    ((req_aux_t *)r->aux)->status = status;
+    return ESP_OK;
+}
+
+esp_err_t httpd_resp_set_type(httpd_req_t *r, const char *type)
+{
+    if (!r || !r->aux || !type)
+    {
+        return ESP_ERR_INVALID_ARG;
+    }
+    ((req_aux_t *)r->aux)->type = type;
+    return ESP_OK;
+}
+
+esp_err_t httpd_resp_set_hdr(httpd_req_t *r, const char *field, const char *value)
+{
+    if (!r || !r->aux || !field || !value)
+    {
+        return ESP_ERR_INVALID_ARG;
+    }
+    req_aux_t *aux = r->aux;
+    server_t *server = r->handle;
+    if (aux->resp_count >= server->config.max_resp_headers)
+    {
+        return ESP_ERR_HTTPD_RESP_HDR;
+    }
+    aux->resp_fields[aux->resp_count] = field;
+    aux->resp_values[aux->resp_count] = value;
+    aux->resp_count++;
+    return ESP_OK;
+}
+
+esp_err_t httpd_resp_send(httpd_req_t *r, const char *buf, ssize_t buf_len)
+{
+    if (!r || !r->aux)
+    {
+        return ESP_ERR_INVALID_ARG;
+    }
+    req_aux_t *aux = r->aux;
+    if (buf_len == HTTPD_RESP_USE_STRLEN)
+    {
+        buf_len = buf ? strlen(buf) : 0;
+    }
+    esp_err_t err = send_headers(r, buf_len);
+    if (err == ESP_OK && buf_len > 0 && send_all(aux->sess->fd, buf, buf_len) != 0)
+    {
+        err = ESP_ERR_HTTPD_RESP_SEND;
+    }
+    return err;
+}
+
+esp_err_t httpd_resp_send_chunk(httpd_req_t *r, const char *buf, ssize_t buf_len)
+{
+    if (!r || !r->aux)
+    {
+        return ESP_ERR_INVALID_ARG;
+    }
+    req_aux_t *aux = r->aux;
+    if (buf_len == HTTPD_RESP_USE_STRLEN)
+    {
+        buf_len = buf ? strlen(buf) : 0;
+    }
+    if (!aux->headers_sent)
+    {
+        aux->chunked = true;
+        esp_err_t err = send_headers(r, -1);
+        if (err != ESP_OK)
+        {
+            return err;
+        }
+    }
+    char size[16];
+    int n = snprintf(size, sizeof(size), "%zx\r\n", (size_t)buf_len);
+    if (send_all(aux->sess->fd, size, n) != 0 ||
+        (buf_len > 0 && send_all(aux->sess->fd, buf, buf_len) != 0) ||
+        send_all(aux->sess->fd, "\r\n", 2) != 0)
+    {
+        return ESP_ERR_HTTPD_RESP_SEND;
+    }
+    return ESP_OK;
+}
+
+esp_err_t httpd_resp_send_err(httpd_req_t *req, httpd_err_code_t error, const char *msg)
+{
+    static const struct
+    {
+        const char *status;
+        const char *msg;
+    } errors[HTTPD_ERR_CODE_MAX] = {
+        [HTTPD_500_INTERNAL_SERVER_ERROR] = {"500 Internal Server Error", "Server has encountered an unexpected error"},
+        [HTTPD_501_METHOD_NOT_IMPLEMENTED] = {"501 Method Not Implemented", "Server does not support this method"},
+        [HTTPD_505_VERSION_NOT_SUPPORTED] = {"505 Version Not Supported", "HTTP version not supported by server"},
+        [HTTPD_400_BAD_REQUEST] = {"400 Bad Request", "Bad request syntax"},
+        [HTTPD_401_UNAUTHORIZED] = {"401 Unauthorized", "No permission -- see authorization schemes"},
+        [HTTPD_403_FORBIDDEN] = {"403 Forbidden", "Request forbidden -- authorization will not help"},
+        [HTTPD_404_NOT_FOUND] = {"404 Not Found", "Nothing matches the given URI"},
+        [HTTPD_405_METHOD_NOT_ALLOWED] = {"405 Method Not Allowed", "Specified method is invalid for this resource"},
+        [HTTPD_408_REQ_TIMEOUT] = {"408 Request Timeout", "Server closed this connection"},
+        [HTTPD_411_LENGTH_REQUIRED] = {"411 Length Required", "Chunked encoding not supported by server"},
+        [HTTPD_414_URI_TOO_LONG] = {"414 URI Too Long", "URI is too long"},
+        [HTTPD_431_REQ_HDR_FIELDS_TOO_LARGE] = {"431 Request Header Fields Too Large", "Header fields are too long"},
+    };
+    if (!req || !req->aux || error >= HTTPD_ERR_CODE_MAX)
+    {
+        return ESP_ERR_INVALID_ARG;
+    }
+    req_aux_t *aux = req->aux;
+    if (aux->headers_sent)
+    {
+        // an error after a partial response can only be reported by dropping the session
+        aux->close = true;
+        return ESP_FAIL;
+    }
+    aux->status = errors[error].status;
+    aux->type = "text/html";
+    ESP_LOGW(TAG, "error %s on %s", errors[error].status, req->uri);
+    return httpd_resp_send(req, msg ? msg : errors[error].msg, HTTPD_RESP_USE_STRLEN);
+}
+
+int httpd_req_recv(httpd_req_t *r, char *buf, size_t buf_len)
+{
+    if (!r || !r->aux || !buf)
+    {
+        return HTTPD_SOCK_ERR_FAIL;
+    }
+    req_aux_t *aux = r->aux;
+    sess_t *sess = aux->sess;
+    size_t want = buf_len < aux->body_left ? buf_len : aux->body_left;
+    if (want == 0)
+    {
+        return 0;
+    }
+    if (sess->len > 0)
+    {
+        size_t n = want < sess->len ? want : sess->len;
+        memcpy(buf, sess->buf, n);
+        sess_consume(sess, n);
+        aux->body_left -= n;
+        return (int)n;
+    }
+    ssize_t n;
+    do
+    {
+        n = recv(sess->fd, buf, want, 0);
+    } while (n < 0 && errno == EINTR);
+    if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK))
+    {
+        return HTTPD_SOCK_ERR_TIMEOUT;
+    }
+    if (n <= 0)
+    {
+        return HTTPD_SOCK_ERR_FAIL;
+    }
+    aux->body_left -= n;
+    return (int)n;
+}
+
+size_t httpd_req_get_hdr_value_len(httpd_req_t *r, const char *field)
+{
+    size_t len = 0;
+    if (r && r->aux && field)
+    {
+        find_header(((req_aux_t *)r->aux)->headers, field, &len);
+    }
+    return len;
+}
+
+esp_err_t httpd_req_get_hdr_value_str(httpd_req_t *r, const char *field, char *val, size_t val_size)
+{
+    if (!r || !r->aux || !field || !val || val_size == 0)
+    {
+        return ESP_ERR_INVALID_ARG;
+    }
+    size_t len;
+    const char *value = find_header(((req_aux_t *)r->aux)->headers, field, &len);
+    if (!value)
+    {
+        return ESP_ERR_NOT_FOUND;
+    }
+    size_t n = len < val_size - 1 ? len : val_size - 1;
+    memcpy(val, value, n);
+    val[n] = '\0';
+    return n < len ? ESP_ERR_HTTPD_RESULT_TRUNC : ESP_OK;
+}
+
+size_t httpd_req_get_url_query_len(httpd_req_t *r)
+{
+    const char *query = r ? strchr(r->uri, '?') : NULL;
+    return query ? strlen(query + 1) : 0;
+}
+
+esp_err_t httpd_req_get_url_query_str(httpd_req_t *r, char *buf, size_t buf_len)
+{
+    if (!r || !buf || buf_len == 0)
+    {
+        return ESP_ERR_INVALID_ARG;
+    }
+    const char *query = strchr(r->uri, '?');
+    if (!query)
+    {
+        return ESP_ERR_NOT_FOUND;
+    }
+    size_t len = strlen(query + 1);
+    size_t n = len < buf_len - 1 ? len : buf_len - 1;
+    memcpy(buf, query + 1, n);
+    buf[n] = '\0';
+    return n < len ? ESP_ERR_HTTPD_RESULT_TRUNC : ESP_OK;
+}
+
+esp_err_t httpd_query_key_value(const char *qry, const char *key, char *val, size_t val_size)
+{
+    if (!qry || !key || !val || val_size == 0)
+    {
+        return ESP_ERR_INVALID_ARG;
+    }
+    size_t key_len = strlen(key);
+    for (const char *p = qry; p && *p; p = strchr(p, '&') ? strchr(p, '&') + 1 : NULL)
+    {
+        if (strncmp(p, key, key_len) == 0 && p[key_len] == '=')
+        {
+            const char *value = p + key_len + 1;
+            const char *end = strchr(value, '&');
+            size_t len = end ? (size_t)(end - value) : strlen(value);
+            size_t n = len < val_size - 1 ? len : val_size - 1;
+            memcpy(val, value, n);
+            val[n] = '\0';
+            return n < len ? ESP_ERR_HTTPD_RESULT_TRUNC : ESP_OK;
+        }
+    }
+    return ESP_ERR_NOT_FOUND;
+}
+
+/* server */
+
+static const httpd_uri_t *find_handler(server_t *server, const char *uri, int method, bool *uri_found)
+{
+    size_t path_len = strcspn(uri, "?");
+    *uri_found = false;
+    for (uint16_t i = 0; i < server->config.max_uri_handlers; i++)
+    {
+        const httpd_uri_t *h = &server->handlers[i];
+        if (!h->uri)
+        {
+            continue;
+        }
+        bool match = server->config.uri_match_fn ? server->config.uri_match_fn(h->uri, uri, path_len)
+                                                 : strlen(h->uri) == path_len && strncmp(h->uri, uri, path_len) == 0;
+        if (match)
+        {
+            *uri_found = true;
+            if ((int)h->method == method)
+            {
+                return h;
+            }
+        }
+    }
+    return NULL;
+}
+
+/* serve the request at the start of the session buffer, returns false when the session must close */
+static bool handle_request(server_t *server, sess_t *sess, size_t hdr_len)
+{
+    req_aux_t *aux = calloc(1, sizeof(req_aux_t));
+    httpd_req_t *req = calloc(1, sizeof(httpd_req_t));
+    const char **resp_hdrs = calloc(server->config.max_resp_headers * 2 + 2, sizeof(char *));
+    if (!aux || !req || !resp_hdrs)
+    {
+        free(aux);
+        free(req);
+        free(resp_hdrs);
+        return false;
+    }
+    aux->sess = sess;
+    aux->status = HTTPD_200;
+    aux->type = HTTPD_TYPE_TEXT;
+    aux->resp_fields = resp_hdrs;
+    aux->resp_values = resp_hdrs + server->config.max_resp_headers + 1;
+    req->handle = server;
+    req->aux = aux;
+
+    // request line
+    char *line = sess->buf;
+    char *line_end = strstr(line, "\r\n");
+    char *sp1 = memchr(line, ' ', line_end - line);
+    char *sp2 = sp1 ? memchr(sp1 + 1, ' ', line_end - sp1 - 1) : NULL;
+    memcpy(aux->headers, line_end + 2, hdr_len - (line_end + 2 - line));
+    aux->headers[hdr_len - (line_end + 2 - line)] = '\0';
+
+    bool keep_open = true;
+    bool bad = !sp1 || !sp2;
+    if (!bad)
+    {
+        req->method = parse_method(line, sp1 - line);
+        size_t uri_len = sp2 - sp1 - 1;
+        if (uri_len > HTTPD_MAX_URI_LEN)
+        {
+            aux->close = true;
+            sess_consume(sess, hdr_len);
+            httpd_resp_send_err(req, HTTPD_414_URI_TOO_LONG, NULL);
+            keep_open = false;
+            goto out;
+        }
+        memcpy((char *)req->uri, sp1 + 1, uri_len);
+        ((char *)req->uri)[uri_len] = '\0';
+        aux->close = strncmp(sp2 + 1, "HTTP/1.0", 8) == 0;
+    }
+
+    size_t value_len;
+    const char *value = find_header(aux->headers, "Connection", &value_len);
+    if (value)
+    {
+        aux->close = strncasecmp(value, "close", 5) == 0 ? true : strncasecmp(value, "keep-alive", 10) == 0 ? false : aux->close;
+    }
+    value = find_header(aux->headers, "Content-Length", &value_len);
+    req->content_len = value ? strtoul(value, NULL, 10) : 0;
+    aux->body_left = req->content_len;
+    sess_consume(sess, hdr_len);
+
+    if (bad || req->method < 0)
+    {
+        aux->close = true;
+        httpd_resp_send_err(req, bad ? HTTPD_400_BAD_REQUEST : HTTPD_501_METHOD_NOT_IMPLEMENTED, NULL);
+        keep_open = false;
+        goto out;
+    }
+    if (find_header(aux->headers, "Transfer-Encoding", &value_len))
+    {
+        aux->close = true;
+        httpd_resp_send_err(req, HTTPD_411_LENGTH_REQUIRED, NULL);
+        keep_open = false;
+        goto out;
+    }
+
+    bool uri_found;
+    const httpd_uri_t *handler = find_handler(server, req->uri, req->method, &uri_found);
+    if (!handler)
+    {
+        httpd_resp_send_err(req, uri_found ? HTTPD_405_METHOD_NOT_ALLOWED : HTTPD_404_NOT_FOUND, NULL);
+    }
+    else
+    {
+        req->user_ctx = handler->user_ctx;
+        if (handler->handler(req) != ESP_OK)
+        {
+            keep_open = false;
+        }
+    }
+
+    // drop whatever part of the body the handler did not read
+    char discard[256];
+    while (keep_open && aux->body_left > 0)
+    {
+        if (httpd_req_recv(req, discard, sizeof(discard)) <= 0)
+        {
+            keep_open = false;
+        }
+    }
+out:
+    keep_open = keep_open && !aux->close;
+    free(resp_hdrs);
+    free(aux);
+    free(req);
+    return keep_open;
+}
+
+static void sess_read(server_t *server, sess_t *sess)
+{
+    ssize_t n = recv(sess->fd, sess->buf + sess->len, SESS_BUF_SIZE - 1 - sess->len, 0);
+    if (n <= 0)
+    {
+        sess_close(sess);
+        return;
+    }
+    sess->len += n;
+    sess->buf[sess->len] = '\0';
+    sess->last_used = ++server->use_counter;
+
+    // serve every complete request, pipelined ones included
+    for (;;)
+    {
+        char *end = strstr(sess->buf, "\r\n\r\n");
+        if (!end)
+        {
+            if (sess->len >= SESS_BUF_SIZE - 1)
+            {
+                static const char too_large[] = "HTTP/1.1 431 Request Header Fields Too Large\r\nContent-Length: 0\r\nConnection: close\r\n\r\n";
+                send_all(sess->fd, too_large, sizeof(too_large) - 1);
+                sess_close(sess);
+            }
+            return;
+        }
+        if (!handle_request(server, sess, end + 4 - sess->buf))
+        {
+            sess_close(sess);
+            return;
+        }
+        sess->buf[sess->len] = '\0';
+    }
+}
+
+static void sess_accept(server_t *server)
+{
+    int fd = accept(server->listen_fd, NULL, NULL);
+    if (fd < 0)
+    {
+        return;
+    }
+    sess_t *slot = NULL;
+    sess_t *lru = NULL;
+    for (uint16_t i = 0; i < server->config.max_open_sockets; i++)
+    {
+        sess_t *sess = &server->sessions[i];
+        if (sess->fd < 0)
+        {
+            slot = sess;
+            break;
+        }
+        if (!lru || sess->last_used < lru->last_used)
+        {
+            lru = sess;
+        }
+    }
+    if (!slot && server->config.lru_purge_enable)
+    {
+        ESP_LOGW(TAG, "purging least recently used session");
+        sess_close(lru);
+        slot = lru;
+    }
+    if (!slot)
+    {
+        ESP_LOGW(TAG, "no free session, closing new connection");
+        close(fd);
+        return;
+    }
+
+    int one = 1;
+    setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+    struct timeval recv_timeout = {.tv_sec = server->config.recv_wait_timeout};
+    struct timeval send_timeout = {.tv_sec = server->config.send_wait_timeout};
+    setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &recv_timeout, sizeof(recv_timeout));
+    setsockopt(fd, SOL_SOCKET, SO_SNDTIMEO, &send_timeout, sizeof(send_timeout));
+    slot->fd = fd;
+    slot->len = 0;
+    slot->last_used = ++server->use_counter;
+}
+
+static void httpd_server_task(void *arg)
+{
+    server_t *server = arg;
+    while (!server->stop)
+    {
+        fd_set fds;
+        FD_ZERO(&fds);
+        FD_SET(server->listen_fd, &fds);
+        FD_SET(server->ctrl_fd[0], &fds);
+        int max_fd = server->listen_fd > server->ctrl_fd[0] ? server->listen_fd : server->ctrl_fd[0];
+        for (uint16_t i = 0; i < server->config.max_open_sockets; i++)
+        {
+            int fd = server->sessions[i].fd;
+            if (fd >= 0)
+            {
+                FD_SET(fd, &fds);
+                max_fd = fd > max_fd ? fd : max_fd;
+            }
+        }
+        if (select(max_fd + 1, &fds, NULL, NULL, NULL) < 0)
+        {
+            if (errno == EINTR)
+            {
+                continue;
+            }
+            ESP_LOGE(TAG, "select failed: %d", errno);
+            break;
+        }
+
+        if (FD_ISSET(server->ctrl_fd[0], &fds))
+        {
+            work_t work;
+            if (read(server->ctrl_fd[0], &work, sizeof(work)) == sizeof(work) && work.fn)
+            {
+                work.fn(work.arg);
+            }
+        }
+        for (uint16_t i = 0; i < server->config.max_open_sockets; i++)
+        {
+            sess_t *sess = &server->sessions[i];
+            if (sess->fd >= 0 && FD_ISSET(sess->fd, &fds))
+            {
+                sess_read(server, sess);
+            }
+        }
+        if (FD_ISSET(server->listen_fd, &fds))
+        {
+            sess_accept(server);
+        }
+    }
+
+    for (uint16_t i = 0; i < server->config.max_open_sockets; i++)
+    {
+        sess_close(&server->sessions[i]);
+    }
+    close(server->listen_fd);
+    close(server->ctrl_fd[0]);
+    close(server->ctrl_fd[1]);
+    if (server->config.global_user_ctx_free_fn)
+    {
+        server->config.global_user_ctx_free_fn(server->config.global_user_ctx);
+    }
+    free(server->handlers);
+    free(server->sessions);
+    free(server);
+    vTaskDelete(NULL);
+}
+
+static uint16_t host_port(const httpd_config_t *config)
+{
+    const char *env = getenv("FCTL_HTTP_PORT");
+    if (env)
+    {
+        return (uint16_t)atoi(env);
+    }
+    return config->server_port == 80 ? HOST_FALLBACK_PORT : config->server_port;
+}
+
+esp_err_t httpd_start(httpd_handle_t *handle, const httpd_config_t *config)
+{
+    if (!handle || !config || config->max_open_sockets == 0)
+    {
+        return ESP_ERR_INVALID_ARG;
+    }
+    server_t *server = calloc(1, sizeof(server_t));
+    if (!server)
+    {
+        return ESP_ERR_HTTPD_ALLOC_MEM;
+    }
+    server->config = *config;
+    server->handlers = calloc(config->max_uri_handlers, sizeof(httpd_uri_t));
+    server->sessions = calloc(config->max_open_sockets, sizeof(sess_t));
+    server->listen_fd = -1;
+    server->ctrl_fd[0] = server->ctrl_fd[1] = -1;
+    if (!server->handlers || !server->sessions)
+    {
+        goto err;
+    }
+    for (uint16_t i = 0; i < config->max_open_sockets; i++)
+    {
+        server->sessions[i].fd = -1;
+    }
+
+    server->listen_fd = socket(AF_INET, SOCK_STREAM, 0);
+    int one = 1;
+    setsockopt(server->listen_fd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+    struct sockaddr_in addr = {
+        .sin_family = AF_INET,
+        .sin_port = htons(host_port(config)),
+        .sin_addr.s_addr = htonl(INADDR_LOOPBACK),
+    };
+    if (server->listen_fd < 0 || bind(server->listen_fd, (struct sockaddr *)&addr, sizeof(addr)) != 0 ||
+        listen(server->listen_fd, config->backlog_conn) != 0)
+    {
+        ESP_LOGE(TAG, "error in bind/listen on port %d: %s", ntohs(addr.sin_port), strerror(errno));
+        goto err;
+    }
+    socklen_t addr_len = sizeof(addr);
+    getsockname(server->listen_fd, (struct sockaddr *)&addr, &addr_len);
+    server->port = ntohs(addr.sin_port);
+    if (pipe(server->ctrl_fd) != 0)
+    {
+        goto err;
+    }
+
+    if (xTaskCreatePinnedToCore(httpd_server_task, "httpd", config->stack_size, server, config->task_priority, &server->task,
+                                config->core_id) != pdPASS)
+    {
+        goto err;
+    }
+    s_last_port = server->port;
+    ESP_LOGI(TAG, "listening on http://127.0.0.1:%d", server->port);
+    *handle = server;
+    return ESP_OK;
+err:
+    if (server->listen_fd >= 0)
+    {
+        close(server->listen_fd);
+    }
+    if (server->ctrl_fd[0] >= 0)
+    {
+        close(server->ctrl_fd[0]);
+        close(server->ctrl_fd[1]);
+    }
+    free(server->handlers);
+    free(server->sessions);
+    free(server);
+    return ESP_ERR_HTTPD_TASK;
+}
+
+esp_err_t httpd_stop(httpd_handle_t handle)
+{
+    server_t *server = handle;
+    if (!server)
+    {
+        return ESP_ERR_INVALID_ARG;
+    }
+    server->stop = true;
+    work_t wake = {0};
+    return write(server->ctrl_fd[1], &wake, sizeof(wake)) == sizeof(wake) ? ESP_OK : ESP_FAIL;
+}
+
+esp_err_t httpd_queue_work(httpd_handle_t handle, httpd_work_fn_t work, void *arg)
+{
+    server_t *server = handle;
+    if (!server || !work)
+    {
+        return ESP_ERR_INVALID_ARG;
+    }
+    work_t msg = {.fn = work, .arg = arg};
+    return write(server->ctrl_fd[1], &msg, sizeof(msg)) == sizeof(msg) ? ESP_OK : ESP_FAIL;
+}
+
+esp_err_t httpd_register_uri_handler(httpd_handle_t handle, const httpd_uri_t *uri_handler)
+{
+    server_t *server = handle;
+    if (!server || !uri_handler || !uri_handler->uri || !uri_handler->handler)
+    {
+        return ESP_ERR_INVALID_ARG;
+    }
+    httpd_uri_t *slot = NULL;
+    for (uint16_t i = 0; i < server->config.max_uri_handlers; i++)
+    {
+        httpd_uri_t *h = &server->handlers[i];
+        if (!h->uri)
+        {
+            slot = slot ? slot : h;
+        }
+        else if (h->method == uri_handler->method && strcmp(h->uri, uri_handler->uri) == 0)
+        {
+            ESP_LOGW(TAG, "handler %s already registered", uri_handler->uri);
+            return ESP_ERR_HTTPD_HANDLER_EXISTS;
+        }
+    }
+    if (!slot)
+    {
+        ESP_LOGW(TAG, "no slots left for registering handler %s", uri_handler->uri);
+        return ESP_ERR_HTTPD_HANDLERS_FULL;
+    }
+    *slot = *uri_handler;
+    return ESP_OK;
+}
+
+esp_err_t httpd_unregister_uri_handler(httpd_handle_t handle, const char *uri, httpd_method_t method)
+{
+    server_t *server = handle;
+    if (!server || !uri)
+    {
+        return ESP_ERR_INVALID_ARG;
+    }
+    for (uint16_t i = 0; i < server->config.max_uri_handlers; i++)
+    {
+        httpd_uri_t *h = &server->handlers[i];
+        if (h->uri && h->method == method && strcmp(h->uri, uri) == 0)
+        {
+            memset(h, 0, sizeof(*h));
+            return ESP_OK;
+        }
+    }
+    return ESP_ERR_NOT_FOUND;
+}
@@ -0,0 +1,252 @@
+/*
+ * esp_timer on the Linux host: one dispatcher thread runs every callback, like the
+ * esp_timer task does on target, so callbacks of different timers never overlap.
+ */
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <pthread.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "esp_timer.h"
+
+#define ESP_TIMER_TASK_PRIORITY 22
+
+struct esp_timer
+{
+    esp_timer_cb_t callback;
+    void *arg;
+    const char *name;
+    bool skip_unhandled_events;
+    int64_t alarm;  // absolute time of the next expiry, in microseconds
+    uint64_t period; // 0 for one-shot timers
+    bool armed;
+    struct esp_timer *next; // armed timers, sorted by alarm
+};
+
+static pthread_mutex_t s_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t s_cond;
+static pthread_once_t s_init_once = PTHREAD_ONCE_INIT;
+static struct esp_timer *s_armed = NULL;
+static struct esp_timer *s_running = NULL;
+static pthread_t s_thread;
+static int64_t s_start_us; // CLOCK_MONOTONIC at process start, stands for the reset
+
+static int64_t monotonic_us(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (int64_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+__attribute__((constructor)) static void esp_timer_init_start(void)
+{
+    s_start_us = monotonic_us();
+}
+
+int64_t esp_timer_get_time(void)
+{
+    return monotonic_us() - s_start_us;
+}
+
+static void timer_unlink(struct esp_timer *timer)
+{
+    for (struct esp_timer **it = &s_armed; *it; it = &(*it)->next)
+    {
+        if (*it == timer)
+        {
+            *it = timer->next;
+            break;
+        }
+    }
+    timer->armed = false;
+}
+
+static void timer_insert(struct esp_timer *timer)
+{
+    struct esp_timer **it = &s_armed;
+    while (*it && (*it)->alarm <= timer->alarm)
+    {
+        it = &(*it)->next;
+    }
+    timer->next = *it;
+    *it = timer;
+    timer->armed = true;
+}
+
+static void *timer_task(void *arg)
+{
+    pthread_setname_np(pthread_self(), "esp_timer");
+    // show up in uxTaskGetSystemState like the esp_timer task does on target
+    vTaskPrioritySet(xTaskGetCurrentTaskHandle(), ESP_TIMER_TASK_PRIORITY);
+    pthread_mutex_lock(&s_lock);
+    for (;;)
+    {
+        if (!s_armed)
+        {
+            pthread_cond_wait(&s_cond, &s_lock);
+            continue;
+        }
+        int64_t now = esp_timer_get_time();
+        struct esp_timer *timer = s_armed;
+        if (timer->alarm > now)
+        {
+            int64_t deadline = timer->alarm + s_start_us;
+            struct timespec ts = {
+                .tv_sec = deadline / 1000000,
+                .tv_nsec = (deadline % 1000000) * 1000,
+            };
+            pthread_cond_timedwait(&s_cond, &s_lock, &ts);
+            continue;
+        }
+
+        s_armed = timer->next;
+        timer->armed = false;
+        if (timer->period)
+        {
+            timer->alarm += timer->period;
+            if (timer->skip_unhandled_events && timer->alarm < now)
+            {
+                timer->alarm = now + timer->period;
+            }
+            timer_insert(timer);
+        }
+        s_running = timer;
+        pthread_mutex_unlock(&s_lock);
+        timer->callback(timer->arg);
+        pthread_mutex_lock(&s_lock);
+        s_running = NULL;
+        pthread_cond_broadcast(&s_cond);
+    }
+    return NULL;
+}
+
+static void timer_init_once(void)
+{
+    pthread_condattr_t attr;
+    pthread_condattr_init(&attr);
+    pthread_condattr_setclock(&attr, CLOCK_MONOTONIC);
+    pthread_cond_init(&s_cond, &attr);
+    pthread_condattr_destroy(&attr);
+
+    pthread_create(&s_thread, NULL, timer_task, NULL);
+    pthread_detach(s_thread);
+}
+
+esp_err_t esp_timer_init(void)
+{
+    pthread_once(&s_init_once, timer_init_once);
+    return ESP_OK;
+}
+
+esp_err_t esp_timer_create(const esp_timer_create_args_t *create_args, esp_timer_handle_t *out_handle)
+{
+    if (!create_args || !create_args->callback || !out_handle)
+    {
+        return ESP_ERR_INVALID_ARG;
+    }
+    esp_timer_init();
+    struct esp_timer *timer = calloc(1, sizeof(*timer));
+    if (!timer)
+    {
+        return ESP_ERR_NO_MEM;
+    }
+    timer->callback = create_args->callback;
+    timer->arg = create_args->arg;
+    timer->name = create_args->name;
+    timer->skip_unhandled_events = create_args->skip_unhandled_events;
+    *out_handle = timer;
+    return ESP_OK;
+}
+
+static esp_err_t timer_start(esp_timer_handle_t timer, uint64_t timeout_us, uint64_t period, bool restart)
+{
+    if (!timer)
+    {
+        return ESP_ERR_INVALID_ARG;
+    }
+    pthread_mutex_lock(&s_lock);
+    if (timer->armed && !restart)
+    {
+        pthread_mutex_unlock(&s_lock);
+        return ESP_ERR_INVALID_STATE;
+    }
+    if (!timer->armed && restart)
+    {
+        pthread_mutex_unlock(&s_lock);
+        return ESP_ERR_INVALID_STATE;
+    }
+    timer_unlink(timer);
+    timer->alarm = esp_timer_get_time() + timeout_us;
+    timer->period = period;
+    timer_insert(timer);
+    pthread_cond_broadcast(&s_cond);
+    pthread_mutex_unlock(&s_lock);
+    return ESP_OK;
+}
+
+esp_err_t esp_timer_start_once(esp_timer_handle_t timer, uint64_t timeout_us)
+{
+    return timer_start(timer, timeout_us, 0, false);
+}
+
+esp_err_t esp_timer_start_periodic(esp_timer_handle_t timer, uint64_t period)
+{
+    return timer_start(timer, period, period, false);
+}
+
+esp_err_t esp_timer_restart(esp_timer_handle_t timer, uint64_t timeout_us)
+{
+    return timer_start(timer, timeout_us, timer ? (timer->period ? timeout_us : 0) : 0, true);
+}
+
+esp_err_t esp_timer_stop(esp_timer_handle_t timer)
+{
+    if (!timer)
+    {
+        return ESP_ERR_INVALID_ARG;
+    }
+    pthread_mutex_lock(&s_lock);
+    bool armed = timer->armed;
+    timer_unlink(timer);
+    pthread_mutex_unlock(&s_lock);
+    return armed ? ESP_OK : ESP_ERR_INVALID_STATE;
+}
+
+esp_err_t esp_timer_delete(esp_timer_handle_t timer)
+{
+    if (!timer)
+    {
+        return ESP_ERR_INVALID_ARG;
+    }
+    pthread_mutex_lock(&s_lock);
+    if (timer->armed)
+    {
+        pthread_mutex_unlock(&s_lock);
+        return ESP_ERR_INVALID_STATE;
+    }
+    // do not free a timer whose callback is running, unless it deletes itself
+    while (s_running == timer && !pthread_equal(pthread_self(), s_thread))
+    {
+        pthread_cond_wait(&s_cond, &s_lock);
+    }
+    pthread_mutex_unlock(&s_lock);
+    free(timer);
+    return ESP_OK;
+}
+
+int64_t esp_timer_get_next_alarm(void)
+{
+    pthread_mutex_lock(&s_lock);
+    int64_t alarm = s_armed ? s_armed->alarm : INT64_MAX;
+    pthread_mutex_unlock(&s_lock);
+    return alarm;
+}
+
+bool esp_timer_is_active(esp_timer_handle_t timer)
+{
+    pthread_mutex_lock(&s_lock);
+    bool armed = timer->armed;
+    pthread_mutex_unlock(&s_lock);
+    return armed;
+}
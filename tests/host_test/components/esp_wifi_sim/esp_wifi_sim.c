@@ -0,0 +1,287 @@
+/*
+ * Wi-Fi and netif on the Linux host. The radio is always in range of a station network:
+ * connecting with a configured SSID succeeds and hands out 192.168.4.2, connecting without
+ * one fails with a disconnect, like a station that finds no AP. Scans return a fixed list.
+ */
+#include <string.h>
+#include <pthread.h>
+#include "esp_log.h"
+#include "esp_event.h"
+#include "esp_netif.h"
+#include "esp_wifi.h"
+
+ESP_EVENT_DEFINE_BASE(WIFI_EVENT);
+ESP_EVENT_DEFINE_BASE(IP_EVENT);
+
+#define SIM_DISCONNECT_REASON_NO_AP_FOUND 201
+
+struct esp_netif_obj
+{
+    const char *if_key;
+    esp_netif_ip_info_t ip_info;
+};
+
+static const char *TAG = "wifi_sim";
+static pthread_mutex_t s_lock = PTHREAD_MUTEX_INITIALIZER;
+static bool s_initialized;
+static bool s_started;
+static bool s_connected;
+static wifi_mode_t s_mode = WIFI_MODE_NULL;
+static wifi_config_t s_config[2];
+static struct esp_netif_obj s_netif_ap = {
+    .if_key = "WIFI_AP_DEF",
+    .ip_info = {
+        .ip = {ESP_IP4TOADDR(192, 168, 4, 1)},
+        .netmask = {ESP_IP4TOADDR(255, 255, 255, 0)},
+        .gw = {ESP_IP4TOADDR(192, 168, 4, 1)},
+    },
+};
+static struct esp_netif_obj s_netif_sta = {
+    .if_key = "WIFI_STA_DEF",
+};
+
+static const wifi_ap_record_t s_scan_records[] = {
+    {.bssid = {0x24, 0x0a, 0xc4, 0x00, 0x00, 0x01}, .ssid = "sim-office", .primary = 1, .rssi = -42, .authmode = WIFI_AUTH_WPA2_PSK},
+    {.bssid = {0x24, 0x0a, 0xc4, 0x00, 0x00, 0x02}, .ssid = "sim-lab", .primary = 6, .rssi = -61, .authmode = WIFI_AUTH_WPA2_PSK},
+    {.bssid = {0x24, 0x0a, 0xc4, 0x00, 0x00, 0x03}, .ssid = "sim-guest", .primary = 11, .rssi = -77, .authmode = WIFI_AUTH_OPEN},
+};
+
+esp_err_t esp_netif_init(void)
+{
+    return ESP_OK;
+}
+
+esp_netif_t *esp_netif_create_default_wifi_ap(void)
+{
+    return &s_netif_ap;
+}
+
+esp_netif_t *esp_netif_create_default_wifi_sta(void)
+{
+    return &s_netif_sta;
+}
+
+esp_err_t esp_netif_get_ip_info(esp_netif_t *esp_netif, esp_netif_ip_info_t *ip_info)
+{
+    if (!esp_netif || !ip_info)
+    {
+        return ESP_ERR_INVALID_ARG;
+    }
+    pthread_mutex_lock(&s_lock);
+    *ip_info = esp_netif->ip_info;
+    pthread_mutex_unlock(&s_lock);
+    return ESP_OK;
+}
+
+esp_netif_t *esp_netif_get_handle_from_ifkey(const char *if_key)
+{
+    if (strcmp(if_key, s_netif_ap.if_key) == 0)
+    {
+        return &s_netif_ap;
+    }
+    if (strcmp(if_key, s_netif_sta.if_key) == 0)
+    {
+        return &s_netif_sta;
+    }
+    return NULL;
+}
+
+esp_err_t esp_wifi_init(const wifi_init_config_t *config)
+{
+    s_initialized = true;
+    return ESP_OK;
+}
+
+esp_err_t esp_wifi_deinit(void)
+{
+    s_initialized = false;
+    return ESP_OK;
+}
+
+esp_err_t esp_wifi_set_mode(wifi_mode_t mode)
+{
+    if (!s_initialized)
+    {
+        return ESP_ERR_INVALID_STATE;
+    }
+    if (mode >= WIFI_MODE_MAX)
+    {
+        return ESP_ERR_INVALID_ARG;
+    }
+    pthread_mutex_lock(&s_lock);
+    s_mode = mode;
+    pthread_mutex_unlock(&s_lock);
+    return ESP_OK;
+}
+
+esp_err_t esp_wifi_get_mode(wifi_mode_t *mode)
+{
+    if (!mode)
+    {
+        return ESP_ERR_INVALID_ARG;
+    }
+    pthread_mutex_lock(&s_lock);
+    *mode = s_mode;
+    pthread_mutex_unlock(&s_lock);
+    return ESP_OK;
+}
+
+esp_err_t esp_wifi_set_config(wifi_interface_t interface, wifi_config_t *conf)
+{
+    if (interface > WIFI_IF_AP || !conf)
+    {
+        return ESP_ERR_INVALID_ARG;
+    }
+    pthread_mutex_lock(&s_lock);
+    s_config[interface] = *conf;
+    pthread_mutex_unlock(&s_lock);
+    return ESP_OK;
+}
+
+esp_err_t esp_wifi_get_config(wifi_interface_t interface, wifi_config_t *conf)
+{
+    if (interface > WIFI_IF_AP || !conf)
+    {
+        return ESP_ERR_INVALID_ARG;
+    }
+    pthread_mutex_lock(&s_lock);
+    *conf = s_config[interface];
+    pthread_mutex_unlock(&s_lock);
+    return ESP_OK;
+}
+
+esp_err_t esp_wifi_start(void)
+{
+    if (!s_initialized)
+    {
+        return ESP_ERR_INVALID_STATE;
+    }
+    wifi_mode_t mode;
+    esp_wifi_get_mode(&mode);
+    s_started = true;
+    if (mode == WIFI_MODE_AP || mode == WIFI_MODE_APSTA)
+    {
+        esp_event_post(WIFI_EVENT, WIFI_EVENT_AP_START, NULL, 0, portMAX_DELAY);
+    }
+    if (mode == WIFI_MODE_STA || mode == WIFI_MODE_APSTA)
+    {
+        esp_event_post(WIFI_EVENT, WIFI_EVENT_STA_START, NULL, 0, portMAX_DELAY);
+    }
+    return ESP_OK;
+}
+
+esp_err_t esp_wifi_stop(void)
+{
+    s_started = false;
+    esp_event_post(WIFI_EVENT, WIFI_EVENT_STA_STOP, NULL, 0, portMAX_DELAY);
+    esp_event_post(WIFI_EVENT, WIFI_EVENT_AP_STOP, NULL, 0, portMAX_DELAY);
+    return ESP_OK;
+}
+
+esp_err_t esp_wifi_connect(void)
+{
+    wifi_mode_t mode;
+    esp_wifi_get_mode(&mode);
+    if (!s_started || (mode != WIFI_MODE_STA && mode != WIFI_MODE_APSTA))
+    {
+        return ESP_ERR_INVALID_STATE;
+    }
+
+    pthread_mutex_lock(&s_lock);
+    wifi_sta_config_t sta = s_config[WIFI_IF_STA].sta;
+    pthread_mutex_unlock(&s_lock);
+    if (sta.ssid[0] == '\0')
+    {
+        wifi_event_sta_disconnected_t disconnected = {
+            .reason = SIM_DISCONNECT_REASON_NO_AP_FOUND,
+        };
+        return esp_event_post(WIFI_EVENT, WIFI_EVENT_STA_DISCONNECTED, &disconnected, sizeof(disconnected), portMAX_DELAY);
+    }
+
+    wifi_event_sta_connected_t connected = {
+        .ssid_len = (uint8_t)strnlen((const char *)sta.ssid, sizeof(sta.ssid)),
+        .channel = 1,
+        .authmode = WIFI_AUTH_WPA2_PSK,
+    };
+    memcpy(connected.ssid, sta.ssid, sizeof(connected.ssid));
+    esp_event_post(WIFI_EVENT, WIFI_EVENT_STA_CONNECTED, &connected, sizeof(connected), portMAX_DELAY);
+
+    pthread_mutex_lock(&s_lock);
+    s_connected = true;
+    s_netif_sta.ip_info.ip.addr = ESP_IP4TOADDR(192, 168, 4, 2);
+    s_netif_sta.ip_info.netmask.addr = ESP_IP4TOADDR(255, 255, 255, 0);
+    s_netif_sta.ip_info.gw.addr = ESP_IP4TOADDR(192, 168, 4, 1);
+    ip_event_got_ip_t got_ip = {
+        .esp_netif = &s_netif_sta,
+        .ip_info = s_netif_sta.ip_info,
+        .ip_changed = true,
+    };
+    pthread_mutex_unlock(&s_lock);
+    ESP_LOGD(TAG, "connected to %s", (const char *)sta.ssid);
+    return esp_event_post(IP_EVENT, IP_EVENT_STA_GOT_IP, &got_ip, sizeof(got_ip), portMAX_DELAY);
+}
+
+esp_err_t esp_wifi_disconnect(void)
+{
+    pthread_mutex_lock(&s_lock);
+    bool was_connected = s_connected;
+    s_connected = false;
+    memset(&s_netif_sta.ip_info, 0, sizeof(s_netif_sta.ip_info));
+    pthread_mutex_unlock(&s_lock);
+    if (!was_connected)
+    {
+        return ESP_OK;
+    }
+    wifi_event_sta_disconnected_t disconnected = {
+        .reason = 8, // WIFI_REASON_ASSOC_LEAVE
+    };
+    return esp_event_post(WIFI_EVENT, WIFI_EVENT_STA_DISCONNECTED, &disconnected, sizeof(disconnected), portMAX_DELAY);
+}
+
+esp_err_t esp_wifi_clear_ap_list(void)
+{
+    return ESP_OK;
+}
+
+esp_err_t esp_wifi_scan_start(const wifi_scan_config_t *config, bool block)
+{
+    if (!s_started)
+    {
+        return ESP_ERR_INVALID_STATE;
+    }
+    return esp_event_post(WIFI_EVENT, WIFI_EVENT_SCAN_DONE, NULL, 0, portMAX_DELAY);
+}
+
+esp_err_t esp_wifi_scan_get_ap_records(uint16_t *number, wifi_ap_record_t *ap_records)
+{
+    if (!number || !ap_records)
+    {
+        return ESP_ERR_INVALID_ARG;
+    }
+    uint16_t n = sizeof(s_scan_records) / sizeof(s_scan_records[0]);
+    if (*number < n)
+    {
+        n = *number;
+    }
+    memcpy(ap_records, s_scan_records, n * sizeof(*ap_records));
+    *number = n;
+    return ESP_OK;
+}
+
+esp_err_t esp_wifi_scan_get_ap_num(uint16_t *number)
+{
+    if (!number)
+    {
+        return ESP_ERR_INVALID_ARG;
+    }
+    *number = sizeof(s_scan_records) / sizeof(s_scan_records[0]);
+    return ESP_OK;
+}
+
+esp_err_t esp_wifi_get_mac(wifi_interface_t ifx, uint8_t mac[6])
+{
+    static const uint8_t base[6] = {0x24, 0x0a, 0xc4, 0x12, 0x34, 0x56};
+    memcpy(mac, base, 6);
+    mac[5] += ifx == WIFI_IF_AP ? 1 : 0;
+    return ESP_OK;
+}
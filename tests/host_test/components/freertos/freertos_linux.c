@@ -0,0 +1,950 @@
+/*
+ * FreeRTOS tasks, queues, semaphores, event groups and software timers on pthreads.
+ *
+ * Every task is a detached thread. Blocking calls wait on a condition variable with an
+ * absolute CLOCK_MONOTONIC deadline derived from the tick timeout. The tick count is the
+ * monotonic clock divided by portTICK_PERIOD_MS, so it runs whether or not anything waits.
+ *
+ * Pinned tasks are pinned to the host CPU of the same number when there is one, and
+ * priorities map to nice values around priority 5; raising a thread above nice 0 needs
+ * CAP_SYS_NICE and is skipped without it.
+ */
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <time.h>
+#include <sched.h>
+#include <unistd.h>
+#include <sys/resource.h>
+#include <sys/syscall.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/queue.h"
+#include "freertos/semphr.h"
+#include "freertos/event_groups.h"
+#include "freertos/timers.h"
+#include "esp_task.h"
+
+#define TASK_NAME_MAX 16
+#define TIMER_TASK_STACK 2048
+#define TIMER_TASK_PRIORITY 1
+#define NICE_PRIORITY 5 // priority running at nice 0
+
+struct tskTaskControlBlock
+{
+    pthread_t thread;
+    char name[TASK_NAME_MAX];
+    TaskFunction_t fn;
+    void *arg;
+    UBaseType_t priority;
+    BaseType_t core_id;
+    uint32_t stack_depth;
+    UBaseType_t number;
+    eTaskState state;
+    uint32_t notify;
+    pthread_cond_t notify_cond;
+    struct tskTaskControlBlock *next;
+};
+
+static pthread_mutex_t s_task_lock = PTHREAD_MUTEX_INITIALIZER;
+static struct tskTaskControlBlock *s_tasks = NULL;
+static UBaseType_t s_task_count = 0;
+static UBaseType_t s_task_number = 0;
+static __thread struct tskTaskControlBlock *s_current = NULL;
+static pthread_condattr_t s_condattr;
+static pthread_once_t s_init_once = PTHREAD_ONCE_INIT;
+
+static void freertos_init(void)
+{
+    pthread_condattr_init(&s_condattr);
+    pthread_condattr_setclock(&s_condattr, CLOCK_MONOTONIC);
+}
+
+static void cond_init(pthread_cond_t *cond)
+{
+    pthread_once(&s_init_once, freertos_init);
+    pthread_cond_init(cond, &s_condattr);
+}
+
+/* absolute deadline `ticks` from now, NULL when waiting forever */
+static const struct timespec *deadline(TickType_t ticks, struct timespec *ts)
+{
+    if (ticks == portMAX_DELAY)
+    {
+        return NULL;
+    }
+    clock_gettime(CLOCK_MONOTONIC, ts);
+    uint64_t ns = (uint64_t)ticks * portTICK_PERIOD_MS * 1000000ULL + ts->tv_nsec;
+    ts->tv_sec += ns / 1000000000ULL;
+    ts->tv_nsec = ns % 1000000000ULL;
+    return ts;
+}
+
+/* wait on `cond`, returns false once the deadline has passed */
+static bool cond_wait(pthread_cond_t *cond, pthread_mutex_t *mutex, const struct timespec *ts)
+{
+    if (!ts)
+    {
+        pthread_cond_wait(cond, mutex);
+        return true;
+    }
+    return pthread_cond_timedwait(cond, mutex, ts) != ETIMEDOUT;
+}
+
+BaseType_t xPortGetCoreID(void)
+{
+    struct tskTaskControlBlock *task = xTaskGetCurrentTaskHandle();
+    return (task->core_id == 0 || task->core_id == 1) ? task->core_id : 0;
+}
+
+BaseType_t xPortInIsrContext(void)
+{
+    return pdFALSE;
+}
+
+/* tasks */
+
+static struct tskTaskControlBlock *task_alloc(const char *name, UBaseType_t priority, BaseType_t core_id, uint32_t stack_depth)
+{
+    struct tskTaskControlBlock *task = calloc(1, sizeof(*task));
+    if (!task)
+    {
+        return NULL;
+    }
+    strlcpy(task->name, name ? name : "", sizeof(task->name));
+    task->priority = priority;
+    task->core_id = core_id;
+    task->stack_depth = stack_depth;
+    task->state = eReady;
+    cond_init(&task->notify_cond);
+
+    pthread_mutex_lock(&s_task_lock);
+    task->number = ++s_task_number;
+    task->next = s_tasks;
+    s_tasks = task;
+    s_task_count++;
+    pthread_mutex_unlock(&s_task_lock);
+    return task;
+}
+
+static void task_unlink(struct tskTaskControlBlock *task)
+{
+    pthread_mutex_lock(&s_task_lock);
+    for (struct tskTaskControlBlock **it = &s_tasks; *it; it = &(*it)->next)
+    {
+        if (*it == task)
+        {
+            *it = task->next;
+            s_task_count--;
+            break;
+        }
+    }
+    pthread_mutex_unlock(&s_task_lock);
+}
+
+static void *task_entry(void *arg)
+{
+    struct tskTaskControlBlock *task = arg;
+    s_current = task;
+    pthread_setname_np(pthread_self(), task->name);
+    if ((task->core_id == 0 || task->core_id == 1) && task->core_id < sysconf(_SC_NPROCESSORS_ONLN))
+    {
+        cpu_set_t cpus;
+        CPU_ZERO(&cpus);
+        CPU_SET(task->core_id, &cpus);
+        pthread_setaffinity_np(pthread_self(), sizeof(cpus), &cpus);
+    }
+    int nice = NICE_PRIORITY - (int)task->priority;
+    setpriority(PRIO_PROCESS, (id_t)syscall(SYS_gettid), nice < -10 ? -10 : nice);
+    task->state = eRunning;
+    task->fn(task->arg);
+    // returning from a task is an error on target, treat it as a self delete here
+    vTaskDelete(NULL);
+    return NULL;
+}
+
+BaseType_t xTaskCreatePinnedToCore(TaskFunction_t pvTaskCode, const char *const pcName, const uint32_t usStackDepth,
+                                   void *const pvParameters, UBaseType_t uxPriority, TaskHandle_t *const pvCreatedTask,
+                                   const BaseType_t xCoreID)
+{
+    struct tskTaskControlBlock *task = task_alloc(pcName, uxPriority, xCoreID, usStackDepth);
+    if (!task)
+    {
+        return pdFAIL;
+    }
+    task->fn = pvTaskCode;
+    task->arg = pvParameters;
+    if (pvCreatedTask)
+    {
+        *pvCreatedTask = task;
+    }
+
+    pthread_attr_t attr;
+    pthread_attr_init(&attr);
+    pthread_attr_setdetachstate(&attr, PTHREAD_CREATE_DETACHED);
+    int err = pthread_create(&task->thread, &attr, task_entry, task);
+    pthread_attr_destroy(&attr);
+    if (err != 0)
+    {
+        task_unlink(task);
+        free(task);
+        return pdFAIL;
+    }
+    return pdPASS;
+}
+
+void vTaskDelete(TaskHandle_t xTaskToDelete)
+{
+    struct tskTaskControlBlock *task = xTaskToDelete ? xTaskToDelete : xTaskGetCurrentTaskHandle();
+    task->state = eDeleted;
+    task_unlink(task);
+    if (task == s_current)
+    {
+        // the handle stays valid: other threads may still hold it
+        pthread_exit(NULL);
+    }
+    pthread_cancel(task->thread);
+}
+
+void vTaskDelay(const TickType_t xTicksToDelay)
+{
+    uint64_t ns = (uint64_t)xTicksToDelay * portTICK_PERIOD_MS * 1000000ULL;
+    struct timespec ts = {.tv_sec = ns / 1000000000ULL, .tv_nsec = ns % 1000000000ULL};
+    if (xTicksToDelay == 0)
+    {
+        sched_yield();
+        return;
+    }
+    while (nanosleep(&ts, &ts) != 0 && errno == EINTR)
+    {
+    }
+}
+
+BaseType_t xTaskDelayUntil(TickType_t *const pxPreviousWakeTime, const TickType_t xTimeIncrement)
+{
+    TickType_t wake = *pxPreviousWakeTime + xTimeIncrement;
+    TickType_t now = xTaskGetTickCount();
+    *pxPreviousWakeTime = wake;
+    if ((int32_t)(wake - now) <= 0)
+    {
+        return pdFALSE;
+    }
+    vTaskDelay(wake - now);
+    return pdTRUE;
+}
+
+TickType_t xTaskGetTickCount(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    uint64_t ms = (uint64_t)ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+    return (TickType_t)(ms / portTICK_PERIOD_MS);
+}
+
+TickType_t xTaskGetTickCountFromISR(void)
+{
+    return xTaskGetTickCount();
+}
+
+TaskHandle_t xTaskGetCurrentTaskHandle(void)
+{
+    if (!s_current)
+    {
+        // a thread not created through xTaskCreate (main, esp_timer, httpd) gets a handle on first use
+        char name[TASK_NAME_MAX] = "main";
+        pthread_getname_np(pthread_self(), name, sizeof(name));
+        s_current = task_alloc(name, 1, tskNO_AFFINITY, ESP_TASK_MAIN_STACK);
+        s_current->thread = pthread_self();
+        s_current->state = eRunning;
+    }
+    return s_current;
+}
+
+char *pcTaskGetName(TaskHandle_t xTaskToQuery)
+{
+    return (xTaskToQuery ? xTaskToQuery : xTaskGetCurrentTaskHandle())->name;
+}
+
+UBaseType_t uxTaskPriorityGet(TaskHandle_t xTask)
+{
+    return (xTask ? xTask : xTaskGetCurrentTaskHandle())->priority;
+}
+
+void vTaskPrioritySet(TaskHandle_t xTask, UBaseType_t uxNewPriority)
+{
+    (xTask ? xTask : xTaskGetCurrentTaskHandle())->priority = uxNewPriority;
+}
+
+BaseType_t xTaskGetAffinity(TaskHandle_t xTask)
+{
+    return (xTask ? xTask : xTaskGetCurrentTaskHandle())->core_id;
+}
+
+UBaseType_t uxTaskGetNumberOfTasks(void)
+{
+    pthread_mutex_lock(&s_task_lock);
+    UBaseType_t count = s_task_count;
+    pthread_mutex_unlock(&s_task_lock);
+    return count;
+}
+
+UBaseType_t uxTaskGetStackHighWaterMark(TaskHandle_t xTask)
+{
+    // stacks are not instrumented on the host, report the requested depth as untouched
+    return (xTask ? xTask : xTaskGetCurrentTaskHandle())->stack_depth;
+}
+
+static uint32_t thread_cpu_us(pthread_t thread)
+{
+    clockid_t clock;
+    struct timespec ts;
+    if (pthread_getcpuclockid(thread, &clock) != 0 || clock_gettime(clock, &ts) != 0)
+    {
+        return 0;
+    }
+    return (uint32_t)((uint64_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000);
+}
+
+UBaseType_t uxTaskGetSystemState(TaskStatus_t *const pxTaskStatusArray, const UBaseType_t uxArraySize, uint32_t *const pulTotalRunTime)
+{
+    UBaseType_t n = 0;
+    pthread_mutex_lock(&s_task_lock);
+    if (uxArraySize >= s_task_count)
+    {
+        for (struct tskTaskControlBlock *task = s_tasks; task; task = task->next)
+        {
+            TaskStatus_t *status = &pxTaskStatusArray[n++];
+            memset(status, 0, sizeof(*status));
+            status->xHandle = task;
+            status->pcTaskName = task->name;
+            status->xTaskNumber = task->number;
+            status->eCurrentState = task == s_current ? eRunning : task->state;
+            status->uxCurrentPriority = task->priority;
+            status->uxBasePriority = task->priority;
+            status->ulRunTimeCounter = thread_cpu_us(task->thread);
+            status->usStackHighWaterMark = task->stack_depth;
+            status->xCoreID = task->core_id;
+        }
+    }
+    pthread_mutex_unlock(&s_task_lock);
+    if (pulTotalRunTime)
+    {
+        struct timespec ts;
+        clock_gettime(CLOCK_MONOTONIC, &ts);
+        *pulTotalRunTime = (uint32_t)((uint64_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000);
+    }
+    return n;
+}
+
+static pthread_mutex_t s_scheduler_lock = PTHREAD_RECURSIVE_MUTEX_INITIALIZER_NP;
+
+void vTaskSuspendAll(void)
+{
+    pthread_mutex_lock(&s_scheduler_lock);
+}
+
+BaseType_t xTaskResumeAll(void)
+{
+    pthread_mutex_unlock(&s_scheduler_lock);
+    return pdFALSE;
+}
+
+uint32_t ulTaskNotifyTake(BaseType_t xClearCountOnExit, TickType_t xTicksToWait)
+{
+    struct tskTaskControlBlock *task = xTaskGetCurrentTaskHandle();
+    struct timespec ts;
+    const struct timespec *until = deadline(xTicksToWait, &ts);
+    pthread_mutex_lock(&s_task_lock);
+    while (task->notify == 0 && xTicksToWait != 0 && cond_wait(&task->notify_cond, &s_task_lock, until))
+    {
+    }
+    uint32_t value = task->notify;
+    if (value)
+    {
+        task->notify = xClearCountOnExit ? 0 : value - 1;
+    }
+    pthread_mutex_unlock(&s_task_lock);
+    return value;
+}
+
+BaseType_t xTaskNotifyGive(TaskHandle_t xTaskToNotify)
+{
+    pthread_mutex_lock(&s_task_lock);
+    xTaskToNotify->notify++;
+    pthread_cond_signal(&xTaskToNotify->notify_cond);
+    pthread_mutex_unlock(&s_task_lock);
+    return pdPASS;
+}
+
+void vTaskNotifyGiveFromISR(TaskHandle_t xTaskToNotify, BaseType_t *pxHigherPriorityTaskWoken)
+{
+    xTaskNotifyGive(xTaskToNotify);
+    if (pxHigherPriorityTaskWoken)
+    {
+        *pxHigherPriorityTaskWoken = pdFALSE;
+    }
+}
+
+/* queues, semaphores are queues with zero sized items */
+
+typedef enum
+{
+    QUEUE_TYPE_QUEUE,
+    QUEUE_TYPE_SEMAPHORE,
+    QUEUE_TYPE_MUTEX,
+    QUEUE_TYPE_RECURSIVE_MUTEX,
+} queue_type_t;
+
+struct QueueDefinition
+{
+    pthread_mutex_t lock;
+    pthread_cond_t not_empty;
+    pthread_cond_t not_full;
+    queue_type_t type;
+    UBaseType_t length;
+    UBaseType_t item_size;
+    UBaseType_t count;
+    UBaseType_t head;
+    TaskHandle_t holder;
+    UBaseType_t recursion;
+    uint8_t *storage;
+};
+
+static QueueHandle_t queue_create(UBaseType_t length, UBaseType_t item_size, queue_type_t type)
+{
+    struct QueueDefinition *queue = calloc(1, sizeof(*queue));
+    if (!queue)
+    {
+        return NULL;
+    }
+    if (item_size)
+    {
+        queue->storage = malloc((size_t)length * item_size);
+        if (!queue->storage)
+        {
+            free(queue);
+            return NULL;
+        }
+    }
+    pthread_mutex_init(&queue->lock, NULL);
+    cond_init(&queue->not_empty);
+    cond_init(&queue->not_full);
+    queue->type = type;
+    queue->length = length;
+    queue->item_size = item_size;
+    return queue;
+}
+
+static BaseType_t queue_send(QueueHandle_t queue, const void *item, TickType_t ticks, bool front, bool overwrite)
+{
+    struct timespec ts;
+    const struct timespec *until = deadline(ticks, &ts);
+    pthread_mutex_lock(&queue->lock);
+    while (queue->count == queue->length && !overwrite)
+    {
+        if (ticks == 0 || !cond_wait(&queue->not_full, &queue->lock, until))
+        {
+            pthread_mutex_unlock(&queue->lock);
+            return errQUEUE_FULL;
+        }
+    }
+    if (queue->item_size)
+    {
+        UBaseType_t slot;
+        if (overwrite && queue->count == queue->length)
+        {
+            slot = (queue->head + queue->count - 1) % queue->length;
+        }
+        else if (front)
+        {
+            queue->head = (queue->head + queue->length - 1) % queue->length;
+            slot = queue->head;
+            queue->count++;
+        }
+        else
+        {
+            slot = (queue->head + queue->count) % queue->length;
+            queue->count++;
+        }
+        // semaphores have no items, a queue given a NULL item keeps the slot as it is
+        if (item)
+        {
+            memcpy(queue->storage + (size_t)slot * queue->item_size, item, queue->item_size);
+        }
+    }
+    else if (queue->count < queue->length)
+    {
+        queue->count++;
+    }
+    if (queue->type == QUEUE_TYPE_MUTEX || queue->type == QUEUE_TYPE_RECURSIVE_MUTEX)
+    {
+        queue->holder = NULL;
+    }
+    pthread_cond_signal(&queue->not_empty);
+    pthread_mutex_unlock(&queue->lock);
+    return pdPASS;
+}
+
+static BaseType_t queue_receive(QueueHandle_t queue, void *buffer, TickType_t ticks)
+{
+    struct timespec ts;
+    const struct timespec *until = deadline(ticks, &ts);
+    pthread_mutex_lock(&queue->lock);
+    while (queue->count == 0)
+    {
+        if (ticks == 0 || !cond_wait(&queue->not_empty, &queue->lock, until))
+        {
+            pthread_mutex_unlock(&queue->lock);
+            return pdFALSE;
+        }
+    }
+    if (queue->item_size)
+    {
+        if (buffer)
+        {
+            memcpy(buffer, queue->storage + (size_t)queue->head * queue->item_size, queue->item_size);
+        }
+        queue->head = (queue->head + 1) % queue->length;
+    }
+    queue->count--;
+    if (queue->type == QUEUE_TYPE_MUTEX || queue->type == QUEUE_TYPE_RECURSIVE_MUTEX)
+    {
+        queue->holder = xTaskGetCurrentTaskHandle();
+    }
+    pthread_cond_signal(&queue->not_full);
+    pthread_mutex_unlock(&queue->lock);
+    return pdTRUE;
+}
+
+QueueHandle_t xQueueCreate(UBaseType_t uxQueueLength, UBaseType_t uxItemSize)
+{
+    return queue_create(uxQueueLength, uxItemSize, QUEUE_TYPE_QUEUE);
+}
+
+void vQueueDelete(QueueHandle_t xQueue)
+{
+    pthread_mutex_destroy(&xQueue->lock);
+    pthread_cond_destroy(&xQueue->not_empty);
+    pthread_cond_destroy(&xQueue->not_full);
+    free(xQueue->storage);
+    free(xQueue);
+}
+
+BaseType_t xQueueSend(QueueHandle_t xQueue, const void *pvItemToQueue, TickType_t xTicksToWait)
+{
+    return queue_send(xQueue, pvItemToQueue, xTicksToWait, false, false);
+}
+
+BaseType_t xQueueSendToFront(QueueHandle_t xQueue, const void *pvItemToQueue, TickType_t xTicksToWait)
+{
+    return queue_send(xQueue, pvItemToQueue, xTicksToWait, true, false);
+}
+
+BaseType_t xQueueSendFromISR(QueueHandle_t xQueue, const void *pvItemToQueue, BaseType_t *pxHigherPriorityTaskWoken)
+{
+    if (pxHigherPriorityTaskWoken)
+    {
+        *pxHigherPriorityTaskWoken = pdFALSE;
+    }
+    return queue_send(xQueue, pvItemToQueue, 0, false, false);
+}
+
+BaseType_t xQueueOverwrite(QueueHandle_t xQueue, const void *pvItemToQueue)
+{
+    return queue_send(xQueue, pvItemToQueue, 0, false, true);
+}
+
+BaseType_t xQueueReceive(QueueHandle_t xQueue, void *pvBuffer, TickType_t xTicksToWait)
+{
+    return queue_receive(xQueue, pvBuffer, xTicksToWait);
+}
+
+UBaseType_t uxQueueMessagesWaiting(QueueHandle_t xQueue)
+{
+    pthread_mutex_lock(&xQueue->lock);
+    UBaseType_t count = xQueue->count;
+    pthread_mutex_unlock(&xQueue->lock);
+    return count;
+}
+
+UBaseType_t uxQueueSpacesAvailable(QueueHandle_t xQueue)
+{
+    pthread_mutex_lock(&xQueue->lock);
+    UBaseType_t spaces = xQueue->length - xQueue->count;
+    pthread_mutex_unlock(&xQueue->lock);
+    return spaces;
+}
+
+SemaphoreHandle_t xSemaphoreCreateBinary(void)
+{
+    return queue_create(1, 0, QUEUE_TYPE_SEMAPHORE);
+}
+
+SemaphoreHandle_t xSemaphoreCreateCounting(UBaseType_t uxMaxCount, UBaseType_t uxInitialCount)
+{
+    SemaphoreHandle_t sem = queue_create(uxMaxCount, 0, QUEUE_TYPE_SEMAPHORE);
+    if (sem)
+    {
+        sem->count = uxInitialCount;
+    }
+    return sem;
+}
+
+SemaphoreHandle_t xSemaphoreCreateMutex(void)
+{
+    SemaphoreHandle_t mutex = queue_create(1, 0, QUEUE_TYPE_MUTEX);
+    if (mutex)
+    {
+        mutex->count = 1;
+    }
+    return mutex;
+}
+
+SemaphoreHandle_t xSemaphoreCreateRecursiveMutex(void)
+{
+    SemaphoreHandle_t mutex = queue_create(1, 0, QUEUE_TYPE_RECURSIVE_MUTEX);
+    if (mutex)
+    {
+        mutex->count = 1;
+    }
+    return mutex;
+}
+
+BaseType_t xSemaphoreTake(SemaphoreHandle_t xSemaphore, TickType_t xBlockTime)
+{
+    return queue_receive(xSemaphore, NULL, xBlockTime);
+}
+
+BaseType_t xSemaphoreGive(SemaphoreHandle_t xSemaphore)
+{
+    // giving a full semaphore fails without blocking
+    return queue_send(xSemaphore, NULL, 0, false, false);
+}
+
+BaseType_t xSemaphoreTakeRecursive(SemaphoreHandle_t xMutex, TickType_t xBlockTime)
+{
+    TaskHandle_t self = xTaskGetCurrentTaskHandle();
+    pthread_mutex_lock(&xMutex->lock);
+    if (xMutex->holder == self)
+    {
+        xMutex->recursion++;
+        pthread_mutex_unlock(&xMutex->lock);
+        return pdTRUE;
+    }
+    pthread_mutex_unlock(&xMutex->lock);
+    if (queue_receive(xMutex, NULL, xBlockTime) != pdTRUE)
+    {
+        return pdFALSE;
+    }
+    xMutex->recursion = 1;
+    return pdTRUE;
+}
+
+BaseType_t xSemaphoreGiveRecursive(SemaphoreHandle_t xMutex)
+{
+    pthread_mutex_lock(&xMutex->lock);
+    if (xMutex->holder != xTaskGetCurrentTaskHandle())
+    {
+        pthread_mutex_unlock(&xMutex->lock);
+        return pdFALSE;
+    }
+    bool release = --xMutex->recursion == 0;
+    pthread_mutex_unlock(&xMutex->lock);
+    return release ? queue_send(xMutex, NULL, 0, false, false) : pdTRUE;
+}
+
+BaseType_t xSemaphoreGiveFromISR(SemaphoreHandle_t xSemaphore, BaseType_t *pxHigherPriorityTaskWoken)
+{
+    if (pxHigherPriorityTaskWoken)
+    {
+        *pxHigherPriorityTaskWoken = pdFALSE;
+    }
+    return xSemaphoreGive(xSemaphore);
+}
+
+BaseType_t xSemaphoreTakeFromISR(SemaphoreHandle_t xSemaphore, BaseType_t *pxHigherPriorityTaskWoken)
+{
+    if (pxHigherPriorityTaskWoken)
+    {
+        *pxHigherPriorityTaskWoken = pdFALSE;
+    }
+    return queue_receive(xSemaphore, NULL, 0);
+}
+
+UBaseType_t uxSemaphoreGetCount(SemaphoreHandle_t xSemaphore)
+{
+    return uxQueueMessagesWaiting(xSemaphore);
+}
+
+void vSemaphoreDelete(SemaphoreHandle_t xSemaphore)
+{
+    vQueueDelete(xSemaphore);
+}
+
+/* event groups */
+
+struct EventGroupDef_t
+{
+    pthread_mutex_t lock;
+    pthread_cond_t changed;
+    EventBits_t bits;
+};
+
+EventGroupHandle_t xEventGroupCreate(void)
+{
+    struct EventGroupDef_t *group = calloc(1, sizeof(*group));
+    if (group)
+    {
+        pthread_mutex_init(&group->lock, NULL);
+        cond_init(&group->changed);
+    }
+    return group;
+}
+
+void vEventGroupDelete(EventGroupHandle_t xEventGroup)
+{
+    pthread_mutex_destroy(&xEventGroup->lock);
+    pthread_cond_destroy(&xEventGroup->changed);
+    free(xEventGroup);
+}
+
+EventBits_t xEventGroupSetBits(EventGroupHandle_t xEventGroup, const EventBits_t uxBitsToSet)
+{
+    pthread_mutex_lock(&xEventGroup->lock);
+    xEventGroup->bits |= uxBitsToSet;
+    EventBits_t bits = xEventGroup->bits;
+    pthread_cond_broadcast(&xEventGroup->changed);
+    pthread_mutex_unlock(&xEventGroup->lock);
+    return bits;
+}
+
+EventBits_t xEventGroupClearBits(EventGroupHandle_t xEventGroup, const EventBits_t uxBitsToClear)
+{
+    pthread_mutex_lock(&xEventGroup->lock);
+    EventBits_t bits = xEventGroup->bits;
+    xEventGroup->bits &= ~uxBitsToClear;
+    pthread_mutex_unlock(&xEventGroup->lock);
+    return bits;
+}
+
+EventBits_t xEventGroupGetBits(EventGroupHandle_t xEventGroup)
+{
+    pthread_mutex_lock(&xEventGroup->lock);
+    EventBits_t bits = xEventGroup->bits;
+    pthread_mutex_unlock(&xEventGroup->lock);
+    return bits;
+}
+
+EventBits_t xEventGroupWaitBits(EventGroupHandle_t xEventGroup, const EventBits_t uxBitsToWaitFor, const BaseType_t xClearOnExit,
+                                const BaseType_t xWaitForAllBits, TickType_t xTicksToWait)
+{
+    struct timespec ts;
+    const struct timespec *until = deadline(xTicksToWait, &ts);
+    pthread_mutex_lock(&xEventGroup->lock);
+    for (;;)
+    {
+        EventBits_t set = xEventGroup->bits & uxBitsToWaitFor;
+        bool done = xWaitForAllBits ? set == uxBitsToWaitFor : set != 0;
+        if (done || xTicksToWait == 0 || !cond_wait(&xEventGroup->changed, &xEventGroup->lock, until))
+        {
+            break;
+        }
+    }
+    EventBits_t bits = xEventGroup->bits;
+    EventBits_t set = bits & uxBitsToWaitFor;
+    if (xClearOnExit && (xWaitForAllBits ? set == uxBitsToWaitFor : set != 0))
+    {
+        xEventGroup->bits &= ~uxBitsToWaitFor;
+    }
+    pthread_mutex_unlock(&xEventGroup->lock);
+    return bits;
+}
+
+/* software timers, callbacks run one at a time on the timer service task */
+
+struct tmrTimerControl
+{
+    const char *name;
+    TickType_t period;
+    bool auto_reload;
+    void *id;
+    TimerCallbackFunction_t callback;
+    uint64_t expiry_ms; // CLOCK_MONOTONIC
+    bool active;
+    bool deleted;
+    struct tmrTimerControl *next; // active timers, sorted by expiry
+};
+
+static pthread_mutex_t s_timer_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t s_timer_cond;
+static struct tmrTimerControl *s_timers = NULL;
+static struct tmrTimerControl *s_timer_running = NULL;
+static TaskHandle_t s_timer_task = NULL;
+
+static uint64_t monotonic_ms(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+}
+
+static void timer_unlink(struct tmrTimerControl *timer)
+{
+    for (struct tmrTimerControl **it = &s_timers; *it; it = &(*it)->next)
+    {
+        if (*it == timer)
+        {
+            *it = timer->next;
+            break;
+        }
+    }
+    timer->active = false;
+}
+
+static void timer_insert(struct tmrTimerControl *timer)
+{
+    struct tmrTimerControl **it = &s_timers;
+    while (*it && (*it)->expiry_ms <= timer->expiry_ms)
+    {
+        it = &(*it)->next;
+    }
+    timer->next = *it;
+    *it = timer;
+    timer->active = true;
+}
+
+static void timer_task(void *arg)
+{
+    pthread_mutex_lock(&s_timer_lock);
+    for (;;)
+    {
+        struct tmrTimerControl *timer = s_timers;
+        if (!timer)
+        {
+            pthread_cond_wait(&s_timer_cond, &s_timer_lock);
+            continue;
+        }
+        uint64_t now = monotonic_ms();
+        if (timer->expiry_ms > now)
+        {
+            struct timespec ts = {.tv_sec = timer->expiry_ms / 1000, .tv_nsec = (timer->expiry_ms % 1000) * 1000000};
+            pthread_cond_timedwait(&s_timer_cond, &s_timer_lock, &ts);
+            continue;
+        }
+
+        timer_unlink(timer);
+        if (timer->auto_reload)
+        {
+            timer->expiry_ms += (uint64_t)timer->period * portTICK_PERIOD_MS;
+            timer_insert(timer);
+        }
+        s_timer_running = timer;
+        pthread_mutex_unlock(&s_timer_lock);
+        timer->callback(timer);
+        pthread_mutex_lock(&s_timer_lock);
+        s_timer_running = NULL;
+        if (timer->deleted)
+        {
+            timer_unlink(timer);
+            free(timer);
+        }
+    }
+}
+
+static void timer_task_start(void)
+{
+    pthread_once(&s_init_once, freertos_init);
+    pthread_cond_init(&s_timer_cond, &s_condattr);
+    xTaskCreatePinnedToCore(timer_task, "Tmr Svc", TIMER_TASK_STACK, NULL, TIMER_TASK_PRIORITY, &s_timer_task, 0);
+}
+
+TimerHandle_t xTimerCreate(const char *const pcTimerName, const TickType_t xTimerPeriodInTicks, const UBaseType_t uxAutoReload,
+                           void *const pvTimerID, TimerCallbackFunction_t pxCallbackFunction)
+{
+    static pthread_once_t timer_once = PTHREAD_ONCE_INIT;
+    if (xTimerPeriodInTicks == 0 || !pxCallbackFunction)
+    {
+        return NULL;
+    }
+    struct tmrTimerControl *timer = calloc(1, sizeof(*timer));
+    if (!timer)
+    {
+        return NULL;
+    }
+    pthread_once(&timer_once, timer_task_start);
+    timer->name = pcTimerName;
+    timer->period = xTimerPeriodInTicks;
+    timer->auto_reload = uxAutoReload != pdFALSE;
+    timer->id = pvTimerID;
+    timer->callback = pxCallbackFunction;
+    return timer;
+}
+
+BaseType_t xTimerChangePeriod(TimerHandle_t xTimer, TickType_t xNewPeriod, TickType_t xTicksToWait)
+{
+    if (xNewPeriod == 0)
+    {
+        return pdFAIL;
+    }
+    pthread_mutex_lock(&s_timer_lock);
+    timer_unlink(xTimer);
+    xTimer->period = xNewPeriod;
+    xTimer->expiry_ms = monotonic_ms() + (uint64_t)xNewPeriod * portTICK_PERIOD_MS;
+    timer_insert(xTimer);
+    pthread_cond_signal(&s_timer_cond);
+    pthread_mutex_unlock(&s_timer_lock);
+    return pdPASS;
+}
+
+BaseType_t xTimerStart(TimerHandle_t xTimer, TickType_t xTicksToWait)
+{
+    return xTimerChangePeriod(xTimer, xTimer->period, xTicksToWait);
+}
+
+BaseType_t xTimerReset(TimerHandle_t xTimer, TickType_t xTicksToWait)
+{
+    return xTimerChangePeriod(xTimer, xTimer->period, xTicksToWait);
+}
+
+BaseType_t xTimerStop(TimerHandle_t xTimer, TickType_t xTicksToWait)
+{
+    pthread_mutex_lock(&s_timer_lock);
+    timer_unlink(xTimer);
+    pthread_mutex_unlock(&s_timer_lock);
+    return pdPASS;
+}
+
+BaseType_t xTimerDelete(TimerHandle_t xTimer, TickType_t xTicksToWait)
+{
+    pthread_mutex_lock(&s_timer_lock);
+    timer_unlink(xTimer);
+    if (s_timer_running == xTimer)
+    {
+        // freed by the service task once the callback returns
+        xTimer->deleted = true;
+    }
+    else
+    {
+        free(xTimer);
+    }
+    pthread_mutex_unlock(&s_timer_lock);
+    return pdPASS;
+}
+
+BaseType_t xTimerIsTimerActive(TimerHandle_t xTimer)
+{
+    pthread_mutex_lock(&s_timer_lock);
+    BaseType_t active = xTimer->active ? pdTRUE : pdFALSE;
+    pthread_mutex_unlock(&s_timer_lock);
+    return active;
+}
+
+void *pvTimerGetTimerID(const TimerHandle_t xTimer)
+{
+    return xTimer->id;
+}
+
+const char *pcTimerGetName(TimerHandle_t xTimer)
+{
+    return xTimer->name;
+}
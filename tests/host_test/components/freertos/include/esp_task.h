@@ -0,0 +1,6 @@
+#pragma once
+
+#define ESP_TASK_PRIO_MAX (configMAX_PRIORITIES)
+#define ESP_TASK_PRIO_MIN (0)
+#define ESP_TASK_MAIN_STACK 3584
+#define ESP_TASK_MAIN_PRIO (ESP_TASK_PRIO_MIN + 1)
@@ -0,0 +1,115 @@
+/*
+ * The part of the mDNS API the firmware uses, with hooks into what it advertises
+ */
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+#include "esp_err.h"
+#include "esp_netif.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define MDNS_TYPE_A 0x0001
+#define MDNS_TYPE_PTR 0x000C
+#define MDNS_TYPE_TXT 0x0010
+#define MDNS_TYPE_AAAA 0x001C
+#define MDNS_TYPE_SRV 0x0021
+#define MDNS_TYPE_ANY 0x00FF
+
+typedef struct mdns_search_once_s mdns_search_once_t;
+
+typedef enum {
+    MDNS_IP_PROTOCOL_V4,
+    MDNS_IP_PROTOCOL_V6,
+    MDNS_IP_PROTOCOL_MAX
+} mdns_ip_protocol_t;
+
+typedef struct {
+    const char *key;
+    const char *value;
+} mdns_txt_item_t;
+
+typedef struct mdns_ip_addr_s {
+    esp_ip_addr_t addr;
+    struct mdns_ip_addr_s *next;
+} mdns_ip_addr_t;
+
+typedef struct mdns_result_s {
+    struct mdns_result_s *next;
+    esp_netif_t *esp_netif;
+    uint32_t ttl;
+    mdns_ip_protocol_t ip_protocol;
+    char *instance_name;
+    char *service_type;
+    char *proto;
+    char *hostname;
+    uint16_t port;
+    mdns_txt_item_t *txt;
+    uint8_t *txt_value_len;
+    size_t txt_count;
+    mdns_ip_addr_t *addr;
+} mdns_result_t;
+
+typedef void (*mdns_query_notify_t)(mdns_search_once_t *search);
+
+esp_err_t mdns_init(void);
+void mdns_free(void);
+esp_err_t mdns_hostname_set(const char *hostname);
+esp_err_t mdns_instance_name_set(const char *instance_name);
+esp_err_t mdns_service_add(const char *instance_name, const char *service_type, const char *proto, uint16_t port,
+                           mdns_txt_item_t txt[], size_t num_items);
+esp_err_t mdns_service_remove(const char *service_type, const char *proto);
+esp_err_t mdns_service_instance_name_set(const char *service_type, const char *proto, const char *instance_name);
+esp_err_t mdns_service_txt_item_set(const char *service_type, const char *proto, const char *key, const char *value);
+
+/* PTR queries only, answered by the peers added with sim_mdns_add_peer */
+mdns_search_once_t *mdns_query_async_new(const char *name, const char *service_type, const char *proto, uint16_t type,
+                                         uint32_t timeout, size_t max_results, mdns_query_notify_t notifier);
+bool mdns_query_async_get_results(mdns_search_once_t *search, uint32_t timeout, mdns_result_t **results, uint8_t *num_results);
+esp_err_t mdns_query_async_delete(mdns_search_once_t *search);
+void mdns_query_results_free(mdns_result_t *results);
+esp_err_t mdns_query_a(const char *host_name, uint32_t timeout, esp_ip4_addr_t *addr);
+
+/**
+ * @brief Copy the host name set by the firmware, empty before mdns_init
+ */
+void sim_mdns_get_hostname(char *buf, size_t size);
+
+/**
+ * @brief Whether the firmware advertises `service_type`.`proto`, and on which port
+ */
+bool sim_mdns_get_service(const char *service_type, const char *proto, uint16_t *port);
+
+/**
+ * @brief Copy the value of TXT item `key` of a service
+ *
+ * @return false if the service or the item is not advertised
+ */
+bool sim_mdns_get_txt(const char *service_type, const char *proto, const char *key, char *buf, size_t size);
+
+/**
+ * @brief Get the number of mdns_service_txt_item_set calls, each one is multicast by the real responder
+ */
+uint32_t sim_mdns_get_txt_updates(void);
+
+/**
+ * @brief Announce a service of another device on the simulated network
+ *
+ * Browses find it with its host name, port and TXT records, and with `ip` unless it is 0.
+ * A queries for `hostname` resolve to `ip`.
+ */
+esp_err_t sim_mdns_add_peer(const char *instance, const char *service_type, const char *proto, const char *hostname,
+                            uint32_t ip, uint16_t port, const mdns_txt_item_t *txt, size_t num_txt);
+
+/**
+ * @brief Stop announcing a peer added with sim_mdns_add_peer
+ */
+esp_err_t sim_mdns_remove_peer(const char *instance);
+
+#ifdef __cplusplus
+}
+#endif
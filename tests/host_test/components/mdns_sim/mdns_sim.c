@@ -0,0 +1,470 @@
+/*
+ * mDNS on the Linux host: keeps what would be advertised without touching the network, and
+ * answers browses from peers added by the tests
+ */
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <unistd.h>
+#include <pthread.h>
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "mdns.h"
+#include "bsd_string.h"
+
+#define SIM_MDNS_MAX_SERVICES 4
+#define SIM_MDNS_MAX_TXT 8
+#define SIM_MDNS_NAME_LEN 64
+#define SIM_MDNS_MAX_PEERS 16
+#define SIM_MDNS_PEER_TTL 120
+
+typedef struct {
+    char key[SIM_MDNS_NAME_LEN];
+    char value[SIM_MDNS_NAME_LEN];
+} sim_txt_t;
+
+typedef struct {
+    bool used;
+    char instance[SIM_MDNS_NAME_LEN];
+    char type[SIM_MDNS_NAME_LEN];
+    char proto[8];
+    uint16_t port;
+    size_t num_txt;
+    sim_txt_t txt[SIM_MDNS_MAX_TXT];
+} sim_service_t;
+
+typedef struct {
+    sim_service_t service;
+    char hostname[SIM_MDNS_NAME_LEN];
+    uint32_t ip;
+} sim_peer_t;
+
+/* peers answer at once, the search still lasts its timeout unless enough answered */
+struct mdns_search_once_s
+{
+    char type[SIM_MDNS_NAME_LEN];
+    char proto[8];
+    int64_t end_us;
+};
+
+static const char *TAG = "mdns_sim";
+static pthread_mutex_t s_lock = PTHREAD_MUTEX_INITIALIZER;
+static bool s_running;
+static char s_hostname[SIM_MDNS_NAME_LEN];
+static char s_instance[SIM_MDNS_NAME_LEN];
+static sim_service_t s_services[SIM_MDNS_MAX_SERVICES];
+static uint32_t s_txt_updates;
+static sim_peer_t s_peers[SIM_MDNS_MAX_PEERS];
+
+/* called with s_lock held */
+static sim_service_t *find_service(const char *service_type, const char *proto)
+{
+    for (int i = 0; i < SIM_MDNS_MAX_SERVICES; i++)
+    {
+        sim_service_t *service = &s_services[i];
+        if (service->used && !strcasecmp(service->type, service_type) && !strcasecmp(service->proto, proto))
+        {
+            return service;
+        }
+    }
+    return NULL;
+}
+
+/* called with s_lock held */
+static esp_err_t set_txt(sim_service_t *service, const char *key, const char *value)
+{
+    sim_txt_t *item = NULL;
+    for (size_t i = 0; i < service->num_txt && !item; i++)
+    {
+        item = strcmp(service->txt[i].key, key) ? NULL : &service->txt[i];
+    }
+    if (!item)
+    {
+        if (service->num_txt == SIM_MDNS_MAX_TXT)
+        {
+            return ESP_ERR_NO_MEM;
+        }
+        item = &service->txt[service->num_txt++];
+        strlcpy(item->key, key, sizeof(item->key));
+    }
+    strlcpy(item->value, value ? value : "", sizeof(item->value));
+    return ESP_OK;
+}
+
+esp_err_t mdns_init(void)
+{
+    pthread_mutex_lock(&s_lock);
+    esp_err_t err = s_running ? ESP_ERR_INVALID_STATE : ESP_OK;
+    s_running = true;
+    pthread_mutex_unlock(&s_lock);
+    return err;
+}
+
+void mdns_free(void)
+{
+    pthread_mutex_lock(&s_lock);
+    s_running = false;
+    s_hostname[0] = '\0';
+    s_instance[0] = '\0';
+    memset(s_services, 0, sizeof(s_services));
+    pthread_mutex_unlock(&s_lock);
+}
+
+esp_err_t mdns_hostname_set(const char *hostname)
+{
+    if (!hostname || !hostname[0] || strlen(hostname) >= SIM_MDNS_NAME_LEN)
+    {
+        return ESP_ERR_INVALID_ARG;
+    }
+    pthread_mutex_lock(&s_lock);
+    esp_err_t err = s_running ? ESP_OK : ESP_ERR_INVALID_STATE;
+    if (err == ESP_OK)
+    {
+        strlcpy(s_hostname, hostname, sizeof(s_hostname));
+    }
+    pthread_mutex_unlock(&s_lock);
+    return err;
+}
+
+esp_err_t mdns_instance_name_set(const char *instance_name)
+{
+    if (!instance_name || !instance_name[0] || strlen(instance_name) >= SIM_MDNS_NAME_LEN)
+    {
+        return ESP_ERR_INVALID_ARG;
+    }
+    pthread_mutex_lock(&s_lock);
+    esp_err_t err = s_running ? ESP_OK : ESP_ERR_INVALID_STATE;
+    if (err == ESP_OK)
+    {
+        strlcpy(s_instance, instance_name, sizeof(s_instance));
+    }
+    pthread_mutex_unlock(&s_lock);
+    return err;
+}
+
+esp_err_t mdns_service_add(const char *instance_name, const char *service_type, const char *proto, uint16_t port,
+                           mdns_txt_item_t txt[], size_t num_items)
+{
+    if (!service_type || !proto || !port || (num_items && !txt) || num_items > SIM_MDNS_MAX_TXT)
+    {
+        return ESP_ERR_INVALID_ARG;
+    }
+    pthread_mutex_lock(&s_lock);
+    esp_err_t err = !s_running ? ESP_ERR_INVALID_STATE : find_service(service_type, proto) ? ESP_ERR_INVALID_ARG : ESP_ERR_NO_MEM;
+    for (int i = 0; i < SIM_MDNS_MAX_SERVICES && err == ESP_ERR_NO_MEM; i++)
+    {
+        sim_service_t *service = &s_services[i];
+        if (service->used)
+        {
+            continue;
+        }
+        memset(service, 0, sizeof(*service));
+        service->used = true;
+        strlcpy(service->instance, instance_name ? instance_name : "", sizeof(service->instance));
+        strlcpy(service->type, service_type, sizeof(service->type));
+        strlcpy(service->proto, proto, sizeof(service->proto));
+        service->port = port;
+        for (size_t t = 0; t < num_items; t++)
+        {
+            set_txt(service, txt[t].key, txt[t].value);
+        }
+        err = ESP_OK;
+    }
+    pthread_mutex_unlock(&s_lock);
+    if (err == ESP_OK)
+    {
+        ESP_LOGI(TAG, "%s.%s on port %u", service_type, proto, port);
+    }
+    return err;
+}
+
+esp_err_t mdns_service_remove(const char *service_type, const char *proto)
+{
+    pthread_mutex_lock(&s_lock);
+    sim_service_t *service = find_service(service_type, proto);
+    if (service)
+    {
+        service->used = false;
+    }
+    pthread_mutex_unlock(&s_lock);
+    return service ? ESP_OK : ESP_ERR_NOT_FOUND;
+}
+
+esp_err_t mdns_service_instance_name_set(const char *service_type, const char *proto, const char *instance_name)
+{
+    if (!instance_name || !instance_name[0])
+    {
+        return ESP_ERR_INVALID_ARG;
+    }
+    pthread_mutex_lock(&s_lock);
+    sim_service_t *service = find_service(service_type, proto);
+    if (service)
+    {
+        strlcpy(service->instance, instance_name, sizeof(service->instance));
+    }
+    pthread_mutex_unlock(&s_lock);
+    return service ? ESP_OK : ESP_ERR_NOT_FOUND;
+}
+
+esp_err_t mdns_service_txt_item_set(const char *service_type, const char *proto, const char *key, const char *value)
+{
+    if (!key || !key[0] || !value)
+    {
+        return ESP_ERR_INVALID_ARG;
+    }
+    pthread_mutex_lock(&s_lock);
+    sim_service_t *service = find_service(service_type, proto);
+    esp_err_t err = service ? set_txt(service, key, value) : ESP_ERR_NOT_FOUND;
+    s_txt_updates += err == ESP_OK;
+    pthread_mutex_unlock(&s_lock);
+    return err;
+}
+
+void sim_mdns_get_hostname(char *buf, size_t size)
+{
+    pthread_mutex_lock(&s_lock);
+    strlcpy(buf, s_hostname, size);
+    pthread_mutex_unlock(&s_lock);
+}
+
+bool sim_mdns_get_service(const char *service_type, const char *proto, uint16_t *port)
+{
+    pthread_mutex_lock(&s_lock);
+    sim_service_t *service = find_service(service_type, proto);
+    if (service && port)
+    {
+        *port = service->port;
+    }
+    pthread_mutex_unlock(&s_lock);
+    return service != NULL;
+}
+
+bool sim_mdns_get_txt(const char *service_type, const char *proto, const char *key, char *buf, size_t size)
+{
+    bool found = false;
+    pthread_mutex_lock(&s_lock);
+    sim_service_t *service = find_service(service_type, proto);
+    for (size_t i = 0; service && i < service->num_txt && !found; i++)
+    {
+        found = !strcmp(service->txt[i].key, key);
+        if (found)
+        {
+            strlcpy(buf, service->txt[i].value, size);
+        }
+    }
+    pthread_mutex_unlock(&s_lock);
+    return found;
+}
+
+uint32_t sim_mdns_get_txt_updates(void)
+{
+    pthread_mutex_lock(&s_lock);
+    uint32_t updates = s_txt_updates;
+    pthread_mutex_unlock(&s_lock);
+    return updates;
+}
+
+mdns_search_once_t *mdns_query_async_new(const char *name, const char *service_type, const char *proto, uint16_t type,
+                                         uint32_t timeout, size_t max_results, mdns_query_notify_t notifier)
+{
+    if (type != MDNS_TYPE_PTR || !service_type || !proto || !timeout || !max_results || notifier)
+    {
+        ESP_LOGE(TAG, "only PTR queries without notifier are simulated");
+        return NULL;
+    }
+    struct mdns_search_once_s *search = calloc(1, sizeof(*search));
+    if (!search)
+    {
+        return NULL;
+    }
+    strlcpy(search->type, service_type, sizeof(search->type));
+    strlcpy(search->proto, proto, sizeof(search->proto));
+    size_t found = 0;
+    pthread_mutex_lock(&s_lock);
+    for (int i = 0; i < SIM_MDNS_MAX_PEERS; i++)
+    {
+        sim_service_t *service = &s_peers[i].service;
+        found += service->used && !strcasecmp(service->type, service_type) && !strcasecmp(service->proto, proto);
+    }
+    pthread_mutex_unlock(&s_lock);
+    search->end_us = esp_timer_get_time() + (found >= max_results ? 0 : timeout * 1000LL);
+    return search;
+}
+
+static char *dup_or_null(const char *s)
+{
+    return s && s[0] ? strdup(s) : NULL;
+}
+
+/* called with s_lock held */
+static mdns_result_t *peer_result(const sim_peer_t *peer)
+{
+    const sim_service_t *service = &peer->service;
+    mdns_result_t *result = calloc(1, sizeof(*result));
+    result->ttl = SIM_MDNS_PEER_TTL;
+    result->ip_protocol = MDNS_IP_PROTOCOL_V4;
+    result->instance_name = dup_or_null(service->instance);
+    result->service_type = dup_or_null(service->type);
+    result->proto = dup_or_null(service->proto);
+    result->hostname = dup_or_null(peer->hostname);
+    result->port = service->port;
+    if (service->num_txt)
+    {
+        result->txt = calloc(service->num_txt, sizeof(mdns_txt_item_t));
+        result->txt_value_len = calloc(service->num_txt, sizeof(uint8_t));
+        result->txt_count = service->num_txt;
+        for (size_t i = 0; i < service->num_txt; i++)
+        {
+            result->txt[i].key = strdup(service->txt[i].key);
+            result->txt[i].value = strdup(service->txt[i].value);
+            result->txt_value_len[i] = strlen(service->txt[i].value);
+        }
+    }
+    if (peer->ip)
+    {
+        result->addr = calloc(1, sizeof(mdns_ip_addr_t));
+        result->addr->addr.type = ESP_IPADDR_TYPE_V4;
+        result->addr->addr.u_addr.ip4.addr = peer->ip;
+    }
+    return result;
+}
+
+bool mdns_query_async_get_results(mdns_search_once_t *search, uint32_t timeout, mdns_result_t **results, uint8_t *num_results)
+{
+    int64_t left = search->end_us - esp_timer_get_time();
+    if (left > timeout * 1000LL)
+    {
+        usleep(timeout * 1000);
+        return false;
+    }
+    if (left > 0)
+    {
+        usleep(left);
+    }
+    mdns_result_t *head = NULL;
+    uint8_t count = 0;
+    pthread_mutex_lock(&s_lock);
+    for (int i = SIM_MDNS_MAX_PEERS - 1; i >= 0; i--)
+    {
+        sim_service_t *service = &s_peers[i].service;
+        if (service->used && !strcasecmp(service->type, search->type) && !strcasecmp(service->proto, search->proto))
+        {
+            mdns_result_t *result = peer_result(&s_peers[i]);
+            result->next = head;
+            head = result;
+            count++;
+        }
+    }
+    pthread_mutex_unlock(&s_lock);
+    *results = head;
+    if (num_results)
+    {
+        *num_results = count;
+    }
+    return true;
+}
+
+esp_err_t mdns_query_async_delete(mdns_search_once_t *search)
+{
+    if (!search)
+    {
+        return ESP_ERR_INVALID_ARG;
+    }
+    free(search);
+    return ESP_OK;
+}
+
+void mdns_query_results_free(mdns_result_t *results)
+{
+    while (results)
+    {
+        mdns_result_t *next = results->next;
+        free(results->instance_name);
+        free(results->service_type);
+        free(results->proto);
+        free(results->hostname);
+        for (size_t i = 0; i < results->txt_count; i++)
+        {
+            free((char *)results->txt[i].key);
+            free((char *)results->txt[i].value);
+        }
+        free(results->txt);
+        free(results->txt_value_len);
+        free(results->addr);
+        free(results);
+        results = next;
+    }
+}
+
+esp_err_t mdns_query_a(const char *host_name, uint32_t timeout, esp_ip4_addr_t *addr)
+{
+    if (!host_name || !timeout || !addr)
+    {
+        return ESP_ERR_INVALID_ARG;
+    }
+    uint32_t ip = 0;
+    pthread_mutex_lock(&s_lock);
+    for (int i = 0; i < SIM_MDNS_MAX_PEERS && !ip; i++)
+    {
+        ip = s_peers[i].service.used && !strcasecmp(s_peers[i].hostname, host_name) ? s_peers[i].ip : 0;
+    }
+    pthread_mutex_unlock(&s_lock);
+    if (!ip)
+    {
+        // nobody answers, the query waits its whole timeout
+        usleep(timeout * 1000);
+        return ESP_ERR_NOT_FOUND;
+    }
+    addr->addr = ip;
+    return ESP_OK;
+}
+
+esp_err_t sim_mdns_add_peer(const char *instance, const char *service_type, const char *proto, const char *hostname,
+                            uint32_t ip, uint16_t port, const mdns_txt_item_t *txt, size_t num_txt)
+{
+    if (!instance || !service_type || !proto || !hostname || num_txt > SIM_MDNS_MAX_TXT)
+    {
+        return ESP_ERR_INVALID_ARG;
+    }
+    esp_err_t err = ESP_ERR_NO_MEM;
+    pthread_mutex_lock(&s_lock);
+    for (int i = 0; i < SIM_MDNS_MAX_PEERS && err != ESP_OK; i++)
+    {
+        sim_peer_t *peer = &s_peers[i];
+        if (peer->service.used)
+        {
+            continue;
+        }
+        memset(peer, 0, sizeof(*peer));
+        peer->service.used = true;
+        strlcpy(peer->service.instance, instance, sizeof(peer->service.instance));
+        strlcpy(peer->service.type, service_type, sizeof(peer->service.type));
+        strlcpy(peer->service.proto, proto, sizeof(peer->service.proto));
+        peer->service.port = port;
+        for (size_t t = 0; t < num_txt; t++)
+        {
+            set_txt(&peer->service, txt[t].key, txt[t].value);
+        }
+        strlcpy(peer->hostname, hostname, sizeof(peer->hostname));
+        peer->ip = ip;
+        err = ESP_OK;
+    }
+    pthread_mutex_unlock(&s_lock);
+    return err;
+}
+
+esp_err_t sim_mdns_remove_peer(const char *instance)
+{
+    esp_err_t err = ESP_ERR_NOT_FOUND;
+    pthread_mutex_lock(&s_lock);
+    for (int i = 0; i < SIM_MDNS_MAX_PEERS && err != ESP_OK; i++)
+    {
+        if (s_peers[i].service.used && !strcasecmp(s_peers[i].service.instance, instance))
+        {
+            s_peers[i].service.used = false;
+            err = ESP_OK;
+        }
+    }
+    pthread_mutex_unlock(&s_lock);
+    return err;
+}
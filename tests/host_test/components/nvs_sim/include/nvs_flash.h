@@ -0,0 +1,22 @@
+#pragma once
+
+#include "esp_err.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @brief Load the simulated partition from FCTL_NVS_PATH (default fctl_nvs.txt)
+ */
+esp_err_t nvs_flash_init(void);
+esp_err_t nvs_flash_deinit(void);
+
+/**
+ * @brief Drop every entry and remove the backing file
+ */
+esp_err_t nvs_flash_erase(void);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,417 @@
+/*
+ * NVS on the Linux host: entries live in memory and nvs_commit rewrites a text file,
+ * one "namespace key type hex-bytes" line per entry, so a restarted process finds them.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+#include <pthread.h>
+#include "nvs.h"
+#include "nvs_flash.h"
+
+#define NVS_MAX_HANDLES 16
+#define NVS_NS_MAX_SIZE 16
+#define NVS_LINE_MAX 8192
+
+typedef enum
+{
+    NVS_TYPE_U8 = 0x01,
+    NVS_TYPE_I8 = 0x11,
+    NVS_TYPE_U32 = 0x04,
+    NVS_TYPE_I32 = 0x14,
+    NVS_TYPE_STR = 0x21,
+    NVS_TYPE_BLOB = 0x42,
+} nvs_type_t;
+
+typedef struct nvs_entry
+{
+    char ns[NVS_NS_MAX_SIZE];
+    char key[NVS_KEY_NAME_MAX_SIZE];
+    nvs_type_t type;
+    size_t size;
+    uint8_t *data;
+    struct nvs_entry *next;
+} nvs_entry_t;
+
+typedef struct
+{
+    bool used;
+    char ns[NVS_NS_MAX_SIZE];
+    nvs_open_mode_t mode;
+} nvs_open_handle_t;
+
+static pthread_mutex_t s_lock = PTHREAD_MUTEX_INITIALIZER;
+static bool s_initialized;
+static nvs_entry_t *s_entries;
+static nvs_open_handle_t s_handles[NVS_MAX_HANDLES];
+
+static const char *nvs_path(void)
+{
+    const char *path = getenv("FCTL_NVS_PATH");
+    return path ? path : "fctl_nvs.txt";
+}
+
+static void entries_free(void)
+{
+    for (nvs_entry_t *e = s_entries, *next; e; e = next)
+    {
+        next = e->next;
+        free(e->data);
+        free(e);
+    }
+    s_entries = NULL;
+}
+
+static nvs_entry_t *entry_find(const char *ns, const char *key)
+{
+    for (nvs_entry_t *e = s_entries; e; e = e->next)
+    {
+        if (strcmp(e->ns, ns) == 0 && strcmp(e->key, key) == 0)
+        {
+            return e;
+        }
+    }
+    return NULL;
+}
+
+static esp_err_t entry_store(const char *ns, const char *key, nvs_type_t type, const void *data, size_t size)
+{
+    nvs_entry_t *e = entry_find(ns, key);
+    if (!e)
+    {
+        e = calloc(1, sizeof(*e));
+        if (!e)
+        {
+            return ESP_ERR_NO_MEM;
+        }
+        strncpy(e->ns, ns, NVS_NS_MAX_SIZE - 1);
+        strncpy(e->key, key, NVS_KEY_NAME_MAX_SIZE - 1);
+        e->next = s_entries;
+        s_entries = e;
+    }
+    uint8_t *copy = malloc(size ? size : 1);
+    if (!copy)
+    {
+        return ESP_ERR_NO_MEM;
+    }
+    memcpy(copy, data, size);
+    free(e->data);
+    e->data = copy;
+    e->size = size;
+    e->type = type;
+    return ESP_OK;
+}
+
+static void load_file(void)
+{
+    FILE *f = fopen(nvs_path(), "r");
+    if (!f)
+    {
+        return;
+    }
+    char *line = malloc(NVS_LINE_MAX);
+    uint8_t *data = malloc(NVS_LINE_MAX / 2);
+    char ns[NVS_NS_MAX_SIZE], key[NVS_KEY_NAME_MAX_SIZE];
+    unsigned type;
+    int hex_at;
+    while (line && data && fgets(line, NVS_LINE_MAX, f))
+    {
+        if (sscanf(line, "%15s %15s %x %n", ns, key, &type, &hex_at) != 3)
+        {
+            continue;
+        }
+        size_t size = 0;
+        unsigned byte;
+        for (const char *p = line + hex_at; sscanf(p, "%2x", &byte) == 1; p += 2)
+        {
+            data[size++] = (uint8_t)byte;
+        }
+        entry_store(ns, key, (nvs_type_t)type, data, size);
+    }
+    free(line);
+    free(data);
+    fclose(f);
+}
+
+static esp_err_t save_file(void)
+{
+    FILE *f = fopen(nvs_path(), "w");
+    if (!f)
+    {
+        return ESP_FAIL;
+    }
+    for (nvs_entry_t *e = s_entries; e; e = e->next)
+    {
+        fprintf(f, "%s %s %02x ", e->ns, e->key, e->type);
+        for (size_t i = 0; i < e->size; i++)
+        {
+            fprintf(f, "%02x", e->data[i]);
+        }
+        fputc('\n', f);
+    }
+    return fclose(f) == 0 ? ESP_OK : ESP_FAIL;
+}
+
+esp_err_t nvs_flash_init(void)
+{
+    pthread_mutex_lock(&s_lock);
+    if (!s_initialized)
+    {
+        load_file();
+        s_initialized = true;
+    }
+    pthread_mutex_unlock(&s_lock);
+    return ESP_OK;
+}
+
+esp_err_t nvs_flash_deinit(void)
+{
+    pthread_mutex_lock(&s_lock);
+    entries_free();
+    memset(s_handles, 0, sizeof(s_handles));
+    s_initialized = false;
+    pthread_mutex_unlock(&s_lock);
+    return ESP_OK;
+}
+
+esp_err_t nvs_flash_erase(void)
+{
+    pthread_mutex_lock(&s_lock);
+    entries_free();
+    remove(nvs_path());
+    pthread_mutex_unlock(&s_lock);
+    return ESP_OK;
+}
+
+esp_err_t nvs_open(const char *namespace_name, nvs_open_mode_t open_mode, nvs_handle_t *out_handle)
+{
+    if (!namespace_name || !out_handle || strlen(namespace_name) >= NVS_NS_MAX_SIZE)
+    {
+        return ESP_ERR_INVALID_ARG;
+    }
+    esp_err_t err = ESP_ERR_NVS_NOT_INITIALIZED;
+    pthread_mutex_lock(&s_lock);
+    if (s_initialized)
+    {
+        err = ESP_ERR_NO_MEM;
+        for (int i = 0; i < NVS_MAX_HANDLES; i++)
+        {
+            if (!s_handles[i].used)
+            {
+                s_handles[i].used = true;
+                s_handles[i].mode = open_mode;
+                strcpy(s_handles[i].ns, namespace_name);
+                *out_handle = i + 1;
+                err = ESP_OK;
+                break;
+            }
+        }
+    }
+    pthread_mutex_unlock(&s_lock);
+    return err;
+}
+
+void nvs_close(nvs_handle_t handle)
+{
+    pthread_mutex_lock(&s_lock);
+    if (handle >= 1 && handle <= NVS_MAX_HANDLES)
+    {
+        s_handles[handle - 1].used = false;
+    }
+    pthread_mutex_unlock(&s_lock);
+}
+
+/* called with s_lock held */
+static nvs_open_handle_t *handle_get(nvs_handle_t handle)
+{
+    if (handle < 1 || handle > NVS_MAX_HANDLES || !s_handles[handle - 1].used)
+    {
+        return NULL;
+    }
+    return &s_handles[handle - 1];
+}
+
+esp_err_t nvs_commit(nvs_handle_t handle)
+{
+    pthread_mutex_lock(&s_lock);
+    esp_err_t err = handle_get(handle) ? save_file() : ESP_ERR_NVS_INVALID_HANDLE;
+    pthread_mutex_unlock(&s_lock);
+    return err;
+}
+
+static esp_err_t nvs_set(nvs_handle_t handle, const char *key, nvs_type_t type, const void *data, size_t size)
+{
+    if (!key || strlen(key) >= NVS_KEY_NAME_MAX_SIZE)
+    {
+        return ESP_ERR_INVALID_ARG;
+    }
+    pthread_mutex_lock(&s_lock);
+    nvs_open_handle_t *h = handle_get(handle);
+    esp_err_t err;
+    if (!h)
+    {
+        err = ESP_ERR_NVS_INVALID_HANDLE;
+    }
+    else if (h->mode == NVS_READONLY)
+    {
+        err = ESP_ERR_NVS_READ_ONLY;
+    }
+    else
+    {
+        err = entry_store(h->ns, key, type, data, size);
+    }
+    pthread_mutex_unlock(&s_lock);
+    return err;
+}
+
+/*
+ * Copy an entry of `type` into `out`. With `length` set the entry is variable sized:
+ * a NULL `out` only reports the size, a short buffer fails like on target.
+ */
+static esp_err_t nvs_get(nvs_handle_t handle, const char *key, nvs_type_t type, void *out, size_t *length, size_t fixed_size)
+{
+    if (!key)
+    {
+        return ESP_ERR_INVALID_ARG;
+    }
+    pthread_mutex_lock(&s_lock);
+    nvs_open_handle_t *h = handle_get(handle);
+    nvs_entry_t *e = h ? entry_find(h->ns, key) : NULL;
+    esp_err_t err = ESP_OK;
+    if (!h)
+    {
+        err = ESP_ERR_NVS_INVALID_HANDLE;
+    }
+    else if (!e)
+    {
+        err = ESP_ERR_NVS_NOT_FOUND;
+    }
+    else if (e->type != type)
+    {
+        err = ESP_ERR_NVS_TYPE_MISMATCH;
+    }
+    else if (!length)
+    {
+        memcpy(out, e->data, fixed_size);
+    }
+    else if (!out)
+    {
+        *length = e->size;
+    }
+    else if (*length < e->size)
+    {
+        *length = e->size;
+        err = ESP_ERR_NVS_INVALID_LENGTH;
+    }
+    else
+    {
+        memcpy(out, e->data, e->size);
+        *length = e->size;
+    }
+    pthread_mutex_unlock(&s_lock);
+    return err;
+}
+
+esp_err_t nvs_set_i8(nvs_handle_t handle, const char *key, int8_t value)
+{
+    return nvs_set(handle, key, NVS_TYPE_I8, &value, sizeof(value));
+}
+
+esp_err_t nvs_set_u8(nvs_handle_t handle, const char *key, uint8_t value)
+{
+    return nvs_set(handle, key, NVS_TYPE_U8, &value, sizeof(value));
+}
+
+esp_err_t nvs_set_i32(nvs_handle_t handle, const char *key, int32_t value)
+{
+    return nvs_set(handle, key, NVS_TYPE_I32, &value, sizeof(value));
+}
+
+esp_err_t nvs_set_u32(nvs_handle_t handle, const char *key, uint32_t value)
+{
+    return nvs_set(handle, key, NVS_TYPE_U32, &value, sizeof(value));
+}
+
+esp_err_t nvs_set_str(nvs_handle_t handle, const char *key, const char *value)
+{
+    return nvs_set(handle, key, NVS_TYPE_STR, value, strlen(value) + 1);
+}
+
+esp_err_t nvs_set_blob(nvs_handle_t handle, const char *key, const void *value, size_t length)
+{
+    return nvs_set(handle, key, NVS_TYPE_BLOB, value, length);
+}
+
+esp_err_t nvs_get_i8(nvs_handle_t handle, const char *key, int8_t *out_value)
+{
+    return nvs_get(handle, key, NVS_TYPE_I8, out_value, NULL, sizeof(*out_value));
+}
+
+esp_err_t nvs_get_u8(nvs_handle_t handle, const char *key, uint8_t *out_value)
+{
+    return nvs_get(handle, key, NVS_TYPE_U8, out_value, NULL, sizeof(*out_value));
+}
+
+esp_err_t nvs_get_i32(nvs_handle_t handle, const char *key, int32_t *out_value)
+{
+    return nvs_get(handle, key, NVS_TYPE_I32, out_value, NULL, sizeof(*out_value));
+}
+
+esp_err_t nvs_get_u32(nvs_handle_t handle, const char *key, uint32_t *out_value)
+{
+    return nvs_get(handle, key, NVS_TYPE_U32, out_value, NULL, sizeof(*out_value));
+}
+
+esp_err_t nvs_get_str(nvs_handle_t handle, const char *key, char *out_value, size_t *length)
+{
+    return length ? nvs_get(handle, key, NVS_TYPE_STR, out_value, length, 0) : ESP_ERR_INVALID_ARG;
+}
+
+esp_err_t nvs_get_blob(nvs_handle_t handle, const char *key, void *out_value, size_t *length)
+{
+    return length ? nvs_get(handle, key, NVS_TYPE_BLOB, out_value, length, 0) : ESP_ERR_INVALID_ARG;
+}
+
+esp_err_t nvs_erase_key(nvs_handle_t handle, const char *key)
+{
+    pthread_mutex_lock(&s_lock);
+    nvs_open_handle_t *h = handle_get(handle);
+    esp_err_t err = h ? ESP_ERR_NVS_NOT_FOUND : ESP_ERR_NVS_INVALID_HANDLE;
+    for (nvs_entry_t **it = &s_entries; h && *it; it = &(*it)->next)
+    {
+        nvs_entry_t *e = *it;
+        if (strcmp(e->ns, h->ns) == 0 && strcmp(e->key, key) == 0)
+        {
+            *it = e->next;
+            free(e->data);
+            free(e);
+            err = ESP_OK;
+            break;
+        }
+    }
+    pthread_mutex_unlock(&s_lock);
+    return err;
+}
+
+esp_err_t nvs_erase_all(nvs_handle_t handle)
+{
+    pthread_mutex_lock(&s_lock);
+    nvs_open_handle_t *h = handle_get(handle);
+    for (nvs_entry_t **it = &s_entries; h && *it;)
+    {
+        nvs_entry_t *e = *it;
+        if (strcmp(e->ns, h->ns) == 0)
+        {
+            *it = e->next;
+            free(e->data);
+            free(e);
+        }
+        else
+        {
+            it = &e->next;
+        }
+    }
+    pthread_mutex_unlock(&s_lock);
+    return h ? ESP_OK : ESP_ERR_NVS_INVALID_HANDLE;
+}
@@ -0,0 +1,15 @@
+/*
+ * strlcpy/strlcat come with newlib on target, but only with glibc 2.38 and later on the host.
+ * Force-included into every host translation unit.
+ */
+#pragma once
+
+#include <string.h>
+
+#if defined(__GLIBC__) && !__GLIBC_PREREQ(2, 38)
+#define BSD_STRING_COMPAT 1
+size_t strlcpy(char *dst, const char *src, size_t size);
+size_t strlcat(char *dst, const char *src, size_t size);
+#else
+#define BSD_STRING_COMPAT 0
+#endif
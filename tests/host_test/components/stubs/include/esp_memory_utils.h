@@ -0,0 +1,20 @@
+#pragma once
+
+#include <stdbool.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// the loaded image stands in for flash mapped data, string literals live there
+extern char __executable_start[];
+extern char edata[];
+
+static inline bool esp_ptr_in_drom(const void *p)
+{
+    return (const char *)p >= __executable_start && (const char *)p < edata;
+}
+
+#ifdef __cplusplus
+}
+#endif
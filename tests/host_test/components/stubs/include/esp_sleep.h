@@ -0,0 +1,3 @@
+#pragma once
+
+/* included by the firmware but unused on the host */
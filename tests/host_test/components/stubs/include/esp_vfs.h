@@ -0,0 +1,8 @@
+#pragma once
+
+#include <unistd.h>
+#include <sys/stat.h>
+#include "esp_err.h"
+
+/* 15 on target; the host mount point is an absolute directory path */
+#define ESP_VFS_PATH_MAX 255
@@ -0,0 +1,3 @@
+#pragma once
+
+// no on-chip peripherals beyond the simulated drivers, SOC_TEMP_SENSOR_SUPPORTED stays undefined
@@ -0,0 +1,127 @@
+/*
+ * Host replacements for the pieces of IDF the firmware only touches at start up
+ */
+#include <string.h>
+#include <dirent.h>
+#include <sys/stat.h>
+#include "esp_log.h"
+#include "esp_spiffs.h"
+#include "esp_chip_info.h"
+#include "esp_system.h"
+#include "esp_rom_crc.h"
+#include "esp_app_desc.h"
+#include "bsd_string.h"
+
+#define SIM_SPIFFS_SIZE (1024 * 1024)
+
+static const char *TAG = "stubs";
+static char s_spiffs_path[256];
+
+esp_err_t esp_vfs_spiffs_register(const esp_vfs_spiffs_conf_t *conf)
+{
+    struct stat st;
+    if (!conf || !conf->base_path)
+    {
+        return ESP_ERR_INVALID_ARG;
+    }
+    if (stat(conf->base_path, &st) != 0 || !S_ISDIR(st.st_mode))
+    {
+        ESP_LOGE(TAG, "%s is not a directory", conf->base_path);
+        return ESP_ERR_NOT_FOUND;
+    }
+    strlcpy(s_spiffs_path, conf->base_path, sizeof(s_spiffs_path));
+    return ESP_OK;
+}
+
+esp_err_t esp_vfs_spiffs_unregister(const char *partition_label)
+{
+    s_spiffs_path[0] = '\0';
+    return ESP_OK;
+}
+
+esp_err_t esp_spiffs_info(const char *partition_label, size_t *total_bytes, size_t *used_bytes)
+{
+    if (!s_spiffs_path[0])
+    {
+        return ESP_ERR_INVALID_STATE;
+    }
+    size_t used = 0;
+    DIR *dir = opendir(s_spiffs_path);
+    for (struct dirent *entry; dir && (entry = readdir(dir));)
+    {
+        char path[512];
+        struct stat st;
+        snprintf(path, sizeof(path), "%s/%s", s_spiffs_path, entry->d_name);
+        if (stat(path, &st) == 0 && S_ISREG(st.st_mode))
+        {
+            used += st.st_size;
+        }
+    }
+    if (dir)
+    {
+        closedir(dir);
+    }
+    *total_bytes = SIM_SPIFFS_SIZE;
+    *used_bytes = used;
+    return ESP_OK;
+}
+
+void esp_chip_info(esp_chip_info_t *out_info)
+{
+    memset(out_info, 0, sizeof(*out_info));
+    out_info->model = CHIP_POSIX_LINUX;
+    out_info->cores = 2;
+}
+
+#if BSD_STRING_COMPAT
+size_t strlcpy(char *dst, const char *src, size_t size)
+{
+    size_t len = strlen(src);
+    if (size)
+    {
+        size_t n = len < size - 1 ? len : size - 1;
+        memcpy(dst, src, n);
+        dst[n] = '\0';
+    }
+    return len;
+}
+
+size_t strlcat(char *dst, const char *src, size_t size)
+{
+    size_t dst_len = strnlen(dst, size);
+    if (dst_len == size)
+    {
+        return size + strlen(src);
+    }
+    return dst_len + strlcpy(dst + dst_len, src, size - dst_len);
+}
+#endif
+
+const esp_app_desc_t *esp_app_get_description(void)
+{
+    static const esp_app_desc_t desc = {
+        .version = "host",
+        .project_name = "fctl",
+        .idf_ver = "linux",
+    };
+    return &desc;
+}
+
+esp_reset_reason_t esp_reset_reason(void)
+{
+    return ESP_RST_POWERON;
+}
+
+uint32_t esp_rom_crc32_le(uint32_t crc, uint8_t const *buf, uint32_t len)
+{
+    crc = ~crc;
+    while (len--)
+    {
+        crc ^= *buf++;
+        for (int i = 0; i < 8; i++)
+        {
+            crc = (crc >> 1) ^ (0xEDB88320 & -(crc & 1));
+        }
+    }
+    return ~crc;
+}
@@ -0,0 +1,155 @@
+/*
+ * REST throughput and latency of the firmware running on simulated peripherals
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <time.h>
+#include "esp_timer.h"
+#include "esp_log.h"
+#include "sim_driver.h"
+#include "esp_http_server.h"
+#include "http_client.h"
+
+#define REQUESTS_PER_CLIENT 2000
+#define CONTROL_SAMPLES 200
+#define MAX_CLIENTS 8
+
+void app_main(void);
+
+typedef struct
+{
+    const char *path;
+    uint32_t *latency_us;
+    int errors;
+} bench_client_t;
+
+static uint64_t now_us(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+static int cmp_u32(const void *a, const void *b)
+{
+    uint32_t x = *(const uint32_t *)a, y = *(const uint32_t *)b;
+    return x < y ? -1 : x > y;
+}
+
+static void print_percentiles(const char *label, uint32_t *samples, size_t n, double seconds)
+{
+    qsort(samples, n, sizeof(samples[0]), cmp_u32);
+    printf("%-28s", label);
+    if (seconds > 0)
+    {
+        printf(" %8.0f req/s", n / seconds);
+    }
+    printf("  p50 %6u us  p90 %6u us  p99 %6u us\n",
+           (unsigned)samples[n / 2], (unsigned)samples[n * 90 / 100], (unsigned)samples[n * 99 / 100]);
+}
+
+static void *client_thread(void *arg)
+{
+    bench_client_t *bc = arg;
+    http_client_t client;
+    char resp[1024];
+    if (http_client_open(&client, sim_httpd_get_port()) != 0)
+    {
+        bc->errors = REQUESTS_PER_CLIENT;
+        return NULL;
+    }
+    for (int i = 0; i < REQUESTS_PER_CLIENT; i++)
+    {
+        uint64_t start = now_us();
+        if (http_client_request(&client, "GET", bc->path, NULL, resp, sizeof(resp)) != 200)
+        {
+            bc->errors++;
+        }
+        bc->latency_us[i] = (uint32_t)(now_us() - start);
+    }
+    http_client_close(&client);
+    return NULL;
+}
+
+static void bench_get(const char *path, int clients)
+{
+    bench_client_t bc[MAX_CLIENTS] = {0};
+    pthread_t threads[MAX_CLIENTS];
+    uint32_t *latency = calloc((size_t)clients * REQUESTS_PER_CLIENT, sizeof(uint32_t));
+
+    uint64_t start = now_us();
+    for (int i = 0; i < clients; i++)
+    {
+        bc[i].path = path;
+        bc[i].latency_us = latency + i * REQUESTS_PER_CLIENT;
+        pthread_create(&threads[i], NULL, client_thread, &bc[i]);
+    }
+    int errors = 0;
+    for (int i = 0; i < clients; i++)
+    {
+        pthread_join(threads[i], NULL);
+        errors += bc[i].errors;
+    }
+    double seconds = (now_us() - start) / 1e6;
+
+    char label[64];
+    snprintf(label, sizeof(label), "GET %s x%d", path, clients);
+    print_percentiles(label, latency, (size_t)clients * REQUESTS_PER_CLIENT, seconds);
+    if (errors)
+    {
+        printf("  %d failed requests\n", errors);
+    }
+    free(latency);
+}
+
+/* time from sending PUT /api/fan/speed to the LEDC duty being updated, and to the response */
+static void bench_control(void)
+{
+    http_client_t client;
+    char resp[256], body[32];
+    uint32_t to_duty[CONTROL_SAMPLES], to_resp[CONTROL_SAMPLES];
+    if (http_client_open(&client, sim_httpd_get_port()) != 0)
+    {
+        printf("connect failed\n");
+        return;
+    }
+    for (int i = 0; i < CONTROL_SAMPLES; i++)
+    {
+        snprintf(body, sizeof(body), "{\"speed\": %d}", 20 + i % 60);
+        int64_t start = esp_timer_get_time();
+        http_client_request(&client, "PUT", "/api/fan/speed", body, resp, sizeof(resp));
+        to_resp[i] = (uint32_t)(esp_timer_get_time() - start);
+        int64_t updated_us = 0;
+        sim_ledc_get(LEDC_HIGH_SPEED_MODE, LEDC_CHANNEL_0, NULL, &updated_us);
+        to_duty[i] = updated_us > start ? (uint32_t)(updated_us - start) : 0;
+    }
+    http_client_close(&client);
+    print_percentiles("PUT speed -> LEDC duty", to_duty, CONTROL_SAMPLES, 0);
+    print_percentiles("PUT speed -> response", to_resp, CONTROL_SAMPLES, 0);
+}
+
+int main(void)
+{
+    char nvs_path[] = "/tmp/fctl_nvs_XXXXXX";
+    close(mkstemp(nvs_path));
+    remove(nvs_path);
+    setenv("FCTL_NVS_PATH", nvs_path, 1);
+    setenv("FCTL_HTTP_PORT", "0", 1);
+
+    app_main();
+    esp_log_level_set("*", ESP_LOG_WARN);
+
+    static const int concurrency[] = {1, 2, 4, 8};
+    for (size_t i = 0; i < sizeof(concurrency) / sizeof(concurrency[0]); i++)
+    {
+        bench_get("/api/state", concurrency[i]);
+    }
+    bench_get("/api/rpm/get", 1);
+    bench_control();
+
+    remove(nvs_path);
+    return 0;
+}
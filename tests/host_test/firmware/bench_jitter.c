@@ -0,0 +1,107 @@
+/*
+ * Control loop timing under REST load, with the task plan and with every task unpinned
+ * at the default priority. Each run boots the firmware in its own process.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdatomic.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/wait.h>
+#include "esp_log.h"
+#include "esp_http_server.h"
+#include "http_client.h"
+#include "task_plan.h"
+#include "control.h"
+
+#define LOAD_CLIENTS 4
+#define LOAD_SECONDS 5
+
+void app_main(void);
+
+static atomic_bool s_stop = false;
+static atomic_uint s_requests = 0;
+
+static void *load_thread(void *arg)
+{
+    http_client_t client;
+    char resp[1024], body[32];
+    if (http_client_open(&client, sim_httpd_get_port()) != 0)
+    {
+        return NULL;
+    }
+    for (int i = 0; !atomic_load(&s_stop); i++)
+    {
+        if (i % 4 == 0)
+        {
+            snprintf(body, sizeof(body), "{\"speed\": %d}", 20 + i % 60);
+            http_client_request(&client, "PUT", "/api/fan/speed", body, resp, sizeof(resp));
+        }
+        else
+        {
+            http_client_request(&client, "GET", "/api/state", NULL, resp, sizeof(resp));
+        }
+        atomic_fetch_add(&s_requests, 1);
+    }
+    http_client_close(&client);
+    return NULL;
+}
+
+static int run(bool plan)
+{
+    char nvs_path[] = "/tmp/fctl_nvs_XXXXXX";
+    close(mkstemp(nvs_path));
+    remove(nvs_path);
+    setenv("FCTL_NVS_PATH", nvs_path, 1);
+    setenv("FCTL_HTTP_PORT", "0", 1);
+
+    task_plan_set_enabled(plan);
+    app_main();
+    esp_log_level_set("*", ESP_LOG_WARN);
+
+    pthread_t threads[LOAD_CLIENTS];
+    control_reset_stats();
+    for (int i = 0; i < LOAD_CLIENTS; i++)
+    {
+        pthread_create(&threads[i], NULL, load_thread, NULL);
+    }
+    sleep(LOAD_SECONDS);
+    atomic_store(&s_stop, true);
+    for (int i = 0; i < LOAD_CLIENTS; i++)
+    {
+        pthread_join(threads[i], NULL);
+    }
+
+    control_stats_t stats;
+    control_get_stats(&stats);
+    printf("%-6s core %2d prio %2u  %5u periods  late avg %6u us  p99 %6u us  max %6u us  %8.0f req/s\n",
+           plan ? "plan" : "flat", stats.core, (unsigned)stats.priority, (unsigned)stats.cycles, (unsigned)stats.late_avg_us,
+           (unsigned)stats.late_p99_us, (unsigned)stats.late_max_us, atomic_load(&s_requests) / (double)LOAD_SECONDS);
+    remove(nvs_path);
+    return 0;
+}
+
+int main(int argc, char **argv)
+{
+    if (argc > 1)
+    {
+        return run(strcmp(argv[1], "plan") == 0);
+    }
+
+    // the firmware boots once per process, run each configuration in a child
+    static const char *modes[] = {"plan", "flat"};
+    for (size_t i = 0; i < sizeof(modes) / sizeof(modes[0]); i++)
+    {
+        fflush(stdout);
+        pid_t pid = fork();
+        if (pid == 0)
+        {
+            execl("/proc/self/exe", argv[0], modes[i], (char *)NULL);
+            _exit(127);
+        }
+        int status;
+        waitpid(pid, &status, 0);
+    }
+    return 0;
+}
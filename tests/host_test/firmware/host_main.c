@@ -0,0 +1,19 @@
+/*
+ * Runs the firmware as a Linux process, the REST API is served on 127.0.0.1
+ */
+#include <unistd.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+
+void app_main(void);
+
+int main(void)
+{
+    app_main();
+    // app_main returns once everything is started, like on target the tasks keep running
+    for (;;)
+    {
+        pause();
+    }
+    return 0;
+}
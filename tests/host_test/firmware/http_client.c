@@ -0,0 +1,213 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <errno.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <arpa/inet.h>
+#include "http_client.h"
+
+#define HEADER_MAX 2048
+
+int http_client_open(http_client_t *client, uint16_t port)
+{
+    client->port = port;
+    client->fd = socket(AF_INET, SOCK_STREAM, 0);
+    if (client->fd < 0)
+    {
+        return -1;
+    }
+    int one = 1;
+    setsockopt(client->fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+    struct timeval timeout = {.tv_sec = 10};
+    setsockopt(client->fd, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+    struct sockaddr_in addr = {
+        .sin_family = AF_INET,
+        .sin_port = htons(port),
+        .sin_addr.s_addr = htonl(INADDR_LOOPBACK),
+    };
+    if (connect(client->fd, (struct sockaddr *)&addr, sizeof(addr)) != 0)
+    {
+        close(client->fd);
+        client->fd = -1;
+        return -1;
+    }
+    return 0;
+}
+
+void http_client_close(http_client_t *client)
+{
+    if (client->fd >= 0)
+    {
+        close(client->fd);
+        client->fd = -1;
+    }
+}
+
+static int send_all(int fd, const char *buf, size_t len)
+{
+    while (len > 0)
+    {
+        ssize_t n = send(fd, buf, len, MSG_NOSIGNAL);
+        if (n <= 0)
+        {
+            return -1;
+        }
+        buf += n;
+        len -= n;
+    }
+    return 0;
+}
+
+static int recv_exact(int fd, char *buf, size_t len)
+{
+    while (len > 0)
+    {
+        ssize_t n = recv(fd, buf, len, 0);
+        if (n <= 0)
+        {
+            return -1;
+        }
+        buf += n;
+        len -= n;
+    }
+    return 0;
+}
+
+/* read up to and including "\r\n" or "\r\n\r\n" one byte at a time, responses are small */
+static int recv_until(int fd, char *buf, size_t size, const char *terminator)
+{
+    size_t n = 0;
+    size_t term_len = strlen(terminator);
+    while (n + 1 < size)
+    {
+        if (recv(fd, buf + n, 1, 0) != 1)
+        {
+            return -1;
+        }
+        n++;
+        buf[n] = '\0';
+        if (n >= term_len && memcmp(buf + n - term_len, terminator, term_len) == 0)
+        {
+            return (int)n;
+        }
+    }
+    return -1;
+}
+
+/* append `len` bytes of body, dropping what does not fit */
+static void body_append(int fd, size_t len, char *resp, size_t resp_size, size_t *used, int *err)
+{
+    char chunk[1024];
+    while (len > 0 && !*err)
+    {
+        size_t n = len < sizeof(chunk) ? len : sizeof(chunk);
+        if (recv_exact(fd, chunk, n) != 0)
+        {
+            *err = 1;
+            return;
+        }
+        size_t copy = *used + n < resp_size ? n : resp_size - 1 - *used;
+        memcpy(resp + *used, chunk, copy);
+        *used += copy;
+        len -= n;
+    }
+}
+
+static int request_once(http_client_t *client, const char *method, const char *path, const char *body,
+                        char *resp, size_t resp_size, int *closed)
+{
+    char head[HEADER_MAX];
+    size_t body_len = body ? strlen(body) : 0;
+    int n = snprintf(head, sizeof(head), "%s %s HTTP/1.1\r\nHost: 127.0.0.1\r\nContent-Length: %zu\r\n\r\n", method, path, body_len);
+    if (send_all(client->fd, head, n) != 0 || (body_len && send_all(client->fd, body, body_len) != 0))
+    {
+        return -1;
+    }
+    if (recv_until(client->fd, head, sizeof(head), "\r\n\r\n") < 0)
+    {
+        return -1;
+    }
+    int status = -1;
+    sscanf(head, "HTTP/1.%*d %d", &status);
+
+    size_t content_len = 0;
+    int chunked = 0;
+    for (char *line = strstr(head, "\r\n") + 2; *line; line = strstr(line, "\r\n") + 2)
+    {
+        if (strncasecmp(line, "Content-Length:", 15) == 0)
+        {
+            content_len = strtoul(line + 15, NULL, 10);
+        }
+        else if (strncasecmp(line, "Transfer-Encoding: chunked", 26) == 0)
+        {
+            chunked = 1;
+        }
+        else if (strncasecmp(line, "Connection: close", 17) == 0)
+        {
+            *closed = 1;
+        }
+    }
+
+    size_t used = 0;
+    int err = 0;
+    if (!chunked)
+    {
+        body_append(client->fd, content_len, resp, resp_size, &used, &err);
+    }
+    else
+    {
+        for (;;)
+        {
+            char size_line[32];
+            if (recv_until(client->fd, size_line, sizeof(size_line), "\r\n") < 0)
+            {
+                err = 1;
+                break;
+            }
+            size_t chunk_len = strtoul(size_line, NULL, 16);
+            body_append(client->fd, chunk_len, resp, resp_size, &used, &err);
+            if (err || recv_exact(client->fd, size_line, 2) != 0)
+            {
+                err = 1;
+                break;
+            }
+            if (chunk_len == 0)
+            {
+                break;
+            }
+        }
+    }
+    if (resp_size)
+    {
+        resp[used] = '\0';
+    }
+    client->resp_len = used;
+    return err ? -1 : status;
+}
+
+int http_client_request(http_client_t *client, const char *method, const char *path, const char *body,
+                        char *resp, size_t resp_size)
+{
+    for (int attempt = 0; attempt < 2; attempt++)
+    {
+        if (client->fd < 0 && http_client_open(client, client->port) != 0)
+        {
+            return -1;
+        }
+        int closed = 0;
+        int status = request_once(client, method, path, body, resp, resp_size, &closed);
+        if (closed || status < 0)
+        {
+            http_client_close(client);
+        }
+        if (status >= 0)
+        {
+            return status;
+        }
+    }
+    return -1;
+}
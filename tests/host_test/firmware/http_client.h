@@ -0,0 +1,25 @@
+/*
+ * Blocking HTTP/1.1 client with a persistent connection, for host tests and benchmarks
+ */
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+typedef struct
+{
+    int fd;
+    uint16_t port;
+    size_t resp_len; // body length of the last response, which may contain NUL bytes
+} http_client_t;
+
+int http_client_open(http_client_t *client, uint16_t port);
+void http_client_close(http_client_t *client);
+
+/**
+ * @brief Send one request on the connection, reconnecting if the server closed it
+ *
+ * @return HTTP status, or -1 on a transport error. The body is NUL terminated in `resp`.
+ */
+int http_client_request(http_client_t *client, const char *method, const char *path, const char *body,
+                        char *resp, size_t resp_size);
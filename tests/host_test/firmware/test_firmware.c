@@ -0,0 +1,732 @@
+/*
+ * Boots the firmware on simulated peripherals and drives it through its REST API
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include "cJSON.h"
+#include "sdkconfig.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "nvs.h"
+#include "esp_timer.h"
+#include "sim_driver.h"
+#include "esp_http_server.h"
+#include "mdns.h"
+#include "http_client.h"
+#include "trace.h"
+#include "esp_log.h"
+
+#define SIM_PIXEL_BYTES 3
+#define RPM_TOLERANCE_PERCENT 10
+
+void app_main(void);
+
+static int failures = 0;
+static http_client_t client;
+static char resp[16384];
+static char log_capture[65536];
+static size_t log_capture_len = 0;
+static pthread_mutex_t log_capture_lock = PTHREAD_MUTEX_INITIALIZER;
+
+#define CHECK(cond, fmt, ...)                                                          \
+    do                                                                                 \
+    {                                                                                  \
+        if (!(cond))                                                                   \
+        {                                                                              \
+            printf("%s(%d): " fmt "\n", __FUNCTION__, __LINE__, ##__VA_ARGS__);         \
+            failures++;                                                                \
+        }                                                                              \
+    } while (0)
+
+/* GET `path` and return the number `field` of the JSON object, -1 on failure */
+static int get_number(const char *path, const char *field)
+{
+    if (http_client_request(&client, "GET", path, NULL, resp, sizeof(resp)) != 200)
+    {
+        return -1;
+    }
+    cJSON *root = cJSON_Parse(resp);
+    cJSON *item = cJSON_GetObjectItem(root, field);
+    int value = cJSON_IsNumber(item) ? item->valueint : cJSON_IsBool(item) ? cJSON_IsTrue(item) : -1;
+    cJSON_Delete(root);
+    return value;
+}
+
+/* keeps what the firmware writes to the console */
+static int capture_vprintf(const char *format, va_list args)
+{
+    char line[512];
+    int len = vsnprintf(line, sizeof(line), format, args);
+    fputs(line, stdout);
+    pthread_mutex_lock(&log_capture_lock);
+    log_capture_len += snprintf(log_capture + log_capture_len, sizeof(log_capture) - log_capture_len, "%s", line);
+    if (log_capture_len >= sizeof(log_capture))
+    {
+        log_capture_len = 0;
+    }
+    pthread_mutex_unlock(&log_capture_lock);
+    return len;
+}
+
+static int count_in_log(const char *text)
+{
+    int count = 0;
+    pthread_mutex_lock(&log_capture_lock);
+    for (const char *p = log_capture; (p = strstr(p, text)) != NULL; p++)
+    {
+        count++;
+    }
+    pthread_mutex_unlock(&log_capture_lock);
+    return count;
+}
+
+static void test_state_after_boot(void)
+{
+    int status = http_client_request(&client, "GET", "/api/state", NULL, resp, sizeof(resp));
+    CHECK(status == 200, "status %d", status);
+    cJSON *root = cJSON_Parse(resp);
+    CHECK(root, "invalid json: %s", resp);
+    cJSON *name = cJSON_GetObjectItem(root, "name");
+    CHECK(cJSON_IsString(name) && strcmp(name->valuestring, "fctl") == 0, "name %s", resp);
+    CHECK(cJSON_IsFalse(cJSON_GetObjectItem(root, "connected")), "connected without an ssid: %s", resp);
+    CHECK(get_number("/api/mode/get", "mode") == 3, "mode is not APSTA");
+    cJSON_Delete(root);
+}
+
+static void test_boot_profile(void)
+{
+    int status = http_client_request(&client, "GET", "/api/boot", NULL, resp, sizeof(resp));
+    CHECK(status == 200, "status %d", status);
+    cJSON *root = cJSON_Parse(resp);
+    cJSON *steps = cJSON_GetObjectItem(root, "steps");
+    CHECK(cJSON_GetArraySize(steps) > 0, "no steps: %s", resp);
+    CHECK(cJSON_GetObjectItem(root, "end_us")->valuedouble > 0, "boot not completed");
+    // the fan spin-up must not hold the API back
+    CHECK(cJSON_GetObjectItem(root, "end_us")->valuedouble < 1000000, "boot took %.0f us",
+          cJSON_GetObjectItem(root, "end_us")->valuedouble);
+    // no retained speed on the host, the fan spins up at full speed first
+    CHECK(cJSON_IsFalse(cJSON_GetObjectItem(root, "pwm_restored")), "pwm restored on power-on");
+    CHECK(cJSON_GetObjectItem(root, "pwm_us")->valuedouble <= cJSON_GetObjectItem(root, "start_us")->valuedouble,
+          "pwm driven after the boot steps started");
+    cJSON *step;
+    cJSON_ArrayForEach(step, steps)
+    {
+        const char *name = cJSON_GetObjectItem(step, "name")->valuestring;
+        const char *step_status = cJSON_GetObjectItem(step, "status")->valuestring;
+        CHECK(strcmp(step_status, "ESP_OK") == 0, "step %s: %s", name, step_status);
+        CHECK(cJSON_GetObjectItem(step, "end_us")->valuedouble >= cJSON_GetObjectItem(step, "start_us")->valuedouble,
+              "step %s ends before it starts", name);
+    }
+    cJSON_Delete(root);
+}
+
+static void test_speed_drives_ledc(void)
+{
+    int status = http_client_request(&client, "PUT", "/api/fan/speed", "{\"speed\": 60}", resp, sizeof(resp));
+    CHECK(status == 200, "status %d", status);
+    uint32_t duty;
+    sim_ledc_get(LEDC_HIGH_SPEED_MODE, LEDC_CHANNEL_0, &duty, NULL);
+    // the fan input is inverted: duty 0 is full speed
+    CHECK(duty == 255 * 40 / 100, "duty %u", (unsigned)duty);
+    CHECK(get_number("/api/fan/speed", "speed") == 60, "speed not reported back");
+}
+
+static void test_trace(void)
+{
+    // the speed set by test_speed_drives_ledc is in the trace
+    int status = http_client_request(&client, "GET", "/api/trace", NULL, resp, sizeof(resp));
+    CHECK(status == 200, "status %d", status);
+    CHECK(client.resp_len >= 20 && memcmp(resp, "FTRC", 4) == 0, "not a trace dump");
+    uint16_t num_ids;
+    memcpy(&num_ids, resp + 6, sizeof(num_ids));
+    CHECK(num_ids == TRACE_ID_MAX, "%d event names", num_ids);
+    size_t offset = 20;
+    for (int i = 0; i < num_ids && offset < client.resp_len; i++)
+    {
+        offset += 1 + (uint8_t)resp[offset];
+    }
+    bool found = false;
+    for (; offset + 20 <= client.resp_len; offset += 20)
+    {
+        uint16_t id;
+        uint32_t a0;
+        memcpy(&id, resp + offset + 8, sizeof(id));
+        memcpy(&a0, resp + offset + 12, sizeof(a0));
+        found |= id == TRACE_FAN_SPEED && a0 == 60;
+    }
+    CHECK(found, "no fan_speed event in %d bytes", (int)client.resp_len);
+}
+
+static void test_name_persisted(void)
+{
+    int status = http_client_request(&client, "PUT", "/api/name", "{\"name\": \"host-fan\"}", resp, sizeof(resp));
+    CHECK(status == 200, "status %d", status);
+    status = http_client_request(&client, "GET", "/api/name", NULL, resp, sizeof(resp));
+    CHECK(status == 200 && strstr(resp, "host-fan"), "name %s", resp);
+
+    // persistence runs on the state event task, give it a moment
+    char name[32] = "";
+    int32_t speed = -1;
+    for (int i = 0; i < 100 && (strcmp(name, "host-fan") != 0 || speed != 60); i++)
+    {
+        usleep(10000);
+        nvs_handle_t nvs;
+        if (nvs_open("storage", NVS_READONLY, &nvs) == ESP_OK)
+        {
+            size_t len = sizeof(name);
+            nvs_get_str(nvs, "name", name, &len);
+            nvs_get_i32(nvs, "fan_speed", &speed);
+            nvs_close(nvs);
+        }
+    }
+    CHECK(strcmp(name, "host-fan") == 0, "name in nvs: %s", name);
+    CHECK(speed == 60, "fan_speed in nvs: %d", (int)speed);
+}
+
+static void test_rpm_follows_tach(void)
+{
+    // the rpm timer samples over 3 s, wait for a window that saw the fan at speed
+    int expected = SIM_FAN_MAX_RPM * 60 / 100;
+    int rpm = -1;
+    for (int i = 0; i < 90; i++)
+    {
+        rpm = get_number("/api/rpm/get", "rpm");
+        if (abs(rpm - expected) * 100 <= expected * RPM_TOLERANCE_PERCENT)
+        {
+            break;
+        }
+        usleep(100000);
+    }
+    CHECK(abs(rpm - expected) * 100 <= expected * RPM_TOLERANCE_PERCENT, "rpm %d, expected %d", rpm, expected);
+    CHECK(get_number("/api/state", "stalled") == 0, "stalled while spinning");
+}
+
+static void test_sys_stats(void)
+{
+    // first sample one period after boot, the rpm test waited long enough
+    int status = http_client_request(&client, "GET", "/api/sys/stats", NULL, resp, sizeof(resp));
+    CHECK(status == 200, "status %d", status);
+    cJSON *root = cJSON_Parse(resp);
+    CHECK(cJSON_GetObjectItem(root, "samples")->valueint >= 2, "samples %s", resp);
+    CHECK(cJSON_GetObjectItem(cJSON_GetObjectItem(root, "heap"), "free")->valueint > 0, "no free heap");
+    bool found_httpd = false, found_timer = false;
+    cJSON *task;
+    cJSON_ArrayForEach(task, cJSON_GetObjectItem(root, "tasks"))
+    {
+        const char *name = cJSON_GetObjectItem(task, "name")->valuestring;
+        found_httpd |= strcmp(name, "httpd") == 0;
+        found_timer |= strcmp(name, "Tmr Svc") == 0;
+        cJSON *cpu;
+        cJSON_ArrayForEach(cpu, cJSON_GetObjectItem(task, "cpu"))
+        {
+            CHECK(cpu->valuedouble >= 0 && cpu->valuedouble <= 101, "task %s cpu %f", name, cpu->valuedouble);
+        }
+    }
+    CHECK(found_httpd && found_timer, "tasks missing: %s", resp);
+    cJSON *control = cJSON_GetObjectItem(root, "control");
+    CHECK(cJSON_GetObjectItem(control, "cycles")->valueint > 0, "control loop not running: %s", resp);
+    CHECK(cJSON_GetObjectItem(control, "core")->valueint == CONFIG_FCTL_CONTROL_CORE, "control core %s", resp);
+    cJSON_Delete(root);
+}
+
+static void test_deferred_log(void)
+{
+    static const char *TAG_TEST = "LOG_TEST";
+    ESP_LOGI(TAG_TEST, "fmt [%d|%5s|%-4u|%.2f|%lld|%*d|%zu|%x|%c|%%]", -7, "ab", 3u, 2.5, -123456789012LL, 4, 9, (size_t)42, 255, 'z');
+    // a precision bounds the read of a string without a terminator, like a Wi-Fi ssid
+    static const struct
+    {
+        char ssid[4];
+        char next[4];
+    } unterminated = {{'a', 'b', 'c', 'd'}, "xyz"};
+    ESP_LOGI(TAG_TEST, "str [%.4s|%.*s|%.0s]", unterminated.ssid, 2, unterminated.ssid, unterminated.ssid);
+    for (int i = 0; i < 20; i++)
+    {
+        ESP_LOGW(TAG_TEST, "burst %d", 1);
+    }
+    ESP_LOGW(TAG_TEST, "burst %d", 2);
+    // drained by the log task, suppressed messages are reported once per second
+    vTaskDelay(pdMS_TO_TICKS(1500));
+
+    CHECK(count_in_log("LOG_TEST: fmt [-7|   ab|3   |2.50|-123456789012|   9|42|ff|z|%]\n") == 1, "formatting differs from printf");
+    CHECK(count_in_log("LOG_TEST: str [abcd|ab|]\n") == 1, "string precision differs from printf");
+    CHECK(count_in_log("LOG_TEST: burst 1\n") == CONFIG_FCTL_LOG_RATE_LIMIT, "%d identical messages written",
+          count_in_log("LOG_TEST: burst 1\n"));
+    CHECK(count_in_log("LOG_TEST: burst 2\n") == 1, "distinct message suppressed");
+    CHECK(count_in_log("LOG_TEST: 15 identical messages suppressed") == 1, "no suppression report");
+
+    int status = http_client_request(&client, "GET", "/api/sys/stats", NULL, resp, sizeof(resp));
+    CHECK(status == 200, "status %d", status);
+    cJSON *root = cJSON_Parse(resp);
+    cJSON *log = cJSON_GetObjectItem(root, "log");
+    CHECK(cJSON_GetObjectItem(log, "written")->valueint > 0, "nothing written: %s", resp);
+    CHECK(cJSON_GetObjectItem(log, "suppressed")->valueint >= 15, "suppressed %s", resp);
+    bool found = false;
+    cJSON *tag;
+    cJSON_ArrayForEach(tag, cJSON_GetObjectItem(log, "tags"))
+    {
+        if (strcmp(cJSON_GetObjectItem(tag, "tag")->valuestring, TAG_TEST) == 0)
+        {
+            found = true;
+            CHECK(cJSON_GetObjectItem(tag, "suppressed")->valueint == 15, "tag %s", resp);
+        }
+    }
+    CHECK(found, "tag missing: %s", resp);
+    cJSON_Delete(root);
+}
+
+static void test_led_frames(void)
+{
+    uint8_t frame[CONFIG_FCTL_LED_STRIP_NUM_PIXELS * SIM_PIXEL_BYTES];
+    size_t len = 0;
+    uint32_t frames = sim_rmt_get_last_frame(frame, sizeof(frame), &len);
+    CHECK(frames > 0, "no frame sent");
+    CHECK(len == sizeof(frame), "frame of %d bytes", (int)len);
+    CHECK(get_number("/api/led/stats", "frames") > 0, "no frame rendered");
+}
+
+static void test_wifi(void)
+{
+    int status = http_client_request(&client, "GET", "/api/wifi/scan", NULL, resp, sizeof(resp));
+    cJSON *root = cJSON_Parse(resp);
+    CHECK(status == 200 && cJSON_GetArraySize(root) == 3, "scan %s", resp);
+    cJSON_Delete(root);
+
+    status = http_client_request(&client, "POST", "/api/wifi/sta", "{\"ssid\": \"sim-office\", \"password\": \"secret\"}", resp, sizeof(resp));
+    CHECK(status == 200, "status %d", status);
+    int connected = 0;
+    for (int i = 0; i < 100 && !connected; i++)
+    {
+        usleep(10000);
+        connected = get_number("/api/state", "connected") == 1;
+    }
+    CHECK(connected, "station did not connect");
+}
+
+/* push `temp` to sensor 1 and return the speed the curve settles on */
+static int speed_at(double temp)
+{
+    char body[48];
+    snprintf(body, sizeof(body), "{\"temperature\": %.1f}", temp);
+    int status = http_client_request(&client, "PUT", "/api/sensor/1", body, resp, sizeof(resp));
+    CHECK(status == 200, "status %d", status);
+    // applied by the next control period
+    usleep(3 * CONFIG_FCTL_CONTROL_PERIOD_MS * 1000);
+    return get_number("/api/fan/speed", "speed");
+}
+
+static void test_fan_curve(void)
+{
+    static const char *curve = "{\"sensor\": 1, \"hysteresis\": 3, \"points\": "
+                               "[{\"temp\": 30, \"speed\": 20}, {\"temp\": 50, \"speed\": 60}, {\"temp\": 70, \"speed\": 100}]}";
+    int status = http_client_request(&client, "PUT", "/api/fan/curve", curve, resp, sizeof(resp));
+    CHECK(status == 200, "status %d", status);
+    CHECK(get_number("/api/fan/curve", "enabled") == 1, "curve not enabled");
+
+    int speed = speed_at(20);
+    CHECK(speed == 20, "speed %d below the first point", speed);
+    speed = speed_at(40);
+    CHECK(speed == 40, "speed %d at 40 C", speed);
+    speed = speed_at(45);
+    CHECK(speed == 50, "speed %d at 45 C", speed);
+    // within the hysteresis the speed holds, below it follows the curve shifted by the hysteresis
+    speed = speed_at(43);
+    CHECK(speed == 50, "speed %d at 43 C after 45 C", speed);
+    speed = speed_at(41);
+    CHECK(speed == 48, "speed %d at 41 C after 45 C", speed);
+    // the forced failsafe speed is not taken for the curve's own, rising again follows the curve
+    http_client_request(&client, "PUT", "/api/sensor/2", "{\"temperature\": 90}", resp, sizeof(resp));
+    usleep(5 * CONFIG_FCTL_FAILSAFE_PERIOD_MS * 1000);
+    speed_at(45);
+    http_client_request(&client, "PUT", "/api/sensor/2", "{\"temperature\": 40}", resp, sizeof(resp));
+    http_client_request(&client, "DELETE", "/api/failsafe", NULL, resp, sizeof(resp));
+    speed = get_number("/api/fan/speed", "speed");
+    CHECK(speed == 50, "speed %d at 45 C after a failsafe", speed);
+    // below the failsafe limit
+    speed = speed_at(80);
+    CHECK(speed == 100, "speed %d above the last point", speed);
+
+    nvs_handle_t nvs;
+    size_t len = 0;
+    if (nvs_open("storage", NVS_READONLY, &nvs) == ESP_OK)
+    {
+        nvs_get_blob(nvs, "fan_curve", NULL, &len);
+        nvs_close(nvs);
+    }
+    CHECK(len == 5 + 3 * 3, "curve blob is %d bytes", (int)len);
+
+    status = http_client_request(&client, "PUT", "/api/fan/curve",
+                                 "{\"sensor\": 1, \"points\": [{\"temp\": 50, \"speed\": 20}, {\"temp\": 30, \"speed\": 60}]}",
+                                 resp, sizeof(resp));
+    CHECK(status == 400, "unsorted curve accepted: %d", status);
+    status = http_client_request(&client, "PUT", "/api/sensor/9", "{\"temperature\": 20}", resp, sizeof(resp));
+    CHECK(status == 404, "unknown sensor: %d", status);
+    status = http_client_request(&client, "GET", "/api/sensors", NULL, resp, sizeof(resp));
+    CHECK(status == 200 && strstr(resp, "\"temperature\":\t80"), "sensors %s", resp);
+
+    // a manual speed takes over
+    status = http_client_request(&client, "PUT", "/api/fan/speed", "{\"speed\": 30}", resp, sizeof(resp));
+    CHECK(status == 200, "status %d", status);
+    CHECK(get_number("/api/fan/curve", "enabled") == 0, "curve still enabled");
+    speed = speed_at(60);
+    CHECK(speed == 30, "speed %d after a manual speed", speed);
+}
+
+static int32_t stored_speed(void)
+{
+    int32_t speed = -1;
+    nvs_handle_t nvs;
+    if (nvs_open("storage", NVS_READONLY, &nvs) == ESP_OK)
+    {
+        nvs_get_i32(nvs, "fan_speed", &speed);
+        nvs_close(nvs);
+    }
+    return speed;
+}
+
+/* a reading over the limit forces the safe speed until cleared */
+static void test_failsafe(void)
+{
+    CHECK(get_number("/api/failsafe", "latched") == 0, "latched before a fault");
+    int trips = get_number("/api/failsafe", "trips");
+    int status = http_client_request(&client, "PUT", "/api/sensor/2", "{\"temperature\": 90}", resp, sizeof(resp));
+    CHECK(status == 200, "status %d", status);
+    usleep(5 * CONFIG_FCTL_FAILSAFE_PERIOD_MS * 1000);
+
+    status = http_client_request(&client, "GET", "/api/failsafe", NULL, resp, sizeof(resp));
+    cJSON *root = cJSON_Parse(resp);
+    CHECK(status == 200 && cJSON_IsTrue(cJSON_GetObjectItem(root, "latched")), "not latched: %s", resp);
+    const char *cause = cJSON_GetStringValue(cJSON_GetObjectItem(root, "cause"));
+    CHECK(cause && strcmp(cause, "temperature") == 0, "cause %s", cause ? cause : "missing");
+    CHECK(cJSON_GetNumberValue(cJSON_GetObjectItem(root, "sensor")) == 2, "sensor %s", resp);
+    // within one check period, plus the time to wake and write the duty on a busy host
+    double reaction = cJSON_GetNumberValue(cJSON_GetObjectItem(root, "reaction_max_us"));
+    CHECK(reaction > 0 && reaction <= 3 * CONFIG_FCTL_FAILSAFE_PERIOD_MS * 1000, "reaction %.0f us", reaction);
+    printf("failsafe: reaction %.0f us\n", reaction);
+    cJSON_Delete(root);
+
+    uint32_t duty;
+    sim_ledc_get(LEDC_HIGH_SPEED_MODE, LEDC_CHANNEL_0, &duty, NULL);
+    CHECK(duty == 255 * (100 - CONFIG_FCTL_FAILSAFE_SPEED) / 100, "duty %u", (unsigned)duty);
+    CHECK(get_number("/api/state", "alarm") == 1, "no alarm");
+    // the forced speed is not stored as the setpoint, a reset while latched restores the requested one
+    int32_t stored = stored_speed();
+    CHECK(stored == 30, "fan_speed in nvs while latched: %d", (int)stored);
+    // a lower speed waits for the clear
+    status = http_client_request(&client, "PUT", "/api/fan/speed", "{\"speed\": 30}", resp, sizeof(resp));
+    CHECK(status == 200, "status %d", status);
+    CHECK(get_number("/api/fan/speed", "speed") == CONFIG_FCTL_FAILSAFE_SPEED, "speed below the failsafe");
+    // a speed change that lost the race with the forced write is put right on a later check
+    ledc_set_duty(LEDC_HIGH_SPEED_MODE, LEDC_CHANNEL_0, 255 * (100 - 30) / 100);
+    ledc_update_duty(LEDC_HIGH_SPEED_MODE, LEDC_CHANNEL_0);
+    usleep(5 * CONFIG_FCTL_FAILSAFE_PERIOD_MS * 1000);
+    sim_ledc_get(LEDC_HIGH_SPEED_MODE, LEDC_CHANNEL_0, &duty, NULL);
+    CHECK(duty == 255 * (100 - CONFIG_FCTL_FAILSAFE_SPEED) / 100, "duty %u below the failsafe", (unsigned)duty);
+
+    http_client_request(&client, "PUT", "/api/sensor/2", "{\"temperature\": 40}", resp, sizeof(resp));
+    status = http_client_request(&client, "DELETE", "/api/failsafe", NULL, resp, sizeof(resp));
+    CHECK(status == 200, "status %d", status);
+    usleep(5 * CONFIG_FCTL_FAILSAFE_PERIOD_MS * 1000);
+    CHECK(get_number("/api/failsafe", "latched") == 0, "still latched");
+    CHECK(get_number("/api/failsafe", "trips") == trips + 1, "trips");
+    CHECK(get_number("/api/fan/speed", "speed") == 30, "requested speed not restored");
+    CHECK(get_number("/api/state", "alarm") == 0, "alarm not cleared");
+}
+
+/* the sweep finds the start and run thresholds of the fan model and its linear speed */
+static void test_fan_calibration(void)
+{
+    int status = http_client_request(&client, "POST", "/api/fan/calibration", "{\"step\": 3}", resp, sizeof(resp));
+    CHECK(status == 400, "step 3 accepted: %d", status);
+    status = http_client_request(&client, "PUT", "/api/fan/speed", "{\"rpm\": 1500}", resp, sizeof(resp));
+    CHECK(status == 400, "rpm accepted before calibration: %d", status);
+
+    status = http_client_request(&client, "POST", "/api/fan/calibration", "{\"step\": 25}", resp, sizeof(resp));
+    CHECK(status == 202, "status %d", status);
+    status = http_client_request(&client, "POST", "/api/fan/calibration", NULL, resp, sizeof(resp));
+    CHECK(status == 409, "second sweep: %d", status);
+    cJSON *root = NULL;
+    for (int i = 0; i < 600; i++)
+    {
+        usleep(100000);
+        cJSON_Delete(root);
+        http_client_request(&client, "GET", "/api/fan/calibration", NULL, resp, sizeof(resp));
+        root = cJSON_Parse(resp);
+        const char *state = cJSON_GetStringValue(cJSON_GetObjectItem(root, "state"));
+        if (!state || strcmp(state, "running") != 0)
+        {
+            break;
+        }
+    }
+    const char *state = cJSON_GetStringValue(cJSON_GetObjectItem(root, "state"));
+    CHECK(state && strcmp(state, "done") == 0, "sweep %s", resp);
+    printf("calibration: %.0f ms\n", cJSON_GetNumberValue(cJSON_GetObjectItem(root, "elapsed_ms")));
+    int min_run = (int)(SIM_FAN_RUN_DRIVE * 100 + 24) / 25 * 25;
+    int min_start = (int)(SIM_FAN_START_DRIVE * 100 + 24) / 25 * 25;
+    CHECK(cJSON_GetNumberValue(cJSON_GetObjectItem(root, "min_run")) == min_run, "min_run %s", resp);
+    CHECK(cJSON_GetNumberValue(cJSON_GetObjectItem(root, "min_start")) == min_start, "min_start %s", resp);
+    cJSON *points = cJSON_GetObjectItem(root, "points");
+    CHECK(cJSON_GetArraySize(points) == (100 - min_run) / 25 + 1, "points %s", resp);
+    cJSON *point;
+    cJSON_ArrayForEach(point, points)
+    {
+        int speed = cJSON_GetNumberValue(cJSON_GetObjectItem(point, "speed"));
+        int rpm = cJSON_GetNumberValue(cJSON_GetObjectItem(point, "rpm"));
+        int expected = SIM_FAN_MAX_RPM * speed / 100;
+        CHECK(abs(rpm - expected) * 100 <= expected * RPM_TOLERANCE_PERCENT, "%d%%: rpm %d, expected %d", speed, rpm, expected);
+    }
+    cJSON_Delete(root);
+
+    nvs_handle_t nvs;
+    size_t len = 0;
+    if (nvs_open("storage", NVS_READONLY, &nvs) == ESP_OK)
+    {
+        nvs_get_blob(nvs, "fan_cal", NULL, &len);
+        nvs_close(nvs);
+    }
+    CHECK(len == 4 + 3 * ((100 - min_run) / 25 + 1), "model blob is %d bytes", (int)len);
+    CHECK(get_number("/api/fan/speed", "speed") == 30, "speed before the sweep not restored");
+    CHECK(get_number("/api/state", "stalled") == 0, "stalled after the sweep");
+
+    // feedforward through the model
+    status = http_client_request(&client, "PUT", "/api/fan/speed", "{\"rpm\": 1500}", resp, sizeof(resp));
+    CHECK(status == 200, "status %d", status);
+    int speed = get_number("/api/fan/speed", "speed");
+    CHECK(abs(speed - 50) <= 2, "speed %d for 1500 rpm", speed);
+
+    // a stopped fan is started at the start speed, even for an rpm the run speed would hold
+    http_client_request(&client, "PUT", "/api/fan/speed", "{\"speed\": 0}", resp, sizeof(resp));
+    for (int i = 0; i < 100 && get_number("/api/state", "rpm") != 0; i++)
+    {
+        usleep(100000);
+    }
+    http_client_request(&client, "PUT", "/api/fan/speed", "{\"rpm\": 800}", resp, sizeof(resp));
+    speed = get_number("/api/fan/speed", "speed");
+    CHECK(speed == min_start, "speed %d for 800 rpm from standstill", speed);
+
+    // a manual speed stops a sweep and is not overwritten by the step being applied
+    status = http_client_request(&client, "POST", "/api/fan/calibration", "{\"step\": 25}", resp, sizeof(resp));
+    CHECK(status == 202, "status %d", status);
+    for (int i = 0; i < 100 && get_number("/api/fan/calibration", "speed") == 100; i++)
+    {
+        usleep(100000);
+    }
+    http_client_request(&client, "PUT", "/api/fan/speed", "{\"speed\": 30}", resp, sizeof(resp));
+    usleep(3 * CONFIG_FCTL_CONTROL_PERIOD_MS * 1000);
+    http_client_request(&client, "GET", "/api/fan/calibration", NULL, resp, sizeof(resp));
+    CHECK(strstr(resp, "\"aborted\"") && strstr(resp, "manually"), "sweep %s", resp);
+    usleep(2 * CONFIG_FCTL_FAN_CAL_WINDOW_MS * 1000);
+    CHECK(get_number("/api/fan/speed", "speed") == 30, "manual speed during a sweep not kept");
+
+    // a failsafe trip during a sweep gives the fans back at the operator's speed, not a sweep step
+    status = http_client_request(&client, "POST", "/api/fan/calibration", "{\"step\": 25}", resp, sizeof(resp));
+    CHECK(status == 202, "status %d", status);
+    for (int i = 0; i < 100 && get_number("/api/fan/calibration", "speed") == 100; i++)
+    {
+        usleep(100000);
+    }
+    CHECK(get_number("/api/fan/calibration", "speed") < 100, "sweep did not step down");
+    http_client_request(&client, "PUT", "/api/sensor/2", "{\"temperature\": 90}", resp, sizeof(resp));
+    usleep(5 * CONFIG_FCTL_FAILSAFE_PERIOD_MS * 1000 + 3 * CONFIG_FCTL_CONTROL_PERIOD_MS * 1000);
+    http_client_request(&client, "GET", "/api/fan/calibration", NULL, resp, sizeof(resp));
+    CHECK(strstr(resp, "\"aborted\"") && strstr(resp, "failsafe"), "sweep %s", resp);
+    http_client_request(&client, "PUT", "/api/sensor/2", "{\"temperature\": 40}", resp, sizeof(resp));
+    http_client_request(&client, "DELETE", "/api/failsafe", NULL, resp, sizeof(resp));
+    usleep(5 * CONFIG_FCTL_FAILSAFE_PERIOD_MS * 1000);
+    CHECK(get_number("/api/fan/speed", "speed") == 30, "speed after the aborted sweep");
+    int32_t stored = stored_speed();
+    CHECK(stored == 30, "fan_speed in nvs after the aborted sweep: %d", (int)stored);
+}
+
+/* wait up to `timeout_ms` for TXT item `key` of _fctl._tcp to read `value` */
+static bool wait_txt(const char *key, const char *value, int timeout_ms)
+{
+    char txt[64] = "";
+    for (int waited = 0; waited <= timeout_ms; waited += 10)
+    {
+        if (sim_mdns_get_txt("_fctl", "_tcp", key, txt, sizeof(txt)) && strcmp(txt, value) == 0)
+        {
+            return true;
+        }
+        usleep(10000);
+    }
+    printf("TXT %s is %s, expected %s\n", key, txt, value);
+    return false;
+}
+
+static void test_mdns_advertise(void)
+{
+    char hostname[64];
+    sim_mdns_get_hostname(hostname, sizeof(hostname));
+    CHECK(strcmp(hostname, CONFIG_EXAMPLE_MDNS_HOST_NAME) == 0, "hostname %s", hostname);
+    uint16_t port = 0;
+    CHECK(sim_mdns_get_service("_http", "_tcp", &port) && port == 80, "_http._tcp port %u", port);
+    CHECK(sim_mdns_get_service("_fctl", "_tcp", &port) && port == 80, "_fctl._tcp port %u", port);
+    CHECK(wait_txt("name", "host-fan", 0), "name");
+    CHECK(wait_txt("version", "host", 0), "version");
+
+    int status = http_client_request(&client, "PUT", "/api/fan/speed", "{\"speed\": 70}", resp, sizeof(resp));
+    CHECK(status == 200, "status %d", status);
+    CHECK(wait_txt("speed", "70", CONFIG_FCTL_MDNS_TXT_INTERVAL_MS + 500), "speed after a change");
+
+    // a burst of changes is pushed at most once per interval, speed and rpm each time
+    usleep(CONFIG_FCTL_MDNS_TXT_INTERVAL_MS * 1000);
+    uint32_t updates = sim_mdns_get_txt_updates();
+    int64_t start = esp_timer_get_time();
+    for (int speed = 71; speed <= 80; speed++)
+    {
+        char body[32];
+        snprintf(body, sizeof(body), "{\"speed\": %d}", speed);
+        http_client_request(&client, "PUT", "/api/fan/speed", body, resp, sizeof(resp));
+        usleep(20000);
+    }
+    CHECK(wait_txt("speed", "80", CONFIG_FCTL_MDNS_TXT_INTERVAL_MS + 500), "speed after a burst");
+    int windows = (int)((esp_timer_get_time() - start) / (CONFIG_FCTL_MDNS_TXT_INTERVAL_MS * 1000)) + 1;
+    updates = sim_mdns_get_txt_updates() - updates;
+    CHECK(updates <= 2 * windows, "%u TXT updates over %d intervals", (unsigned)updates, windows);
+}
+
+/* a socket listening on a free loopback port, closed right away when `keep` is false */
+static int listen_loopback(uint16_t *port, bool keep)
+{
+    int fd = socket(AF_INET, SOCK_STREAM, 0);
+    struct sockaddr_in addr = {.sin_family = AF_INET, .sin_addr.s_addr = htonl(INADDR_LOOPBACK)};
+    socklen_t len = sizeof(addr);
+    bind(fd, (struct sockaddr *)&addr, sizeof(addr));
+    listen(fd, 4);
+    getsockname(fd, (struct sockaddr *)&addr, &len);
+    *port = ntohs(addr.sin_port);
+    if (!keep)
+    {
+        close(fd);
+        fd = -1;
+    }
+    return fd;
+}
+
+static cJSON *find_peer(cJSON *peers, const char *instance)
+{
+    cJSON *peer;
+    cJSON_ArrayForEach(peer, peers)
+    {
+        if (strcmp(cJSON_GetStringValue(cJSON_GetObjectItem(peer, "instance")), instance) == 0)
+        {
+            return peer;
+        }
+    }
+    return NULL;
+}
+
+static void test_fleet(void)
+{
+    const uint32_t loopback = ESP_IP4TOADDR(127, 0, 0, 1);
+    uint16_t refused_port, silent_port;
+    listen_loopback(&refused_port, false);
+    // accepts connections in the backlog but never answers
+    int silent = listen_loopback(&silent_port, true);
+    mdns_txt_item_t txt[] = {{"version", "1.2.3"}, {"name", "from-txt"}, {"speed", "40"}};
+    sim_mdns_add_peer("fctl-live", "_fctl", "_tcp", "fctl-live", loopback, sim_httpd_get_port(), txt, 3);
+    sim_mdns_add_peer("fctl-refused", "_fctl", "_tcp", "fctl-refused", loopback, refused_port, txt, 3);
+    sim_mdns_add_peer("fctl-silent", "_fctl", "_tcp", "fctl-silent", loopback, silent_port, txt, 3);
+    // announced without address, and nobody answers the A query
+    sim_mdns_add_peer("fctl-ghost", "_fctl", "_tcp", "fctl-ghost", 0, 80, txt, 3);
+
+    int rounds = get_number("/api/fleet", "rounds");
+    int status = http_client_request(&client, "POST", "/api/fleet", NULL, resp, sizeof(resp));
+    CHECK(status == 202, "status %d", status);
+    int timeout_ms = CONFIG_FCTL_FLEET_BROWSE_MS + 2 * CONFIG_FCTL_FLEET_TIMEOUT_MS + 2000;
+    for (int waited = 0; waited < timeout_ms && get_number("/api/fleet", "rounds") <= rounds; waited += 100)
+    {
+        usleep(100000);
+    }
+    status = http_client_request(&client, "GET", "/api/fleet", NULL, resp, sizeof(resp));
+    CHECK(status == 200, "status %d", status);
+    cJSON *root = cJSON_Parse(resp);
+    CHECK(cJSON_IsTrue(cJSON_GetObjectItem(root, "enabled")), "not enabled");
+    CHECK(cJSON_GetObjectItem(root, "rounds")->valueint > rounds, "no round after the refresh");
+    cJSON *peers = cJSON_GetObjectItem(root, "peers");
+    CHECK(cJSON_GetArraySize(peers) == 4, "%d peers", cJSON_GetArraySize(peers));
+    cJSON *first = cJSON_GetArrayItem(peers, 0);
+    CHECK(first && !strcmp(cJSON_GetStringValue(cJSON_GetObjectItem(first, "instance")), "fctl-ghost"), "not sorted");
+
+    cJSON *live = find_peer(peers, "fctl-live");
+    cJSON *self = cJSON_GetObjectItem(root, "self");
+    CHECK(live && !strcmp(cJSON_GetStringValue(cJSON_GetObjectItem(live, "status")), "ok"), "live peer not fetched");
+    CHECK(live && !strcmp(cJSON_GetStringValue(cJSON_GetObjectItem(live, "name")), "host-fan"), "live peer name from TXT");
+    CHECK(live && !strcmp(cJSON_GetStringValue(cJSON_GetObjectItem(live, "version")), "1.2.3"), "version");
+    CHECK(live && !strcmp(cJSON_GetStringValue(cJSON_GetObjectItem(live, "ip")), "127.0.0.1"), "ip");
+    CHECK(live && cJSON_GetObjectItem(live, "speed")->valueint == cJSON_GetObjectItem(self, "speed")->valueint,
+          "live peer speed %d, own %d", cJSON_GetObjectItem(live, "speed")->valueint, cJSON_GetObjectItem(self, "speed")->valueint);
+
+    cJSON *refused = find_peer(peers, "fctl-refused");
+    CHECK(refused && !strcmp(cJSON_GetStringValue(cJSON_GetObjectItem(refused, "status")), "unreachable"), "refused peer");
+    CHECK(refused && !strcmp(cJSON_GetStringValue(cJSON_GetObjectItem(refused, "name")), "from-txt"), "name from TXT");
+    cJSON *timeout = find_peer(peers, "fctl-silent");
+    CHECK(timeout && !strcmp(cJSON_GetStringValue(cJSON_GetObjectItem(timeout, "status")), "timeout"), "silent peer");
+    int latency = timeout ? cJSON_GetObjectItem(timeout, "latency_ms")->valueint : 0;
+    CHECK(latency >= CONFIG_FCTL_FLEET_TIMEOUT_MS && latency < 2 * CONFIG_FCTL_FLEET_TIMEOUT_MS, "silent peer latency %d", latency);
+    cJSON *ghost = find_peer(peers, "fctl-ghost");
+    CHECK(ghost && !strcmp(cJSON_GetStringValue(cJSON_GetObjectItem(ghost, "status")), "no_address"), "ghost peer");
+
+    // the silent peer and the failed A query overlap with two fetchers
+    int fetch_ms = cJSON_GetObjectItem(root, "round_ms")->valueint - cJSON_GetObjectItem(root, "browse_ms")->valueint;
+    CHECK(fetch_ms < CONFIG_FCTL_FLEET_TIMEOUT_MS + 400, "fetches took %d ms", fetch_ms);
+    printf("fleet: browse %d ms, fetches %d ms\n", cJSON_GetObjectItem(root, "browse_ms")->valueint, fetch_ms);
+    cJSON_Delete(root);
+    close(silent);
+}
+
+static void test_errors(void)
+{
+    int status = http_client_request(&client, "PUT", "/api/unknown", "{}", resp, sizeof(resp));
+    CHECK(status == 405, "status %d", status);
+    status = http_client_request(&client, "GET", "/", NULL, resp, sizeof(resp));
+    CHECK(status == 200 && strlen(resp) > 0, "index status %d", status);
+}
+
+int main(void)
+{
+    char nvs_path[] = "/tmp/fctl_nvs_XXXXXX";
+    int fd = mkstemp(nvs_path);
+    close(fd);
+    remove(nvs_path);
+    setenv("FCTL_NVS_PATH", nvs_path, 1);
+    setenv("FCTL_HTTP_PORT", "0", 1);
+    unsetenv("FCTL_TACH_SCRIPT");
+
+    esp_log_set_vprintf(capture_vprintf);
+    app_main();
+    CHECK(http_client_open(&client, sim_httpd_get_port()) == 0, "connect to port %d failed", sim_httpd_get_port());
+
+    test_state_after_boot();
+    test_boot_profile();
+    test_speed_drives_ledc();
+    test_trace();
+    test_name_persisted();
+    test_rpm_follows_tach();
+    test_sys_stats();
+    test_deferred_log();
+    test_led_frames();
+    test_wifi();
+    test_fan_curve();
+    test_failsafe();
+    test_fan_calibration();
+    test_mdns_advertise();
+    test_fleet();
+    test_errors();
+
+    http_client_close(&client);
+    remove(nvs_path);
+    if (failures)
+    {
+        printf("%d check(s) failed\n", failures);
+        return 1;
+    }
+    printf("all checks passed\n");
+    return 0;
+}
@@ -0,0 +1,45 @@
+/*
+ * Configuration of the Linux host build, mirrors the options of main/Kconfig.projbuild
+ */
+#pragma once
+
+#define CONFIG_IDF_TARGET_LINUX 1
+#define CONFIG_IDF_TARGET "linux"
+#define CONFIG_FREERTOS_HZ 100
+#define CONFIG_FREERTOS_USE_TRACE_FACILITY 1
+#define CONFIG_FREERTOS_GENERATE_RUN_TIME_STATS 1
+#define CONFIG_LOG_DEFAULT_LEVEL 3
+
+#define CONFIG_EXAMPLE_MDNS_HOST_NAME "esp-home"
+#define CONFIG_EXAMPLE_WEB_DEPLOY_SF 1
+#define CONFIG_EXAMPLE_WEB_MOUNT_POINT FCTL_HOST_WWW_DIR
+#define CONFIG_FCTL_LED_STRIP_NUM_PIXELS 1
+#define CONFIG_FCTL_LED_ANIM_INTERVAL_MS 20
+#define CONFIG_FCTL_SYS_STATS_PERIOD_MS 1000
+#define CONFIG_FCTL_TRACE_EVENTS_PER_CORE 256
+#define CONFIG_FCTL_LOG_DEFERRED 1
+#define CONFIG_FCTL_LOG_QUEUE_LEN 32
+#define CONFIG_FCTL_LOG_RATE_LIMIT 5
+#define CONFIG_FCTL_TASK_PLAN 1
+#define CONFIG_FCTL_CONTROL_CORE 1
+#define CONFIG_FCTL_CONTROL_PRIORITY 20
+#define CONFIG_FCTL_NETWORK_CORE 0
+#define CONFIG_FCTL_NETWORK_PRIORITY 5
+#define CONFIG_FCTL_BACKGROUND_PRIORITY 0
+#define CONFIG_FCTL_CONTROL_PERIOD_MS 100
+#define CONFIG_FCTL_FAILSAFE_PERIOD_MS 20
+#define CONFIG_FCTL_FAILSAFE_PRIORITY 21
+#define CONFIG_FCTL_FAILSAFE_SPEED 100
+#define CONFIG_FCTL_FAILSAFE_TEMP_C 85
+#define CONFIG_FCTL_FAILSAFE_HEARTBEAT_MS 500
+#define CONFIG_FCTL_FAN_CAL_WINDOW_MS 500
+#define CONFIG_FCTL_MDNS_TXT_INTERVAL_MS 1000
+// off by default on target, on here so test_firmware covers it
+#define CONFIG_FCTL_FLEET 1
+#define CONFIG_FCTL_FLEET_PERIOD_S 30
+#define CONFIG_FCTL_FLEET_BROWSE_MS 2000
+#define CONFIG_FCTL_FLEET_MAX_PEERS 16
+#define CONFIG_FCTL_FLEET_FETCHERS 2
+#define CONFIG_FCTL_FLEET_TIMEOUT_MS 1500
+#define CONFIG_FCTL_CURVE_MAX_POINTS 8
+#define CONFIG_FCTL_SENSOR_TIMEOUT_S 30
@@ -0,0 +1,263 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include "adc_filter.h"
+
+#define NUM_CHANNELS 3
+#define DECIMATION 64
+#define NUM_FRAMES (DECIMATION * 32)
+#define NUM_OUTPUTS (NUM_FRAMES / DECIMATION)
+
+static int failures = 0;
+
+#define CHECK(cond, fmt, ...)                                                          \
+    do                                                                                 \
+    {                                                                                  \
+        if (!(cond))                                                                   \
+        {                                                                              \
+            printf("%s(%d): " fmt "\n", __FUNCTION__, __LINE__, ##__VA_ARGS__);         \
+            failures++;                                                                \
+        }                                                                              \
+    } while (0)
+
+static uint16_t s_frames[NUM_FRAMES * NUM_CHANNELS];
+static uint16_t s_out[NUM_OUTPUTS * NUM_CHANNELS];
+
+/* deterministic noise in -amplitude..amplitude */
+static int noise(uint32_t *seed, int amplitude)
+{
+    *seed = *seed * 1103515245 + 12345;
+    return (int)((*seed >> 16) % (2 * amplitude + 1)) - amplitude;
+}
+
+static uint16_t clamp12(int v)
+{
+    return v < 0 ? 0 : v > 4095 ? 4095 : v;
+}
+
+static size_t run(size_t order, size_t decimation)
+{
+    adc_cic_t cic;
+    CHECK(adc_cic_init(&cic, NUM_CHANNELS, order, decimation), "order %zu decimation %zu", order, decimation);
+    return adc_cic_process(&cic, s_frames, NUM_FRAMES, s_out, NUM_OUTPUTS);
+}
+
+/* a constant input comes out unchanged on every channel */
+static void test_dc(void)
+{
+    for (size_t i = 0; i < NUM_FRAMES; i++)
+    {
+        s_frames[i * NUM_CHANNELS + 0] = 0;
+        s_frames[i * NUM_CHANNELS + 1] = 1234;
+        s_frames[i * NUM_CHANNELS + 2] = 4095;
+    }
+    for (size_t order = 1; order <= ADC_FILTER_MAX_ORDER; order++)
+    {
+        size_t n = run(order, DECIMATION);
+        CHECK(n == NUM_OUTPUTS, "order %zu: %zu outputs", order, n);
+        // the first outputs of higher orders are still filling the combs
+        for (size_t o = order - 1; o < n; o++)
+        {
+            CHECK(s_out[o * NUM_CHANNELS + 0] == 0 && s_out[o * NUM_CHANNELS + 1] == 1234 && s_out[o * NUM_CHANNELS + 2] == 4095,
+                  "order %zu output %zu: %u %u %u", order, o, s_out[o * NUM_CHANNELS], s_out[o * NUM_CHANNELS + 1],
+                  s_out[o * NUM_CHANNELS + 2]);
+        }
+    }
+}
+
+/* a step settles within `order` outputs */
+static void test_step(void)
+{
+    const size_t step = NUM_FRAMES / 2;
+    for (size_t i = 0; i < NUM_FRAMES; i++)
+    {
+        for (size_t c = 0; c < NUM_CHANNELS; c++)
+        {
+            s_frames[i * NUM_CHANNELS + c] = i < step ? 1000 : 3000;
+        }
+    }
+    size_t n = run(2, DECIMATION);
+    size_t first = step / DECIMATION;
+    for (size_t o = 1; o < n; o++)
+    {
+        uint16_t y = s_out[o * NUM_CHANNELS];
+        if (o < first)
+        {
+            CHECK(y == 1000, "output %zu: %u", o, y);
+        }
+        else if (o >= first + 2)
+        {
+            CHECK(y == 3000, "output %zu: %u", o, y);
+        }
+        else
+        {
+            CHECK(y >= 1000 && y <= 3000, "output %zu: %u", o, y);
+        }
+    }
+}
+
+/* white noise is reduced, ripple whose period divides the decimation is removed */
+static void test_noise_and_ripple(void)
+{
+    uint32_t seed = 1;
+    for (size_t i = 0; i < NUM_FRAMES; i++)
+    {
+        s_frames[i * NUM_CHANNELS + 0] = clamp12(2000 + noise(&seed, 200));
+        s_frames[i * NUM_CHANNELS + 1] = clamp12(2000 + (int)lround(300 * sin(2 * M_PI * i / (DECIMATION / 4))));
+        s_frames[i * NUM_CHANNELS + 2] = 2000;
+    }
+    size_t n = run(2, DECIMATION);
+    int worst_noise = 0, worst_ripple = 0;
+    for (size_t o = 1; o < n; o++)
+    {
+        int d = abs(s_out[o * NUM_CHANNELS + 0] - 2000);
+        worst_noise = d > worst_noise ? d : worst_noise;
+        d = abs(s_out[o * NUM_CHANNELS + 1] - 2000);
+        worst_ripple = d > worst_ripple ? d : worst_ripple;
+        CHECK(s_out[o * NUM_CHANNELS + 2] == 2000, "output %zu: quiet channel %u", o, s_out[o * NUM_CHANNELS + 2]);
+    }
+    // +-200 uniform noise has a deviation of 115, about 12 after the filter
+    CHECK(worst_noise <= 40, "noise %d", worst_noise);
+    CHECK(worst_ripple <= 1, "ripple %d", worst_ripple);
+    printf("noise: +-200 in, %d out; ripple: +-300 in, %d out\n", worst_noise, worst_ripple);
+}
+
+/* order 1 is the rounded mean of each block */
+static void test_order1_is_block_mean(void)
+{
+    uint32_t seed = 7;
+    for (size_t i = 0; i < NUM_FRAMES * NUM_CHANNELS; i++)
+    {
+        s_frames[i] = clamp12(2048 + noise(&seed, 2047));
+    }
+    size_t n = run(1, DECIMATION);
+    for (size_t o = 0; o < n; o++)
+    {
+        for (size_t c = 0; c < NUM_CHANNELS; c++)
+        {
+            uint32_t sum = 0;
+            for (size_t i = o * DECIMATION; i < (o + 1) * DECIMATION; i++)
+            {
+                sum += s_frames[i * NUM_CHANNELS + c];
+            }
+            uint16_t mean = (sum + DECIMATION / 2) / DECIMATION;
+            CHECK(s_out[o * NUM_CHANNELS + c] == mean, "output %zu channel %zu: %u, mean %u", o, c,
+                  s_out[o * NUM_CHANNELS + c], mean);
+        }
+    }
+}
+
+/* the integrators wrap at full scale with the largest gain the firmware allows */
+static void test_full_scale_no_overflow(void)
+{
+    static uint16_t frames[1024 * 8];
+    uint16_t out[8];
+    adc_cic_t cic;
+    CHECK(adc_cic_init(&cic, 1, 2, 1024), "init");
+    for (size_t i = 0; i < 1024 * 8; i++)
+    {
+        frames[i] = 4095;
+    }
+    size_t n = adc_cic_process(&cic, frames, 1024 * 8, out, 8);
+    CHECK(n == 8, "%zu outputs", n);
+    for (size_t o = 1; o < n; o++)
+    {
+        CHECK(out[o] == 4095, "output %zu: %u", o, out[o]);
+    }
+}
+
+/* outputs may come over several calls, split anywhere */
+static void test_split_calls(void)
+{
+    uint32_t seed = 3;
+    for (size_t i = 0; i < NUM_FRAMES * NUM_CHANNELS; i++)
+    {
+        s_frames[i] = clamp12(2048 + noise(&seed, 1000));
+    }
+    size_t n = run(3, DECIMATION);
+    uint16_t whole[NUM_OUTPUTS * NUM_CHANNELS];
+    memcpy(whole, s_out, sizeof(whole));
+
+    adc_cic_t cic;
+    adc_cic_init(&cic, NUM_CHANNELS, 3, DECIMATION);
+    size_t got = 0;
+    for (size_t f = 0; f < NUM_FRAMES;)
+    {
+        size_t chunk = 1 + f % 37;
+        chunk = f + chunk > NUM_FRAMES ? NUM_FRAMES - f : chunk;
+        got += adc_cic_process(&cic, &s_frames[f * NUM_CHANNELS], chunk, &s_out[got * NUM_CHANNELS], NUM_OUTPUTS - got);
+        f += chunk;
+    }
+    CHECK(got == n && memcmp(whole, s_out, sizeof(whole)) == 0, "%zu outputs, %zu in one call", got, n);
+}
+
+static void test_init_limits(void)
+{
+    adc_cic_t cic;
+    CHECK(!adc_cic_init(&cic, 0, 1, 16), "no channels");
+    CHECK(!adc_cic_init(&cic, ADC_FILTER_MAX_CHANNELS + 1, 1, 16), "too many channels");
+    CHECK(!adc_cic_init(&cic, 1, ADC_FILTER_MAX_ORDER + 1, 16), "order");
+    CHECK(!adc_cic_init(&cic, 1, 1, 0), "decimation 0");
+    CHECK(!adc_cic_init(&cic, 1, 3, 128), "gain 2^21 overflows");
+    CHECK(adc_cic_init(&cic, 1, 3, 101) && adc_cic_init(&cic, 1, 2, 1024), "gain 2^20");
+}
+
+static void test_conversions(void)
+{
+    // at R0 the divider sits at half the supply
+    int16_t t = adc_ntc_temp(1650, 3300, 10000, 10000, 3950);
+    CHECK(t == 250, "R0: %d", t);
+    // 10k, B3950 at 50 C is 3588 ohm
+    t = adc_ntc_temp(3300 * 3588 / (10000 + 3588), 3300, 10000, 10000, 3950);
+    CHECK(abs(t - 500) <= 5, "50 C: %d", t);
+    CHECK(adc_ntc_temp(0, 3300, 10000, 10000, 3950) == INT16_MIN, "shorted");
+    CHECK(adc_ntc_temp(3300, 3300, 10000, 10000, 3950) == INT16_MIN, "open");
+    // 100 mOhm, gain 20: 2 V is 1 A
+    CHECK(adc_shunt_ma(2000, 100, 20) == 1000, "shunt %u", (unsigned)adc_shunt_ma(2000, 100, 20));
+}
+
+/* replay a recording: one frame per line, NUM_CHANNELS comma separated raw samples */
+static int replay(const char *path)
+{
+    FILE *f = fopen(path, "r");
+    if (!f)
+    {
+        perror(path);
+        return 1;
+    }
+    adc_cic_t cic;
+    adc_cic_init(&cic, NUM_CHANNELS, 2, DECIMATION);
+    unsigned a, b, c;
+    size_t frames = 0;
+    while (fscanf(f, "%u,%u,%u", &a, &b, &c) == 3)
+    {
+        uint16_t frame[NUM_CHANNELS] = {a, b, c};
+        uint16_t out[NUM_CHANNELS];
+        if (adc_cic_process(&cic, frame, 1, out, 1))
+        {
+            printf("%zu,%u,%u,%u\n", frames, out[0], out[1], out[2]);
+        }
+        frames++;
+    }
+    fclose(f);
+    return 0;
+}
+
+int main(int argc, char **argv)
+{
+    if (argc > 1)
+    {
+        return replay(argv[1]);
+    }
+    test_dc();
+    test_step();
+    test_noise_and_ripple();
+    test_order1_is_block_mean();
+    test_full_scale_no_overflow();
+    test_split_calls();
+    test_init_limits();
+    test_conversions();
+    printf("%s\n", failures ? "FAIL" : "OK");
+    return failures ? 1 : 0;
+}
@@ -0,0 +1,122 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+#include "led_color.h"
+
+#define HSV_TOLERANCE 1
+#define GAMMA_TOLERANCE 4
+
+static int failures = 0;
+
+#define CHECK(cond, fmt, ...)                                                          \
+    do                                                                                 \
+    {                                                                                  \
+        if (!(cond))                                                                   \
+        {                                                                              \
+            printf("%s(%d): " fmt "\n", __FUNCTION__, __LINE__, ##__VA_ARGS__);         \
+            failures++;                                                                \
+        }                                                                              \
+    } while (0)
+
+/* the integer kernel must track the float reference over the whole input range */
+static void test_hsv2rgb_matches_float(void)
+{
+    int worst = 0;
+    for (uint32_t h = 0; h < 360; h++)
+    {
+        for (uint32_t s = 0; s <= 100; s++)
+        {
+            for (uint32_t v = 0; v <= 100; v++)
+            {
+                uint32_t r, g, b;
+                led_strip_hsv2rgb(h, s, v, &r, &g, &b);
+                led_rgb_t rgb = led_color_hsv2rgb(h, s, v);
+                int d = abs((int)r - rgb.r);
+                d = abs((int)g - rgb.g) > d ? abs((int)g - rgb.g) : d;
+                d = abs((int)b - rgb.b) > d ? abs((int)b - rgb.b) : d;
+                worst = d > worst ? d : worst;
+                CHECK(d <= HSV_TOLERANCE, "h=%u s=%u v=%u float=(%u,%u,%u) int=(%u,%u,%u)",
+                      h, s, v, r, g, b, rgb.r, rgb.g, rgb.b);
+            }
+        }
+    }
+    printf("hsv2rgb: worst channel difference %d\n", worst);
+}
+
+static void test_span_matches_scalar(void)
+{
+    led_hsv_t hsv[360];
+    led_rgb_t rgb[360];
+    for (int i = 0; i < 360; i++)
+    {
+        hsv[i] = (led_hsv_t){.h = i, .s = i % 101, .v = 100 - i % 101};
+    }
+    led_color_hsv2rgb_span(hsv, rgb, 360);
+    for (int i = 0; i < 360; i++)
+    {
+        led_rgb_t one = led_color_hsv2rgb(hsv[i].h, hsv[i].s, hsv[i].v);
+        CHECK(one.r == rgb[i].r && one.g == rgb[i].g && one.b == rgb[i].b, "pixel %d", i);
+    }
+}
+
+/* out of range inputs wrap the hue and clamp saturation and value, like the scalar conversion */
+static void test_span_out_of_range(void)
+{
+    const led_hsv_t hsv[] = {
+        {.h = 360, .s = 100, .v = 100},
+        {.h = 420, .s = 150, .v = 255},
+        {.h = 719, .s = 255, .v = 50},
+        {.h = 65535, .s = 40, .v = 101},
+    };
+    const led_hsv_t wrapped[] = {
+        {.h = 0, .s = 100, .v = 100},
+        {.h = 60, .s = 100, .v = 100},
+        {.h = 359, .s = 100, .v = 50},
+        {.h = 65535 % 360, .s = 40, .v = 100},
+    };
+    led_rgb_t rgb[4];
+    led_color_hsv2rgb_span(hsv, rgb, 4);
+    for (int i = 0; i < 4; i++)
+    {
+        led_rgb_t one = led_color_hsv2rgb(wrapped[i].h, wrapped[i].s, wrapped[i].v);
+        CHECK(one.r == rgb[i].r && one.g == rgb[i].g && one.b == rgb[i].b, "pixel %d: %u %u %u", i, rgb[i].r, rgb[i].g,
+              rgb[i].b);
+        one = led_color_hsv2rgb(hsv[i].h, hsv[i].s, hsv[i].v);
+        CHECK(one.r == rgb[i].r && one.g == rgb[i].g && one.b == rgb[i].b, "scalar pixel %d", i);
+    }
+}
+
+static void test_gamma_table(void)
+{
+    CHECK(led_color_gamma8(0) == 0, "gamma(0) = %d", led_color_gamma8(0));
+    CHECK(led_color_gamma8(255) == 255, "gamma(255) = %d", led_color_gamma8(255));
+    for (int x = 0; x < 256; x++)
+    {
+        int expected = (int)lround(pow(x / 255.0, 2.2) * 255.0);
+        CHECK(abs(expected - led_color_gamma8(x)) <= GAMMA_TOLERANCE, "gamma(%d) = %d, expected %d", x, led_color_gamma8(x), expected);
+        if (x > 0)
+        {
+            CHECK(led_color_gamma8(x) >= led_color_gamma8(x - 1), "gamma not monotone at %d", x);
+        }
+    }
+}
+
+static void test_gamma_span_brightness(void)
+{
+    led_rgb_t rgb[2] = {{255, 128, 0}, {255, 255, 255}};
+    led_color_gamma_span(rgb, 2, 25);
+    CHECK(rgb[0].r == 25 && rgb[0].b == 0, "(%d,%d,%d)", rgb[0].r, rgb[0].g, rgb[0].b);
+    CHECK(rgb[0].g < rgb[0].r / 2, "mid channel not corrected: %d", rgb[0].g);
+    CHECK(rgb[1].r == 25 && rgb[1].g == 25 && rgb[1].b == 25, "(%d,%d,%d)", rgb[1].r, rgb[1].g, rgb[1].b);
+}
+
+int main(void)
+{
+    test_hsv2rgb_matches_float();
+    test_span_matches_scalar();
+    test_span_out_of_range();
+    test_gamma_table();
+    test_gamma_span_brightness();
+    printf("%s\n", failures ? "FAIL" : "OK");
+    return failures ? 1 : 0;
+}
@@ -0,0 +1,90 @@
+#!/usr/bin/env python3
+"""Convert a dump of GET /api/trace to the Chrome trace event format.
+
+    python tools/trace_to_chrome.py http://esp-home.local/api/trace -o trace.json
+    python tools/trace_to_chrome.py trace.bin > trace.json
+
+Open the result in chrome://tracing or https://ui.perfetto.dev. Each core is a thread.
+"""
+import argparse
+import json
+import re
+import struct
+import sys
+import urllib.request
+
+HEADER = struct.Struct('<4sHHHHQ')
+RECORD = struct.Struct('<IIHBBII')
+FLAG_INSTANT = 0x01
+
+
+def parse(data):
+    magic, version, num_ids, num_cores, record_size, now_us = HEADER.unpack_from(data)
+    if magic != b'FTRC' or version != 1 or record_size != RECORD.size:
+        raise ValueError('not a version 1 trace dump')
+    offset = HEADER.size
+
+    names = []
+    for _ in range(num_ids):
+        length = data[offset]
+        match = re.fullmatch(r'(\w+)(?:\((\w*),(\w*)\))?', data[offset + 1:offset + 1 + length].decode())
+        names.append((match.group(1), match.group(2) or 'a0', match.group(3) or 'a1'))
+        offset += 1 + length
+
+    events = []
+    for ts_us, dur_us, event_id, core, flags, a0, a1 in RECORD.iter_unpack(data[offset:]):
+        name, label0, label1 = names[event_id] if event_id < len(names) else ('event_%d' % event_id, 'a0', 'a1')
+        # timestamps are the low 32 bits of the time since boot
+        ts = now_us - ((now_us - ts_us) & 0xffffffff)
+        event = {
+            'name': name,
+            'ts': ts,
+            'pid': 0,
+            'tid': core,
+            'args': {label0: decode_arg(label0, a0), label1: decode_arg(label1, a1)},
+        }
+        if flags & FLAG_INSTANT:
+            event.update(ph='i', s='t')
+        else:
+            event.update(ph='X', dur=dur_us)
+        events.append(event)
+    events.sort(key=lambda e: e['ts'])
+
+    for core in range(num_cores):
+        events.append({'name': 'thread_name', 'ph': 'M', 'pid': 0, 'tid': core, 'args': {'name': 'core %d' % core}})
+    return {'traceEvents': events, 'displayTimeUnit': 'ms'}
+
+
+def decode_arg(label, value):
+    if label == 'key':
+        # trace_tag(): first four characters of the key
+        return value.to_bytes(4, 'little').rstrip(b'\0').decode(errors='replace')
+    if label == 'err':
+        return struct.unpack('<i', struct.pack('<I', value))[0]
+    return value
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__, formatter_class=argparse.RawDescriptionHelpFormatter)
+    parser.add_argument('source', help='dump file or URL of /api/trace')
+    parser.add_argument('-o', '--output', help='output file, stdout by default')
+    args = parser.parse_args()
+
+    if re.match(r'https?://', args.source):
+        with urllib.request.urlopen(args.source, timeout=10) as resp:
+            data = resp.read()
+    else:
+        with open(args.source, 'rb') as f:
+            data = f.read()
+
+    trace = parse(data)
+    out = open(args.output, 'w') if args.output else sys.stdout
+    json.dump(trace, out, indent=1)
+    out.write('\n')
+    if args.output:
+        out.close()
+        print('%d events written to %s' % (len(trace['traceEvents']), args.output), file=sys.stderr)
+
+
+if __name__ == '__main__':
+    main()